@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/io.h"
+#include "../source/ui/error.h"
+#include "../source/ui/section/task/task.h"
+#include "test.h"
+
+// Times a copy with a single buffer against the pipelined reader, with per-block latency on either side standing in
+// for the SD card, the network or AM. The local profile marks both streams local, which keeps the copy serial; the
+// no latency profile shows what pipelining it would cost.
+
+#define COPY_SIZE (32 * 1024 * 1024)
+#define BUFFER_SIZE (256 * 1024)
+#define RUNS 5
+
+typedef struct {
+    const char* name;
+    u32 readDelayUs;
+    u32 writeDelayUs;
+    bool local;
+} bench_profile;
+
+static const bench_profile profiles[] = {
+    {"local", 0, 0, true},
+    {"no latency", 0, 0, false},
+    {"slow source", 1000, 250, false},
+    {"slow destination", 250, 1000, false},
+    {"balanced", 1000, 1000, false},
+};
+
+static u8* srcData;
+static const bench_profile* currProfile;
+
+static Result bench_src_get_size(io_stream* stream, u64* size) {
+    *size = COPY_SIZE;
+    return 0;
+}
+
+static Result bench_src_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    if(size > COPY_SIZE - offset) {
+        size = (u32) (COPY_SIZE - offset);
+    }
+
+    if(currProfile->readDelayUs > 0) {
+        usleep(currProfile->readDelayUs);
+    }
+
+    memcpy(buffer, srcData + offset, size);
+    *bytesRead = size;
+    return 0;
+}
+
+static Result bench_dst_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    if(currProfile->writeDelayUs > 0) {
+        usleep(currProfile->writeDelayUs);
+    }
+
+    *bytesWritten = size;
+    return 0;
+}
+
+static const io_ops bench_src_ops = {
+    .getSize = bench_src_get_size,
+    .read = bench_src_read,
+    .write = NULL,
+    .close = NULL
+};
+
+static const io_ops bench_dst_ops = {
+    .getSize = NULL,
+    .read = NULL,
+    .write = bench_dst_write,
+    .close = NULL
+};
+
+static const io_ops bench_local_src_ops = {
+    .getSize = bench_src_get_size,
+    .read = bench_src_read,
+    .write = NULL,
+    .close = NULL,
+    .local = true
+};
+
+static const io_ops bench_local_dst_ops = {
+    .getSize = NULL,
+    .read = NULL,
+    .write = bench_dst_write,
+    .close = NULL,
+    .local = true
+};
+
+static Result bench_is_src_directory(void* data, u32 index, bool* isDirectory) {
+    *isDirectory = false;
+    return 0;
+}
+
+static Result bench_make_dst_directory(void* data, u32 index) {
+    return 0;
+}
+
+static Result bench_open_src(void* data, u32 index, io_stream** stream) {
+    return io_open(stream, currProfile->local ? &bench_local_src_ops : &bench_src_ops, NULL, 0, 0);
+}
+
+static Result bench_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    return io_open(stream, currProfile->local ? &bench_local_dst_ops : &bench_dst_ops, NULL, 0, 0);
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_copy_once(u32 bufferCount) {
+    data_op_data op;
+    memset(&op, 0, sizeof(op));
+
+    op.op = DATAOP_COPY;
+    op.total = 1;
+    op.bufferSize = BUFFER_SIZE;
+    op.bufferCount = bufferCount;
+    op.copyEmpty = true;
+
+    op.batch = true;
+    op.headless = true;
+
+    op.isSrcDirectory = bench_is_src_directory;
+    op.makeDstDirectory = bench_make_dst_directory;
+    op.openSrc = bench_open_src;
+    op.openDst = bench_open_dst;
+
+    double start = bench_now();
+    TEST_CHECK_RESULT(task_data_op_run(&op));
+    double elapsed = bench_now() - start;
+
+    TEST_CHECK(op.copiedBytes == COPY_SIZE);
+
+    return elapsed;
+}
+
+static double bench_copy(u32 bufferCount) {
+    double best = 0;
+    for(u32 i = 0; i < RUNS; i++) {
+        double elapsed = bench_copy_once(bufferCount);
+        if(i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return best;
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+
+    srcData = (u8*) malloc(COPY_SIZE);
+    TEST_CHECK(srcData != NULL);
+    memset(srcData, 0xA5, COPY_SIZE);
+
+    printf("%d MiB in %d KiB blocks, best of %d runs\n", COPY_SIZE / (1024 * 1024), BUFFER_SIZE / 1024, RUNS);
+    printf("%-18s %14s %14s %8s\n", "profile", "serial MiB/s", "4 bufs MiB/s", "speedup");
+
+    for(u32 i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        currProfile = &profiles[i];
+
+        double serial = bench_copy(1);
+        double pipelined = bench_copy(4);
+
+        printf("%-18s %14.1f %14.1f %7.2fx\n", currProfile->name, COPY_SIZE / (1024.0 * 1024.0) / serial, COPY_SIZE / (1024.0 * 1024.0) / pipelined,
+               serial / pipelined);
+    }
+
+    free(srcData);
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    return 0;
+}
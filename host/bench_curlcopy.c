@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/http.h"
+#include "../source/ui/error.h"
+#include "hosthttpc.h"
+#include "httpserver.h"
+#include "test.h"
+
+// Downloads through the curl fallback of http_download_callback and counts how many of the bytes handed to the
+// callback were first copied into the staging buffer, rather than passed straight from curl's receive buffer. The
+// first block is always delivered whole from the staging buffer, so its address identifies every later staged
+// delivery. Staging everything would be 1.00 bytes copied per byte downloaded.
+
+#define DOWNLOAD_SIZE (8 * 1024 * 1024)
+
+typedef struct {
+    const char* name;
+    u32 chunkSize;
+    u32 chunkDelayUs;
+} bench_profile;
+
+static const bench_profile profiles[] = {
+    {"bulk", 0, 0},
+    {"trickle", 1024, 50},
+};
+
+static host_http_resource resource = {"/download.cia", NULL, DOWNLOAD_SIZE, NULL, NULL, false};
+static char baseUrl[64];
+
+typedef struct {
+    const u8* staging;
+    u64 total;
+    u64 staged;
+    u32 calls;
+} bench_download;
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Result bench_callback(void* userData, void* buffer, size_t size) {
+    bench_download* download = (bench_download*) userData;
+
+    TEST_CHECK(download->total + size <= DOWNLOAD_SIZE);
+    TEST_CHECK(memcmp(buffer, (const u8*) resource.body + download->total, size) == 0);
+
+    if(download->calls == 0) {
+        download->staging = (const u8*) buffer;
+    }
+
+    if(buffer == download->staging) {
+        download->staged += size;
+    }
+
+    download->total += size;
+    download->calls++;
+    return 0;
+}
+
+static void bench_run(const bench_profile* profile, u32 bufferSize) {
+    char url[128];
+    snprintf(url, sizeof(url), "%s%s", baseUrl, resource.path);
+
+    host_http_server_set_chunk_size(profile->chunkSize);
+    host_http_server_set_delays(0, profile->chunkDelayUs);
+
+    bench_download download;
+    memset(&download, 0, sizeof(download));
+
+    double start = bench_now();
+    TEST_CHECK_RESULT(http_download_callback(url, bufferSize, NULL, &download, bench_callback));
+    double elapsed = bench_now() - start;
+
+    TEST_CHECK(download.total == DOWNLOAD_SIZE);
+
+    printf("%-8s %8lu %8lu %12.1f %10.2f %8.1f\n", profile->name, (unsigned long) (bufferSize / 1024), (unsigned long) download.calls,
+           download.total / 1024.0 / download.calls, (double) download.staged / download.total, DOWNLOAD_SIZE / (1024.0 * 1024.0) / elapsed);
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+
+    u8* body = (u8*) malloc(DOWNLOAD_SIZE);
+    TEST_CHECK(body != NULL);
+
+    for(u32 i = 0; i < DOWNLOAD_SIZE; i++) {
+        body[i] = (u8) rand();
+    }
+
+    resource.body = body;
+
+    host_http_server_start(&resource, 1, baseUrl, sizeof(baseUrl));
+    host_httpc_set_tls_failure(true);
+
+    printf("%d MiB through curl\n", DOWNLOAD_SIZE / (1024 * 1024));
+    printf("%-8s %8s %8s %12s %10s %8s\n", "profile", "buf KiB", "calls", "KiB per call", "copied/B", "MiB/s");
+
+    const u32 bufferSizes[] = {64 * 1024, 256 * 1024, 1024 * 1024};
+    for(u32 i = 0; i < sizeof(profiles) / sizeof(*profiles); i++) {
+        for(u32 j = 0; j < sizeof(bufferSizes) / sizeof(*bufferSizes); j++) {
+            bench_run(&profiles[i], bufferSizes[j]);
+        }
+    }
+
+    host_httpc_set_tls_failure(false);
+    host_http_server_stop();
+
+    free(body);
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/http.h"
+#include "../source/ui/error.h"
+#include "hosthttpc.h"
+#include "httpserver.h"
+#include "test.h"
+
+// Fetches a run of small resources from one host, one after the other, and reports how many connections that took and
+// the time to first byte. The loopback server waits on every new connection, standing in for the TCP and TLS
+// handshakes. Only the curl fallback pools its connections; httpc contexts serve a single request each.
+
+#define RESOURCE_COUNT 32
+#define RESOURCE_SIZE (24 * 1024)
+#define BUFFER_SIZE (16 * 1024)
+#define HANDSHAKE_DELAY_US 30000
+
+typedef struct {
+    const char* name;
+    bool curl;
+    bool pooled;
+} bench_mode;
+
+static const bench_mode modes[] = {
+    {"httpc", false, true},
+    {"curl, unpooled", true, false},
+    {"curl, pooled", true, true},
+};
+
+static host_http_resource resources[RESOURCE_COUNT];
+static char paths[RESOURCE_COUNT][32];
+static u8* body;
+
+static char baseUrl[64];
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    double firstByte;
+    u32 size;
+} bench_fetch;
+
+static Result bench_callback(void* userData, void* buffer, size_t size) {
+    bench_fetch* fetch = (bench_fetch*) userData;
+
+    if(fetch->size == 0) {
+        fetch->firstByte = bench_now();
+    }
+
+    fetch->size += size;
+    return 0;
+}
+
+static void bench_run(const bench_mode* mode) {
+    host_httpc_set_tls_failure(mode->curl);
+
+    // Without http_init there is no pool, and every curl transfer gets a fresh handle.
+    if(mode->pooled) {
+        http_init();
+    }
+
+    host_http_server_reset_stats();
+
+    double firstByteTotal = 0;
+    double start = bench_now();
+
+    for(u32 i = 0; i < RESOURCE_COUNT; i++) {
+        char url[128];
+        snprintf(url, sizeof(url), "%s%s", baseUrl, resources[i].path);
+
+        bench_fetch fetch = {0, 0};
+
+        double requestStart = bench_now();
+        TEST_CHECK_RESULT(http_download_callback(url, BUFFER_SIZE, NULL, &fetch, bench_callback));
+        TEST_CHECK(fetch.size == RESOURCE_SIZE);
+
+        firstByteTotal += fetch.firstByte - requestStart;
+    }
+
+    double elapsed = bench_now() - start;
+
+    if(mode->pooled) {
+        http_exit();
+    }
+
+    host_http_stats stats;
+    host_http_server_get_stats(&stats);
+
+    printf("%-16s %12lu %14.1f %12.1f\n", mode->name, (unsigned long) stats.connections, firstByteTotal * 1000 / RESOURCE_COUNT, elapsed * 1000);
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+
+    TEST_CHECK((body = (u8*) malloc(RESOURCE_SIZE)) != NULL);
+    for(u32 i = 0; i < RESOURCE_SIZE; i++) {
+        body[i] = (u8) rand();
+    }
+
+    for(u32 i = 0; i < RESOURCE_COUNT; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/icon/%lu.png", (unsigned long) i);
+
+        resources[i].path = paths[i];
+        resources[i].body = body;
+        resources[i].size = RESOURCE_SIZE;
+    }
+
+    host_http_server_start(resources, RESOURCE_COUNT, baseUrl, sizeof(baseUrl));
+    host_http_server_set_delays(HANDSHAKE_DELAY_US, 0);
+
+    printf("%d requests of %d KiB, %d ms per handshake\n", RESOURCE_COUNT, RESOURCE_SIZE / 1024, HANDSHAKE_DELAY_US / 1000);
+    printf("%-16s %12s %14s %12s\n", "client", "connections", "mean TTFB ms", "total ms");
+
+    for(u32 i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+        bench_run(&modes[i]);
+    }
+
+    host_httpc_set_tls_failure(false);
+    host_http_server_stop();
+
+    free(body);
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/http.h"
+#include "../source/ui/error.h"
+#include "httpserver.h"
+#include "test.h"
+
+// Reads a compressed body through http_read from the loopback server, so it goes through http_read_compressed and its
+// 32 KiB input buffer, which is refilled only once inflate has drained it. The body is served gzipped, zlib-wrapped,
+// as raw deflate (which takes the retry after the zlib header fails to parse) and uncompressed.
+
+#define BODY_SIZE (32 * 1024 * 1024)
+
+typedef struct {
+    const char* name;
+    const char* contentEncoding;
+    // Passed to deflateInit2; 0 serves the body as is.
+    int windowBits;
+} bench_encoding;
+
+static const bench_encoding encodings[] = {
+    {"gzip", "gzip", MAX_WBITS + 16},
+    {"deflate", "deflate", MAX_WBITS},
+    {"raw deflate", "deflate", -MAX_WBITS},
+    {"identity", NULL, 0},
+};
+
+#define ENCODING_COUNT (sizeof(encodings) / sizeof(*encodings))
+
+static host_http_resource resources[ENCODING_COUNT];
+static char paths[ENCODING_COUNT][32];
+
+static char baseUrl[64];
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_run(u32 index, u32 readSize, uLong expectedCrc) {
+    char url[128];
+    snprintf(url, sizeof(url), "%s%s", baseUrl, resources[index].path);
+
+    u8* buffer = (u8*) malloc(readSize);
+    TEST_CHECK(buffer != NULL);
+
+    double start = bench_now();
+
+    http_context context = NULL;
+    TEST_CHECK_RESULT(http_open(&context, url, true));
+
+    uLong crc = crc32(0, Z_NULL, 0);
+    u64 total = 0;
+
+    u32 bytesRead = 0;
+    do {
+        TEST_CHECK_RESULT(http_read(context, &bytesRead, buffer, readSize));
+
+        crc = crc32(crc, buffer, bytesRead);
+        total += bytesRead;
+    } while(bytesRead > 0);
+
+    TEST_CHECK_RESULT(http_close(context));
+
+    double elapsed = bench_now() - start;
+
+    TEST_CHECK(total == BODY_SIZE);
+    TEST_CHECK(crc == expectedCrc);
+
+    free(buffer);
+
+    return BODY_SIZE / (1024.0 * 1024.0) / elapsed;
+}
+
+// Something like a JSON catalogue: repetitive keys around varying values.
+static void bench_make_body(u8* body, u32 size) {
+    u32 pos = 0;
+    u32 index = 0;
+
+    srand(5);
+    while(pos < size) {
+        char record[256];
+        int length = snprintf(record, sizeof(record), "{\"id\": %lu, \"titleid\": \"00040000%08X\", \"name\": \"Title %d\", \"size\": %d, \"author\": \"Author %d\"},\n",
+                              (unsigned long) index, rand(), rand() % 100000, rand(), rand() % 500);
+
+        u32 copySize = size - pos < (u32) length ? size - pos : (u32) length;
+        memcpy(body + pos, record, copySize);
+
+        pos += copySize;
+        index++;
+    }
+}
+
+static u8* bench_compress(const u8* data, u32 size, int windowBits, u32* compressedSize) {
+    z_stream deflateStream;
+    memset(&deflateStream, 0, sizeof(deflateStream));
+    TEST_CHECK(deflateInit2(&deflateStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+
+    uLong bound = deflateBound(&deflateStream, size);
+    u8* compressed = (u8*) malloc(bound);
+    TEST_CHECK(compressed != NULL);
+
+    deflateStream.next_in = (u8*) data;
+    deflateStream.avail_in = size;
+    deflateStream.next_out = compressed;
+    deflateStream.avail_out = (uInt) bound;
+
+    TEST_CHECK(deflate(&deflateStream, Z_FINISH) == Z_STREAM_END);
+
+    *compressedSize = (u32) deflateStream.total_out;
+    deflateEnd(&deflateStream);
+
+    return compressed;
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+
+    u8* body = (u8*) malloc(BODY_SIZE);
+    TEST_CHECK(body != NULL);
+
+    bench_make_body(body, BODY_SIZE);
+    uLong expectedCrc = crc32(crc32(0, Z_NULL, 0), body, BODY_SIZE);
+
+    for(u32 i = 0; i < ENCODING_COUNT; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/catalogue/%lu.json", (unsigned long) i);
+
+        resources[i].path = paths[i];
+        resources[i].contentEncoding = encodings[i].contentEncoding;
+
+        if(encodings[i].windowBits != 0) {
+            resources[i].body = bench_compress(body, BODY_SIZE, encodings[i].windowBits, &resources[i].size);
+        } else {
+            resources[i].body = body;
+            resources[i].size = BODY_SIZE;
+        }
+    }
+
+    host_http_server_start(resources, ENCODING_COUNT, baseUrl, sizeof(baseUrl));
+
+    printf("%d MiB body, %.1f MiB gzipped, read through http_read\n", BODY_SIZE / (1024 * 1024), resources[0].size / (1024.0 * 1024.0));
+
+    printf("%-10s", "read size");
+    for(u32 i = 0; i < ENCODING_COUNT; i++) {
+        printf(" %12s", encodings[i].name);
+    }
+
+    printf("   (MiB/s)\n");
+
+    const u32 readSizes[] = {512, 4 * 1024, 64 * 1024, 256 * 1024};
+    for(u32 i = 0; i < sizeof(readSizes) / sizeof(readSizes[0]); i++) {
+        printf("%-10lu", (unsigned long) readSizes[i]);
+
+        for(u32 j = 0; j < ENCODING_COUNT; j++) {
+            printf(" %12.1f", bench_run(j, readSizes[i], expectedCrc));
+        }
+
+        printf("\n");
+    }
+
+    host_http_server_stop();
+
+    for(u32 i = 0; i < ENCODING_COUNT; i++) {
+        if(resources[i].body != body) {
+            free((void*) resources[i].body);
+        }
+    }
+
+    free(body);
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    return 0;
+}
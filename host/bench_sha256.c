@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/sha256.h"
+#include "test.h"
+
+// Measures SHA-256 throughput at the write sizes CIA installs feed it, against a textbook implementation that expands
+// the full 64-word message schedule up front.
+
+#define HASH_SIZE (64 * 1024 * 1024)
+
+static const u32 reference_k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#define REF_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void reference_block(u32* state, const u8* block) {
+    u32 w[64];
+    for(u32 i = 0; i < 16; i++) {
+        w[i] = ((u32) block[i * 4] << 24) | ((u32) block[i * 4 + 1] << 16) | ((u32) block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+
+    for(u32 i = 16; i < 64; i++) {
+        u32 s0 = REF_ROR(w[i - 15], 7) ^ REF_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        u32 s1 = REF_ROR(w[i - 2], 17) ^ REF_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    u32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+    for(u32 i = 0; i < 64; i++) {
+        u32 t1 = h + (REF_ROR(e, 6) ^ REF_ROR(e, 11) ^ REF_ROR(e, 25)) + ((e & f) ^ (~e & g)) + reference_k[i] + w[i];
+        u32 t2 = (REF_ROR(a, 2) ^ REF_ROR(a, 13) ^ REF_ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+// Whole blocks only, which is all the benchmark feeds it.
+static void reference_hash(const u8* data, u32 size, u32* state) {
+    static const u32 init[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+    memcpy(state, init, sizeof(init));
+
+    for(u32 offset = 0; offset + SHA256_BLOCK_SIZE <= size; offset += SHA256_BLOCK_SIZE) {
+        reference_block(state, data + offset);
+    }
+}
+
+static void bench_check_vector(const char* input, u32 repeat, const char* expected) {
+    sha256_context context;
+    sha256_init(&context);
+
+    for(u32 i = 0; i < repeat; i++) {
+        sha256_update(&context, input, (u32) strlen(input));
+    }
+
+    u8 hash[SHA256_HASH_SIZE];
+    sha256_final(&context, hash);
+
+    char hex[SHA256_HASH_SIZE * 2 + 1];
+    for(u32 i = 0; i < SHA256_HASH_SIZE; i++) {
+        snprintf(&hex[i * 2], 3, "%02x", hash[i]);
+    }
+
+    TEST_CHECK(strcmp(hex, expected) == 0);
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, const char* argv[]) {
+    bench_check_vector("", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    bench_check_vector("abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    bench_check_vector("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    bench_check_vector("a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    u8* data = (u8*) malloc(HASH_SIZE);
+    TEST_CHECK(data != NULL);
+
+    srand(4);
+    for(u32 i = 0; i < HASH_SIZE; i++) {
+        data[i] = (u8) rand();
+    }
+
+    printf("%d MiB\n", HASH_SIZE / (1024 * 1024));
+
+    const u32 chunkSizes[] = {1, 61, 4 * 1024, 256 * 1024};
+    u8 hash[SHA256_HASH_SIZE];
+    for(u32 i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); i++) {
+        // Byte-at-a-time updates only walk a slice, which is plenty to show their overhead.
+        u32 size = chunkSizes[i] < 64 ? HASH_SIZE / 16 : HASH_SIZE;
+
+        double start = bench_now();
+
+        sha256_context context;
+        sha256_init(&context);
+        for(u32 offset = 0; offset < size; offset += chunkSizes[i]) {
+            sha256_update(&context, data + offset, chunkSizes[i] < size - offset ? chunkSizes[i] : size - offset);
+        }
+        sha256_final(&context, hash);
+
+        double elapsed = bench_now() - start;
+        printf("sha256, %6lu byte updates:  %8.1f MiB/s\n", (unsigned long) chunkSizes[i], size / (1024.0 * 1024.0) / elapsed);
+    }
+
+    // The state after the whole buffer must match, or the comparison is meaningless.
+    double start = bench_now();
+
+    sha256_context context;
+    sha256_init(&context);
+    sha256_update(&context, data, HASH_SIZE);
+
+    double elapsed = bench_now() - start;
+    printf("sha256, whole buffer:       %8.1f MiB/s\n", HASH_SIZE / (1024.0 * 1024.0) / elapsed);
+
+    u32 referenceState[8];
+    start = bench_now();
+    reference_hash(data, HASH_SIZE, referenceState);
+    elapsed = bench_now() - start;
+    printf("reference, whole buffer:    %8.1f MiB/s\n", HASH_SIZE / (1024.0 * 1024.0) / elapsed);
+
+    TEST_CHECK(memcmp(context.state, referenceState, sizeof(referenceState)) == 0);
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/jsonstream.h"
+#include "../source/core/stringutil.h"
+#include "../source/ui/error.h"
+#include "test.h"
+
+#ifdef BENCH_JSON_PARSER
+#include "json.h"
+#endif
+
+// Parses a generated 10,000-entry TitleDB catalogue with the streaming parser, fed in download-sized chunks, and pulls
+// out the fields the TitleDB list uses. When built against json-parser, the same catalogue also goes through
+// json_parse the way the list used to: whole, and cut at the 128 KiB buffer the list used to download into.
+
+#define ENTRY_COUNT 10000
+#define CHUNK_SIZE (16 * 1024)
+#define OLD_BUFFER_SIZE (128 * 1024)
+#define RUNS 5
+
+typedef struct {
+    u64 titleId;
+    u64 size;
+    char name[0x100];
+    char description[0x200];
+    char author[0x100];
+} bench_record;
+
+typedef struct {
+    bench_record* records;
+    u32 count;
+    char key[16];
+    // Catalogue bytes fed when the first entry completed.
+    u64 fed;
+    u64 firstRecordFed;
+} bench_parse;
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fields are quoted and escaped the way the TitleDB API sends them; some descriptions carry escapes and non-ASCII text.
+static char* bench_make_catalogue(u32* size) {
+    u32 capacity = ENTRY_COUNT * 1024;
+    char* catalogue = (char*) malloc(capacity);
+    TEST_CHECK(catalogue != NULL);
+
+    u32 pos = 0;
+    catalogue[pos++] = '[';
+
+    srand(21);
+    for(u32 i = 0; i < ENTRY_COUNT; i++) {
+        char description[320];
+        int descriptionLength = snprintf(description, sizeof(description), "Homebrew number %lu.", (unsigned long) i);
+        for(u32 words = rand() % 24; words > 0 && descriptionLength < (int) sizeof(description) - 32; words--) {
+            descriptionLength += snprintf(description + descriptionLength, sizeof(description) - descriptionLength, "%s",
+                                          i % 5 == 0 && words == 1 ? " \\\"Caf\\u00e9\\\"\\n" : " lorem ipsum");
+        }
+
+        pos += snprintf(catalogue + pos, capacity - pos,
+                        "%s{\"id\": %lu, \"titleid\": \"000400000%07lX\", \"name\": \"Title %lu\", \"description\": \"%s\", \"author\": \"Author %lu\", "
+                        "\"size\": %lu, \"mtime\": \"2017-01-%02lu 12:00:00\", \"cia\": {\"id\": %lu, \"version\": \"1.%lu\", \"size\": %lu}}",
+                        i > 0 ? ",\n" : "\n", (unsigned long) i, (unsigned long) (0x10000 + i), (unsigned long) i, description,
+                        (unsigned long) (rand() % 500), (unsigned long) (rand() % 100000000), (unsigned long) (1 + i % 28), (unsigned long) i,
+                        (unsigned long) (i % 10), (unsigned long) (rand() % 100000000));
+
+        TEST_CHECK(pos < capacity - 2);
+    }
+
+    catalogue[pos++] = '\n';
+    catalogue[pos++] = ']';
+
+    *size = pos;
+    return catalogue;
+}
+
+// The same extraction the TitleDB list does, minus adding list items.
+static Result bench_stream_callback(void* userData, json_stream_event event, u32 depth, const char* value, u32 length) {
+    bench_parse* parse = (bench_parse*) userData;
+
+    if(depth == 1 && event == JSON_STREAM_OBJECT_START) {
+        TEST_CHECK(parse->count < ENTRY_COUNT);
+        memset(&parse->records[parse->count], 0, sizeof(bench_record));
+    } else if(depth == 1 && event == JSON_STREAM_OBJECT_END) {
+        if(parse->count++ == 0) {
+            parse->firstRecordFed = parse->fed;
+        }
+    } else if(depth == 2) {
+        bench_record* record = &parse->records[parse->count];
+
+        if(event == JSON_STREAM_KEY) {
+            string_copy(parse->key, value, sizeof(parse->key));
+        } else if(event == JSON_STREAM_STRING) {
+            if(strcmp(parse->key, "titleid") == 0) {
+                record->titleId = strtoull(value, NULL, 16);
+            } else if(strcmp(parse->key, "name") == 0) {
+                string_copy(record->name, value, sizeof(record->name));
+            } else if(strcmp(parse->key, "description") == 0) {
+                string_copy(record->description, value, sizeof(record->description));
+            } else if(strcmp(parse->key, "author") == 0) {
+                string_copy(record->author, value, sizeof(record->author));
+            }
+        } else if(event == JSON_STREAM_NUMBER && strcmp(parse->key, "size") == 0) {
+            record->size = strtoull(value, NULL, 10);
+        }
+    }
+
+    return 0;
+}
+
+static double bench_stream(const char* catalogue, u32 size, bench_parse* parse) {
+    json_stream* stream = (json_stream*) malloc(sizeof(json_stream));
+    TEST_CHECK(stream != NULL);
+
+    double start = bench_now();
+
+    parse->count = 0;
+    parse->fed = 0;
+    json_stream_init(stream, parse, bench_stream_callback);
+
+    for(u32 pos = 0; pos < size; pos += CHUNK_SIZE) {
+        u32 chunk = size - pos < CHUNK_SIZE ? size - pos : CHUNK_SIZE;
+
+        parse->fed += chunk;
+        TEST_CHECK_RESULT(json_stream_feed(stream, catalogue + pos, chunk));
+    }
+
+    TEST_CHECK_RESULT(json_stream_finish(stream));
+
+    double elapsed = bench_now() - start;
+
+    free(stream);
+    return elapsed;
+}
+
+#ifdef BENCH_JSON_PARSER
+
+// The TitleDB list's old loop over json_parse's tree.
+static u32 bench_json_parse_extract(json_value* json, bench_record* records) {
+    u32 count = 0;
+
+    if(json->type == json_array) {
+        for(u32 i = 0; i < json->u.array.length; i++) {
+            json_value* val = json->u.array.values[i];
+            if(val->type != json_object) {
+                continue;
+            }
+
+            bench_record* record = &records[count++];
+            memset(record, 0, sizeof(*record));
+
+            for(u32 j = 0; j < val->u.object.length; j++) {
+                char* name = val->u.object.values[j].name;
+                u32 nameLen = val->u.object.values[j].name_length;
+                json_value* subVal = val->u.object.values[j].value;
+                if(subVal->type == json_string) {
+                    if(strncmp(name, "titleid", nameLen) == 0) {
+                        record->titleId = strtoull(subVal->u.string.ptr, NULL, 16);
+                    } else if(strncmp(name, "name", nameLen) == 0) {
+                        string_copy(record->name, subVal->u.string.ptr, sizeof(record->name));
+                    } else if(strncmp(name, "description", nameLen) == 0) {
+                        string_copy(record->description, subVal->u.string.ptr, sizeof(record->description));
+                    } else if(strncmp(name, "author", nameLen) == 0) {
+                        string_copy(record->author, subVal->u.string.ptr, sizeof(record->author));
+                    }
+                } else if(subVal->type == json_integer) {
+                    if(strncmp(name, "size", nameLen) == 0) {
+                        record->size = (u64) subVal->u.integer;
+                    }
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+// Returns the number of entries recovered, or 0 if the text didn't parse.
+static u32 bench_json_parse(const char* catalogue, u32 size, bench_record* records, double* elapsed) {
+    double start = bench_now();
+
+    u32 count = 0;
+
+    json_value* json = json_parse(catalogue, size);
+    if(json != NULL) {
+        count = bench_json_parse_extract(json, records);
+        json_value_free(json);
+    }
+
+    *elapsed = bench_now() - start;
+    return count;
+}
+
+#endif
+
+int main(int argc, const char* argv[]) {
+    u32 size = 0;
+    char* catalogue = bench_make_catalogue(&size);
+
+    bench_parse parse;
+    memset(&parse, 0, sizeof(parse));
+    TEST_CHECK((parse.records = (bench_record*) calloc(ENTRY_COUNT, sizeof(bench_record))) != NULL);
+
+    printf("%d entries, %.1f MiB catalogue, best of %d runs\n", ENTRY_COUNT, size / (1024.0 * 1024.0), RUNS);
+
+    double best = 0;
+    for(u32 i = 0; i < RUNS; i++) {
+        double elapsed = bench_stream(catalogue, size, &parse);
+        if(i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    TEST_CHECK(parse.count == ENTRY_COUNT);
+    TEST_CHECK(parse.records[ENTRY_COUNT - 1].titleId == 0x0004000000010000ULL + ENTRY_COUNT - 1);
+    TEST_CHECK(strstr(parse.records[0].description, "\"Caf\xC3\xA9\"\n") != NULL);
+
+    printf("%-24s %10s %10s %14s %16s\n", "parser", "ms", "entries", "first entry", "parser memory");
+    printf("%-24s %10.1f %10lu %11lu KiB %12lu KiB\n", "json_stream, 16 KiB", best * 1000, (unsigned long) parse.count,
+           (unsigned long) (parse.firstRecordFed / 1024), (unsigned long) ((sizeof(json_stream) + CHUNK_SIZE) / 1024));
+
+#ifdef BENCH_JSON_PARSER
+    bench_record* records = (bench_record*) calloc(ENTRY_COUNT, sizeof(bench_record));
+    TEST_CHECK(records != NULL);
+
+    u32 count = 0;
+    best = 0;
+    for(u32 i = 0; i < RUNS; i++) {
+        double elapsed = 0;
+        count = bench_json_parse(catalogue, size, records, &elapsed);
+        if(i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    // json_parse's tree isn't counted; the body it needs in memory is.
+    printf("%-24s %10.1f %10lu %11lu KiB %12lu KiB\n", "json_parse, whole body", best * 1000, (unsigned long) count, (unsigned long) (size / 1024),
+           (unsigned long) (size / 1024));
+
+    TEST_CHECK(count == ENTRY_COUNT);
+    TEST_CHECK(memcmp(records, parse.records, ENTRY_COUNT * sizeof(bench_record)) == 0);
+
+    double elapsed = 0;
+    count = bench_json_parse(catalogue, OLD_BUFFER_SIZE, records, &elapsed);
+    printf("%-24s %10.1f %10lu %14s %12lu KiB\n", "json_parse, 128 KiB", elapsed * 1000, (unsigned long) count, "-", (unsigned long) (OLD_BUFFER_SIZE / 1024));
+
+    free(records);
+#else
+    printf("json_parse: not built; set JSON_PARSER_DIR to a json-parser checkout to compare\n");
+#endif
+
+    free(parse.records);
+    free(catalogue);
+
+    return 0;
+}
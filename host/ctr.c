@@ -0,0 +1,395 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/util.h"
+#include "../source/ui/error.h"
+
+// Events, mutexes and semaphores share one lock and condition; waiters recheck every object they wait on whenever
+// any of them changes. Handles are indices into the object table, offset by one so that zero stays invalid.
+#define CTR_OBJECTS_MAX 1024
+
+typedef enum {
+    CTR_OBJECT_NONE,
+    CTR_OBJECT_EVENT,
+    CTR_OBJECT_MUTEX,
+    CTR_OBJECT_SEMAPHORE
+} ctr_object_type;
+
+typedef struct {
+    ctr_object_type type;
+
+    // Events
+    ResetType resetType;
+    bool signaled;
+
+    // Mutexes
+    pthread_t owner;
+    u32 lockCount;
+
+    // Semaphores
+    s32 count;
+    s32 maxCount;
+} ctr_object;
+
+static ctr_object ctr_objects[CTR_OBJECTS_MAX];
+static pthread_mutex_t ctr_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ctr_cond = PTHREAD_COND_INITIALIZER;
+
+static Result ctr_create(Handle* handle, ctr_object_type type, ctr_object** object) {
+    if(handle == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    for(u32 i = 0; i < CTR_OBJECTS_MAX; i++) {
+        if(ctr_objects[i].type == CTR_OBJECT_NONE) {
+            *object = &ctr_objects[i];
+            (*object)->type = type;
+
+            *handle = i + 1;
+            return 0;
+        }
+    }
+
+    return R_FBI_OUT_OF_MEMORY;
+}
+
+static ctr_object* ctr_get(Handle handle, ctr_object_type type) {
+    if(handle == 0 || handle > CTR_OBJECTS_MAX || ctr_objects[handle - 1].type != type) {
+        return NULL;
+    }
+
+    return &ctr_objects[handle - 1];
+}
+
+static bool ctr_try_acquire(Handle handle) {
+    if(handle == 0 || handle > CTR_OBJECTS_MAX) {
+        return false;
+    }
+
+    ctr_object* object = &ctr_objects[handle - 1];
+    switch(object->type) {
+        case CTR_OBJECT_EVENT:
+            if(!object->signaled) {
+                return false;
+            }
+
+            if(object->resetType == RESET_ONESHOT) {
+                object->signaled = false;
+            }
+
+            return true;
+        case CTR_OBJECT_MUTEX:
+            if(object->lockCount > 0 && !pthread_equal(object->owner, pthread_self())) {
+                return false;
+            }
+
+            object->owner = pthread_self();
+            object->lockCount++;
+            return true;
+        case CTR_OBJECT_SEMAPHORE:
+            if(object->count <= 0) {
+                return false;
+            }
+
+            object->count--;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static Result ctr_wait(s32* out, const Handle* handles, s32 handlesNum, s64 nanoseconds) {
+    struct timespec deadline;
+    if(nanoseconds > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+
+        deadline.tv_sec += nanoseconds / 1000000000;
+        deadline.tv_nsec += nanoseconds % 1000000000;
+        if(deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    Result res = 0;
+
+    pthread_mutex_lock(&ctr_lock);
+
+    while(true) {
+        s32 signaled = -1;
+        for(s32 i = 0; i < handlesNum && signaled < 0; i++) {
+            if(ctr_try_acquire(handles[i])) {
+                signaled = i;
+            }
+        }
+
+        if(signaled >= 0) {
+            if(out != NULL) {
+                *out = signaled;
+            }
+
+            break;
+        }
+
+        if(nanoseconds == 0
+           || (nanoseconds > 0 && pthread_cond_timedwait(&ctr_cond, &ctr_lock, &deadline) != 0)
+           || (nanoseconds < 0 && pthread_cond_wait(&ctr_cond, &ctr_lock) != 0)) {
+            res = RES_TIMEOUT;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return res;
+}
+
+Result svcCreateEvent(Handle* event, ResetType resetType) {
+    pthread_mutex_lock(&ctr_lock);
+
+    ctr_object* object = NULL;
+    Result res = ctr_create(event, CTR_OBJECT_EVENT, &object);
+    if(R_SUCCEEDED(res)) {
+        object->resetType = resetType;
+        object->signaled = false;
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return res;
+}
+
+static Result ctr_set_event(Handle event, bool signaled) {
+    Result res = 0;
+
+    pthread_mutex_lock(&ctr_lock);
+
+    ctr_object* object = ctr_get(event, CTR_OBJECT_EVENT);
+    if(object != NULL) {
+        object->signaled = signaled;
+
+        if(signaled) {
+            pthread_cond_broadcast(&ctr_cond);
+        }
+    } else {
+        res = R_FBI_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return res;
+}
+
+Result svcSignalEvent(Handle event) {
+    return ctr_set_event(event, true);
+}
+
+Result svcClearEvent(Handle event) {
+    return ctr_set_event(event, false);
+}
+
+Result svcCreateMutex(Handle* mutex, bool initiallyLocked) {
+    pthread_mutex_lock(&ctr_lock);
+
+    ctr_object* object = NULL;
+    Result res = ctr_create(mutex, CTR_OBJECT_MUTEX, &object);
+    if(R_SUCCEEDED(res)) {
+        object->owner = pthread_self();
+        object->lockCount = initiallyLocked ? 1 : 0;
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return res;
+}
+
+Result svcReleaseMutex(Handle mutex) {
+    Result res = 0;
+
+    pthread_mutex_lock(&ctr_lock);
+
+    ctr_object* object = ctr_get(mutex, CTR_OBJECT_MUTEX);
+    if(object != NULL && object->lockCount > 0 && pthread_equal(object->owner, pthread_self())) {
+        if(--object->lockCount == 0) {
+            pthread_cond_broadcast(&ctr_cond);
+        }
+    } else {
+        res = R_FBI_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return res;
+}
+
+Result svcCreateSemaphore(Handle* semaphore, s32 initialCount, s32 maxCount) {
+    pthread_mutex_lock(&ctr_lock);
+
+    ctr_object* object = NULL;
+    Result res = ctr_create(semaphore, CTR_OBJECT_SEMAPHORE, &object);
+    if(R_SUCCEEDED(res)) {
+        object->count = initialCount;
+        object->maxCount = maxCount;
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return res;
+}
+
+Result svcReleaseSemaphore(s32* count, Handle semaphore, s32 releaseCount) {
+    Result res = 0;
+
+    pthread_mutex_lock(&ctr_lock);
+
+    ctr_object* object = ctr_get(semaphore, CTR_OBJECT_SEMAPHORE);
+    if(object != NULL && object->count + releaseCount <= object->maxCount) {
+        if(count != NULL) {
+            *count = object->count;
+        }
+
+        object->count += releaseCount;
+        pthread_cond_broadcast(&ctr_cond);
+    } else {
+        res = R_FBI_OUT_OF_RANGE;
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return res;
+}
+
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds) {
+    return ctr_wait(NULL, &handle, 1, nanoseconds);
+}
+
+Result svcWaitSynchronizationN(s32* out, const Handle* handles, s32 handlesNum, bool waitAll, s64 nanoseconds) {
+    if(waitAll) {
+        return R_FBI_NOT_IMPLEMENTED;
+    }
+
+    return ctr_wait(out, handles, handlesNum, nanoseconds);
+}
+
+Result svcCloseHandle(Handle handle) {
+    pthread_mutex_lock(&ctr_lock);
+
+    if(handle > 0 && handle <= CTR_OBJECTS_MAX) {
+        ctr_objects[handle - 1].type = CTR_OBJECT_NONE;
+    }
+
+    pthread_mutex_unlock(&ctr_lock);
+
+    return 0;
+}
+
+Result svcGetThreadId(u32* threadId, Handle handle) {
+    *threadId = (u32) (uintptr_t) pthread_self();
+    return 0;
+}
+
+void svcSleepThread(s64 nanoseconds) {
+    struct timespec ts = {nanoseconds / 1000000000, nanoseconds % 1000000000};
+    nanosleep(&ts, NULL);
+}
+
+u64 svcGetSystemTick() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64) ts.tv_sec * SYSCLOCK_ARM11 + (u64) ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000;
+}
+
+u64 osGetTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (u64) ts.tv_sec * 1000 + (u64) ts.tv_nsec / 1000000;
+}
+
+struct Thread_tag {
+    pthread_t thread;
+    bool detached;
+
+    ThreadFunc entrypoint;
+    void* arg;
+};
+
+static void* ctr_thread_main(void* arg) {
+    struct Thread_tag* thread = (struct Thread_tag*) arg;
+    thread->entrypoint(thread->arg);
+
+    if(thread->detached) {
+        free(thread);
+    }
+
+    return NULL;
+}
+
+// Priorities and cores are left to the host scheduler.
+Result svcGetThreadPriority(s32* out, Handle handle) {
+    *out = 0x30;
+    return 0;
+}
+
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stackSize, int prio, int coreId, bool detached) {
+    struct Thread_tag* thread = (struct Thread_tag*) calloc(1, sizeof(struct Thread_tag));
+    if(thread == NULL) {
+        return NULL;
+    }
+
+    thread->detached = detached;
+    thread->entrypoint = entrypoint;
+    thread->arg = arg;
+
+    // A detached thread may already have exited and freed its state by the time pthread_create returns.
+    pthread_t handle;
+    if(pthread_create(&handle, NULL, ctr_thread_main, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+
+    if(detached) {
+        pthread_detach(handle);
+    } else {
+        thread->thread = handle;
+    }
+
+    return thread;
+}
+
+Result threadJoin(Thread thread, u64 timeoutNs) {
+    return pthread_join(thread->thread, NULL) == 0 ? 0 : R_FBI_INVALID_ARGUMENT;
+}
+
+void threadFree(Thread thread) {
+    free(thread);
+}
+
+void* linearAlloc(size_t size) {
+    return malloc(size);
+}
+
+void linearFree(void* mem) {
+    free(mem);
+}
+
+void aptSetSleepAllowed(bool allowed) {
+}
+
+void util_panic(const char* s, ...) {
+    va_list list;
+    va_start(list, s);
+
+    fprintf(stderr, "FBI has encountered a fatal error!\n");
+    vfprintf(stderr, s, list);
+    fprintf(stderr, "\n");
+
+    va_end(list);
+
+    abort();
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/io.h"
+#include "../source/core/job.h"
+#include "../source/ui/error.h"
+
+// Runs a job file the way the Jobs menu does, against a directory standing in for the SD card.
+int main(int argc, const char* argv[]) {
+    if(argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s (job file) [sd root]\n", argv[0]);
+        return 2;
+    }
+
+    job* j = (job*) calloc(1, sizeof(job));
+    if(j == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    bufpool_init();
+    bandwidth_init();
+
+    Result res = 0;
+
+    io_stream* stream = NULL;
+    if(R_SUCCEEDED(res = io_open_posix(&stream, argv[1], "rb"))) {
+        res = job_load(j, stream);
+        io_close(stream, R_SUCCEEDED(res));
+
+        if(R_SUCCEEDED(res)) {
+            res = job_run(j, &job_host_backend, (void*) (argc > 2 ? argv[2] : "."));
+        } else {
+            fprintf(stderr, "Failed to load job file: 0x%08lX\n", (unsigned long) (u32) res);
+        }
+    } else {
+        fprintf(stderr, "Failed to open job file: 0x%08lX\n", (unsigned long) (u32) res);
+    }
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    free(j);
+
+    return R_SUCCEEDED(res) ? 0 : 1;
+}
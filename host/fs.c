@@ -0,0 +1,243 @@
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/fs.h"
+#include "../source/ui/error.h"
+
+// Files and directories are held in a table of their own; handles are indices into it, offset by one so that zero
+// stays invalid. Paths are taken relative to the working directory.
+#define FS_HANDLES_MAX 64
+
+typedef struct {
+    FILE* file;
+    DIR* dir;
+    char path[FILE_PATH_MAX];
+} fs_handle;
+
+static fs_handle fs_handles[FS_HANDLES_MAX];
+static pthread_mutex_t fs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* fs_host_path(FS_Path path) {
+    const char* str = (const char*) path.data;
+    while(*str == '/') {
+        str++;
+    }
+
+    return *str != '\0' ? str : ".";
+}
+
+static Result fs_add_handle(Handle* out, FILE* file, DIR* dir, const char* path) {
+    Result res = R_FBI_OUT_OF_MEMORY;
+
+    pthread_mutex_lock(&fs_lock);
+
+    for(u32 i = 0; i < FS_HANDLES_MAX; i++) {
+        if(fs_handles[i].file == NULL && fs_handles[i].dir == NULL) {
+            fs_handles[i].file = file;
+            fs_handles[i].dir = dir;
+            snprintf(fs_handles[i].path, sizeof(fs_handles[i].path), "%s", path);
+
+            *out = i + 1;
+            res = 0;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&fs_lock);
+
+    return res;
+}
+
+static fs_handle* fs_get_handle(Handle handle) {
+    if(handle == 0 || handle > FS_HANDLES_MAX) {
+        return NULL;
+    }
+
+    return &fs_handles[handle - 1];
+}
+
+FS_Path fsMakePath(FS_PathType type, const void* path) {
+    FS_Path fsPath = {type, type == PATH_EMPTY ? 1 : (u32) strlen((const char*) path) + 1, type == PATH_EMPTY ? "" : path};
+    return fsPath;
+}
+
+Result FSUSER_OpenArchive(FS_Archive* archive, FS_ArchiveID id, FS_Path path) {
+    if(id != ARCHIVE_SDMC) {
+        return R_FBI_NOT_IMPLEMENTED;
+    }
+
+    *archive = 1;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive) {
+    return 0;
+}
+
+Result FSUSER_OpenFile(Handle* out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes) {
+    const char* hostPath = fs_host_path(path);
+
+    FILE* file = fopen(hostPath, (openFlags & FS_OPEN_WRITE) ? "r+b" : "rb");
+    if(file == NULL && (openFlags & FS_OPEN_CREATE)) {
+        file = fopen(hostPath, "w+b");
+    }
+
+    if(file == NULL) {
+        return R_FBI_BAD_DATA;
+    }
+
+    Result res = fs_add_handle(out, file, NULL, hostPath);
+    if(R_FAILED(res)) {
+        fclose(file);
+    }
+
+    return res;
+}
+
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path) {
+    return remove(fs_host_path(path)) == 0 ? 0 : R_FBI_BAD_DATA;
+}
+
+Result FSUSER_OpenDirectory(Handle* out, FS_Archive archive, FS_Path path) {
+    const char* hostPath = fs_host_path(path);
+
+    DIR* dir = opendir(hostPath);
+    if(dir == NULL) {
+        return R_FBI_BAD_DATA;
+    }
+
+    Result res = fs_add_handle(out, NULL, dir, hostPath);
+    if(R_FAILED(res)) {
+        closedir(dir);
+    }
+
+    return res;
+}
+
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes) {
+    return mkdir(fs_host_path(path), 0777) == 0 ? 0 : R_FBI_BAD_DATA;
+}
+
+Result FSFILE_Read(Handle handle, u32* bytesRead, u64 offset, void* buffer, u32 size) {
+    fs_handle* fsHandle = fs_get_handle(handle);
+    if(fsHandle == NULL || fsHandle->file == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(fseeko(fsHandle->file, (off_t) offset, SEEK_SET) != 0) {
+        return R_FBI_BAD_DATA;
+    }
+
+    *bytesRead = (u32) fread(buffer, 1, size, fsHandle->file);
+    return ferror(fsHandle->file) ? R_FBI_BAD_DATA : 0;
+}
+
+Result FSFILE_Write(Handle handle, u32* bytesWritten, u64 offset, const void* buffer, u32 size, u32 flags) {
+    fs_handle* fsHandle = fs_get_handle(handle);
+    if(fsHandle == NULL || fsHandle->file == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(fseeko(fsHandle->file, (off_t) offset, SEEK_SET) != 0) {
+        return R_FBI_BAD_DATA;
+    }
+
+    *bytesWritten = (u32) fwrite(buffer, 1, size, fsHandle->file);
+    return *bytesWritten == size ? 0 : R_FBI_BAD_DATA;
+}
+
+Result FSFILE_Close(Handle handle) {
+    fs_handle* fsHandle = fs_get_handle(handle);
+    if(fsHandle == NULL || fsHandle->file == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = fclose(fsHandle->file) == 0 ? 0 : R_FBI_BAD_DATA;
+
+    pthread_mutex_lock(&fs_lock);
+    fsHandle->file = NULL;
+    pthread_mutex_unlock(&fs_lock);
+
+    return res;
+}
+
+Result FSDIR_Read(Handle handle, u32* entriesRead, u32 entryCount, FS_DirectoryEntry* entries) {
+    fs_handle* fsHandle = fs_get_handle(handle);
+    if(fsHandle == NULL || fsHandle->dir == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    *entriesRead = 0;
+
+    struct dirent* ent = NULL;
+    while(*entriesRead < entryCount && (ent = readdir(fsHandle->dir)) != NULL) {
+        if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+
+        char path[FILE_PATH_MAX * 2];
+        snprintf(path, sizeof(path), "%s/%s", fsHandle->path, ent->d_name);
+
+        struct stat st;
+        if(stat(path, &st) != 0) {
+            continue;
+        }
+
+        FS_DirectoryEntry* entry = &entries[(*entriesRead)++];
+        memset(entry, 0, sizeof(*entry));
+
+        for(u32 i = 0; i < sizeof(entry->name) / sizeof(entry->name[0]) - 1 && ent->d_name[i] != '\0'; i++) {
+            entry->name[i] = (u8) ent->d_name[i];
+        }
+
+        entry->attributes = S_ISDIR(st.st_mode) ? FS_ATTRIBUTE_DIRECTORY : 0;
+        entry->fileSize = (u64) st.st_size;
+    }
+
+    return 0;
+}
+
+Result FSDIR_Close(Handle handle) {
+    fs_handle* fsHandle = fs_get_handle(handle);
+    if(fsHandle == NULL || fsHandle->dir == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    closedir(fsHandle->dir);
+
+    pthread_mutex_lock(&fs_lock);
+    fsHandle->dir = NULL;
+    pthread_mutex_unlock(&fs_lock);
+
+    return 0;
+}
+
+// Names on the host are taken to be ASCII.
+ssize_t utf16_to_utf8(uint8_t* out, const uint16_t* in, size_t len) {
+    size_t pos = 0;
+    while(pos < len && in[pos] != 0) {
+        out[pos] = (uint8_t) in[pos];
+        pos++;
+    }
+
+    return (ssize_t) pos;
+}
+
+// The rest of core/fs.c is device-only.
+Result fs_ensure_dir(FS_Archive archive, const char* path) {
+    FS_Path fsPath = fsMakePath(PATH_ASCII, path);
+
+    struct stat st;
+    if(stat(fs_host_path(fsPath), &st) == 0) {
+        return S_ISDIR(st.st_mode) ? 0 : R_FBI_BAD_DATA;
+    }
+
+    return mkdir(fs_host_path(fsPath), 0777) == 0 || errno == EEXIST ? 0 : R_FBI_BAD_DATA;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Makes every request fail the way a TLS verification failure does, which sends downloads through curl.
+void host_httpc_set_tls_failure(bool fail);
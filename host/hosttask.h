@@ -0,0 +1,4 @@
+#pragma once
+
+// Suspends running tasks the way leaving for the home menu does, or lets them continue.
+void host_task_set_suspended(bool suspended);
@@ -0,0 +1,4 @@
+#pragma once
+
+// Answers the next yes/no prompts with response (true for yes), or leaves them unanswered when response is negative.
+void host_ui_set_prompt_response(int response);
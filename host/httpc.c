@@ -0,0 +1,394 @@
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../source/core/iohost.h"
+#include "../source/ui/error.h"
+#include "hosthttpc.h"
+
+// Each context is one request over its own socket, as with the system service: nothing is carried over to the next
+// context. Bodies must come with a Content-Length.
+#define HTTPC_CONTEXTS_MAX 64
+#define HTTPC_URL_MAX 1024
+#define HTTPC_REQUEST_HEADERS_MAX 4096
+#define HTTPC_RESPONSE_HEADERS_MAX 16384
+
+#define HTTPC_RESULTCODE_NOTFOUNDHEADER ((Result) 0xD8A0A028)
+#define HTTPC_RESULTCODE_TIMEDOUT ((Result) 0xD820A069)
+#define HTTPC_RESULTCODE_TLS_VERIFY_FAILED ((Result) 0xD8A0A03C)
+
+#define HTTPC_SOC_ERROR(err) MAKERESULT(RL_PERMANENT, RS_INTERNAL, RM_SOC, (err))
+
+typedef struct {
+    bool used;
+
+    char host[256];
+    char port[8];
+    char path[HTTPC_URL_MAX];
+
+    char requestHeaders[HTTPC_REQUEST_HEADERS_MAX];
+    size_t requestHeadersSize;
+    bool keepAlive;
+
+    int fd;
+
+    char responseHeaders[HTTPC_RESPONSE_HEADERS_MAX];
+    size_t responseHeadersSize;
+    bool responded;
+    u32 statusCode;
+    u32 contentLength;
+
+    // Body bytes that arrived along with the headers.
+    u8* early;
+    u32 earlySize;
+    u32 earlyPos;
+
+    u32 downloaded;
+} httpc_host_context;
+
+static httpc_host_context httpc_contexts[HTTPC_CONTEXTS_MAX];
+static pthread_mutex_t httpc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile bool httpc_fail_tls;
+
+void host_httpc_set_tls_failure(bool fail) {
+    httpc_fail_tls = fail;
+}
+
+static httpc_host_context* httpc_get(httpcContext* context) {
+    if(context == NULL || context->httphandle == 0 || context->httphandle > HTTPC_CONTEXTS_MAX || !httpc_contexts[context->httphandle - 1].used) {
+        return NULL;
+    }
+
+    return &httpc_contexts[context->httphandle - 1];
+}
+
+static Result httpc_wait(int fd, short events, u64 timeout) {
+    struct pollfd pfd = {fd, events, 0};
+
+    int ret = 0;
+    while((ret = poll(&pfd, 1, (int) (timeout / 1000000))) < 0 && errno == EINTR) {
+    }
+
+    if(ret < 0) {
+        return HTTPC_SOC_ERROR(errno);
+    }
+
+    return ret > 0 ? 0 : HTTPC_RESULTCODE_TIMEDOUT;
+}
+
+Result httpcOpenContext(httpcContext* context, HTTPC_RequestMethod method, const char* url, u32 useDefaultProxy) {
+    if(context == NULL || url == NULL || method != HTTPC_METHOD_GET || strncmp(url, "http://", 7) != 0) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    const char* hostStart = url + 7;
+    const char* pathStart = strchr(hostStart, '/');
+    if(pathStart == NULL) {
+        pathStart = hostStart + strlen(hostStart);
+    }
+
+    const char* portStart = memchr(hostStart, ':', (size_t) (pathStart - hostStart));
+    const char* hostEnd = portStart != NULL ? portStart : pathStart;
+
+    httpc_host_context* ctx = NULL;
+
+    pthread_mutex_lock(&httpc_lock);
+
+    for(u32 i = 0; i < HTTPC_CONTEXTS_MAX; i++) {
+        if(!httpc_contexts[i].used) {
+            ctx = &httpc_contexts[i];
+            memset(ctx, 0, sizeof(*ctx));
+            ctx->used = true;
+
+            context->httphandle = i + 1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&httpc_lock);
+
+    if(ctx == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    snprintf(ctx->host, sizeof(ctx->host), "%.*s", (int) (hostEnd - hostStart), hostStart);
+    snprintf(ctx->port, sizeof(ctx->port), "%.*s", portStart != NULL ? (int) (pathStart - portStart - 1) : 2, portStart != NULL ? portStart + 1 : "80");
+    snprintf(ctx->path, sizeof(ctx->path), "%s", *pathStart != '\0' ? pathStart : "/");
+    ctx->fd = -1;
+
+    context->servhandle = 0;
+    return 0;
+}
+
+Result httpcCloseContext(httpcContext* context) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(ctx->fd >= 0) {
+        close(ctx->fd);
+    }
+
+    free(ctx->early);
+
+    pthread_mutex_lock(&httpc_lock);
+    ctx->used = false;
+    pthread_mutex_unlock(&httpc_lock);
+
+    context->httphandle = 0;
+    return 0;
+}
+
+Result httpcAddRequestHeaderField(httpcContext* context, const char* name, const char* value) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    int len = snprintf(ctx->requestHeaders + ctx->requestHeadersSize, sizeof(ctx->requestHeaders) - ctx->requestHeadersSize, "%s: %s\r\n", name, value);
+    if(len < 0 || (size_t) len >= sizeof(ctx->requestHeaders) - ctx->requestHeadersSize) {
+        return R_FBI_OUT_OF_RANGE;
+    }
+
+    ctx->requestHeadersSize += len;
+    return 0;
+}
+
+Result httpcSetSSLOpt(httpcContext* context, u32 options) {
+    return httpc_get(context) != NULL ? 0 : R_FBI_INVALID_ARGUMENT;
+}
+
+Result httpcSetKeepAlive(httpcContext* context, HTTPC_KeepAlive option) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    ctx->keepAlive = option == HTTPC_KEEPALIVE_ENABLED;
+    return 0;
+}
+
+Result httpcBeginRequest(httpcContext* context) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(httpc_fail_tls) {
+        return HTTPC_RESULTCODE_TLS_VERIFY_FAILED;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* addr = NULL;
+    if(getaddrinfo(ctx->host, ctx->port, &hints, &addr) != 0) {
+        return HTTPC_SOC_ERROR(EHOSTUNREACH);
+    }
+
+    Result res = 0;
+
+    if((ctx->fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0 || connect(ctx->fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+        res = HTTPC_SOC_ERROR(errno);
+    }
+
+    freeaddrinfo(addr);
+
+    if(R_SUCCEEDED(res)) {
+        char request[HTTPC_URL_MAX + HTTPC_REQUEST_HEADERS_MAX + 512];
+        int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s:%s\r\n%sConnection: %s\r\n\r\n", ctx->path, ctx->host, ctx->port,
+                           ctx->requestHeaders, ctx->keepAlive ? "keep-alive" : "close");
+
+        for(int pos = 0; pos < len && R_SUCCEEDED(res);) {
+            ssize_t sent = send(ctx->fd, request + pos, (size_t) (len - pos), MSG_NOSIGNAL);
+            if(sent > 0) {
+                pos += sent;
+            } else if(sent < 0 && errno != EINTR) {
+                res = HTTPC_SOC_ERROR(errno);
+            }
+        }
+    }
+
+    return res;
+}
+
+static Result httpc_read_response(httpc_host_context* ctx, u64 timeout) {
+    if(ctx->fd < 0) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    char* end = NULL;
+    while(R_SUCCEEDED(res) && end == NULL) {
+        if(ctx->responseHeadersSize >= sizeof(ctx->responseHeaders) - 1) {
+            return R_FBI_BAD_DATA;
+        }
+
+        if(R_SUCCEEDED(res = httpc_wait(ctx->fd, POLLIN, timeout))) {
+            ssize_t received = recv(ctx->fd, ctx->responseHeaders + ctx->responseHeadersSize, sizeof(ctx->responseHeaders) - 1 - ctx->responseHeadersSize, 0);
+            if(received > 0) {
+                ctx->responseHeadersSize += received;
+                ctx->responseHeaders[ctx->responseHeadersSize] = '\0';
+
+                end = strstr(ctx->responseHeaders, "\r\n\r\n");
+            } else if(received == 0) {
+                res = HTTPC_SOC_ERROR(ECONNRESET);
+            } else if(errno != EINTR) {
+                res = HTTPC_SOC_ERROR(errno);
+            }
+        }
+    }
+
+    if(R_FAILED(res)) {
+        return res;
+    }
+
+    end += 4;
+
+    u32 earlySize = (u32) (ctx->responseHeaders + ctx->responseHeadersSize - end);
+    if(earlySize > 0) {
+        if((ctx->early = (u8*) malloc(earlySize)) == NULL) {
+            return R_FBI_OUT_OF_MEMORY;
+        }
+
+        memcpy(ctx->early, end, earlySize);
+        ctx->earlySize = earlySize;
+    }
+
+    *end = '\0';
+    ctx->responseHeadersSize = (size_t) (end - ctx->responseHeaders);
+
+    if(sscanf(ctx->responseHeaders, "HTTP/%*s %lu", (unsigned long*) &ctx->statusCode) != 1) {
+        return R_FBI_BAD_DATA;
+    }
+
+    ctx->responded = true;
+    return 0;
+}
+
+static Result httpc_find_header(httpc_host_context* ctx, const char* name, char* value, u32 valueBufferSize) {
+    size_t nameLen = strlen(name);
+
+    for(const char* line = strstr(ctx->responseHeaders, "\r\n"); line != NULL && line[2] != '\0'; line = strstr(line + 2, "\r\n")) {
+        const char* start = line + 2;
+        if(strncasecmp(start, name, nameLen) != 0 || start[nameLen] != ':') {
+            continue;
+        }
+
+        start += nameLen + 1;
+        while(*start == ' ') {
+            start++;
+        }
+
+        const char* end = strstr(start, "\r\n");
+        snprintf(value, valueBufferSize, "%.*s", (int) (end - start), start);
+        return 0;
+    }
+
+    return HTTPC_RESULTCODE_NOTFOUNDHEADER;
+}
+
+Result httpcGetResponseStatusCodeTimeout(httpcContext* context, u32* out, u64 timeout) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL || out == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(!ctx->responded) {
+        Result res = httpc_read_response(ctx, timeout);
+        if(R_FAILED(res)) {
+            return res;
+        }
+
+        char contentLength[16];
+        if(R_SUCCEEDED(httpc_find_header(ctx, "Content-Length", contentLength, sizeof(contentLength)))) {
+            ctx->contentLength = (u32) strtoul(contentLength, NULL, 10);
+        }
+    }
+
+    *out = ctx->statusCode;
+    return 0;
+}
+
+Result httpcGetResponseHeader(httpcContext* context, const char* name, char* value, u32 valueBufferSize) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL || name == NULL || value == NULL || !ctx->responded) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    return httpc_find_header(ctx, name, value, valueBufferSize);
+}
+
+Result httpcGetDownloadSizeState(httpcContext* context, u32* downloadedSize, u32* contentSize) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(downloadedSize != NULL) {
+        *downloadedSize = ctx->downloaded;
+    }
+
+    if(contentSize != NULL) {
+        *contentSize = ctx->contentLength;
+    }
+
+    return 0;
+}
+
+Result httpcReceiveDataTimeout(httpcContext* context, u8* buffer, u32 size, u64 timeout) {
+    httpc_host_context* ctx = httpc_get(context);
+    if(ctx == NULL || buffer == NULL || !ctx->responded) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    u32 pos = 0;
+    while(R_SUCCEEDED(res) && pos < size && ctx->downloaded < ctx->contentLength) {
+        u32 want = size - pos;
+        if(want > ctx->contentLength - ctx->downloaded) {
+            want = ctx->contentLength - ctx->downloaded;
+        }
+
+        if(ctx->earlyPos < ctx->earlySize) {
+            u32 copy = ctx->earlySize - ctx->earlyPos < want ? ctx->earlySize - ctx->earlyPos : want;
+            memcpy(buffer + pos, ctx->early + ctx->earlyPos, copy);
+
+            ctx->earlyPos += copy;
+            ctx->downloaded += copy;
+            pos += copy;
+            continue;
+        }
+
+        if(R_SUCCEEDED(res = httpc_wait(ctx->fd, POLLIN, timeout))) {
+            ssize_t received = recv(ctx->fd, buffer + pos, want, 0);
+            if(received > 0) {
+                ctx->downloaded += received;
+                pos += received;
+            } else if(received == 0) {
+                res = HTTPC_SOC_ERROR(ECONNRESET);
+            } else if(errno != EINTR) {
+                res = HTTPC_SOC_ERROR(errno);
+            }
+        }
+    }
+
+    if(R_SUCCEEDED(res) && ctx->downloaded < ctx->contentLength) {
+        res = HTTPC_RESULTCODE_DOWNLOADPENDING;
+    }
+
+    return res;
+}
@@ -0,0 +1,338 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../source/core/iohost.h"
+#include "httpserver.h"
+#include "test.h"
+
+#define HTTP_SERVER_CHUNK_SIZE (16 * 1024)
+#define HTTP_SERVER_REQUEST_MAX 8192
+#define HTTP_SERVER_CLIENTS_MAX 256
+
+static host_http_resource* server_resources;
+static u32 server_resource_count;
+
+static int server_fd = -1;
+static pthread_t server_thread;
+static pthread_mutex_t server_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool server_stopping;
+static u32 server_accept_delay_us;
+static u32 server_chunk_delay_us;
+static u32 server_chunk_size = HTTP_SERVER_CHUNK_SIZE;
+static pthread_cond_t server_cond = PTHREAD_COND_INITIALIZER;
+static host_http_stats server_stats;
+static int server_clients[HTTP_SERVER_CLIENTS_MAX];
+static u32 server_client_count;
+
+static bool server_send(int fd, const void* data, size_t size) {
+    size_t pos = 0;
+    while(pos < size) {
+        ssize_t sent = send(fd, (const u8*) data + pos, size - pos, MSG_NOSIGNAL);
+        if(sent > 0) {
+            pos += sent;
+        } else if(sent < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool server_get_header(const char* request, const char* name, char* value, size_t size) {
+    size_t nameLen = strlen(name);
+
+    for(const char* line = strstr(request, "\r\n"); line != NULL && line[2] != '\r'; line = strstr(line + 2, "\r\n")) {
+        const char* start = line + 2;
+        if(strncasecmp(start, name, nameLen) == 0 && start[nameLen] == ':') {
+            start += nameLen + 1;
+            while(*start == ' ') {
+                start++;
+            }
+
+            snprintf(value, size, "%.*s", (int) (strstr(start, "\r\n") - start), start);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns false once the connection should be closed.
+static bool server_respond(int fd, const char* request) {
+    char path[1024];
+    if(sscanf(request, "GET %1023s HTTP/1.1", path) != 1) {
+        return false;
+    }
+
+    char header[1024];
+    bool keepAlive = !server_get_header(request, "Connection", header, sizeof(header)) || strcasecmp(header, "close") != 0;
+
+    host_http_resource* resource = NULL;
+    for(u32 i = 0; i < server_resource_count && resource == NULL; i++) {
+        if(strcmp(server_resources[i].path, path) == 0) {
+            resource = &server_resources[i];
+        }
+    }
+
+    pthread_mutex_lock(&server_lock);
+    server_stats.requests++;
+    u32 chunkDelayUs = server_chunk_delay_us;
+    u32 chunkSize = server_chunk_size;
+    pthread_mutex_unlock(&server_lock);
+
+    char response[2048];
+    if(resource == NULL) {
+        int len = snprintf(response, sizeof(response), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        return server_send(fd, response, len) && keepAlive;
+    }
+
+    if(resource->etag != NULL && server_get_header(request, "If-None-Match", header, sizeof(header)) && strcmp(header, resource->etag) == 0) {
+        pthread_mutex_lock(&server_lock);
+        server_stats.notModified++;
+        pthread_mutex_unlock(&server_lock);
+
+        int len = snprintf(response, sizeof(response), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n\r\n", resource->etag);
+        return server_send(fd, response, len) && keepAlive;
+    }
+
+    u64 start = 0;
+    u64 end = resource->size > 0 ? resource->size - 1 : 0;
+    bool ranged = false;
+
+    unsigned long long rangeStart = 0;
+    unsigned long long rangeEnd = 0;
+    if(!resource->ignoreRanges && server_get_header(request, "Range", header, sizeof(header))) {
+        pthread_mutex_lock(&server_lock);
+        server_stats.rangeRequests++;
+        pthread_mutex_unlock(&server_lock);
+
+        int fields = sscanf(header, "bytes=%llu-%llu", &rangeStart, &rangeEnd);
+        if(fields >= 1) {
+            if(rangeStart >= resource->size) {
+                int len = snprintf(response, sizeof(response), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lu\r\nContent-Length: 0\r\n\r\n",
+                                   (unsigned long) resource->size);
+                return server_send(fd, response, len) && keepAlive;
+            }
+
+            start = rangeStart;
+            if(fields == 2 && rangeEnd < end) {
+                end = rangeEnd;
+            }
+
+            ranged = true;
+        }
+    }
+
+    u32 size = resource->size > 0 ? (u32) (end - start + 1) : 0;
+
+    int len = snprintf(response, sizeof(response), "HTTP/1.1 %s\r\nContent-Length: %lu\r\n", ranged ? "206 Partial Content" : "200 OK", (unsigned long) size);
+    if(ranged) {
+        len += snprintf(response + len, sizeof(response) - len, "Content-Range: bytes %llu-%llu/%lu\r\n", (unsigned long long) start, (unsigned long long) end,
+                        (unsigned long) resource->size);
+    }
+
+    if(resource->etag != NULL) {
+        len += snprintf(response + len, sizeof(response) - len, "ETag: %s\r\n", resource->etag);
+    }
+
+    if(resource->contentEncoding != NULL) {
+        len += snprintf(response + len, sizeof(response) - len, "Content-Encoding: %s\r\n", resource->contentEncoding);
+    }
+
+    len += snprintf(response + len, sizeof(response) - len, "\r\n");
+
+    if(!server_send(fd, response, len)) {
+        return false;
+    }
+
+    for(u32 pos = 0; pos < size; pos += chunkSize) {
+        u32 chunk = size - pos < chunkSize ? size - pos : chunkSize;
+        if(!server_send(fd, (const u8*) resource->body + start + pos, chunk)) {
+            return false;
+        }
+
+        if(chunkDelayUs > 0) {
+            usleep(chunkDelayUs);
+        }
+    }
+
+    return keepAlive;
+}
+
+static void* server_client_thread(void* arg) {
+    int fd = (int) (intptr_t) arg;
+
+    pthread_mutex_lock(&server_lock);
+    u32 acceptDelayUs = server_accept_delay_us;
+    pthread_mutex_unlock(&server_lock);
+
+    if(acceptDelayUs > 0) {
+        usleep(acceptDelayUs);
+    }
+
+    char request[HTTP_SERVER_REQUEST_MAX + 1] = {'\0'};
+    size_t requestSize = 0;
+
+    bool open = true;
+    while(open) {
+        char* end = NULL;
+        while(open && (end = strstr(request, "\r\n\r\n")) == NULL) {
+            ssize_t received = requestSize < HTTP_SERVER_REQUEST_MAX ? recv(fd, request + requestSize, HTTP_SERVER_REQUEST_MAX - requestSize, 0) : 0;
+            if(received > 0) {
+                requestSize += received;
+                request[requestSize] = '\0';
+            } else if(received == 0 || errno != EINTR) {
+                open = false;
+            }
+        }
+
+        if(open) {
+            end += 4;
+
+            char next = *end;
+            *end = '\0';
+            open = server_respond(fd, request);
+            *end = next;
+
+            requestSize -= end - request;
+            memmove(request, end, requestSize + 1);
+        }
+    }
+
+    pthread_mutex_lock(&server_lock);
+
+    for(u32 i = 0; i < server_client_count; i++) {
+        if(server_clients[i] == fd) {
+            server_clients[i] = server_clients[--server_client_count];
+            break;
+        }
+    }
+
+    close(fd);
+
+    pthread_cond_broadcast(&server_cond);
+    pthread_mutex_unlock(&server_lock);
+
+    return NULL;
+}
+
+// Runs until the listening socket is shut down.
+static void* server_accept_thread(void* arg) {
+    while(true) {
+        int fd = accept(server_fd, NULL, NULL);
+        if(fd < 0) {
+            if(errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            break;
+        }
+
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        pthread_mutex_lock(&server_lock);
+
+        bool accepted = !server_stopping && server_client_count < HTTP_SERVER_CLIENTS_MAX;
+        if(accepted) {
+            server_clients[server_client_count++] = fd;
+            server_stats.connections++;
+        }
+
+        pthread_mutex_unlock(&server_lock);
+
+        pthread_t thread;
+        if(!accepted || pthread_create(&thread, NULL, server_client_thread, (void*) (intptr_t) fd) != 0) {
+            close(fd);
+            continue;
+        }
+
+        pthread_detach(thread);
+    }
+
+    return NULL;
+}
+
+void host_http_server_start(host_http_resource* resources, u32 count, char* baseUrl, size_t size) {
+    server_resources = resources;
+    server_resource_count = count;
+
+    pthread_mutex_lock(&server_lock);
+    server_stopping = false;
+    pthread_mutex_unlock(&server_lock);
+
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_CHECK(server_fd >= 0);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t addrLen = sizeof(addr);
+    TEST_CHECK(bind(server_fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+    TEST_CHECK(listen(server_fd, 64) == 0);
+    TEST_CHECK(getsockname(server_fd, (struct sockaddr*) &addr, &addrLen) == 0);
+
+    snprintf(baseUrl, size, "http://127.0.0.1:%u", ntohs(addr.sin_port));
+
+    TEST_CHECK(pthread_create(&server_thread, NULL, server_accept_thread, NULL) == 0);
+}
+
+void host_http_server_stop() {
+    pthread_mutex_lock(&server_lock);
+    server_stopping = true;
+    pthread_mutex_unlock(&server_lock);
+
+    shutdown(server_fd, SHUT_RDWR);
+    pthread_join(server_thread, NULL);
+    close(server_fd);
+    server_fd = -1;
+
+    // Connections kept alive by a client end with the server.
+    pthread_mutex_lock(&server_lock);
+
+    for(u32 i = 0; i < server_client_count; i++) {
+        shutdown(server_clients[i], SHUT_RDWR);
+    }
+
+    while(server_client_count > 0) {
+        pthread_cond_wait(&server_cond, &server_lock);
+    }
+
+    pthread_mutex_unlock(&server_lock);
+}
+
+void host_http_server_set_delays(u32 acceptDelayUs, u32 chunkDelayUs) {
+    pthread_mutex_lock(&server_lock);
+    server_accept_delay_us = acceptDelayUs;
+    server_chunk_delay_us = chunkDelayUs;
+    pthread_mutex_unlock(&server_lock);
+}
+
+void host_http_server_set_chunk_size(u32 chunkSize) {
+    pthread_mutex_lock(&server_lock);
+    server_chunk_size = chunkSize > 0 ? chunkSize : HTTP_SERVER_CHUNK_SIZE;
+    pthread_mutex_unlock(&server_lock);
+}
+
+void host_http_server_get_stats(host_http_stats* stats) {
+    pthread_mutex_lock(&server_lock);
+    *stats = server_stats;
+    pthread_mutex_unlock(&server_lock);
+}
+
+void host_http_server_reset_stats() {
+    pthread_mutex_lock(&server_lock);
+    memset(&server_stats, 0, sizeof(server_stats));
+    pthread_mutex_unlock(&server_lock);
+}
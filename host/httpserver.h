@@ -0,0 +1,37 @@
+#pragma once
+
+// A loopback HTTP/1.1 server for the HTTP tests and benchmarks. Connections are kept alive and served on threads of
+// their own; byte ranges, ETag revalidation and pre-encoded bodies are supported.
+
+typedef struct {
+    const char* path;
+    const void* body;
+    u32 size;
+
+    // Optional; requests carrying it in If-None-Match get a 304.
+    const char* etag;
+    // Sent as the Content-Encoding, with the body as is.
+    const char* contentEncoding;
+    // Answer ranged requests with the whole body and a 200.
+    bool ignoreRanges;
+} host_http_resource;
+
+typedef struct {
+    u32 connections;
+    u32 requests;
+    u32 rangeRequests;
+    u32 notModified;
+} host_http_stats;
+
+// Serves resources, which must stay valid until the server is stopped. baseUrl receives http://127.0.0.1:port.
+void host_http_server_start(host_http_resource* resources, u32 count, char* baseUrl, size_t size);
+void host_http_server_stop();
+
+// acceptDelayUs is spent on every new connection, standing in for a TLS handshake. chunkDelayUs is spent after every
+// chunk of body.
+void host_http_server_set_delays(u32 acceptDelayUs, u32 chunkDelayUs);
+// Bodies are sent in chunks of this many bytes; 16 KiB unless set, and 0 restores that.
+void host_http_server_set_chunk_size(u32 chunkSize);
+
+void host_http_server_get_stats(host_http_stats* stats);
+void host_http_server_reset_stats();
@@ -0,0 +1,51 @@
+#include <pthread.h>
+
+#include "../source/core/iohost.h"
+#include "../source/ui/error.h"
+#include "../source/ui/section/task/task.h"
+#include "hosttask.h"
+
+// There is no worker pool, sleep or home menu on the host: submitted tasks get a thread of their own and the pause
+// and suspend events stay signaled unless a test suspends them.
+static Handle task_pause_event;
+static Handle task_suspend_event;
+
+static pthread_once_t task_once = PTHREAD_ONCE_INIT;
+
+static void task_host_init() {
+    svcCreateEvent(&task_pause_event, RESET_STICKY);
+    svcSignalEvent(task_pause_event);
+
+    svcCreateEvent(&task_suspend_event, RESET_STICKY);
+    svcSignalEvent(task_suspend_event);
+}
+
+bool task_is_quit_all() {
+    return false;
+}
+
+Handle task_get_pause_event() {
+    pthread_once(&task_once, task_host_init);
+    return task_pause_event;
+}
+
+Handle task_get_suspend_event() {
+    pthread_once(&task_once, task_host_init);
+    return task_suspend_event;
+}
+
+void host_task_set_suspended(bool suspended) {
+    pthread_once(&task_once, task_host_init);
+
+    if(suspended) {
+        svcClearEvent(task_suspend_event);
+        svcClearEvent(task_pause_event);
+    } else {
+        svcSignalEvent(task_suspend_event);
+        svcSignalEvent(task_pause_event);
+    }
+}
+
+Result task_submit(const char* name, task_priority priority, void (*func)(void* arg), void* arg) {
+    return threadCreate(func, arg, 0x10000, 0x18, 1, true) != NULL ? 0 : R_FBI_THREAD_CREATE_FAILED;
+}
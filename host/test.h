@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Ends the test program at the first unmet expectation.
+#define TEST_CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while(0)
+
+#define TEST_CHECK_RESULT(expr) \
+    do { \
+        Result testRes = (expr); \
+        if(R_FAILED(testRes)) { \
+            fprintf(stderr, "%s:%d: %s failed: 0x%08lX\n", __FILE__, __LINE__, #expr, (unsigned long) (u32) testRes); \
+            exit(1); \
+        } \
+    } while(0)
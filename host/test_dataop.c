@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/io.h"
+#include "../source/ui/error.h"
+#include "../source/ui/section/task/task.h"
+#include "hosttask.h"
+#include "test.h"
+
+// Copies in-memory sources to files through the data operation engine, serially and on the worker pool, and suspends
+// a pooled copy part way through.
+
+#define ITEM_COUNT 5
+#define BUFFER_SIZE (64 * 1024)
+
+#define SUSPEND_ITEM_SIZE (16 * 1024 * 1024)
+#define SUSPEND_MS 50
+
+typedef struct {
+    u8* data;
+    u64 size;
+    bool missing;
+} test_item;
+
+static test_item items[ITEM_COUNT];
+
+static void test_make_path(char* out, size_t size, u32 index) {
+    snprintf(out, size, "item%lu.bin", (unsigned long) index);
+}
+
+static Result test_is_src_directory(void* data, u32 index, bool* isDirectory) {
+    *isDirectory = false;
+    return 0;
+}
+
+static Result test_make_dst_directory(void* data, u32 index) {
+    return 0;
+}
+
+static Result test_open_src(void* data, u32 index, io_stream** stream) {
+    if(items[index].missing) {
+        return R_FBI_BAD_DATA;
+    }
+
+    return io_open_memory(stream, items[index].data, items[index].size);
+}
+
+static Result test_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    char path[64];
+    test_make_path(path, sizeof(path), index);
+
+    return io_open_posix(stream, path, "wb");
+}
+
+static void test_verify(u32 index) {
+    char path[64];
+    test_make_path(path, sizeof(path), index);
+
+    FILE* fd = fopen(path, "rb");
+    TEST_CHECK(fd != NULL);
+
+    u8* contents = (u8*) malloc(items[index].size + 1);
+    TEST_CHECK(contents != NULL);
+
+    TEST_CHECK(fread(contents, 1, items[index].size + 1, fd) == items[index].size);
+    TEST_CHECK(items[index].size == 0 || memcmp(contents, items[index].data, items[index].size) == 0);
+
+    free(contents);
+    fclose(fd);
+
+    remove(path);
+}
+
+static void test_copy(u32 workerCount) {
+    data_op_data op;
+    memset(&op, 0, sizeof(op));
+
+    op.op = DATAOP_COPY;
+    op.total = ITEM_COUNT;
+    op.bufferSize = BUFFER_SIZE;
+    op.bufferCount = 4;
+    op.copyEmpty = true;
+    op.workerCount = workerCount;
+
+    op.batch = true;
+    op.headless = true;
+
+    op.isSrcDirectory = test_is_src_directory;
+    op.makeDstDirectory = test_make_dst_directory;
+    op.openSrc = test_open_src;
+    op.openDst = test_open_dst;
+
+    Result res = task_data_op_run(&op);
+    TEST_CHECK(res == R_FBI_BAD_DATA);
+    TEST_CHECK(op.finished);
+    TEST_CHECK(op.failedItems == 1);
+
+    u64 expectedBytes = 0;
+    for(u32 i = 0; i < ITEM_COUNT; i++) {
+        if(!items[i].missing) {
+            test_verify(i);
+            expectedBytes += items[i].size;
+        }
+    }
+
+    TEST_CHECK(op.copiedBytes == expectedBytes);
+}
+
+static Handle suspendStart;
+static volatile u32 suspendCalls;
+static volatile u32 restoreCalls;
+static volatile bool suspendInside;
+
+static Result test_suspend_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    svcSignalEvent(suspendStart);
+
+    return test_open_dst(data, index, initialReadBlock, size, stream);
+}
+
+static Result test_suspend(void* data, u32 index) {
+    TEST_CHECK(!__atomic_exchange_n(&suspendInside, true, __ATOMIC_SEQ_CST));
+
+    __atomic_add_fetch(&suspendCalls, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static Result test_restore(void* data, u32 index) {
+    TEST_CHECK(__atomic_exchange_n(&suspendInside, false, __ATOMIC_SEQ_CST));
+
+    __atomic_add_fetch(&restoreCalls, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static void test_suspend_thread(void* arg) {
+    svcWaitSynchronization(suspendStart, U64_MAX);
+
+    host_task_set_suspended(true);
+    svcSleepThread((s64) SUSPEND_MS * 1000000);
+    host_task_set_suspended(false);
+}
+
+// Every worker sees the suspend, but the operation's callbacks run once, never side by side.
+static void test_suspend_pool(u32 workerCount) {
+    for(u32 i = 0; i < ITEM_COUNT; i++) {
+        items[i].missing = false;
+    }
+
+    TEST_CHECK_RESULT(svcCreateEvent(&suspendStart, RESET_STICKY));
+
+    Thread thread = threadCreate(test_suspend_thread, NULL, 0x8000, 0x30, 1, false);
+    TEST_CHECK(thread != NULL);
+
+    data_op_data op;
+    memset(&op, 0, sizeof(op));
+
+    op.op = DATAOP_COPY;
+    op.total = ITEM_COUNT;
+    op.bufferSize = BUFFER_SIZE;
+    op.bufferCount = 4;
+    op.workerCount = workerCount;
+
+    op.batch = true;
+    op.headless = true;
+
+    op.isSrcDirectory = test_is_src_directory;
+    op.makeDstDirectory = test_make_dst_directory;
+    op.openSrc = test_open_src;
+    op.openDst = test_suspend_open_dst;
+    op.suspend = test_suspend;
+    op.restore = test_restore;
+
+    TEST_CHECK_RESULT(task_data_op_run(&op));
+
+    threadJoin(thread, U64_MAX);
+    threadFree(thread);
+    svcCloseHandle(suspendStart);
+
+    printf("  %lu workers: %lu suspend, %lu restore\n", (unsigned long) workerCount, (unsigned long) suspendCalls, (unsigned long) restoreCalls);
+
+    TEST_CHECK(suspendCalls == 1);
+    TEST_CHECK(restoreCalls == 1);
+    TEST_CHECK(!suspendInside);
+
+    for(u32 i = 0; i < ITEM_COUNT; i++) {
+        test_verify(i);
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+
+    // Empty, smaller than one block, exactly one block, failing, and large enough to be pipelined.
+    const u64 sizes[ITEM_COUNT] = {0, 1000, BUFFER_SIZE, 4096, 3 * 1024 * 1024 + 17};
+
+    srand(1);
+    for(u32 i = 0; i < ITEM_COUNT; i++) {
+        items[i].size = sizes[i];
+        items[i].data = (u8*) malloc(sizes[i] > 0 ? sizes[i] : 1);
+        TEST_CHECK(items[i].data != NULL);
+
+        for(u64 j = 0; j < sizes[i]; j++) {
+            items[i].data[j] = (u8) rand();
+        }
+    }
+
+    items[3].missing = true;
+
+    test_copy(1);
+    test_copy(3);
+
+    for(u32 i = 0; i < ITEM_COUNT; i++) {
+        free(items[i].data);
+
+        items[i].size = SUSPEND_ITEM_SIZE;
+        TEST_CHECK((items[i].data = (u8*) malloc(SUSPEND_ITEM_SIZE)) != NULL);
+        memset(items[i].data, (int) i, SUSPEND_ITEM_SIZE);
+    }
+
+    printf("suspend:\n");
+    test_suspend_pool(4);
+
+    for(u32 i = 0; i < ITEM_COUNT; i++) {
+        free(items[i].data);
+    }
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/http.h"
+#include "../source/ui/error.h"
+#include "hosthttpc.h"
+#include "httpserver.h"
+#include "test.h"
+
+// Fetches a set of icon-sized resources through http_download_buffer from several threads at once, the way the TitleDB
+// icon fetchers do: first with a cold cache, then after the cache index has to be rebuilt from the SD card, then with
+// some of the resources changed on the server, and finally through the curl fallback.
+
+#define RESOURCE_COUNT 48
+#define FETCHER_COUNT 8
+#define ICON_BUFFER_SIZE (128 * 1024)
+
+static host_http_resource resources[RESOURCE_COUNT];
+static char paths[RESOURCE_COUNT][32];
+static char etags[RESOURCE_COUNT][32];
+static u8* bodies[RESOURCE_COUNT];
+
+static char baseUrl[64];
+
+static volatile u32 nextResource;
+static Handle fetchMutex;
+
+static void test_make_body(u32 index, u32 version) {
+    srand(index * 31 + version);
+    for(u32 i = 0; i < resources[index].size; i++) {
+        bodies[index][i] = (u8) rand();
+    }
+
+    snprintf(etags[index], sizeof(etags[index]), "\"%lu-%lu\"", (unsigned long) index, (unsigned long) version);
+}
+
+static void test_fetch_thread(void* arg) {
+    u8* buffer = (u8*) malloc(ICON_BUFFER_SIZE);
+    TEST_CHECK(buffer != NULL);
+
+    while(true) {
+        svcWaitSynchronization(fetchMutex, U64_MAX);
+        u32 index = nextResource++;
+        svcReleaseMutex(fetchMutex);
+
+        if(index >= RESOURCE_COUNT) {
+            break;
+        }
+
+        char url[128];
+        snprintf(url, sizeof(url), "%s%s", baseUrl, resources[index].path);
+
+        u32 downloadedSize = 0;
+        TEST_CHECK_RESULT(http_download_buffer(url, &downloadedSize, buffer, ICON_BUFFER_SIZE));
+        TEST_CHECK(downloadedSize == resources[index].size);
+        TEST_CHECK(memcmp(buffer, bodies[index], downloadedSize) == 0);
+    }
+
+    free(buffer);
+}
+
+static void test_fetch_all(void) {
+    nextResource = 0;
+
+    Thread threads[FETCHER_COUNT];
+    for(u32 i = 0; i < FETCHER_COUNT; i++) {
+        TEST_CHECK((threads[i] = threadCreate(test_fetch_thread, NULL, 0x8000, 0x30, 1, false)) != NULL);
+    }
+
+    for(u32 i = 0; i < FETCHER_COUNT; i++) {
+        threadJoin(threads[i], U64_MAX);
+        threadFree(threads[i]);
+    }
+}
+
+static u32 test_count_cache_files(void) {
+    DIR* dir = opendir("fbi/cache/http");
+    TEST_CHECK(dir != NULL);
+
+    u32 count = 0;
+
+    struct dirent* ent = NULL;
+    while((ent = readdir(dir)) != NULL) {
+        if(strstr(ent->d_name, ".bin") != NULL) {
+            count++;
+        }
+    }
+
+    closedir(dir);
+    return count;
+}
+
+// Every fetch is a new request; the ones answered from the cache got a 304.
+static void test_check_stats(u32 expectedNotModified) {
+    host_http_stats serverStats;
+    host_http_server_get_stats(&serverStats);
+
+    http_pool_stats poolStats;
+    http_get_pool_stats(&poolStats);
+
+    printf("  %lu requests, %lu not modified, %lu served from the cache\n", (unsigned long) serverStats.requests, (unsigned long) serverStats.notModified,
+           (unsigned long) poolStats.cached);
+
+    TEST_CHECK(serverStats.requests == RESOURCE_COUNT);
+    TEST_CHECK(serverStats.notModified == expectedNotModified);
+    TEST_CHECK(poolStats.cached == expectedNotModified);
+}
+
+static void test_restart(void) {
+    http_exit();
+    http_init();
+
+    host_http_server_reset_stats();
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+
+    TEST_CHECK_RESULT(svcCreateMutex(&fetchMutex, false));
+
+    for(u32 i = 0; i < RESOURCE_COUNT; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/icon/%lu.png", (unsigned long) i);
+
+        resources[i].path = paths[i];
+        resources[i].size = 2 * 1024 + i * 1500;
+        resources[i].etag = etags[i];
+
+        TEST_CHECK((bodies[i] = (u8*) malloc(resources[i].size)) != NULL);
+        resources[i].body = bodies[i];
+
+        test_make_body(i, 1);
+    }
+
+    host_http_server_start(resources, RESOURCE_COUNT, baseUrl, sizeof(baseUrl));
+
+    printf("cold cache:\n");
+    test_restart();
+    test_fetch_all();
+    test_check_stats(0);
+    TEST_CHECK(test_count_cache_files() == RESOURCE_COUNT);
+
+    // The index is rebuilt from the files by whichever fetcher gets there first.
+    printf("rebuilt index:\n");
+    test_restart();
+    test_fetch_all();
+    test_check_stats(RESOURCE_COUNT);
+
+    printf("changed resources:\n");
+    for(u32 i = 0; i < RESOURCE_COUNT; i += 4) {
+        test_make_body(i, 2);
+    }
+
+    test_restart();
+    test_fetch_all();
+    test_check_stats(RESOURCE_COUNT - RESOURCE_COUNT / 4);
+    TEST_CHECK(test_count_cache_files() == RESOURCE_COUNT);
+
+    printf("through curl:\n");
+    host_httpc_set_tls_failure(true);
+    test_restart();
+    test_fetch_all();
+    test_check_stats(RESOURCE_COUNT);
+    host_httpc_set_tls_failure(false);
+
+    http_exit();
+    host_http_server_stop();
+
+    svcCloseHandle(fetchMutex);
+
+    for(u32 i = 0; i < RESOURCE_COUNT; i++) {
+        free(bodies[i]);
+    }
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    printf("ok\n");
+    return 0;
+}
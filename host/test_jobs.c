@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/io.h"
+#include "../source/core/job.h"
+#include "../source/ui/error.h"
+#include "test.h"
+
+// Runs a job through the host backend, which drives every step through the data operation engine.
+
+#define TEST_FILE_SIZE (1024 * 1024 + 123)
+
+static const char test_job_text[] =
+    "{\"name\": \"test\", \"bufferSize\": 65536, \"steps\": ["
+    "{\"op\": \"paste\", \"src\": \"/data/a.bin\", \"dst\": \"/data/b.bin\"},"
+    "{\"op\": \"install-cia\", \"src\": \"/data/a.bin\", \"media\": \"sd\", \"verify\": false},"
+    "{\"op\": \"delete\", \"src\": \"/data/a.bin\"},"
+    "{\"op\": \"install-url\", \"src\": \"http://localhost/title.cia\"},"
+    "{\"op\": \"paste\", \"src\": \"/data/missing.bin\", \"dst\": \"/data/c.bin\"}"
+    "]}";
+
+static void test_write_file(const char* path, const void* data, size_t size) {
+    FILE* fd = fopen(path, "wb");
+    TEST_CHECK(fd != NULL);
+    TEST_CHECK(fwrite(data, 1, size, fd) == size);
+    fclose(fd);
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+
+    mkdir("data", 0777);
+
+    u8* contents = (u8*) malloc(TEST_FILE_SIZE);
+    TEST_CHECK(contents != NULL);
+
+    srand(2);
+    for(u32 i = 0; i < TEST_FILE_SIZE; i++) {
+        contents[i] = (u8) rand();
+    }
+
+    test_write_file("data/a.bin", contents, TEST_FILE_SIZE);
+    test_write_file("job.json", test_job_text, sizeof(test_job_text) - 1);
+
+    job* j = (job*) calloc(1, sizeof(job));
+    TEST_CHECK(j != NULL);
+
+    io_stream* stream = NULL;
+    TEST_CHECK_RESULT(io_open_posix(&stream, "job.json", "rb"));
+    TEST_CHECK_RESULT(job_load(j, stream));
+    TEST_CHECK_RESULT(io_close(stream, true));
+
+    TEST_CHECK(j->stepCount == 5);
+    TEST_CHECK(j->steps[0].verify && !j->steps[1].verify && j->steps[3].verify);
+
+    Result res = job_run(j, &job_host_backend, ".");
+    TEST_CHECK(res == R_FBI_NOT_IMPLEMENTED);
+
+    TEST_CHECK(j->steps[0].result == 0);
+    TEST_CHECK(j->steps[0].bytes == TEST_FILE_SIZE);
+
+    TEST_CHECK(j->steps[1].result == 0);
+    TEST_CHECK(j->steps[1].bytes == TEST_FILE_SIZE);
+
+    TEST_CHECK(j->steps[2].result == 0);
+    TEST_CHECK(j->steps[3].result == R_FBI_NOT_IMPLEMENTED);
+    TEST_CHECK(j->steps[4].result == R_FBI_BAD_DATA);
+
+    struct stat st;
+    TEST_CHECK(stat("data/a.bin", &st) != 0);
+    TEST_CHECK(stat("data/c.bin", &st) != 0);
+
+    u8* copy = (u8*) malloc(TEST_FILE_SIZE + 1);
+    TEST_CHECK(copy != NULL);
+
+    FILE* fd = fopen("data/b.bin", "rb");
+    TEST_CHECK(fd != NULL);
+    TEST_CHECK(fread(copy, 1, TEST_FILE_SIZE + 1, fd) == TEST_FILE_SIZE);
+    TEST_CHECK(memcmp(copy, contents, TEST_FILE_SIZE) == 0);
+    fclose(fd);
+
+    free(copy);
+    free(contents);
+    free(j);
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/io.h"
+#include "../source/ui/error.h"
+#include "../source/ui/section/task/task.h"
+#include "hostui.h"
+#include "test.h"
+
+// Kills a copy once it has checkpointed, then reruns it and checks that it picked up from the journal, or started over
+// when the resume prompt was declined.
+
+#define JOURNAL_NAME "test"
+#define JOURNAL_PATH "fbi/journal/" JOURNAL_NAME ".bin"
+#define DST_PATH "dst.bin"
+
+#define BUFFER_SIZE (64 * 1024)
+#define SRC_SIZE (12 * 1024 * 1024 + 345)
+
+// Long enough per read that the child is still copying when it gets killed.
+#define SRC_READ_DELAY_US 2000
+
+static u8* srcData;
+static volatile u64 srcFirstOffset;
+
+static Result test_src_get_size(io_stream* stream, u64* size) {
+    *size = SRC_SIZE;
+    return 0;
+}
+
+static Result test_src_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    if(offset >= SRC_SIZE) {
+        *bytesRead = 0;
+        return 0;
+    }
+
+    if(offset < srcFirstOffset) {
+        srcFirstOffset = offset;
+    }
+
+    if(size > SRC_SIZE - offset) {
+        size = (u32) (SRC_SIZE - offset);
+    }
+
+    usleep(SRC_READ_DELAY_US);
+
+    memcpy(buffer, srcData + offset, size);
+    *bytesRead = size;
+    return 0;
+}
+
+static const io_ops test_src_ops = {
+    .getSize = test_src_get_size,
+    .read = test_src_read,
+    .write = NULL,
+    .close = NULL
+};
+
+static Result test_is_src_directory(void* data, u32 index, bool* isDirectory) {
+    *isDirectory = false;
+    return 0;
+}
+
+static Result test_make_dst_directory(void* data, u32 index) {
+    return 0;
+}
+
+static Result test_open_src(void* data, u32 index, io_stream** stream) {
+    return io_open(stream, &test_src_ops, NULL, 0, 0);
+}
+
+// Written through, as the device's FS_WRITE_FLUSH files are, so a kill loses nothing the journal counted.
+static Result test_open_dst_file(io_stream** stream, const char* mode) {
+    Result res = io_open_posix(stream, DST_PATH, mode);
+    if(R_SUCCEEDED(res)) {
+        setvbuf((FILE*) (*stream)->data, NULL, _IONBF, 0);
+    }
+
+    return res;
+}
+
+static Result test_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    return test_open_dst_file(stream, "wb");
+}
+
+static Result test_resume_dst(void* data, u32 index, const char* identity, io_stream** stream) {
+    if(strcmp(identity, DST_PATH) != 0) {
+        return R_FBI_BAD_DATA;
+    }
+
+    return test_open_dst_file(stream, "r+b");
+}
+
+static Result test_get_src_identity(void* data, u32 index, char* identity, size_t maxSize) {
+    snprintf(identity, maxSize, "test:%lu", (unsigned long) SRC_SIZE);
+    return 0;
+}
+
+static Result test_get_dst_identity(void* data, u32 index, io_stream* dst, char* identity, size_t maxSize) {
+    snprintf(identity, maxSize, "%s", DST_PATH);
+    return 0;
+}
+
+static Result test_copy(data_op_data* op, bool headless) {
+    memset(op, 0, sizeof(*op));
+
+    op->op = DATAOP_COPY;
+    op->total = 1;
+    op->bufferSize = BUFFER_SIZE;
+    op->bufferCount = 4;
+    op->copyEmpty = true;
+
+    op->batch = true;
+    op->headless = headless;
+
+    op->journalName = JOURNAL_NAME;
+    op->getSrcIdentity = test_get_src_identity;
+    op->getDstIdentity = test_get_dst_identity;
+    op->resumeDst = test_resume_dst;
+
+    op->isSrcDirectory = test_is_src_directory;
+    op->makeDstDirectory = test_make_dst_directory;
+    op->openSrc = test_open_src;
+    op->openDst = test_open_dst;
+
+    srcFirstOffset = U64_MAX;
+
+    bufpool_init();
+    bandwidth_init();
+
+    Result res = task_data_op_run(op);
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    return res;
+}
+
+static void test_interrupt(void) {
+    pid_t pid = fork();
+    TEST_CHECK(pid >= 0);
+
+    if(pid == 0) {
+        data_op_data op;
+        test_copy(&op, true);
+
+        // Finishing means the kill came too late to leave anything to resume.
+        _exit(0);
+    }
+
+    // The file appears before its first record is complete, so wait for one that loads.
+    data_op_journal journal;
+    while(R_FAILED(task_journal_load(JOURNAL_NAME, &journal, NULL))) {
+        int status = 0;
+        TEST_CHECK(waitpid(pid, &status, WNOHANG) == 0);
+
+        usleep(1000);
+    }
+
+    kill(pid, SIGKILL);
+
+    int status = 0;
+    TEST_CHECK(waitpid(pid, &status, 0) == pid);
+    TEST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+}
+
+static void test_verify(void) {
+    FILE* fd = fopen(DST_PATH, "rb");
+    TEST_CHECK(fd != NULL);
+
+    u8* contents = (u8*) malloc(SRC_SIZE + 1);
+    TEST_CHECK(contents != NULL);
+
+    TEST_CHECK(fread(contents, 1, SRC_SIZE + 1, fd) == SRC_SIZE);
+    TEST_CHECK(memcmp(contents, srcData, SRC_SIZE) == 0);
+
+    free(contents);
+    fclose(fd);
+}
+
+static void test_resume(bool headless, int promptResponse) {
+    test_interrupt();
+
+    host_ui_set_prompt_response(promptResponse);
+
+    data_op_data op;
+    TEST_CHECK_RESULT(test_copy(&op, headless));
+    TEST_CHECK(op.finished);
+    TEST_CHECK(op.failedItems == 0);
+    TEST_CHECK(op.copiedBytes == SRC_SIZE);
+
+    host_ui_set_prompt_response(-1);
+
+    printf("%s: started at %llu of %llu bytes\n", headless ? "headless" : promptResponse ? "resume accepted" : "resume declined",
+           (unsigned long long) srcFirstOffset, (unsigned long long) SRC_SIZE);
+
+    // Nothing before the first checkpoint is read again, unless the user asked to start over.
+    if(headless || promptResponse) {
+        TEST_CHECK(srcFirstOffset >= 4 * 1024 * 1024 && srcFirstOffset < SRC_SIZE);
+    } else {
+        TEST_CHECK(srcFirstOffset == 0);
+    }
+
+    test_verify();
+
+    struct stat st;
+    TEST_CHECK(stat(JOURNAL_PATH, &st) != 0);
+
+    remove(DST_PATH);
+}
+
+int main(int argc, const char* argv[]) {
+    srcData = (u8*) malloc(SRC_SIZE);
+    TEST_CHECK(srcData != NULL);
+
+    srand(3);
+    for(u32 i = 0; i < SRC_SIZE; i++) {
+        srcData[i] = (u8) rand();
+    }
+
+    test_resume(true, -1);
+    test_resume(false, true);
+    test_resume(false, false);
+
+    free(srcData);
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/bandwidth.h"
+#include "../source/core/bufpool.h"
+#include "../source/core/http.h"
+#include "../source/core/io.h"
+#include "../source/ui/error.h"
+#include "hosthttpc.h"
+#include "httpserver.h"
+#include "test.h"
+
+// Downloads from a loopback server that honours ranges over several connections, checking the bytes, how many requests
+// it took, resuming part way in, servers that ignore ranges, and cancelling a download that is waiting on its segments.
+// The same downloads then go through io_open_http, both over httpc and handed over from the curl fallback.
+
+#define LARGE_SIZE (40 * 1024 * 1024 + 12345)
+#define SMALL_SIZE (300 * 1024)
+#define BUFFER_SIZE (64 * 1024)
+// Not a multiple of anything the server or the segments use, so every read has to be stitched together.
+#define STREAM_BUFFER_SIZE (100 * 1000 + 7)
+
+// 16 KiB every 2ms is about 8 MiB/s per connection, slow enough for the cancel to land mid-download.
+#define THROTTLE_CHUNK_DELAY_US 2000
+#define CANCEL_DELAY_MS 500
+#define CANCEL_LATENCY_MAX_MS 250
+
+enum {
+    RESOURCE_LARGE,
+    RESOURCE_SMALL,
+    RESOURCE_NO_RANGES,
+    RESOURCE_COUNT
+};
+
+static host_http_resource resources[RESOURCE_COUNT] = {
+    {"/large.bin", NULL, LARGE_SIZE, NULL, NULL, false},
+    {"/small.bin", NULL, SMALL_SIZE, NULL, NULL, false},
+    {"/noranges.bin", NULL, SMALL_SIZE * 3, NULL, NULL, true},
+};
+
+static char baseUrl[64];
+
+typedef struct {
+    const u8* expected;
+    u64 offset;
+    u64 size;
+} test_download;
+
+static Result test_download_callback(void* userData, void* buffer, size_t size) {
+    test_download* download = (test_download*) userData;
+
+    TEST_CHECK(download->offset + size <= download->size);
+    TEST_CHECK(memcmp(buffer, download->expected + download->offset, size) == 0);
+
+    download->offset += size;
+    return 0;
+}
+
+static Result test_download_resource(u32 index, u64 rangeStart, u32 connections, host_http_stats* stats) {
+    char url[128];
+    snprintf(url, sizeof(url), "%s%s", baseUrl, resources[index].path);
+
+    test_download download = {(const u8*) resources[index].body + rangeStart, 0, resources[index].size - rangeStart};
+
+    host_http_server_reset_stats();
+
+    u64 contentLength = 0;
+    Result res = http_download_callback_segmented(url, rangeStart, BUFFER_SIZE, connections, 0, &contentLength, &download, test_download_callback);
+
+    host_http_server_get_stats(stats);
+
+    if(R_SUCCEEDED(res)) {
+        TEST_CHECK(contentLength == download.size);
+        TEST_CHECK(download.offset == download.size);
+    }
+
+    return res;
+}
+
+static void test_connections(u32 connections) {
+    host_http_stats stats;
+    TEST_CHECK_RESULT(test_download_resource(RESOURCE_LARGE, 0, connections, &stats));
+
+    printf("  %lu connections: %lu requests, %lu connections opened\n", (unsigned long) connections, (unsigned long) stats.requests,
+           (unsigned long) stats.connections);
+
+    // Segments average at least a megabyte, so a request per 512 KiB would fail this.
+    TEST_CHECK(stats.requests <= LARGE_SIZE / (1024 * 1024) + 1);
+    TEST_CHECK(connections <= 1 || stats.rangeRequests == stats.requests);
+}
+
+static void test_resume(void) {
+    static const u64 offsets[] = {1, 5 * 1024 * 1024 + 777, LARGE_SIZE - 100};
+
+    for(u32 i = 0; i < sizeof(offsets) / sizeof(*offsets); i++) {
+        host_http_stats stats;
+        TEST_CHECK_RESULT(test_download_resource(RESOURCE_LARGE, offsets[i], 4, &stats));
+
+        printf("  from %llu: %lu requests\n", (unsigned long long) offsets[i], (unsigned long) stats.requests);
+    }
+}
+
+static void test_small(void) {
+    host_http_stats stats;
+    TEST_CHECK_RESULT(test_download_resource(RESOURCE_SMALL, 0, 4, &stats));
+    TEST_CHECK(stats.requests == 1);
+}
+
+static void test_no_ranges(void) {
+    host_http_stats stats;
+    TEST_CHECK_RESULT(test_download_resource(RESOURCE_NO_RANGES, 0, 4, &stats));
+    TEST_CHECK(stats.requests == 1);
+
+    TEST_CHECK(test_download_resource(RESOURCE_NO_RANGES, 1000, 4, &stats) == R_FBI_HTTP_RANGE_NOT_SUPPORTED);
+}
+
+static Handle cancelEvent;
+static volatile u64 cancelTime;
+
+static void test_cancel_thread(void* arg) {
+    svcSleepThread((s64) CANCEL_DELAY_MS * 1000000);
+
+    cancelTime = osGetTime();
+    svcSignalEvent(cancelEvent);
+}
+
+static void test_cancel(void) {
+    char url[128];
+    snprintf(url, sizeof(url), "%s%s", baseUrl, resources[RESOURCE_LARGE].path);
+
+    TEST_CHECK_RESULT(svcCreateEvent(&cancelEvent, RESET_STICKY));
+    host_http_server_set_delays(0, THROTTLE_CHUNK_DELAY_US);
+
+    u8* buffer = (u8*) malloc(BUFFER_SIZE);
+    TEST_CHECK(buffer != NULL);
+
+    http_segmented download = NULL;
+    TEST_CHECK_RESULT(http_segmented_open(&download, url, true, 0, 4, cancelEvent));
+
+    Thread thread = threadCreate(test_cancel_thread, NULL, 0x8000, 0x30, 1, false);
+    TEST_CHECK(thread != NULL);
+
+    Result res = 0;
+    u64 total = 0;
+    u32 bytesRead = 0;
+    while(total < LARGE_SIZE && R_SUCCEEDED(res = http_segmented_read(download, &bytesRead, buffer, BUFFER_SIZE))) {
+        total += bytesRead;
+    }
+
+    u64 returned = osGetTime();
+    TEST_CHECK_RESULT(http_segmented_close(download));
+    u64 closed = osGetTime();
+
+    threadJoin(thread, U64_MAX);
+    threadFree(thread);
+
+    printf("  cancelled after %llu of %lu bytes; read returned in %llums, close took %llums\n", (unsigned long long) total, (unsigned long) LARGE_SIZE,
+           (unsigned long long) (returned - cancelTime), (unsigned long long) (closed - returned));
+
+    TEST_CHECK(res == R_FBI_CANCELLED);
+    TEST_CHECK(total < LARGE_SIZE);
+    TEST_CHECK(returned - cancelTime <= CANCEL_LATENCY_MAX_MS);
+    TEST_CHECK(closed - returned <= CANCEL_LATENCY_MAX_MS);
+
+    free(buffer);
+    host_http_server_set_delays(0, 0);
+    svcCloseHandle(cancelEvent);
+}
+
+static Result test_stream_resource(u32 index, u64 rangeStart, u32 connections, host_http_stats* stats) {
+    char url[128];
+    snprintf(url, sizeof(url), "%s%s", baseUrl, resources[index].path);
+
+    const u8* expected = (const u8*) resources[index].body + rangeStart;
+    u64 expectedSize = resources[index].size - rangeStart;
+
+    u8* buffer = (u8*) malloc(STREAM_BUFFER_SIZE);
+    TEST_CHECK(buffer != NULL);
+
+    host_http_server_reset_stats();
+
+    io_stream* stream = NULL;
+    Result res = io_open_http(&stream, url, true, rangeStart, connections, 0);
+    if(R_SUCCEEDED(res)) {
+        u64 size = 0;
+        TEST_CHECK_RESULT(io_get_size(stream, &size));
+        TEST_CHECK(size == expectedSize);
+
+        u64 total = 0;
+        u32 bytesRead = 0;
+        while(R_SUCCEEDED(res = io_read(stream, &bytesRead, buffer, total, STREAM_BUFFER_SIZE)) && bytesRead > 0) {
+            TEST_CHECK(total + bytesRead <= expectedSize);
+            TEST_CHECK(memcmp(buffer, expected + total, bytesRead) == 0);
+
+            total += bytesRead;
+
+            // Only the end of the body may cut a read short.
+            TEST_CHECK(bytesRead == STREAM_BUFFER_SIZE || total == expectedSize);
+        }
+
+        TEST_CHECK_RESULT(res);
+        TEST_CHECK(total == expectedSize);
+
+        res = io_close(stream, true);
+    }
+
+    host_http_server_get_stats(stats);
+
+    free(buffer);
+    return res;
+}
+
+static void test_stream(bool curl) {
+    host_httpc_set_tls_failure(curl);
+
+    static const u32 connections[] = {1, 4};
+    for(u32 i = 0; i < sizeof(connections) / sizeof(*connections); i++) {
+        host_http_stats stats;
+        TEST_CHECK_RESULT(test_stream_resource(RESOURCE_LARGE, 0, connections[i], &stats));
+
+        printf("  %s, %lu connections: %lu requests\n", curl ? "curl" : "httpc", (unsigned long) connections[i], (unsigned long) stats.requests);
+
+        // One connection is one open-ended request; curl never splits the body.
+        TEST_CHECK(stats.requests == 1 || (!curl && connections[i] > 1));
+    }
+
+    host_http_stats stats;
+    TEST_CHECK_RESULT(test_stream_resource(RESOURCE_LARGE, 5 * 1024 * 1024 + 777, 4, &stats));
+    TEST_CHECK_RESULT(test_stream_resource(RESOURCE_SMALL, 0, 4, &stats));
+    TEST_CHECK_RESULT(test_stream_resource(RESOURCE_NO_RANGES, 0, 4, &stats));
+    TEST_CHECK(test_stream_resource(RESOURCE_NO_RANGES, 1000, 4, &stats) == R_FBI_HTTP_RANGE_NOT_SUPPORTED);
+
+    host_httpc_set_tls_failure(false);
+}
+
+static void test_stream_cancel(bool curl) {
+    char url[128];
+    snprintf(url, sizeof(url), "%s%s", baseUrl, resources[RESOURCE_LARGE].path);
+
+    host_httpc_set_tls_failure(curl);
+
+    TEST_CHECK_RESULT(svcCreateEvent(&cancelEvent, RESET_STICKY));
+    host_http_server_set_delays(0, THROTTLE_CHUNK_DELAY_US);
+
+    u8* buffer = (u8*) malloc(BUFFER_SIZE);
+    TEST_CHECK(buffer != NULL);
+
+    io_stream* stream = NULL;
+    TEST_CHECK_RESULT(io_open_http(&stream, url, true, 0, 4, cancelEvent));
+
+    Thread thread = threadCreate(test_cancel_thread, NULL, 0x8000, 0x30, 1, false);
+    TEST_CHECK(thread != NULL);
+
+    Result res = 0;
+    u64 total = 0;
+    u32 bytesRead = 0;
+    while(total < LARGE_SIZE && R_SUCCEEDED(res = io_read(stream, &bytesRead, buffer, total, BUFFER_SIZE))) {
+        total += bytesRead;
+    }
+
+    u64 returned = osGetTime();
+    io_close(stream, false);
+    u64 closed = osGetTime();
+
+    threadJoin(thread, U64_MAX);
+    threadFree(thread);
+
+    printf("  %s: cancelled after %llu bytes; read returned in %llums, close took %llums\n", curl ? "curl" : "httpc", (unsigned long long) total,
+           (unsigned long long) (returned - cancelTime), (unsigned long long) (closed - returned));
+
+    TEST_CHECK(res == R_FBI_CANCELLED);
+    TEST_CHECK(total < LARGE_SIZE);
+    TEST_CHECK(returned - cancelTime <= CANCEL_LATENCY_MAX_MS);
+    TEST_CHECK(closed - returned <= CANCEL_LATENCY_MAX_MS);
+
+    free(buffer);
+    host_http_server_set_delays(0, 0);
+    svcCloseHandle(cancelEvent);
+
+    host_httpc_set_tls_failure(false);
+}
+
+int main(int argc, const char* argv[]) {
+    bufpool_init();
+    bandwidth_init();
+    http_init();
+
+    srand(1);
+    for(u32 i = 0; i < RESOURCE_COUNT; i++) {
+        u8* body = (u8*) malloc(resources[i].size);
+        TEST_CHECK(body != NULL);
+
+        for(u32 j = 0; j < resources[i].size; j++) {
+            body[j] = (u8) rand();
+        }
+
+        resources[i].body = body;
+    }
+
+    host_http_server_start(resources, RESOURCE_COUNT, baseUrl, sizeof(baseUrl));
+
+    printf("connections:\n");
+    test_connections(1);
+    test_connections(4);
+    test_connections(8);
+
+    printf("resume:\n");
+    test_resume();
+
+    printf("small and range-less resources:\n");
+    test_small();
+    test_no_ranges();
+
+    printf("cancel:\n");
+    test_cancel();
+
+    printf("io_open_http:\n");
+    test_stream(false);
+    test_stream(true);
+    test_stream_cancel(false);
+    test_stream_cancel(true);
+
+    http_exit();
+    host_http_server_stop();
+
+    for(u32 i = 0; i < RESOURCE_COUNT; i++) {
+        free((void*) resources[i].body);
+    }
+
+    bandwidth_exit();
+    bufpool_exit();
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/core/iohost.h"
+#include "../source/core/io.h"
+#include "../source/core/titledbcache.h"
+#include "../source/ui/error.h"
+#include "test.h"
+
+// Builds a TitleDB snapshot, writes it out and reads it back through a file and a memory stream, then corrupts it.
+
+#define RECORD_COUNT 5000
+#define DESCRIPTION_MAX 599
+
+static void test_make_strings(u32 index, char* name, size_t nameSize, char* description, char* author, size_t authorSize) {
+    snprintf(name, nameSize, "Name %lu", (unsigned long) index);
+    memset(description, 'x', index % DESCRIPTION_MAX);
+    description[index % DESCRIPTION_MAX] = '\0';
+    snprintf(author, authorSize, "Author %lu", (unsigned long) (index % 7));
+}
+
+static void test_check_cache(const void* buffer, u32 size) {
+    titledb_cache cache;
+    TEST_CHECK_RESULT(titledb_cache_open(&cache, buffer, size));
+    TEST_CHECK(cache.recordCount == RECORD_COUNT);
+
+    char name[64];
+    char description[DESCRIPTION_MAX + 1];
+    char author[32];
+    for(u32 i = 0; i < RECORD_COUNT; i++) {
+        test_make_strings(i, name, sizeof(name), description, author, sizeof(author));
+
+        const titledb_cache_record* record = &cache.records[i];
+        TEST_CHECK(record->titleId == 0x0004000000100000ULL + i);
+        TEST_CHECK(record->size == i * 1000ULL);
+        TEST_CHECK(strcmp(titledb_cache_get_string(&cache, record->name), name) == 0);
+        TEST_CHECK(strcmp(titledb_cache_get_string(&cache, record->description), description) == 0);
+        TEST_CHECK(strcmp(titledb_cache_get_string(&cache, record->author), author) == 0);
+    }
+}
+
+// Reads a stream back the way the cache is loaded: its size first, then the whole snapshot in one go.
+static void* test_read_stream(io_stream* stream, u32* size) {
+    u64 streamSize = 0;
+    TEST_CHECK_RESULT(io_get_size(stream, &streamSize));
+    TEST_CHECK(streamSize > 0 && streamSize <= TITLEDB_CACHE_SIZE_MAX);
+
+    void* buffer = malloc((size_t) streamSize);
+    TEST_CHECK(buffer != NULL);
+
+    u32 bytesRead = 0;
+    TEST_CHECK_RESULT(io_read(stream, &bytesRead, buffer, 0, (u32) streamSize));
+    TEST_CHECK(bytesRead == streamSize);
+
+    *size = (u32) streamSize;
+    return buffer;
+}
+
+static void test_file(void* snapshot, u32 snapshotSize) {
+    io_stream* stream = NULL;
+    TEST_CHECK_RESULT(io_open_posix(&stream, "titledb.bin", "wb"));
+
+    u32 bytesWritten = 0;
+    TEST_CHECK_RESULT(io_write(stream, &bytesWritten, snapshot, 0, snapshotSize));
+    TEST_CHECK(bytesWritten == snapshotSize);
+    TEST_CHECK_RESULT(io_close(stream, true));
+
+    TEST_CHECK_RESULT(io_open_posix(&stream, "titledb.bin", "rb"));
+
+    u32 size = 0;
+    void* buffer = test_read_stream(stream, &size);
+    TEST_CHECK_RESULT(io_close(stream, true));
+
+    TEST_CHECK(size == snapshotSize);
+    TEST_CHECK(memcmp(buffer, snapshot, size) == 0);
+    test_check_cache(buffer, size);
+
+    free(buffer);
+    remove("titledb.bin");
+}
+
+static void test_memory(void* snapshot, u32 snapshotSize) {
+    io_stream* stream = NULL;
+    TEST_CHECK_RESULT(io_open_memory(&stream, snapshot, snapshotSize));
+
+    u32 size = 0;
+    void* buffer = test_read_stream(stream, &size);
+    TEST_CHECK_RESULT(io_close(stream, true));
+
+    TEST_CHECK(size == snapshotSize);
+    test_check_cache(buffer, size);
+
+    free(buffer);
+}
+
+static void test_corrupt(void* snapshot, u32 snapshotSize) {
+    titledb_cache cache;
+    u8* bytes = (u8*) snapshot;
+
+    // Strings must end inside the table.
+    bytes[snapshotSize - 1] = 'a';
+    TEST_CHECK(titledb_cache_open(&cache, snapshot, snapshotSize) == R_FBI_BAD_DATA);
+    bytes[snapshotSize - 1] = '\0';
+
+    TEST_CHECK(titledb_cache_open(&cache, snapshot, snapshotSize - 1) == R_FBI_BAD_DATA);
+
+    titledb_cache_record* records = (titledb_cache_record*) (bytes + sizeof(titledb_cache_header));
+    u32 name = records[3].name;
+    records[3].name = 0xFFFFFFF;
+    TEST_CHECK(titledb_cache_open(&cache, snapshot, snapshotSize) == R_FBI_BAD_DATA);
+    records[3].name = name;
+
+    titledb_cache_header* header = (titledb_cache_header*) snapshot;
+    header->version = TITLEDB_CACHE_VERSION + 1;
+    TEST_CHECK(titledb_cache_open(&cache, snapshot, snapshotSize) == R_FBI_BAD_DATA);
+    header->version = TITLEDB_CACHE_VERSION;
+
+    TEST_CHECK_RESULT(titledb_cache_open(&cache, snapshot, snapshotSize));
+}
+
+int main(int argc, const char* argv[]) {
+    titledb_cache_builder builder;
+    titledb_cache_builder_init(&builder);
+
+    char name[64];
+    char description[DESCRIPTION_MAX + 1];
+    char author[32];
+    for(u32 i = 0; i < RECORD_COUNT; i++) {
+        test_make_strings(i, name, sizeof(name), description, author, sizeof(author));
+        TEST_CHECK_RESULT(titledb_cache_builder_add(&builder, 0x0004000000100000ULL + i, i * 1000ULL, name, description, author));
+    }
+
+    void* snapshot = NULL;
+    u32 snapshotSize = 0;
+    TEST_CHECK_RESULT(titledb_cache_builder_finish(&builder, &snapshot, &snapshotSize));
+    titledb_cache_builder_free(&builder);
+
+    test_file(snapshot, snapshotSize);
+    test_memory(snapshot, snapshotSize);
+    test_corrupt(snapshot, snapshotSize);
+
+    free(snapshot);
+
+    // An empty catalogue still makes a valid snapshot.
+    titledb_cache_builder_init(&builder);
+    TEST_CHECK_RESULT(titledb_cache_builder_finish(&builder, &snapshot, &snapshotSize));
+    titledb_cache_builder_free(&builder);
+
+    titledb_cache cache;
+    TEST_CHECK_RESULT(titledb_cache_open(&cache, snapshot, snapshotSize));
+    TEST_CHECK(cache.recordCount == 0);
+
+    free(snapshot);
+
+    printf("ok\n");
+    return 0;
+}
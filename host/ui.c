@@ -0,0 +1,64 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "../source/core/iohost.h"
+#include "../source/ui/error.h"
+#include "../source/ui/prompt.h"
+#include "hostui.h"
+
+static int host_ui_prompt_response = -1;
+
+void host_ui_set_prompt_response(int response) {
+    host_ui_prompt_response = response;
+}
+
+// Prompts and errors are printed and dismissed at once, so there is never a view to wait on. Yes/no prompts get the
+// answer a test has set, if any, before this returns; otherwise operations see them as declined.
+ui_view* prompt_display(const char* name, const char* text, u32 color, bool option, void* data, void (*drawTop)(ui_view* view, void* data, float x1, float y1, float x2, float y2),
+                                                                                                void (*onResponse)(ui_view* view, void* data, bool response)) {
+    fprintf(stderr, "%s: %s\n", name, text);
+
+    if(option && host_ui_prompt_response >= 0 && onResponse != NULL) {
+        fprintf(stderr, "%s: answered %s\n", name, host_ui_prompt_response ? "yes" : "no");
+        onResponse(NULL, data, host_ui_prompt_response != 0);
+    }
+
+    return NULL;
+}
+
+ui_view* error_display(void* data, void (*drawTop)(ui_view* view, void* data, float x1, float y1, float x2, float y2), const char* text, ...) {
+    va_list list;
+    va_start(list, text);
+
+    vfprintf(stderr, text, list);
+    fprintf(stderr, "\n");
+
+    va_end(list);
+
+    return NULL;
+}
+
+const char* error_get_description(Result result) {
+    switch(result) {
+        case R_FBI_INVALID_ARGUMENT:
+            return "Invalid argument";
+        case R_FBI_CANCELLED:
+            return "Operation cancelled";
+        case R_FBI_SKIPPED:
+            return "Operation skipped";
+        case R_FBI_THREAD_CREATE_FAILED:
+            return "Thread creation failed";
+        case R_FBI_PARSE_FAILED:
+            return "Parse failed";
+        case R_FBI_BAD_DATA:
+            return "Bad data";
+        case R_FBI_NOT_IMPLEMENTED:
+            return "Not implemented";
+        case R_FBI_OUT_OF_MEMORY:
+            return "Out of memory";
+        case R_FBI_OUT_OF_RANGE:
+            return "Out of range";
+        default:
+            return "<unknown>";
+    }
+}
@@ -0,0 +1,180 @@
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include "bandwidth.h"
+#include "util.h"
+
+// A class counts as competing for the link if it received data this recently.
+#define BANDWIDTH_ACTIVE_MS 1000
+#define BANDWIDTH_WINDOW_MS 1000
+#define BANDWIDTH_BURST_MS 250
+#define BANDWIDTH_MIN_RATE (8 * 1024)
+#define BANDWIDTH_MAX_SLEEP_MS 1000
+
+typedef struct {
+    u32 weight;
+
+    u64 lastActive;
+
+    u64 windowStart;
+    u32 windowBytes;
+    u32 rate;
+
+    s64 tokens;
+    u64 lastRefill;
+} bandwidth_state;
+
+static Handle bandwidth_mutex;
+static bandwidth_state bandwidth_states[BANDWIDTH_CLASS_COUNT];
+
+static __thread bandwidth_class bandwidth_thread_class = BANDWIDTH_CLASS_INSTALL;
+
+static const u32 bandwidth_default_weights[BANDWIDTH_CLASS_COUNT] = {8, 3, 1};
+
+void bandwidth_init() {
+    Result res = 0;
+    if(R_FAILED(res = svcCreateMutex(&bandwidth_mutex, false))) {
+        util_panic("Failed to create bandwidth mutex: 0x%08lX", res);
+        return;
+    }
+
+    for(u32 i = 0; i < BANDWIDTH_CLASS_COUNT; i++) {
+        bandwidth_states[i] = (bandwidth_state) {0};
+        bandwidth_states[i].weight = bandwidth_default_weights[i];
+    }
+}
+
+void bandwidth_exit() {
+    if(bandwidth_mutex != 0) {
+        svcCloseHandle(bandwidth_mutex);
+        bandwidth_mutex = 0;
+    }
+}
+
+void bandwidth_set_class(bandwidth_class cls) {
+    if(cls < BANDWIDTH_CLASS_COUNT) {
+        bandwidth_thread_class = cls;
+    }
+}
+
+bandwidth_class bandwidth_get_class() {
+    return bandwidth_thread_class;
+}
+
+void bandwidth_set_weight(bandwidth_class cls, u32 weight) {
+    if(cls < BANDWIDTH_CLASS_COUNT && weight > 0) {
+        bandwidth_states[cls].weight = weight;
+    }
+}
+
+u32 bandwidth_get_weight(bandwidth_class cls) {
+    return cls < BANDWIDTH_CLASS_COUNT ? bandwidth_states[cls].weight : 0;
+}
+
+static void bandwidth_update_rate(bandwidth_state* state, u64 now) {
+    u64 elapsed = now - state->windowStart;
+    if(elapsed >= BANDWIDTH_WINDOW_MS) {
+        state->rate = (u32) ((u64) state->windowBytes * 1000 / elapsed);
+        state->windowBytes = 0;
+        state->windowStart = now;
+    }
+}
+
+void bandwidth_consume(u32 bytes) {
+    if(bandwidth_mutex == 0 || bytes == 0) {
+        return;
+    }
+
+    u64 sleepMs = 0;
+
+    svcWaitSynchronization(bandwidth_mutex, U64_MAX);
+
+    u64 now = osGetTime();
+    bandwidth_class cls = bandwidth_thread_class;
+    bandwidth_state* state = &bandwidth_states[cls];
+
+    if(now - state->lastActive >= BANDWIDTH_ACTIVE_MS) {
+        state->windowStart = now;
+        state->windowBytes = 0;
+        state->tokens = 0;
+        state->lastRefill = now;
+    }
+
+    state->lastActive = now;
+    state->windowBytes += bytes;
+    bandwidth_update_rate(state, now);
+
+    // The heaviest active class is never throttled, so the link stays fully used; lighter classes
+    // are held to their weighted share of what the link is currently delivering.
+    u32 totalRate = 0;
+    u32 totalWeight = 0;
+    u32 maxWeight = 0;
+    for(u32 i = 0; i < BANDWIDTH_CLASS_COUNT; i++) {
+        bandwidth_state* other = &bandwidth_states[i];
+        if(now - other->lastActive < BANDWIDTH_ACTIVE_MS) {
+            totalRate += other->rate;
+            totalWeight += other->weight;
+
+            if(i != cls && other->weight > maxWeight) {
+                maxWeight = other->weight;
+            }
+        }
+    }
+
+    if(maxWeight >= state->weight) {
+        // A quarter of headroom lets equally weighted classes grow into spare capacity.
+        u32 share = (u32) ((u64) totalRate * 5 / 4 * state->weight / totalWeight);
+        if(share < BANDWIDTH_MIN_RATE) {
+            share = BANDWIDTH_MIN_RATE;
+        }
+
+        s64 burst = (s64) share * BANDWIDTH_BURST_MS / 1000;
+
+        state->tokens += (s64) share * (s64) (now - state->lastRefill) / 1000;
+        if(state->tokens > burst) {
+            state->tokens = burst;
+        }
+
+        state->tokens -= bytes;
+        if(state->tokens < 0) {
+            sleepMs = (u64) -state->tokens * 1000 / share;
+            if(sleepMs > BANDWIDTH_MAX_SLEEP_MS) {
+                sleepMs = BANDWIDTH_MAX_SLEEP_MS;
+            }
+        }
+    } else {
+        state->tokens = 0;
+    }
+
+    state->lastRefill = now;
+
+    svcReleaseMutex(bandwidth_mutex);
+
+    if(sleepMs > 0) {
+        svcSleepThread(sleepMs * 1000000);
+    }
+}
+
+u32 bandwidth_get_rate(bandwidth_class cls) {
+    if(cls >= BANDWIDTH_CLASS_COUNT || bandwidth_mutex == 0) {
+        return 0;
+    }
+
+    svcWaitSynchronization(bandwidth_mutex, U64_MAX);
+
+    u64 now = osGetTime();
+    bandwidth_state* state = &bandwidth_states[cls];
+
+    u32 rate = 0;
+    if(now - state->lastActive < BANDWIDTH_ACTIVE_MS + BANDWIDTH_WINDOW_MS) {
+        bandwidth_update_rate(state, now);
+        rate = state->rate;
+    }
+
+    svcReleaseMutex(bandwidth_mutex);
+
+    return rate;
+}
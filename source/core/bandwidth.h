@@ -0,0 +1,24 @@
+#pragma once
+
+typedef enum bandwidth_class_e {
+    BANDWIDTH_CLASS_INSTALL,
+    BANDWIDTH_CLASS_LISTING,
+    BANDWIDTH_CLASS_ICON,
+    BANDWIDTH_CLASS_COUNT
+} bandwidth_class;
+
+void bandwidth_init();
+void bandwidth_exit();
+
+// The class is tracked per thread; threads start out in BANDWIDTH_CLASS_INSTALL.
+void bandwidth_set_class(bandwidth_class cls);
+bandwidth_class bandwidth_get_class();
+
+void bandwidth_set_weight(bandwidth_class cls, u32 weight);
+u32 bandwidth_get_weight(bandwidth_class cls);
+
+// Accounts received bytes to the calling thread's class, sleeping if the class is over its share of the link.
+void bandwidth_consume(u32 bytes);
+
+// Bytes per second received by the class over the last second.
+u32 bandwidth_get_rate(bandwidth_class cls);
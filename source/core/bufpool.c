@@ -0,0 +1,208 @@
+#include <malloc.h>
+#include <string.h>
+
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include "bufpool.h"
+#include "util.h"
+
+// Power-of-two size classes from 4 KiB to 1 MiB; anything larger bypasses the pool.
+#define BUFPOOL_CLASS_MIN_SHIFT 12
+#define BUFPOOL_CLASS_COUNT 9
+#define BUFPOOL_CLASS_SLOTS 8
+
+typedef struct {
+    void* free[BUFPOOL_CLASS_COUNT][BUFPOOL_CLASS_SLOTS];
+    u32 freeCount[BUFPOOL_CLASS_COUNT];
+
+    u32 cacheLimit;
+
+    bufpool_stats stats;
+} bufpool_state;
+
+static Handle bufpool_mutex;
+static bufpool_state bufpool_states[BUFPOOL_HEAP_COUNT];
+
+// Linear memory is shared with the GPU and much scarcer, so it keeps a smaller cache.
+static const u32 bufpool_cache_limits[BUFPOOL_HEAP_COUNT] = {2 * 1024 * 1024, 512 * 1024};
+
+static u32 bufpool_get_class(u32 size) {
+    u32 cls = 0;
+    while(cls < BUFPOOL_CLASS_COUNT && ((u32) 1 << (cls + BUFPOOL_CLASS_MIN_SHIFT)) < size) {
+        cls++;
+    }
+
+    return cls;
+}
+
+static u32 bufpool_class_size(u32 cls) {
+    return (u32) 1 << (cls + BUFPOOL_CLASS_MIN_SHIFT);
+}
+
+static void* bufpool_heap_alloc(bufpool_heap heap, u32 size) {
+    return heap == BUFPOOL_LINEAR ? linearAlloc(size) : malloc(size);
+}
+
+static void bufpool_heap_free(bufpool_heap heap, void* buffer) {
+    if(heap == BUFPOOL_LINEAR) {
+        linearFree(buffer);
+    } else {
+        free(buffer);
+    }
+}
+
+static void bufpool_update_peak(bufpool_stats* stats) {
+    u32 total = stats->outstandingBytes + stats->cachedBytes;
+    if(total > stats->peakBytes) {
+        stats->peakBytes = total;
+    }
+}
+
+void bufpool_init() {
+    Result res = 0;
+    if(R_FAILED(res = svcCreateMutex(&bufpool_mutex, false))) {
+        util_panic("Failed to create buffer pool mutex: 0x%08lX", res);
+        return;
+    }
+
+    for(u32 i = 0; i < BUFPOOL_HEAP_COUNT; i++) {
+        memset(&bufpool_states[i], 0, sizeof(bufpool_states[i]));
+        bufpool_states[i].cacheLimit = bufpool_cache_limits[i];
+    }
+}
+
+void bufpool_exit() {
+    if(bufpool_mutex != 0) {
+        bufpool_trim();
+
+        svcCloseHandle(bufpool_mutex);
+        bufpool_mutex = 0;
+    }
+}
+
+void* bufpool_alloc(bufpool_heap heap, u32 size) {
+    if(heap >= BUFPOOL_HEAP_COUNT) {
+        return NULL;
+    }
+
+    // Pooled sizes are always rounded up to their class, even before the pool is running, so buffers can be cached no matter when they were allocated.
+    u32 cls = bufpool_get_class(size);
+    u32 allocSize = cls < BUFPOOL_CLASS_COUNT ? bufpool_class_size(cls) : size;
+
+    if(bufpool_mutex == 0) {
+        return bufpool_heap_alloc(heap, allocSize);
+    }
+
+    bufpool_state* state = &bufpool_states[heap];
+    void* buffer = NULL;
+
+    svcWaitSynchronization(bufpool_mutex, U64_MAX);
+
+    state->stats.allocs++;
+
+    if(cls < BUFPOOL_CLASS_COUNT && state->freeCount[cls] > 0) {
+        buffer = state->free[cls][--state->freeCount[cls]];
+
+        state->stats.reused++;
+        state->stats.cachedBytes -= allocSize;
+    }
+
+    svcReleaseMutex(bufpool_mutex);
+
+    if(buffer == NULL && (buffer = bufpool_heap_alloc(heap, allocSize)) == NULL) {
+        // Cached buffers of other sizes may be what is standing in the way.
+        bufpool_trim();
+        buffer = bufpool_heap_alloc(heap, allocSize);
+    }
+
+    if(buffer != NULL) {
+        svcWaitSynchronization(bufpool_mutex, U64_MAX);
+
+        state->stats.outstanding++;
+        state->stats.outstandingBytes += allocSize;
+        bufpool_update_peak(&state->stats);
+
+        svcReleaseMutex(bufpool_mutex);
+    }
+
+    return buffer;
+}
+
+void bufpool_free(bufpool_heap heap, void* buffer, u32 size) {
+    if(heap >= BUFPOOL_HEAP_COUNT || buffer == NULL) {
+        return;
+    }
+
+    if(bufpool_mutex == 0) {
+        bufpool_heap_free(heap, buffer);
+        return;
+    }
+
+    u32 cls = bufpool_get_class(size);
+    u32 allocSize = cls < BUFPOOL_CLASS_COUNT ? bufpool_class_size(cls) : size;
+
+    bufpool_state* state = &bufpool_states[heap];
+    bool cached = false;
+
+    svcWaitSynchronization(bufpool_mutex, U64_MAX);
+
+    if(state->stats.outstanding > 0) {
+        state->stats.outstanding--;
+    }
+
+    state->stats.outstandingBytes = state->stats.outstandingBytes > allocSize ? state->stats.outstandingBytes - allocSize : 0;
+
+    if(cls < BUFPOOL_CLASS_COUNT && state->freeCount[cls] < BUFPOOL_CLASS_SLOTS && state->stats.cachedBytes + allocSize <= state->cacheLimit) {
+        state->free[cls][state->freeCount[cls]++] = buffer;
+        state->stats.cachedBytes += allocSize;
+
+        cached = true;
+    }
+
+    svcReleaseMutex(bufpool_mutex);
+
+    if(!cached) {
+        bufpool_heap_free(heap, buffer);
+    }
+}
+
+void bufpool_trim() {
+    if(bufpool_mutex == 0) {
+        return;
+    }
+
+    svcWaitSynchronization(bufpool_mutex, U64_MAX);
+
+    for(u32 heap = 0; heap < BUFPOOL_HEAP_COUNT; heap++) {
+        bufpool_state* state = &bufpool_states[heap];
+
+        for(u32 cls = 0; cls < BUFPOOL_CLASS_COUNT; cls++) {
+            while(state->freeCount[cls] > 0) {
+                bufpool_heap_free((bufpool_heap) heap, state->free[cls][--state->freeCount[cls]]);
+            }
+        }
+
+        state->stats.cachedBytes = 0;
+    }
+
+    svcReleaseMutex(bufpool_mutex);
+}
+
+void bufpool_get_stats(bufpool_heap heap, bufpool_stats* stats) {
+    if(heap >= BUFPOOL_HEAP_COUNT || stats == NULL) {
+        return;
+    }
+
+    if(bufpool_mutex == 0) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    svcWaitSynchronization(bufpool_mutex, U64_MAX);
+    *stats = bufpool_states[heap].stats;
+    svcReleaseMutex(bufpool_mutex);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+typedef enum bufpool_heap_e {
+    BUFPOOL_HEAP,
+    BUFPOOL_LINEAR,
+    BUFPOOL_HEAP_COUNT
+} bufpool_heap;
+
+typedef struct bufpool_stats_s {
+    u32 allocs;
+    u32 reused;
+    u32 outstanding;
+    u32 outstandingBytes;
+    u32 cachedBytes;
+    u32 peakBytes;
+} bufpool_stats;
+
+void bufpool_init();
+void bufpool_exit();
+
+// Buffers are not zeroed. They must be returned to the pool they came from, with the size they were requested with.
+void* bufpool_alloc(bufpool_heap heap, u32 size);
+void bufpool_free(bufpool_heap heap, void* buffer, u32 size);
+
+// Releases every cached buffer back to its heap.
+void bufpool_trim();
+
+void bufpool_get_stats(bufpool_heap heap, bufpool_stats* stats);
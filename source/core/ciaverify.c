@@ -0,0 +1,225 @@
+#include <malloc.h>
+#include <string.h>
+
+#include <3ds.h>
+
+#include "ciaverify.h"
+#include "util.h"
+#include "../ui/error.h"
+
+#define CIA_ALIGN(x) (((x) + 0x3F) & ~0x3F)
+
+#define TMD_SIZE_MAX (1024 * 1024)
+
+#define TMD_CONTENT_TYPE_ENCRYPTED 0x1
+
+static const u32 cia_verify_sig_sizes[6] = {0x240, 0x140, 0x80, 0x240, 0x140, 0x80};
+
+void cia_verify_init(cia_verifier* verifier) {
+    memset(verifier, 0, sizeof(*verifier));
+
+    verifier->active = true;
+}
+
+void cia_verify_free(cia_verifier* verifier) {
+    if(verifier->tmd != NULL) {
+        free(verifier->tmd);
+        verifier->tmd = NULL;
+    }
+
+    if(verifier->contents != NULL) {
+        free(verifier->contents);
+        verifier->contents = NULL;
+    }
+
+    verifier->active = false;
+}
+
+// Verification is best effort; anything this doesn't understand is left for AM to judge.
+static void cia_verify_abandon(cia_verifier* verifier) {
+    cia_verify_free(verifier);
+}
+
+static void cia_verify_parse_header(cia_verifier* verifier) {
+    u32* header = (u32*) verifier->header;
+
+    u32 headerSize = header[0];
+    u32 certSize = header[2];
+    u32 ticketSize = header[3];
+    u32 tmdSize = header[4];
+
+    if(headerSize != CIA_HEADER_SIZE || tmdSize == 0 || tmdSize > TMD_SIZE_MAX) {
+        cia_verify_abandon(verifier);
+        return;
+    }
+
+    verifier->tmd = (u8*) calloc(1, tmdSize);
+    if(verifier->tmd == NULL) {
+        cia_verify_abandon(verifier);
+        return;
+    }
+
+    verifier->tmdSize = tmdSize;
+    verifier->tmdOffset = CIA_ALIGN(headerSize) + CIA_ALIGN(certSize) + CIA_ALIGN(ticketSize);
+    verifier->contentOffset = verifier->tmdOffset + CIA_ALIGN(tmdSize);
+}
+
+static void cia_verify_parse_tmd(cia_verifier* verifier) {
+    u8* tmd = verifier->tmd;
+
+    if(tmd[0x00] != 0x00 || tmd[0x01] != 0x01 || tmd[0x02] != 0x00 || tmd[0x03] >= 6
+       || cia_verify_sig_sizes[tmd[0x03]] + 0x9C4 > verifier->tmdSize) {
+        cia_verify_abandon(verifier);
+        return;
+    }
+
+    u16 chunkCount = util_get_tmd_content_count(tmd);
+    if(cia_verify_sig_sizes[tmd[0x03]] + 0x9C4 + chunkCount * 0x30 > verifier->tmdSize) {
+        cia_verify_abandon(verifier);
+        return;
+    }
+
+    verifier->contents = (cia_verify_content*) calloc(chunkCount > 0 ? chunkCount : 1, sizeof(cia_verify_content));
+    if(verifier->contents == NULL) {
+        cia_verify_abandon(verifier);
+        return;
+    }
+
+    u8* contentIndex = &verifier->header[0x20];
+
+    // Only contents flagged in the header's index bitmap are present, in TMD chunk order.
+    for(u32 i = 0; i < chunkCount; i++) {
+        u8* chunk = util_get_tmd_content_chunk(tmd, i);
+
+        u16 index = __builtin_bswap16(*(u16*) &chunk[0x04]);
+        if(!(contentIndex[index >> 3] & (0x80 >> (index & 7)))) {
+            continue;
+        }
+
+        cia_verify_content* content = &verifier->contents[verifier->contentCount++];
+        content->size = __builtin_bswap64(*(u64*) &chunk[0x08]);
+        content->hashed = !(__builtin_bswap16(*(u16*) &chunk[0x06]) & TMD_CONTENT_TYPE_ENCRYPTED);
+        memcpy(content->hash, &chunk[0x10], SHA256_HASH_SIZE);
+    }
+
+    free(verifier->tmd);
+    verifier->tmd = NULL;
+
+    sha256_init(&verifier->sha);
+}
+
+static Result cia_verify_finish_content(cia_verifier* verifier) {
+    cia_verify_content* content = &verifier->contents[verifier->currContent];
+
+    Result res = 0;
+
+    if(content->hashed) {
+        u8 hash[SHA256_HASH_SIZE];
+        sha256_final(&verifier->sha, hash);
+
+        if(memcmp(hash, content->hash, SHA256_HASH_SIZE) != 0) {
+            res = R_FBI_HASH_MISMATCH;
+        }
+    }
+
+    verifier->currContent++;
+    verifier->currProcessed = 0;
+
+    sha256_init(&verifier->sha);
+
+    return res;
+}
+
+Result cia_verify_update(cia_verifier* verifier, const void* data, u64 offset, u32 size) {
+    if(!verifier->active) {
+        return 0;
+    }
+
+    // Out of order writes can't be hashed in a single pass.
+    if(offset != verifier->offset) {
+        cia_verify_abandon(verifier);
+        return 0;
+    }
+
+    Result res = 0;
+
+    const u8* bytes = (const u8*) data;
+    u64 end = offset + size;
+
+    while(verifier->active && offset < end && R_SUCCEEDED(res)) {
+        u32 remaining = (u32) (end - offset);
+
+        if(offset < CIA_HEADER_SIZE) {
+            u32 copySize = CIA_HEADER_SIZE - (u32) offset;
+            if(copySize > remaining) {
+                copySize = remaining;
+            }
+
+            memcpy(&verifier->header[offset], bytes, copySize);
+
+            offset += copySize;
+            bytes += copySize;
+
+            if(offset == CIA_HEADER_SIZE) {
+                cia_verify_parse_header(verifier);
+            }
+        } else if(verifier->contents == NULL) {
+            if(offset < verifier->tmdOffset) {
+                u32 skipSize = verifier->tmdOffset - offset < remaining ? (u32) (verifier->tmdOffset - offset) : remaining;
+
+                offset += skipSize;
+                bytes += skipSize;
+            } else if(offset < verifier->tmdOffset + verifier->tmdSize) {
+                u32 tmdPos = (u32) (offset - verifier->tmdOffset);
+                u32 copySize = verifier->tmdSize - tmdPos < remaining ? verifier->tmdSize - tmdPos : remaining;
+
+                memcpy(&verifier->tmd[tmdPos], bytes, copySize);
+
+                offset += copySize;
+                bytes += copySize;
+
+                if(tmdPos + copySize == verifier->tmdSize) {
+                    cia_verify_parse_tmd(verifier);
+                }
+            } else {
+                cia_verify_abandon(verifier);
+            }
+        } else if(offset < verifier->contentOffset) {
+            u32 skipSize = verifier->contentOffset - offset < remaining ? (u32) (verifier->contentOffset - offset) : remaining;
+
+            offset += skipSize;
+            bytes += skipSize;
+        } else if(verifier->currContent < verifier->contentCount) {
+            cia_verify_content* content = &verifier->contents[verifier->currContent];
+
+            u32 hashSize = content->size - verifier->currProcessed < remaining ? (u32) (content->size - verifier->currProcessed) : remaining;
+
+            if(content->hashed) {
+                sha256_update(&verifier->sha, bytes, hashSize);
+            }
+
+            verifier->currProcessed += hashSize;
+
+            offset += hashSize;
+            bytes += hashSize;
+
+            if(verifier->currProcessed == content->size) {
+                res = cia_verify_finish_content(verifier);
+            }
+        } else {
+            offset = end;
+        }
+    }
+
+    verifier->offset = end;
+
+    return res;
+}
+
+Result cia_verify_finish(cia_verifier* verifier) {
+    if(!verifier->active) {
+        return 0;
+    }
+
+    return verifier->currContent == verifier->contentCount ? 0 : R_FBI_BAD_DATA;
+}
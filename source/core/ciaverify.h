@@ -0,0 +1,36 @@
+#pragma once
+
+#include "sha256.h"
+
+#define CIA_HEADER_SIZE 0x2020
+
+typedef struct cia_verify_content_s {
+    u64 size;
+    bool hashed;
+    u8 hash[SHA256_HASH_SIZE];
+} cia_verify_content;
+
+typedef struct cia_verifier_s {
+    bool active;
+    u64 offset;
+
+    u8 header[CIA_HEADER_SIZE];
+    u32 headerSize;
+
+    u8* tmd;
+    u32 tmdSize;
+    u64 tmdOffset;
+
+    cia_verify_content* contents;
+    u32 contentCount;
+    u64 contentOffset;
+
+    u32 currContent;
+    u64 currProcessed;
+    sha256_context sha;
+} cia_verifier;
+
+void cia_verify_init(cia_verifier* verifier);
+Result cia_verify_update(cia_verifier* verifier, const void* data, u64 offset, u32 size);
+Result cia_verify_finish(cia_verifier* verifier);
+void cia_verify_free(cia_verifier* verifier);
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "bandwidth.h"
+#include "bufpool.h"
 #include "fs.h"
 #include "../ui/section/task/task.h"
 #include "../ui/ui.h"
+#include "ciaverify.h"
 #include "clipboard.h"
 #include "../ui/error.h"
 #include "http.h"
+#include "io.h"
+#include "job.h"
 #include "linkedlist.h"
 #include "screen.h"
 #include "util.h"
@@ -1,16 +1,27 @@
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
 #include <3ds.h>
+#endif
+
 #include <curl/curl.h>
+#ifndef FBI_HOST
 #include <jansson.h>
+#endif
 #include <zlib.h>
 
+#include "bandwidth.h"
+#include "bufpool.h"
 #include "fs.h"
 #include "../ui/error.h"
 #include "http.h"
 #include "stringutil.h"
+#include "util.h"
 
 #define MAKE_HTTP_USER_AGENT_(major, minor, micro) ("Mozilla/5.0 (Nintendo 3DS; Mobile; rv:10.0) Gecko/20100101 FBI/" #major "." #minor "." #micro)
 #define MAKE_HTTP_USER_AGENT(major, minor, micro) MAKE_HTTP_USER_AGENT_(major, minor, micro)
@@ -19,12 +30,24 @@
 #define HTTP_TIMEOUT_SEC 15
 #define HTTP_TIMEOUT_NS ((u64) HTTP_TIMEOUT_SEC * 1000000000)
 
+#define HTTP_INFLATE_BUFFER_SIZE (32 * 1024)
+
 struct http_context_s {
     httpcContext httpc;
 
+    bool partial;
+    u64 totalSize;
+
     bool compressed;
+    bool rawDeflate;
+    bool received;
+    bool streamEnd;
     z_stream inflate;
-    u8 buffer[32 * 1024];
+    u32 receivedPos;
+
+    // Compressed input waiting to be inflated. It is only refilled once inflate has taken all of it, so it never wraps.
+    u8 buffer[HTTP_INFLATE_BUFFER_SIZE];
+    u32 bufferStart;
     u32 bufferSize;
 };
 
@@ -42,368 +65,1780 @@ void http_resolve_redirect(char* oldUrl, const char* redirectTo, size_t size) {
                 }
             }
 
-            // If there are less than 3 slashes, assume the base URL ends at the end of the string; e.g. https://www.example.com
-            if(slashCount != 3) {
-                baseEnd = oldUrl + strlen(oldUrl);
-            }
+            // If there are less than 3 slashes, assume the base URL ends at the end of the string; e.g. https://www.example.com
+            if(slashCount != 3) {
+                baseEnd = oldUrl + strlen(oldUrl);
+            }
+
+            size_t baseLen = baseEnd - oldUrl;
+            if(baseLen < size) {
+                string_copy(baseEnd, redirectTo, size - baseLen);
+            }
+        } else {
+            string_copy(oldUrl, redirectTo, size);
+        }
+    }
+}
+
+// Bodies fetched through http_download_buffer are kept on the SD card along with their validators,
+// so repeat requests only cost a revalidation round trip when the server answers 304.
+#define HTTP_CACHE_DIR "/fbi/cache/http/"
+#define HTTP_CACHE_MAGIC 0x43484246 // "FBHC"
+#define HTTP_CACHE_VERSION 1
+#define HTTP_CACHE_MAX_SIZE (4 * 1024 * 1024)
+#define HTTP_CACHE_MAX_ENTRIES 512
+#define HTTP_CACHE_ENTRY_MAX (512 * 1024)
+#define HTTP_CACHE_URL_MAX 1024
+#define HTTP_CACHE_VALIDATOR_MAX 128
+
+#define R_HTTP_NOT_MODIFIED (R_FBI_HTTP_ERROR_BASE + 304)
+
+typedef struct {
+    char etag[HTTP_CACHE_VALIDATOR_MAX];
+    char lastModified[HTTP_CACHE_VALIDATOR_MAX];
+    bool notModified;
+} http_cache_validators;
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 lastUsed;
+    u32 size;
+    u32 reserved;
+    char etag[HTTP_CACHE_VALIDATOR_MAX];
+    char lastModified[HTTP_CACHE_VALIDATOR_MAX];
+    char url[HTTP_CACHE_URL_MAX];
+} http_cache_header;
+
+typedef struct {
+    u64 key;
+    u64 lastUsed;
+    u32 size;
+} http_cache_entry;
+
+static Handle http_cache_mutex;
+static FS_Archive http_cache_archive;
+static bool http_cache_loaded;
+static http_cache_entry http_cache_entries[HTTP_CACHE_MAX_ENTRIES];
+static u32 http_cache_count;
+static u32 http_cache_size;
+
+static u64 http_cache_key(const char* url) {
+    u64 hash = 0xCBF29CE484222325;
+    for(const char* c = url; *c != '\0'; c++) {
+        hash = (hash ^ (u8) *c) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+static FS_Path http_cache_path(char* path, size_t size, u64 key) {
+    snprintf(path, size, HTTP_CACHE_DIR "%016llX.bin", (unsigned long long) key);
+    return fsMakePath(PATH_ASCII, path);
+}
+
+static http_cache_entry* http_cache_find(u64 key) {
+    for(u32 i = 0; i < http_cache_count; i++) {
+        if(http_cache_entries[i].key == key) {
+            return &http_cache_entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void http_cache_remove(u64 key) {
+    for(u32 i = 0; i < http_cache_count; i++) {
+        if(http_cache_entries[i].key == key) {
+            char path[64];
+            FSUSER_DeleteFile(http_cache_archive, http_cache_path(path, sizeof(path), key));
+
+            http_cache_size -= http_cache_entries[i].size;
+            http_cache_entries[i] = http_cache_entries[--http_cache_count];
+            break;
+        }
+    }
+}
+
+// Rebuilds the index from the headers on disk; leaves http_cache_archive unset if the cache can't be used.
+static void http_cache_build_index() {
+    if(R_FAILED(FSUSER_OpenArchive(&http_cache_archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        http_cache_archive = 0;
+        return;
+    }
+
+    if(R_FAILED(fs_ensure_dir(http_cache_archive, "/fbi/"))
+       || R_FAILED(fs_ensure_dir(http_cache_archive, "/fbi/cache/"))
+       || R_FAILED(fs_ensure_dir(http_cache_archive, HTTP_CACHE_DIR))) {
+        FSUSER_CloseArchive(http_cache_archive);
+        http_cache_archive = 0;
+        return;
+    }
+
+    Handle dirHandle = 0;
+    if(R_SUCCEEDED(FSUSER_OpenDirectory(&dirHandle, http_cache_archive, fsMakePath(PATH_ASCII, HTTP_CACHE_DIR)))) {
+        FS_DirectoryEntry entry;
+
+        u32 entriesRead = 0;
+        while(R_SUCCEEDED(FSDIR_Read(dirHandle, &entriesRead, 1, &entry)) && entriesRead > 0) {
+            if(entry.attributes & FS_ATTRIBUTE_DIRECTORY) {
+                continue;
+            }
+
+            char name[FILE_NAME_MAX] = {'\0'};
+            utf16_to_utf8((uint8_t*) name, entry.name, sizeof(name) - 1);
+
+            unsigned long long key = 0;
+            if(sscanf(name, "%016llX.bin", &key) != 1) {
+                continue;
+            }
+
+            char path[64];
+            FS_Path fsPath = http_cache_path(path, sizeof(path), key);
+
+            bool valid = false;
+
+            http_cache_header header;
+
+            Handle fileHandle = 0;
+            if(R_SUCCEEDED(FSUSER_OpenFile(&fileHandle, http_cache_archive, fsPath, FS_OPEN_READ, 0))) {
+                u32 bytesRead = 0;
+                valid = R_SUCCEEDED(FSFILE_Read(fileHandle, &bytesRead, 0, &header, sizeof(header))) && bytesRead == sizeof(header)
+                        && header.magic == HTTP_CACHE_MAGIC && header.version == HTTP_CACHE_VERSION
+                        && sizeof(header) + header.size == entry.fileSize && http_cache_count < HTTP_CACHE_MAX_ENTRIES;
+
+                FSFILE_Close(fileHandle);
+            }
+
+            if(valid) {
+                http_cache_entry* cacheEntry = &http_cache_entries[http_cache_count++];
+                cacheEntry->key = key;
+                cacheEntry->lastUsed = header.lastUsed;
+                cacheEntry->size = (u32) entry.fileSize;
+
+                http_cache_size += cacheEntry->size;
+            } else {
+                FSUSER_DeleteFile(http_cache_archive, fsPath);
+            }
+        }
+
+        FSDIR_Close(dirHandle);
+    }
+}
+
+// Loads the index the first time the cache is used. Must be called with http_cache_mutex held, so that no other
+// thread sees the index before it is complete.
+static bool http_cache_load() {
+    if(!http_cache_loaded) {
+        http_cache_build_index();
+        http_cache_loaded = true;
+    }
+
+    return http_cache_archive != 0;
+}
+
+// Opens a cached entry for the given URL and reads its header, checking that it belongs to the URL.
+static Result http_cache_open(Handle* fileHandle, const char* url, http_cache_header* header) {
+    Result res = 0;
+
+    u64 key = http_cache_key(url);
+    if(http_cache_find(key) == NULL) {
+        return R_FBI_BAD_DATA;
+    }
+
+    char path[64];
+    if(R_SUCCEEDED(res = FSUSER_OpenFile(fileHandle, http_cache_archive, http_cache_path(path, sizeof(path), key), FS_OPEN_READ | FS_OPEN_WRITE, 0))) {
+        u32 bytesRead = 0;
+        if(R_SUCCEEDED(res = FSFILE_Read(*fileHandle, &bytesRead, 0, header, sizeof(*header)))
+           && (bytesRead != sizeof(*header) || strncmp(header->url, url, sizeof(header->url)) != 0)) {
+            res = R_FBI_BAD_DATA;
+        }
+
+        if(R_FAILED(res)) {
+            FSFILE_Close(*fileHandle);
+        }
+    }
+
+    return res;
+}
+
+// Fills in the validators of a usable cached copy, if any; returns false if there is no cache to use at all.
+static bool http_cache_get_validators(const char* url, http_cache_validators* validators, u32 maxSize) {
+    if(http_cache_mutex == 0) {
+        return false;
+    }
+
+    svcWaitSynchronization(http_cache_mutex, U64_MAX);
+
+    bool loaded = http_cache_load();
+
+    Handle fileHandle = 0;
+    http_cache_header header;
+    if(loaded && R_SUCCEEDED(http_cache_open(&fileHandle, url, &header))) {
+        if(header.size <= maxSize) {
+            string_copy(validators->etag, header.etag, sizeof(validators->etag));
+            string_copy(validators->lastModified, header.lastModified, sizeof(validators->lastModified));
+        }
+
+        FSFILE_Close(fileHandle);
+    }
+
+    svcReleaseMutex(http_cache_mutex);
+
+    return loaded;
+}
+
+static Result http_cache_read(const char* url, u32* bytesRead, void* buf, u32 size) {
+    Result res = 0;
+
+    svcWaitSynchronization(http_cache_mutex, U64_MAX);
+
+    Handle fileHandle = 0;
+    http_cache_header header;
+    if(R_SUCCEEDED(res = http_cache_open(&fileHandle, url, &header))) {
+        if(header.size > size) {
+            res = R_FBI_OUT_OF_RANGE;
+        } else if(R_SUCCEEDED(res = FSFILE_Read(fileHandle, bytesRead, sizeof(header), buf, header.size)) && *bytesRead != header.size) {
+            res = R_FBI_BAD_DATA;
+        }
+
+        if(R_SUCCEEDED(res)) {
+            u64 now = osGetTime();
+
+            u32 bytesWritten = 0;
+            FSFILE_Write(fileHandle, &bytesWritten, offsetof(http_cache_header, lastUsed), &now, sizeof(now), 0);
+
+            http_cache_entry* entry = http_cache_find(http_cache_key(url));
+            if(entry != NULL) {
+                entry->lastUsed = now;
+            }
+        }
+
+        FSFILE_Close(fileHandle);
+    }
+
+    if(R_FAILED(res)) {
+        http_cache_remove(http_cache_key(url));
+    }
+
+    svcReleaseMutex(http_cache_mutex);
+
+    return res;
+}
+
+static void http_cache_store(const char* url, const http_cache_validators* validators, void* buf, u32 size) {
+    if(size > HTTP_CACHE_ENTRY_MAX || strlen(url) >= HTTP_CACHE_URL_MAX || http_cache_mutex == 0) {
+        return;
+    }
+
+    http_cache_header* header = (http_cache_header*) calloc(1, sizeof(http_cache_header));
+    if(header == NULL) {
+        return;
+    }
+
+    header->magic = HTTP_CACHE_MAGIC;
+    header->version = HTTP_CACHE_VERSION;
+    header->lastUsed = osGetTime();
+    header->size = size;
+    string_copy(header->etag, validators->etag, sizeof(header->etag));
+    string_copy(header->lastModified, validators->lastModified, sizeof(header->lastModified));
+    string_copy(header->url, url, sizeof(header->url));
+
+    u64 key = http_cache_key(url);
+    u32 entrySize = sizeof(http_cache_header) + size;
+
+    char path[64];
+    FS_Path fsPath = http_cache_path(path, sizeof(path), key);
+
+    svcWaitSynchronization(http_cache_mutex, U64_MAX);
+
+    if(http_cache_load()) {
+        http_cache_remove(key);
+        FSUSER_DeleteFile(http_cache_archive, fsPath);
+
+        // Evict least recently used entries until the new one fits.
+        while(http_cache_count > 0 && (http_cache_count >= HTTP_CACHE_MAX_ENTRIES || http_cache_size + entrySize > HTTP_CACHE_MAX_SIZE)) {
+            u32 oldest = 0;
+            for(u32 i = 1; i < http_cache_count; i++) {
+                if(http_cache_entries[i].lastUsed < http_cache_entries[oldest].lastUsed) {
+                    oldest = i;
+                }
+            }
+
+            http_cache_remove(http_cache_entries[oldest].key);
+        }
+
+        Result res = 0;
+
+        Handle fileHandle = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenFile(&fileHandle, http_cache_archive, fsPath, FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+            u32 bytesWritten = 0;
+            if(R_SUCCEEDED(res = FSFILE_Write(fileHandle, &bytesWritten, 0, header, sizeof(http_cache_header), 0))) {
+                res = FSFILE_Write(fileHandle, &bytesWritten, sizeof(http_cache_header), buf, size, 0);
+            }
+
+            FSFILE_Close(fileHandle);
+
+            if(R_SUCCEEDED(res)) {
+                http_cache_entry* entry = &http_cache_entries[http_cache_count++];
+                entry->key = key;
+                entry->lastUsed = header->lastUsed;
+                entry->size = entrySize;
+
+                http_cache_size += entrySize;
+            } else {
+                FSUSER_DeleteFile(http_cache_archive, fsPath);
+            }
+        }
+    }
+
+    svcReleaseMutex(http_cache_mutex);
+
+    free(header);
+}
+
+// Idle curl handles are kept per host; curl keeps their connections open between transfers, so
+// a later request to the same host skips the TCP and TLS handshakes. httpc contexts are bound to
+// a single request by the service and can't be pooled.
+#define HTTP_HOST_MAX 128
+#define HTTP_POOL_IDLE_MAX 8
+#define HTTP_POOL_HOST_IDLE_MAX 2
+#define HTTP_POOL_IDLE_TIMEOUT_MS 30000
+#define HTTP_CURL_HOSTS_MAX 16
+
+typedef struct {
+    char host[HTTP_HOST_MAX];
+    CURL* curl;
+    u64 lastUsed;
+} http_pool_entry;
+
+static Handle http_pool_mutex;
+static http_pool_entry http_pool_idle[HTTP_POOL_IDLE_MAX];
+static u32 http_pool_idle_count;
+static http_pool_stats http_pool_totals;
+
+// Hosts the system TLS stack failed to connect to; requests to them go straight to curl.
+static char http_curl_hosts[HTTP_CURL_HOSTS_MAX][HTTP_HOST_MAX];
+static u32 http_curl_hosts_next;
+
+void http_init() {
+    Result res = 0;
+    if(R_FAILED(res = svcCreateMutex(&http_pool_mutex, false))) {
+        util_panic("Failed to create HTTP pool mutex: 0x%08lX", res);
+        return;
+    }
+
+    if(R_FAILED(res = svcCreateMutex(&http_cache_mutex, false))) {
+        util_panic("Failed to create HTTP cache mutex: 0x%08lX", res);
+        return;
+    }
+
+    http_cache_loaded = false;
+    http_cache_count = 0;
+    http_cache_size = 0;
+
+    memset(http_pool_idle, 0, sizeof(http_pool_idle));
+    http_pool_idle_count = 0;
+    memset(&http_pool_totals, 0, sizeof(http_pool_totals));
+    memset(http_curl_hosts, 0, sizeof(http_curl_hosts));
+    http_curl_hosts_next = 0;
+}
+
+void http_exit() {
+    if(http_pool_mutex != 0) {
+        for(u32 i = 0; i < http_pool_idle_count; i++) {
+            curl_easy_cleanup(http_pool_idle[i].curl);
+        }
+
+        http_pool_idle_count = 0;
+
+        svcCloseHandle(http_pool_mutex);
+        http_pool_mutex = 0;
+    }
+
+    if(http_cache_mutex != 0) {
+        if(http_cache_archive != 0) {
+            FSUSER_CloseArchive(http_cache_archive);
+            http_cache_archive = 0;
+        }
+
+        svcCloseHandle(http_cache_mutex);
+        http_cache_mutex = 0;
+    }
+}
+
+// Reduces a URL to its scheme, host and port; e.g. https://www.example.com:8080
+static void http_get_host(const char* url, char* host, size_t size) {
+    const char* end = strstr(url, "://");
+    end = end != NULL ? strchr(end + 3, '/') : NULL;
+
+    size_t len = end != NULL ? (size_t) (end - url) : strlen(url);
+    if(len >= size) {
+        len = size - 1;
+    }
+
+    strncpy(host, url, len);
+    host[len] = '\0';
+}
+
+static void http_pool_record(u32 connections, u64 firstByteMs) {
+    if(http_pool_mutex == 0) {
+        return;
+    }
+
+    svcWaitSynchronization(http_pool_mutex, U64_MAX);
+
+    http_pool_totals.requests++;
+    http_pool_totals.connections += connections;
+    http_pool_totals.firstByteMs += firstByteMs;
+
+    if(connections == 0) {
+        http_pool_totals.reused++;
+    }
+
+    svcReleaseMutex(http_pool_mutex);
+}
+
+static void http_pool_record_cached() {
+    if(http_pool_mutex == 0) {
+        return;
+    }
+
+    svcWaitSynchronization(http_pool_mutex, U64_MAX);
+    http_pool_totals.cached++;
+    svcReleaseMutex(http_pool_mutex);
+}
+
+static bool http_is_curl_host(const char* url) {
+    if(http_pool_mutex == 0) {
+        return false;
+    }
+
+    char host[HTTP_HOST_MAX];
+    http_get_host(url, host, sizeof(host));
+
+    bool found = false;
+
+    svcWaitSynchronization(http_pool_mutex, U64_MAX);
+
+    for(u32 i = 0; i < HTTP_CURL_HOSTS_MAX && !found; i++) {
+        found = strncmp(http_curl_hosts[i], host, HTTP_HOST_MAX) == 0;
+    }
+
+    svcReleaseMutex(http_pool_mutex);
+
+    return found;
+}
+
+static void http_add_curl_host(const char* url) {
+    if(http_pool_mutex == 0 || http_is_curl_host(url)) {
+        return;
+    }
+
+    svcWaitSynchronization(http_pool_mutex, U64_MAX);
+
+    http_get_host(url, http_curl_hosts[http_curl_hosts_next], HTTP_HOST_MAX);
+    http_curl_hosts_next = (http_curl_hosts_next + 1) % HTTP_CURL_HOSTS_MAX;
+
+    svcReleaseMutex(http_pool_mutex);
+}
+
+static CURL* http_pool_acquire(const char* url) {
+    if(http_pool_mutex == 0) {
+        return curl_easy_init();
+    }
+
+    char host[HTTP_HOST_MAX];
+    http_get_host(url, host, sizeof(host));
+
+    CURL* curl = NULL;
+
+    CURL* expired[HTTP_POOL_IDLE_MAX];
+    u32 expiredCount = 0;
+
+    svcWaitSynchronization(http_pool_mutex, U64_MAX);
+
+    u64 now = osGetTime();
+    for(u32 i = 0; i < http_pool_idle_count;) {
+        http_pool_entry* entry = &http_pool_idle[i];
+
+        bool stale = now - entry->lastUsed >= HTTP_POOL_IDLE_TIMEOUT_MS;
+        if(stale || (curl == NULL && strncmp(entry->host, host, HTTP_HOST_MAX) == 0)) {
+            if(stale) {
+                expired[expiredCount++] = entry->curl;
+            } else {
+                curl = entry->curl;
+            }
+
+            *entry = http_pool_idle[--http_pool_idle_count];
+        } else {
+            i++;
+        }
+    }
+
+    http_pool_totals.idle = http_pool_idle_count;
+
+    svcReleaseMutex(http_pool_mutex);
+
+    for(u32 i = 0; i < expiredCount; i++) {
+        curl_easy_cleanup(expired[i]);
+    }
+
+    if(curl != NULL) {
+        // Resets options only; the handle's open connections are kept.
+        curl_easy_reset(curl);
+    } else {
+        curl = curl_easy_init();
+    }
+
+    return curl;
+}
+
+static void http_pool_release(const char* url, CURL* curl, bool reusable) {
+    if(http_pool_mutex == 0 || !reusable) {
+        curl_easy_cleanup(curl);
+        return;
+    }
+
+    char host[HTTP_HOST_MAX];
+    http_get_host(url, host, sizeof(host));
+
+    CURL* evicted = NULL;
+
+    svcWaitSynchronization(http_pool_mutex, U64_MAX);
+
+    u32 hostIdle = 0;
+    u32 oldest = 0;
+    for(u32 i = 0; i < http_pool_idle_count; i++) {
+        if(strncmp(http_pool_idle[i].host, host, HTTP_HOST_MAX) == 0) {
+            hostIdle++;
+        }
+
+        if(http_pool_idle[i].lastUsed < http_pool_idle[oldest].lastUsed) {
+            oldest = i;
+        }
+    }
+
+    if(hostIdle >= HTTP_POOL_HOST_IDLE_MAX) {
+        evicted = curl;
+    } else {
+        if(http_pool_idle_count >= HTTP_POOL_IDLE_MAX) {
+            evicted = http_pool_idle[oldest].curl;
+            http_pool_idle[oldest] = http_pool_idle[--http_pool_idle_count];
+        }
+
+        http_pool_entry* entry = &http_pool_idle[http_pool_idle_count++];
+        string_copy(entry->host, host, sizeof(entry->host));
+        entry->curl = curl;
+        entry->lastUsed = osGetTime();
+    }
+
+    http_pool_totals.idle = http_pool_idle_count;
+
+    svcReleaseMutex(http_pool_mutex);
+
+    if(evicted != NULL) {
+        curl_easy_cleanup(evicted);
+    }
+}
+
+void http_get_pool_stats(http_pool_stats* stats) {
+    if(stats == NULL) {
+        return;
+    }
+
+    if(http_pool_mutex == 0) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    svcWaitSynchronization(http_pool_mutex, U64_MAX);
+    *stats = http_pool_totals;
+    svcReleaseMutex(http_pool_mutex);
+}
+
+static Result http_open_request(http_context* context, const char* url, bool userAgent, bool compressed, u64 rangeStart, u64 rangeEnd, http_cache_validators* validators);
+
+Result http_open(http_context* context, const char* url, bool userAgent) {
+    return http_open_request(context, url, userAgent, true, 0, 0, NULL);
+}
+
+// Ranged opens always ask for the identity encoding, even from the start with no end, so the size is the body's.
+Result http_open_ranged(http_context* context, const char* url, bool userAgent, u64 rangeStart, u64 rangeEnd) {
+    return http_open_request(context, url, userAgent, false, rangeStart, rangeEnd, NULL);
+}
+
+// With validators, the request is made conditional on the cached copy being stale and the response's validators are
+// stored back; a 304 fails with R_HTTP_NOT_MODIFIED.
+static Result http_open_request(http_context* context, const char* url, bool userAgent, bool compressed, u64 rangeStart, u64 rangeEnd, http_cache_validators* validators) {
+    if(url == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    http_context ctx = (http_context) calloc(1, sizeof(struct http_context_s));
+    if(ctx != NULL) {
+        char currUrl[1024];
+        string_copy(currUrl, url, sizeof(currUrl));
+
+        // Byte ranges only make sense against the identity encoding, so ranged requests never ask for compression.
+        bool ranged = rangeStart > 0 || rangeEnd > rangeStart;
+
+        char range[64];
+        if(rangeEnd > rangeStart) {
+            snprintf(range, sizeof(range), "bytes=%llu-%llu", (unsigned long long) rangeStart, (unsigned long long) rangeEnd);
+        } else {
+            snprintf(range, sizeof(range), "bytes=%llu-", (unsigned long long) rangeStart);
+        }
+
+        bool resolved = false;
+        u32 redirectCount = 0;
+        while(R_SUCCEEDED(res) && !resolved && redirectCount < 32) {
+            u64 requestStart = osGetTime();
+
+            if(R_SUCCEEDED(res = httpcOpenContext(&ctx->httpc, HTTPC_METHOD_GET, currUrl, 1))) {
+                u32 response = 0;
+                if(R_SUCCEEDED(res = httpcSetSSLOpt(&ctx->httpc, SSLCOPT_DisableVerify))
+                   && (!userAgent || R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "User-Agent", HTTP_USER_AGENT)))
+                   && (!ranged || R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "Range", range)))
+                   && (!compressed || ranged || R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "Accept-Encoding", "gzip, deflate")))
+                   && (validators == NULL || validators->etag[0] == '\0' || R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "If-None-Match", validators->etag)))
+                   && (validators == NULL || validators->lastModified[0] == '\0' || R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "If-Modified-Since", validators->lastModified)))
+                   && R_SUCCEEDED(res = httpcSetKeepAlive(&ctx->httpc, HTTPC_KEEPALIVE_ENABLED))
+                   && R_SUCCEEDED(res = httpcBeginRequest(&ctx->httpc))
+                   && R_SUCCEEDED(res = httpcGetResponseStatusCodeTimeout(&ctx->httpc, &response, HTTP_TIMEOUT_NS))) {
+                    http_pool_record(1, osGetTime() - requestStart);
+
+                    if(response == 301 || response == 302 || response == 303) {
+                        redirectCount++;
+
+                        char redirectTo[1024];
+                        memset(redirectTo, '\0', sizeof(redirectTo));
+                        if(R_SUCCEEDED(res = httpcGetResponseHeader(&ctx->httpc, "Location", redirectTo, sizeof(redirectTo)))) {
+                            httpcCloseContext(&ctx->httpc);
+
+                            http_resolve_redirect(currUrl, redirectTo, sizeof(currUrl));
+                        }
+                    } else {
+                        resolved = true;
+
+                        if(rangeStart > 0 && response == 200) {
+                            res = R_FBI_HTTP_RANGE_NOT_SUPPORTED;
+                        } else if(response == 200 || (ranged && response == 206)) {
+                            if(response == 206) {
+                                char contentRange[64];
+                                unsigned long long totalSize = 0;
+                                if(R_SUCCEEDED(httpcGetResponseHeader(&ctx->httpc, "Content-Range", contentRange, sizeof(contentRange)))
+                                   && sscanf(contentRange, "bytes %*[0-9]-%*[0-9]/%llu", &totalSize) == 1) {
+                                    ctx->partial = true;
+                                    ctx->totalSize = totalSize;
+                                }
+                            }
+
+                            if(validators != NULL) {
+                                memset(validators, 0, sizeof(*validators));
+
+                                if(R_FAILED(httpcGetResponseHeader(&ctx->httpc, "ETag", validators->etag, sizeof(validators->etag)))) {
+                                    validators->etag[0] = '\0';
+                                }
+
+                                if(R_FAILED(httpcGetResponseHeader(&ctx->httpc, "Last-Modified", validators->lastModified, sizeof(validators->lastModified)))) {
+                                    validators->lastModified[0] = '\0';
+                                }
+                            }
+
+                            char encoding[32];
+                            if(R_SUCCEEDED(httpcGetResponseHeader(&ctx->httpc, "Content-Encoding", encoding, sizeof(encoding)))) {
+                                bool gzip = strncmp(encoding, "gzip", sizeof(encoding)) == 0;
+                                bool deflate = strncmp(encoding, "deflate", sizeof(encoding)) == 0;
+
+                                // Detect the zlib or gzip wrapper from the stream itself; servers don't always send the one they name.
+                                if((gzip || deflate) && inflateInit2(&ctx->inflate, MAX_WBITS + 32) == Z_OK) {
+                                    ctx->compressed = true;
+                                    httpcGetDownloadSizeState(&ctx->httpc, &ctx->receivedPos, NULL);
+                                }
+                            }
+                        } else {
+                            res = R_FBI_HTTP_ERROR_BASE + response;
+                        }
+                    }
+                }
+
+                if(R_FAILED(res)) {
+                    httpcCloseContext(&ctx->httpc);
+                }
+            }
+        }
+
+        if(R_SUCCEEDED(res) && redirectCount >= 32) {
+            res = R_FBI_HTTP_TOO_MANY_REDIRECTS;
+        }
+
+        if(R_FAILED(res)) {
+            free(ctx);
+        }
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    if(R_SUCCEEDED(res)) {
+        *context = ctx;
+    }
+
+    return res;
+}
+
+Result http_close(http_context context) {
+    if(context == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(context->compressed) {
+        inflateEnd(&context->inflate);
+    }
+
+    Result res = httpcCloseContext(&context->httpc);
+    free(context);
+    return res;
+}
+
+Result http_get_size(http_context context, u32* size) {
+    if(context == NULL || size == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    return httpcGetDownloadSizeState(&context->httpc, NULL, size);
+}
+
+// The size of the whole resource, as opposed to the size of the requested range.
+Result http_get_total_size(http_context context, u64* size) {
+    if(context == NULL || size == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(context->partial) {
+        *size = context->totalSize;
+        return 0;
+    }
+
+    Result res = 0;
+
+    u32 contentSize = 0;
+    if(R_SUCCEEDED(res = http_get_size(context, &contentSize))) {
+        *size = contentSize;
+    }
+
+    return res;
+}
+
+Result http_get_file_name(http_context context, char* out, u32 size) {
+    if(context == NULL || out == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    char* header = (char*) calloc(1, size + 64);
+    if(header != NULL) {
+        if(R_SUCCEEDED(res = httpcGetResponseHeader(&context->httpc, "Content-Disposition", header, size + 64))) {
+            char* start = strstr(header, "filename=");
+            if(start != NULL) {
+                char format[32];
+                snprintf(format, sizeof(format), "filename=\"%%%lu[^\"]\"", (unsigned long) size);
+                if(sscanf(start, format, out) != 1) {
+                    res = R_FBI_BAD_DATA;
+                }
+            } else {
+                res = R_FBI_BAD_DATA;
+            }
+        }
+
+        free(header);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+// Refills the drained input buffer with whatever the body has ready.
+static Result http_receive_compressed(http_context context) {
+    Result res = 0;
+
+    context->bufferStart = 0;
+    context->bufferSize = 0;
+
+    if(R_SUCCEEDED(res = httpcReceiveDataTimeout(&context->httpc, context->buffer, HTTP_INFLATE_BUFFER_SIZE, HTTP_TIMEOUT_NS))) {
+        context->received = true;
+    }
+
+    if(R_SUCCEEDED(res) || res == HTTPC_RESULTCODE_DOWNLOADPENDING) {
+        u32 currPos = 0;
+        if(R_SUCCEEDED(res = httpcGetDownloadSizeState(&context->httpc, &currPos, NULL))) {
+            u32 received = currPos - context->receivedPos;
+
+            context->bufferSize = received;
+            context->receivedPos = currPos;
+
+            // Throttle on what crossed the link, not on what it inflates to.
+            bandwidth_consume(received);
+        }
+    }
+
+    return res;
+}
+
+static Result http_read_compressed(http_context context, u32* bytesRead, void* buffer, u32 size) {
+    Result res = 0;
+
+    u32 outPos = 0;
+    while(R_SUCCEEDED(res) && outPos < size && !context->streamEnd) {
+        u32 available = context->bufferSize;
+
+        context->inflate.next_in = &context->buffer[context->bufferStart];
+        context->inflate.avail_in = available;
+        context->inflate.next_out = (u8*) buffer + outPos;
+        context->inflate.avail_out = size - outPos;
+
+        int ret = inflate(&context->inflate, Z_NO_FLUSH);
+
+        u32 consumed = available - context->inflate.avail_in;
+        u32 produced = (size - outPos) - context->inflate.avail_out;
+
+        // "deflate" is sometimes sent without its zlib wrapper; start over on the same input as raw deflate.
+        if(ret == Z_DATA_ERROR && !context->rawDeflate && context->inflate.total_out == 0) {
+            context->rawDeflate = true;
+
+            if(inflateReset2(&context->inflate, -MAX_WBITS) == Z_OK) {
+                continue;
+            }
+        }
+
+        context->bufferStart += consumed;
+        context->bufferSize -= consumed;
+        outPos += produced;
+
+        if(ret == Z_STREAM_END) {
+            context->streamEnd = true;
+        } else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+            res = R_FBI_BAD_DATA;
+        } else if(consumed == 0 && produced == 0) {
+            if(context->bufferSize > 0) {
+                res = R_FBI_BAD_DATA;
+            } else if(context->received) {
+                // Body ended without the end of the stream; hand back what there is.
+                context->streamEnd = true;
+            } else {
+                res = http_receive_compressed(context);
+            }
+        }
+    }
+
+    if(R_SUCCEEDED(res)) {
+        *bytesRead = outPos;
+    }
+
+    return res;
+}
+
+Result http_read(http_context context, u32* bytesRead, void* buffer, u32 size) {
+    if(context == NULL || buffer == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    u32 startPos = 0;
+    if(R_SUCCEEDED(res = httpcGetDownloadSizeState(&context->httpc, &startPos, NULL))) {
+        res = HTTPC_RESULTCODE_DOWNLOADPENDING;
+
+        u32 outPos = 0;
+        if(context->compressed) {
+            res = http_read_compressed(context, &outPos, buffer, size);
+        } else {
+            while(res == HTTPC_RESULTCODE_DOWNLOADPENDING && outPos < size) {
+                if(R_SUCCEEDED(res = httpcReceiveDataTimeout(&context->httpc, &((u8*) buffer)[outPos], size - outPos, HTTP_TIMEOUT_NS)) || res == HTTPC_RESULTCODE_DOWNLOADPENDING) {
+                    Result posRes = 0;
+                    u32 currPos = 0;
+                    if(R_SUCCEEDED(posRes = httpcGetDownloadSizeState(&context->httpc, &currPos, NULL))) {
+                        outPos = currPos - startPos;
+                    } else {
+                        res = posRes;
+                    }
+                }
+            }
+        }
+
+        if(res == HTTPC_RESULTCODE_DOWNLOADPENDING) {
+            res = 0;
+        }
+
+        if(R_SUCCEEDED(res)) {
+            if(!context->compressed) {
+                bandwidth_consume(outPos);
+            }
+
+            if(bytesRead != NULL) {
+                *bytesRead = outPos;
+            }
+        }
+    }
+
+    return res;
+}
+
+// Failures worth retrying later: the server or the network may recover, the request itself is fine.
+bool http_is_transient_error(Result res) {
+    if(res >= R_FBI_HTTP_ERROR_BASE && res < R_FBI_HTTP_ERROR_END) {
+        u32 responseCode = (u32) (res - R_FBI_HTTP_ERROR_BASE);
+        return responseCode == 408 || responseCode == 429 || responseCode >= 500;
+    }
+
+    if(res >= R_FBI_CURL_ERROR_BASE && res < R_FBI_CURL_ERROR_END) {
+        switch(res - R_FBI_CURL_ERROR_BASE) {
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_PARTIAL_FILE:
+            case CURLE_OPERATION_TIMEDOUT:
+            case CURLE_SSL_CONNECT_ERROR:
+            case CURLE_GOT_NOTHING:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    if(R_MODULE(res) == RM_SOC) {
+        return true;
+    }
+
+    if(R_MODULE(res) == RM_HTTP) {
+        // Network unavailable, request timed out.
+        return R_DESCRIPTION(res) == 70 || R_DESCRIPTION(res) == 105;
+    }
+
+    return false;
+}
+
+#define HTTP_CONTENT_LENGTH_HEADER "Content-Length"
+
+#define HTTP_CURL_DIRECT_MIN (16 * 1024)
+
+typedef struct {
+    u64 rangeStart;
+    u32 bufferSize;
+    u64* contentLength;
+    void* userData;
+    Result (*callback)(void* userData, void* buffer, size_t size);
+
+    void* buf;
+    u32 pos;
+    bool filled;
+
+    http_cache_validators* validators;
+
+    Result res;
+} http_curl_data;
+
+static void http_curl_copy_header(char* out, size_t size, const char* header, size_t bytes, size_t nameLen) {
+    const char* value = header + nameLen;
+    const char* end = header + bytes;
+
+    while(value < end && *value == ' ') {
+        value++;
+    }
+
+    while(end > value && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ')) {
+        end--;
+    }
+
+    size_t len = (size_t) (end - value);
+    if(len >= size) {
+        len = size - 1;
+    }
+
+    memcpy(out, value, len);
+    out[len] = '\0';
+}
+
+static size_t http_curl_header_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    http_curl_data* curlData = (http_curl_data*) userdata;
+
+    size_t bytes = size * nitems;
+    size_t headerNameLen = strlen(HTTP_CONTENT_LENGTH_HEADER);
+
+    // A plain 200 to a ranged request means the server sent the whole resource.
+    unsigned long response = 0;
+    if(curlData->rangeStart > 0 && bytes >= 5 && strncmp(buffer, "HTTP/", 5) == 0 && sscanf(buffer, "HTTP/%*s %lu", &response) == 1 && response == 200) {
+        curlData->res = R_FBI_HTTP_RANGE_NOT_SUPPORTED;
+        return 0;
+    }
+
+    if(curlData->validators != NULL) {
+        // Redirects deliver several responses' headers; only the last one's count.
+        if(bytes >= 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+            memset(curlData->validators, 0, sizeof(*curlData->validators));
+        } else if(bytes >= 5 && strncasecmp(buffer, "ETag:", 5) == 0) {
+            http_curl_copy_header(curlData->validators->etag, sizeof(curlData->validators->etag), buffer, bytes, 5);
+        } else if(bytes >= 14 && strncasecmp(buffer, "Last-Modified:", 14) == 0) {
+            http_curl_copy_header(curlData->validators->lastModified, sizeof(curlData->validators->lastModified), buffer, bytes, 14);
+        }
+    }
+
+    if(bytes >= headerNameLen && strncmp(buffer, HTTP_CONTENT_LENGTH_HEADER, headerNameLen) == 0) {
+        char* separator = strstr(buffer, ": ");
+        if(separator != NULL) {
+            char* valueStart = separator + 2;
+
+            char value[32];
+            memset(value, '\0', sizeof(value));
+            strncpy(value, valueStart, bytes - (valueStart - buffer));
+
+            if(curlData->contentLength != NULL) {
+                *(curlData->contentLength) = (u64) atoll(value);
+            }
+        }
+    }
+
+    return size * nitems;
+}
+
+static Result http_curl_flush(http_curl_data* curlData) {
+    if(curlData->pos > 0 && R_SUCCEEDED(curlData->res)) {
+        curlData->res = curlData->callback(curlData->userData, curlData->buf, curlData->pos);
+        curlData->pos = 0;
+    }
+
+    return curlData->res;
+}
+
+// Chunks are handed to the callback straight from curl's receive buffer; only small ones are
+// coalesced, so a trickle of tiny reads doesn't turn into a trickle of tiny writes. The first block
+// is what callers inspect as the start of the file, so it is always delivered whole.
+static size_t http_curl_write_callback(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    http_curl_data* curlData = (http_curl_data*) userdata;
+
+    size_t total = size * nmemb;
+    bandwidth_consume(total);
+
+    size_t available = total;
+
+    if(!curlData->filled) {
+        size_t copy = curlData->bufferSize - curlData->pos;
+        if(copy > available) {
+            copy = available;
+        }
+
+        memcpy((u8*) curlData->buf + curlData->pos, ptr, copy);
+        curlData->pos += copy;
+
+        ptr += copy;
+        available -= copy;
+
+        if(curlData->pos == curlData->bufferSize) {
+            curlData->filled = true;
+            http_curl_flush(curlData);
+        }
+    }
+
+    if(available > 0 && R_SUCCEEDED(curlData->res)) {
+        bool direct = available >= HTTP_CURL_DIRECT_MIN || available > curlData->bufferSize;
+
+        if(direct || curlData->pos + available > curlData->bufferSize) {
+            http_curl_flush(curlData);
+        }
+
+        if(R_SUCCEEDED(curlData->res)) {
+            if(direct) {
+                curlData->res = curlData->callback(curlData->userData, ptr, available);
+            } else {
+                memcpy((u8*) curlData->buf + curlData->pos, ptr, available);
+                curlData->pos += available;
+            }
+        }
+    }
+
+    return R_SUCCEEDED(curlData->res) ? total : 0;
+}
+
+static Result http_download_request(const char* url, u64 rangeStart, u32 bufferSize, u64* contentLength, http_cache_validators* validators, void* userData, Result (*callback)(void* userData, void* buffer, size_t size));
+
+Result http_download_callback(const char* url, u32 bufferSize, u64* contentLength, void* userData, Result (*callback)(void* userData, void* buffer, size_t size)) {
+    return http_download_callback_ranged(url, 0, bufferSize, contentLength, userData, callback);
+}
+
+Result http_download_callback_ranged(const char* url, u64 rangeStart, u32 bufferSize, u64* contentLength, void* userData, Result (*callback)(void* userData, void* buffer, size_t size)) {
+    return http_download_request(url, rangeStart, bufferSize, contentLength, NULL, userData, callback);
+}
+
+// With validators, a 304 succeeds without calling back and sets notModified.
+static Result http_download_request(const char* url, u64 rangeStart, u32 bufferSize, u64* contentLength, http_cache_validators* validators, void* userData, Result (*callback)(void* userData, void* buffer, size_t size)) {
+    Result res = 0;
+
+    void* buf = bufpool_alloc(BUFPOOL_HEAP, bufferSize);
+    if(buf != NULL) {
+        // Skip a handshake that is known to fail.
+        if(http_is_curl_host(url)) {
+            res = R_HTTP_TLS_VERIFY_FAILED;
+        }
+
+        http_context context = NULL;
+        if(R_SUCCEEDED(res) && R_SUCCEEDED(res = http_open_request(&context, url, true, true, rangeStart, 0, validators))) {
+            u32 dlSize = 0;
+            if(R_SUCCEEDED(res = http_get_size(context, &dlSize))) {
+                if(contentLength != NULL) {
+                    *contentLength = dlSize;
+                }
+
+                // The size of a compressed body says nothing about how much it inflates to; read it to the end of the stream.
+                u32 total = 0;
+                u32 currSize = 0;
+                while((context->compressed ? !context->streamEnd : total < dlSize)
+                      && R_SUCCEEDED(res = http_read(context, &currSize, buf, bufferSize))
+                      && R_SUCCEEDED(res = callback(userData, buf, currSize))) {
+                    total += currSize;
+                }
+
+                Result closeRes = http_close(context);
+                if(R_SUCCEEDED(res)) {
+                    res = closeRes;
+                }
+            }
+        } else if(res == R_HTTP_NOT_MODIFIED && validators != NULL) {
+            res = 0;
+
+            validators->notModified = true;
+        } else if(res == R_HTTP_TLS_VERIFY_FAILED) {
+            res = 0;
+
+            http_add_curl_host(url);
+
+            CURL* curl = http_pool_acquire(url);
+            if(curl != NULL) {
+                http_curl_data curlData = {rangeStart, bufferSize, contentLength, userData, callback, buf, 0, false, validators, 0};
+
+                char range[32];
+                snprintf(range, sizeof(range), "%llu-", (unsigned long long) rangeStart);
+
+                struct curl_slist* headers = NULL;
+                if(validators != NULL) {
+                    char header[HTTP_CACHE_VALIDATOR_MAX + 32];
+
+                    if(validators->etag[0] != '\0') {
+                        snprintf(header, sizeof(header), "If-None-Match: %s", validators->etag);
+                        headers = curl_slist_append(headers, header);
+                    }
+
+                    if(validators->lastModified[0] != '\0') {
+                        snprintf(header, sizeof(header), "If-Modified-Since: %s", validators->lastModified);
+                        headers = curl_slist_append(headers, header);
+                    }
+                }
+
+                curl_easy_setopt(curl, CURLOPT_URL, url);
+                if(rangeStart > 0) {
+                    curl_easy_setopt(curl, CURLOPT_RANGE, range);
+                }
+                curl_easy_setopt(curl, CURLOPT_USERAGENT, HTTP_USER_AGENT);
+                curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, (long) bufferSize);
+                curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long) HTTP_TIMEOUT_SEC);
+                curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_curl_write_callback);
+                curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*) &curlData);
+                curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, http_curl_header_callback);
+                curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*) &curlData);
+                if(headers != NULL) {
+                    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+                }
+
+                CURLcode ret = curl_easy_perform(curl);
+
+                if(ret == CURLE_OK && R_FAILED(http_curl_flush(&curlData))) {
+                    ret = CURLE_WRITE_ERROR;
+                }
+
+                if(ret != CURLE_OK) {
+                    if(ret == CURLE_WRITE_ERROR) {
+                        res = curlData.res;
+                    } else {
+                        res = R_FBI_CURL_ERROR_BASE + ret;
+                    }
+                } else if(validators != NULL) {
+                    long response = 0;
+                    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response);
+
+                    if(response == 304) {
+                        validators->notModified = true;
+                    } else if(response != 200) {
+                        // Not worth caching.
+                        memset(validators, 0, sizeof(*validators));
+                    }
+                }
+
+                curl_slist_free_all(headers);
+
+                long connections = 0;
+                double firstByte = 0;
+                curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connections);
+                curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &firstByte);
+                http_pool_record((u32) connections, (u64) (firstByte * 1000));
+
+                // Connections cut off mid-transfer can't carry another request.
+                http_pool_release(url, curl, ret == CURLE_OK);
+            } else {
+                res = R_FBI_CURL_INIT_FAILED;
+            }
+        }
+
+        bufpool_free(BUFPOOL_HEAP, buf, bufferSize);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+// Every segment costs a request, and with it a handshake, so segments are as large as the memory for the slots allows:
+// between HTTP_SEGMENT_SIZE_MIN and HTTP_SEGMENT_SIZE_MAX, with all slots together within HTTP_SEGMENT_MEMORY_MAX.
+#define HTTP_SEGMENT_SIZE_MIN (512 * 1024)
+#define HTTP_SEGMENT_SIZE_MAX (2 * 1024 * 1024)
+#define HTTP_SEGMENT_MEMORY_MAX (12 * 1024 * 1024)
+#define HTTP_SEGMENT_PER_WORKER 4
+#define HTTP_SEGMENT_READ_SIZE (64 * 1024)
+#define HTTP_SEGMENT_RETRIES 2
+#define HTTP_SEGMENT_ADAPT_MS 1000
+#define HTTP_SEGMENT_WAIT_NS (100 * 1000000)
+
+typedef struct {
+    u8* buffer;
+    u64 segment;
+    u32 size;
+    bool ready;
+} http_segment_slot;
+
+typedef struct {
+    http_segmented download;
+    u32 id;
+    Thread thread;
+} http_segment_worker;
+
+// Segment 0 is streamed straight from the request that probed for range support, while workers
+// fetch the following segments into a ring of slots. The reader drains the slots strictly in order.
+struct http_segmented_s {
+    char url[1024];
+    bool userAgent;
+    Handle cancelEvent;
+
+    u64 start;
+    u64 size;
+    u32 firstSize;
+    u32 segmentSize;
+    u64 segmentCount;
+
+    http_context stream;
+    u32 streamRemaining;
+
+    http_segment_slot* slots;
+    u32 slotCount;
+    u32 readOffset;
+
+    http_segment_worker* workers;
+    u32 workerCount;
+    u32 activeWorkers;
+    bandwidth_class cls;
+
+    Handle mutex;
+    Handle wakeEvent;
+    Handle progressEvent;
+
+    u64 next;
+    u64 delivered;
+    // Polled by the workers mid-segment, outside the mutex.
+    bool abort;
+    Result result;
+
+    u64 adaptStart;
+    u64 adaptBytes;
+    u32 lastRate;
+    s32 direction;
+};
+
+static Result http_segmented_fetch(http_segmented download, http_segment_slot* slot) {
+    u64 offset = download->start + download->firstSize + (slot->segment - 1) * download->segmentSize;
+    u64 end = download->start + download->size;
+
+    slot->size = end - offset < download->segmentSize ? (u32) (end - offset) : download->segmentSize;
+
+    Result res = 0;
+
+    for(u32 attempt = 0; attempt <= HTTP_SEGMENT_RETRIES; attempt++) {
+        http_context context = NULL;
+        if(R_SUCCEEDED(res = http_open_ranged(&context, download->url, download->userAgent, offset, offset + slot->size - 1))) {
+            // Segments only line up if the server keeps honouring ranges.
+            if(!context->partial) {
+                res = R_FBI_HTTP_RANGE_NOT_SUPPORTED;
+            }
+
+            u32 pos = 0;
+            while(R_SUCCEEDED(res) && pos < slot->size && !__atomic_load_n(&download->abort, __ATOMIC_ACQUIRE)) {
+                u32 readSize = slot->size - pos;
+                if(readSize > HTTP_SEGMENT_READ_SIZE) {
+                    readSize = HTTP_SEGMENT_READ_SIZE;
+                }
+
+                u32 bytesRead = 0;
+                if(R_SUCCEEDED(res = http_read(context, &bytesRead, slot->buffer + pos, readSize)) && bytesRead == 0) {
+                    res = R_FBI_BAD_DATA;
+                }
+
+                pos += bytesRead;
+            }
+
+            http_close(context);
+        }
+
+        if(R_SUCCEEDED(res) || __atomic_load_n(&download->abort, __ATOMIC_ACQUIRE) || !http_is_transient_error(res)) {
+            break;
+        }
+    }
+
+    if(R_SUCCEEDED(res) && __atomic_load_n(&download->abort, __ATOMIC_ACQUIRE)) {
+        res = R_FBI_CANCELLED;
+    }
+
+    return res;
+}
+
+static void http_segmented_worker_thread(void* arg) {
+    http_segment_worker* worker = (http_segment_worker*) arg;
+    http_segmented download = worker->download;
+
+    bandwidth_set_class(download->cls);
+
+    while(true) {
+        svcWaitSynchronization(download->mutex, U64_MAX);
+
+        if(__atomic_load_n(&download->abort, __ATOMIC_ACQUIRE) || R_FAILED(download->result) || download->next >= download->segmentCount) {
+            svcReleaseMutex(download->mutex);
+            break;
+        }
+
+        if(worker->id >= download->activeWorkers || download->next >= download->delivered + download->slotCount) {
+            svcClearEvent(download->wakeEvent);
+            svcReleaseMutex(download->mutex);
+
+            svcWaitSynchronization(download->wakeEvent, U64_MAX);
+            continue;
+        }
+
+        http_segment_slot* slot = &download->slots[download->next % download->slotCount];
+        slot->segment = download->next++;
+        slot->ready = false;
+
+        svcReleaseMutex(download->mutex);
+
+        Result res = http_segmented_fetch(download, slot);
+
+        svcWaitSynchronization(download->mutex, U64_MAX);
+
+        if(R_SUCCEEDED(res)) {
+            slot->ready = true;
+        } else if(R_SUCCEEDED(download->result)) {
+            download->result = res;
+        }
+
+        svcSignalEvent(download->progressEvent);
+        svcReleaseMutex(download->mutex);
+    }
+}
+
+// Hill-climbs the number of connections: keep stepping while throughput improves, step back when it drops.
+static void http_segmented_adapt(http_segmented download, u32 bytes) {
+    download->adaptBytes += bytes;
+
+    u64 now = osGetTime();
+    u64 elapsed = now - download->adaptStart;
+    if(elapsed < HTTP_SEGMENT_ADAPT_MS) {
+        return;
+    }
+
+    u32 rate = (u32) (download->adaptBytes * 1000 / elapsed);
+
+    if(download->lastRate == 0 || rate > download->lastRate / 10 * 11) {
+        if(download->direction == 0) {
+            download->direction = 1;
+        }
+    } else if(rate < download->lastRate / 10 * 9) {
+        download->direction = download->direction > 0 ? -1 : 1;
+    } else {
+        download->direction = 0;
+    }
+
+    s32 active = (s32) download->activeWorkers + download->direction;
+    if(active >= 1 && active <= (s32) download->workerCount) {
+        download->activeWorkers = (u32) active;
+    } else {
+        download->direction = 0;
+    }
+
+    download->lastRate = rate;
+    download->adaptStart = now;
+    download->adaptBytes = 0;
+}
+
+static void http_segmented_free(http_segmented download) {
+    if(download->workers != NULL) {
+        __atomic_store_n(&download->abort, true, __ATOMIC_RELEASE);
+
+        if(download->wakeEvent != 0) {
+            svcSignalEvent(download->wakeEvent);
+        }
+
+        for(u32 i = 0; i < download->workerCount; i++) {
+            threadJoin(download->workers[i].thread, U64_MAX);
+            threadFree(download->workers[i].thread);
+        }
+
+        free(download->workers);
+    }
+
+    if(download->slots != NULL) {
+        for(u32 i = 0; i < download->slotCount; i++) {
+            if(download->slots[i].buffer != NULL) {
+                bufpool_free(BUFPOOL_HEAP, download->slots[i].buffer, download->segmentSize);
+            }
+        }
+
+        free(download->slots);
+    }
+
+    if(download->progressEvent != 0) {
+        svcCloseHandle(download->progressEvent);
+    }
+
+    if(download->wakeEvent != 0) {
+        svcCloseHandle(download->wakeEvent);
+    }
+
+    if(download->mutex != 0) {
+        svcCloseHandle(download->mutex);
+    }
+
+    if(download->stream != NULL) {
+        http_close(download->stream);
+    }
+
+    free(download);
+}
+
+static Result http_segmented_start_workers(http_segmented download, u32 workerCount) {
+    Result res = 0;
+
+    download->slotCount = workerCount + 2;
+
+    if((download->slots = (http_segment_slot*) calloc(download->slotCount, sizeof(http_segment_slot))) == NULL
+       || (download->workers = (http_segment_worker*) calloc(workerCount, sizeof(http_segment_worker))) == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    for(u32 i = 0; i < download->slotCount; i++) {
+        if((download->slots[i].buffer = (u8*) bufpool_alloc(BUFPOOL_HEAP, download->segmentSize)) == NULL) {
+            return R_FBI_OUT_OF_MEMORY;
+        }
+    }
+
+    if(R_FAILED(res = svcCreateMutex(&download->mutex, false))
+       || R_FAILED(res = svcCreateEvent(&download->wakeEvent, RESET_STICKY))
+       || R_FAILED(res = svcCreateEvent(&download->progressEvent, RESET_ONESHOT))) {
+        return res;
+    }
+
+    s32 priority = 0x30;
+    svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+
+    download->cls = bandwidth_get_class();
+    download->activeWorkers = workerCount < 2 ? workerCount : 2;
+    download->next = 1;
+    download->adaptStart = osGetTime();
 
-            size_t baseLen = baseEnd - oldUrl;
-            if(baseLen < size) {
-                string_copy(baseEnd, redirectTo, size - baseLen);
-            }
-        } else {
-            string_copy(oldUrl, redirectTo, size);
+    for(; download->workerCount < workerCount; download->workerCount++) {
+        http_segment_worker* worker = &download->workers[download->workerCount];
+        worker->download = download;
+        worker->id = download->workerCount;
+
+        if((worker->thread = threadCreate(http_segmented_worker_thread, worker, 0x8000, priority, 1, false)) == NULL) {
+            break;
         }
     }
-}
 
-Result http_open(http_context* context, const char* url, bool userAgent) {
-    return http_open_ranged(context, url, userAgent, 0, 0);
+    if(download->workerCount == 0) {
+        return R_FBI_THREAD_CREATE_FAILED;
+    }
+
+    if(download->activeWorkers > download->workerCount) {
+        download->activeWorkers = download->workerCount;
+    }
+
+    return 0;
 }
 
-Result http_open_ranged(http_context* context, const char* url, bool userAgent, u32 rangeStart, u32 rangeEnd) {
-    if(url == NULL) {
+Result http_segmented_open(http_segmented* download, const char* url, bool userAgent, u64 rangeStart, u32 maxConnections, Handle cancelEvent) {
+    if(download == NULL || url == NULL) {
         return R_FBI_INVALID_ARGUMENT;
     }
 
-    Result res = 0;
+    http_segmented newDownload = (http_segmented) calloc(1, sizeof(struct http_segmented_s));
+    if(newDownload == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
 
-    http_context ctx = (http_context) calloc(1, sizeof(struct http_context_s));
-    if(ctx != NULL) {
-        char currUrl[1024];
-        string_copy(currUrl, url, sizeof(currUrl));
+    string_copy(newDownload->url, url, sizeof(newDownload->url));
+    newDownload->userAgent = userAgent;
+    newDownload->cancelEvent = cancelEvent;
+    newDownload->start = rangeStart;
+    newDownload->segmentCount = 1;
 
-        char range[64];
-        if(rangeEnd > rangeStart) {
-            snprintf(range, sizeof(range), "%lu-%lu", rangeStart, rangeEnd);
-        } else {
-            snprintf(range, sizeof(range), "%lu-", rangeStart);
-        }
+    Result res = 0;
 
-        bool resolved = false;
-        u32 redirectCount = 0;
-        while(R_SUCCEEDED(res) && !resolved && redirectCount < 32) {
-            if(R_SUCCEEDED(res = httpcOpenContext(&ctx->httpc, HTTPC_METHOD_GET, currUrl, 1))) {
-                u32 response = 0;
-                if(R_SUCCEEDED(res = httpcSetSSLOpt(&ctx->httpc, SSLCOPT_DisableVerify))
-                   && (!userAgent || R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "User-Agent", HTTP_USER_AGENT)))
-                   && (rangeStart == 0 || R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "Range", range)))
-                   && R_SUCCEEDED(res = httpcAddRequestHeaderField(&ctx->httpc, "Accept-Encoding", "gzip, deflate"))
-                   && R_SUCCEEDED(res = httpcSetKeepAlive(&ctx->httpc, HTTPC_KEEPALIVE_ENABLED))
-                   && R_SUCCEEDED(res = httpcBeginRequest(&ctx->httpc))
-                   && R_SUCCEEDED(res = httpcGetResponseStatusCodeTimeout(&ctx->httpc, &response, HTTP_TIMEOUT_NS))) {
-                    if(response == 301 || response == 302 || response == 303) {
-                        redirectCount++;
+    // A single connection requests everything from the start of the range in one go.
+    u64 rangeEnd = maxConnections > 1 ? rangeStart + HTTP_SEGMENT_SIZE_MAX - 1 : 0;
+
+    u64 total = 0;
+    u32 streamSize = 0;
+    if(R_SUCCEEDED(res = http_open_ranged(&newDownload->stream, url, userAgent, rangeStart, rangeEnd))
+       && R_SUCCEEDED(res = http_get_size(newDownload->stream, &streamSize))
+       && R_SUCCEEDED(res = http_get_total_size(newDownload->stream, &total))) {
+        newDownload->streamRemaining = streamSize;
+        newDownload->firstSize = streamSize;
+
+        if(newDownload->stream->partial && total > rangeStart) {
+            newDownload->size = total - rangeStart;
+
+            u64 remaining = newDownload->size - streamSize;
+            if(remaining > 0) {
+                u64 workerCount = (remaining + HTTP_SEGMENT_SIZE_MIN - 1) / HTTP_SEGMENT_SIZE_MIN;
+                if(workerCount > maxConnections) {
+                    workerCount = maxConnections;
+                }
 
-                        char redirectTo[1024];
-                        memset(redirectTo, '\0', sizeof(redirectTo));
-                        if(R_SUCCEEDED(res = httpcGetResponseHeader(&ctx->httpc, "Location", redirectTo, sizeof(redirectTo)))) {
-                            httpcCloseContext(&ctx->httpc);
+                if(workerCount > 0) {
+                    // Aim for a few segments per worker, so the connection count still has room to adapt.
+                    u64 segmentSize = remaining / (workerCount * HTTP_SEGMENT_PER_WORKER);
+                    if(segmentSize > HTTP_SEGMENT_MEMORY_MAX / (workerCount + 2)) {
+                        segmentSize = HTTP_SEGMENT_MEMORY_MAX / (workerCount + 2);
+                    }
 
-                            http_resolve_redirect(currUrl, redirectTo, sizeof(currUrl));
-                        }
-                    } else {
-                        resolved = true;
+                    if(segmentSize > HTTP_SEGMENT_SIZE_MAX) {
+                        segmentSize = HTTP_SEGMENT_SIZE_MAX;
+                    }
 
-                        if(response == 200) {
-                            char encoding[32];
-                            if(R_SUCCEEDED(httpcGetResponseHeader(&ctx->httpc, "Content-Encoding", encoding, sizeof(encoding)))) {
-                                bool gzip = strncmp(encoding, "gzip", sizeof(encoding)) == 0;
-                                bool deflate = strncmp(encoding, "deflate", sizeof(encoding)) == 0;
+                    segmentSize -= segmentSize % HTTP_SEGMENT_READ_SIZE;
+                    if(segmentSize < HTTP_SEGMENT_SIZE_MIN) {
+                        segmentSize = HTTP_SEGMENT_SIZE_MIN;
+                    }
 
-                                ctx->compressed = gzip || deflate;
+                    newDownload->segmentSize = (u32) segmentSize;
+                    newDownload->segmentCount = 1 + (remaining + segmentSize - 1) / segmentSize;
 
-                                if(ctx->compressed) {
-                                    memset(&ctx->inflate, 0, sizeof(ctx->inflate));
-                                    if(deflate) {
-                                        inflateInit(&ctx->inflate);
-                                    } else if(gzip) {
-                                        inflateInit2(&ctx->inflate, MAX_WBITS | 16);
-                                    }
-                                }
-                            }
-                        } else {
-                            res = R_FBI_HTTP_ERROR_BASE + response;
-                        }
+                    if(workerCount > newDownload->segmentCount - 1) {
+                        workerCount = newDownload->segmentCount - 1;
                     }
-                }
 
-                if(R_FAILED(res)) {
-                    httpcCloseContext(&ctx->httpc);
+                    res = http_segmented_start_workers(newDownload, (u32) workerCount);
                 }
             }
+        } else {
+            // The server ignored the range and sent the whole resource; read it over this one connection.
+            newDownload->size = streamSize;
         }
-
-        if(R_SUCCEEDED(res) && redirectCount >= 32) {
-            res = R_FBI_HTTP_TOO_MANY_REDIRECTS;
-        }
-
-        if(R_FAILED(res)) {
-            free(ctx);
-        }
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
     }
 
     if(R_SUCCEEDED(res)) {
-        *context = ctx;
+        *download = newDownload;
+    } else {
+        http_segmented_free(newDownload);
     }
 
     return res;
 }
 
-Result http_close(http_context context) {
-    if(context == NULL) {
-        return R_FBI_INVALID_ARGUMENT;
+// Stops the workers as soon as the cancel event is signalled; they are joined when the download is closed.
+static bool http_segmented_cancelled(http_segmented download) {
+    if(download->cancelEvent == 0 || svcWaitSynchronization(download->cancelEvent, 0) != 0) {
+        return false;
     }
 
-    if(context->compressed) {
-        inflateEnd(&context->inflate);
+    if(download->workers != NULL) {
+        __atomic_store_n(&download->abort, true, __ATOMIC_RELEASE);
+        svcSignalEvent(download->wakeEvent);
     }
 
-    Result res = httpcCloseContext(&context->httpc);
-    free(context);
-    return res;
+    return true;
 }
 
-Result http_get_size(http_context context, u32* size) {
-    if(context == NULL || size == NULL) {
+Result http_segmented_get_size(http_segmented download, u64* size) {
+    if(download == NULL || size == NULL) {
         return R_FBI_INVALID_ARGUMENT;
     }
 
-    return httpcGetDownloadSizeState(&context->httpc, NULL, size);
+    *size = download->size;
+    return 0;
 }
 
-Result http_get_file_name(http_context context, char* out, u32 size) {
-    if(context == NULL || out == NULL) {
+Result http_segmented_read(http_segmented download, u32* bytesRead, void* buffer, u32 size) {
+    if(download == NULL || bytesRead == NULL || buffer == NULL) {
         return R_FBI_INVALID_ARGUMENT;
     }
 
     Result res = 0;
 
-    char* header = (char*) calloc(1, size + 64);
-    if(header != NULL) {
-        if(R_SUCCEEDED(res = httpcGetResponseHeader(&context->httpc, "Content-Disposition", header, size + 64))) {
-            char* start = strstr(header, "filename=");
-            if(start != NULL) {
-                char format[32];
-                snprintf(format, sizeof(format), "filename=\"%%%lu[^\"]\"", size);
-                if(sscanf(start, format, out) != 1) {
-                    res = R_FBI_BAD_DATA;
-                }
-            } else {
-                res = R_FBI_BAD_DATA;
-            }
-        }
+    *bytesRead = 0;
 
-        free(header);
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
+    if(http_segmented_cancelled(download)) {
+        return R_FBI_CANCELLED;
     }
 
-    return res;
-}
-
-Result http_read(http_context context, u32* bytesRead, void* buffer, u32 size) {
-    if(context == NULL || buffer == NULL) {
-        return R_FBI_INVALID_ARGUMENT;
-    }
+    if(download->stream != NULL) {
+        if(size > download->streamRemaining) {
+            size = download->streamRemaining;
+        }
 
-    Result res = 0;
+        if(R_SUCCEEDED(res = http_read(download->stream, bytesRead, buffer, size)) && *bytesRead == 0 && size > 0) {
+            res = R_FBI_BAD_DATA;
+        }
 
-    u32 startPos = 0;
-    if(R_SUCCEEDED(res = httpcGetDownloadSizeState(&context->httpc, &startPos, NULL))) {
-        res = HTTPC_RESULTCODE_DOWNLOADPENDING;
+        if(R_SUCCEEDED(res)) {
+            download->streamRemaining -= *bytesRead;
 
-        u32 outPos = 0;
-        if(context->compressed) {
-            u32 lastPos = context->bufferSize;
-            while(res == HTTPC_RESULTCODE_DOWNLOADPENDING && outPos < size) {
-                if((context->bufferSize > 0
-                    || R_SUCCEEDED(res = httpcReceiveDataTimeout(&context->httpc, &context->buffer[context->bufferSize], sizeof(context->buffer) - context->bufferSize, HTTP_TIMEOUT_NS))
-                    || res == HTTPC_RESULTCODE_DOWNLOADPENDING)) {
-                    Result posRes = 0;
-                    u32 currPos = 0;
-                    if(R_SUCCEEDED(posRes = httpcGetDownloadSizeState(&context->httpc, &currPos, NULL))) {
-                        context->bufferSize += currPos - lastPos;
+            if(download->streamRemaining == 0) {
+                http_close(download->stream);
+                download->stream = NULL;
 
-                        context->inflate.next_in = context->buffer;
-                        context->inflate.next_out = buffer + outPos;
-                        context->inflate.avail_in = context->bufferSize;
-                        context->inflate.avail_out = size - outPos;
-                        inflate(&context->inflate, Z_SYNC_FLUSH);
+                if(download->workers != NULL) {
+                    svcWaitSynchronization(download->mutex, U64_MAX);
 
-                        memcpy(context->buffer, context->buffer + (context->bufferSize - context->inflate.avail_in), context->inflate.avail_in);
-                        context->bufferSize = context->inflate.avail_in;
+                    download->delivered = 1;
+                    svcSignalEvent(download->wakeEvent);
 
-                        lastPos = currPos;
-                        outPos = size - context->inflate.avail_out;
-                    } else {
-                        res = posRes;
-                    }
-                }
-            }
-        } else {
-            while(res == HTTPC_RESULTCODE_DOWNLOADPENDING && outPos < size) {
-                if(R_SUCCEEDED(res = httpcReceiveDataTimeout(&context->httpc, &((u8*) buffer)[outPos], size - outPos, HTTP_TIMEOUT_NS)) || res == HTTPC_RESULTCODE_DOWNLOADPENDING) {
-                    Result posRes = 0;
-                    u32 currPos = 0;
-                    if(R_SUCCEEDED(posRes = httpcGetDownloadSizeState(&context->httpc, &currPos, NULL))) {
-                        outPos = currPos - startPos;
-                    } else {
-                        res = posRes;
-                    }
+                    svcReleaseMutex(download->mutex);
                 }
             }
         }
 
-        if(res == HTTPC_RESULTCODE_DOWNLOADPENDING) {
-            res = 0;
-        }
-
-        if(R_SUCCEEDED(res) && bytesRead != NULL) {
-            *bytesRead = outPos;
-        }
+        return res;
     }
 
-    return res;
-}
-
-#define R_HTTP_TLS_VERIFY_FAILED 0xD8A0A03C
-
-#define HTTP_CONTENT_LENGTH_HEADER "Content-Length"
+    if(download->workers == NULL || download->delivered >= download->segmentCount) {
+        return 0;
+    }
 
-typedef struct {
-    u32 bufferSize;
-    u64* contentLength;
-    void* userData;
-    Result (*callback)(void* userData, void* buffer, size_t size);
+    http_segment_slot* slot = &download->slots[download->delivered % download->slotCount];
 
-    void* buf;
-    u32 pos;
+    while(true) {
+        svcWaitSynchronization(download->mutex, U64_MAX);
 
-    Result res;
-} http_curl_data;
+        bool ready = slot->ready && slot->segment == download->delivered;
+        res = download->result;
 
-static size_t http_curl_header_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
-    http_curl_data* curlData = (http_curl_data*) userdata;
+        svcReleaseMutex(download->mutex);
 
-    size_t bytes = size * nitems;
-    size_t headerNameLen = strlen(HTTP_CONTENT_LENGTH_HEADER);
+        if(ready) {
+            break;
+        }
 
-    if(bytes >= headerNameLen && strncmp(buffer, HTTP_CONTENT_LENGTH_HEADER, headerNameLen) == 0) {
-        char* separator = strstr(buffer, ": ");
-        if(separator != NULL) {
-            char* valueStart = separator + 2;
+        if(R_FAILED(res)) {
+            return res;
+        }
 
-            char value[32];
-            memset(value, '\0', sizeof(value));
-            strncpy(value, valueStart, bytes - (valueStart - buffer));
+        // Bounded, so a missed wakeup costs a poll rather than a hang.
+        Handle handles[2] = {download->progressEvent, download->cancelEvent};
+        s32 index = 0;
+        svcWaitSynchronizationN(&index, handles, download->cancelEvent != 0 ? 2 : 1, false, HTTP_SEGMENT_WAIT_NS);
 
-            if(curlData->contentLength != NULL) {
-                *(curlData->contentLength) = (u64) atoll(value);
-            }
+        if(http_segmented_cancelled(download)) {
+            return R_FBI_CANCELLED;
         }
     }
 
-    return size * nitems;
-}
-
-static size_t http_curl_write_callback(char* ptr, size_t size, size_t nmemb, void* userdata) {
-    http_curl_data* curlData = (http_curl_data*) userdata;
+    u32 available = slot->size - download->readOffset;
+    if(size > available) {
+        size = available;
+    }
 
-    size_t available = size * nmemb;
-    while(available > 0) {
-        size_t remaining = curlData->bufferSize - curlData->pos;
-        size_t copySize = available < remaining ? available : remaining;
+    memcpy(buffer, slot->buffer + download->readOffset, size);
+    download->readOffset += size;
 
-        memcpy((u8*) curlData->buf + curlData->pos, ptr, copySize);
-        curlData->pos += copySize;
-        available -= copySize;
+    *bytesRead = size;
 
-        if(curlData->pos == curlData->bufferSize) {
-            curlData->res = curlData->callback(curlData->userData, curlData->buf, curlData->bufferSize);
-            curlData->pos = 0;
-        }
-    }
+    if(download->readOffset >= slot->size) {
+        svcWaitSynchronization(download->mutex, U64_MAX);
 
-    return R_SUCCEEDED(curlData->res) ? size * nmemb : 0;
-}
+        slot->ready = false;
+        download->delivered++;
+        download->readOffset = 0;
 
-Result http_download_callback(const char* url, u32 bufferSize, u64* contentLength, void* userData, Result (*callback)(void* userData, void* buffer, size_t size)) {
-    Result res = 0;
+        http_segmented_adapt(download, slot->size);
+        svcSignalEvent(download->wakeEvent);
 
-    void* buf = malloc(bufferSize);
-    if(buf != NULL) {
-        http_context context = NULL;
-        if(R_SUCCEEDED(res = http_open(&context, url, true))) {
-            u32 dlSize = 0;
-            if(R_SUCCEEDED(res = http_get_size(context, &dlSize))) {
-                if(contentLength != NULL) {
-                    *contentLength = dlSize;
-                }
+        svcReleaseMutex(download->mutex);
+    }
 
-                u32 total = 0;
-                u32 currSize = 0;
-                while(total < dlSize
-                      && R_SUCCEEDED(res = http_read(context, &currSize, buf, bufferSize))
-                      && R_SUCCEEDED(res = callback(userData, buf, currSize))) {
-                    total += currSize;
-                }
+    return 0;
+}
 
-                Result closeRes = http_close(context);
-                if(R_SUCCEEDED(res)) {
-                    res = closeRes;
-                }
-            }
-        } else if(res == R_HTTP_TLS_VERIFY_FAILED) {
-            res = 0;
+Result http_segmented_close(http_segmented download) {
+    if(download == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
 
-            CURL* curl = curl_easy_init();
-            if(curl != NULL) {
-                http_curl_data curlData = {bufferSize, contentLength, userData, callback, buf, 0, 0};
+    http_segmented_free(download);
 
-                curl_easy_setopt(curl, CURLOPT_URL, url);
-                curl_easy_setopt(curl, CURLOPT_USERAGENT, HTTP_USER_AGENT);
-                curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, bufferSize);
-                curl_easy_setopt(curl, CURLOPT_TIMEOUT, HTTP_TIMEOUT_SEC);
-                curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_curl_write_callback);
-                curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*) &curlData);
-                curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, http_curl_header_callback);
-                curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*) &curlData);
+    return 0;
+}
 
-                CURLcode ret = curl_easy_perform(curl);
+Result http_download_callback_segmented(const char* url, u64 rangeStart, u32 bufferSize, u32 maxConnections, Handle cancelEvent, u64* contentLength, void* userData, Result (*callback)(void* userData, void* buffer, size_t size)) {
+    if(maxConnections <= 1) {
+        return http_download_callback_ranged(url, rangeStart, bufferSize, contentLength, userData, callback);
+    }
 
-                if(ret == CURLE_OK && curlData.pos != 0) {
-                    curlData.res = curlData.callback(curlData.userData, curlData.buf, curlData.pos);
-                    curlData.pos = 0;
+    Result res = 0;
 
-                    if(R_FAILED(curlData.res)) {
-                        ret = CURLE_WRITE_ERROR;
-                    }
-                }
+    void* buf = bufpool_alloc(BUFPOOL_HEAP, bufferSize);
+    if(buf != NULL) {
+        http_segmented download = NULL;
+        if(R_SUCCEEDED(res = http_segmented_open(&download, url, true, rangeStart, maxConnections, cancelEvent))) {
+            if(contentLength != NULL) {
+                *contentLength = download->size;
+            }
 
-                if(ret != CURLE_OK) {
-                    if(ret == CURLE_WRITE_ERROR) {
-                        res = curlData.res;
-                    } else {
-                        res = R_FBI_CURL_ERROR_BASE + ret;
-                    }
-                }
+            u64 total = 0;
+            u32 currSize = 0;
+            while(total < download->size
+                  && R_SUCCEEDED(res = http_segmented_read(download, &currSize, buf, bufferSize))
+                  && R_SUCCEEDED(res = currSize > 0 ? callback(userData, buf, currSize) : R_FBI_BAD_DATA)) {
+                total += currSize;
+            }
 
-                curl_easy_cleanup(curl);
-            } else {
-                res = R_FBI_CURL_INIT_FAILED;
+            Result closeRes = http_segmented_close(download);
+            if(R_SUCCEEDED(res)) {
+                res = closeRes;
             }
         }
 
-        free(buf);
+        bufpool_free(BUFPOOL_HEAP, buf, bufferSize);
     } else {
         res = R_FBI_OUT_OF_MEMORY;
     }
 
+    // The curl fallback for servers the system TLS stack can't talk to only does single connections.
+    if(res == R_HTTP_TLS_VERIFY_FAILED) {
+        res = http_download_callback_ranged(url, rangeStart, bufferSize, contentLength, userData, callback);
+    }
+
     return res;
 }
 
@@ -412,6 +1847,7 @@ typedef struct {
     size_t size;
 
     size_t pos;
+    bool truncated;
 } http_buffer_data;
 
 static Result http_download_buffer_callback(void* userData, void* buffer, size_t size) {
@@ -421,6 +1857,7 @@ static Result http_download_buffer_callback(void* userData, void* buffer, size_t
     size_t copySize = size;
     if(copySize > remaining) {
         copySize = remaining;
+        data->truncated = true;
     }
 
     if(copySize > 0) {
@@ -433,16 +1870,40 @@ static Result http_download_buffer_callback(void* userData, void* buffer, size_t
 
 
 Result http_download_buffer(const char* url, u32* downloadedSize, void* buf, size_t size) {
-    http_buffer_data data = {buf, size, 0};
-    Result res = http_download_callback(url, size, NULL, &data, http_download_buffer_callback);
+    http_cache_validators validators;
+    memset(&validators, 0, sizeof(validators));
+
+    bool cache = http_cache_get_validators(url, &validators, size);
+
+    http_buffer_data data = {buf, size, 0, false};
+    Result res = http_download_request(url, 0, size, NULL, cache ? &validators : NULL, &data, http_download_buffer_callback);
+
+    if(R_SUCCEEDED(res) && validators.notModified) {
+        u32 bytesRead = 0;
+        if(R_SUCCEEDED(http_cache_read(url, &bytesRead, buf, size))) {
+            http_pool_record_cached();
+
+            *downloadedSize = bytesRead;
+            return res;
+        }
+
+        // The cached copy went missing; fetch it again.
+        memset(&validators, 0, sizeof(validators));
+        res = http_download_request(url, 0, size, NULL, &validators, &data, http_download_buffer_callback);
+    }
 
     if(R_SUCCEEDED(res)) {
         *downloadedSize = data.pos;
+
+        if(cache && !data.truncated && !validators.notModified && (validators.etag[0] != '\0' || validators.lastModified[0] != '\0')) {
+            http_cache_store(url, &validators, buf, data.pos);
+        }
     }
 
     return res;
 }
 
+#ifndef FBI_HOST
 Result http_download_json(const char* url, json_t** json, size_t maxSize) {
     if(url == NULL || json == NULL) {
         return R_FBI_INVALID_ARGUMENT;
@@ -533,4 +1994,5 @@ Result http_download_seed(u64 titleId) {
     }
 
     return res;
-}
\ No newline at end of file
+}
+#endif
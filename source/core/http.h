@@ -1,14 +1,51 @@
 #pragma once
 typedef struct http_context_s* http_context;
+typedef struct http_segmented_s* http_segmented;
+
+#define HTTP_SEGMENTED_CONNECTIONS_DEFAULT 4
+
+// httpc can't complete the TLS handshake with the server; such servers are fetched through curl instead.
+#define R_HTTP_TLS_VERIFY_FAILED 0xD8A0A03C
+
+// Connections are only pooled for transfers that go through curl; httpc contexts serve a single request each, so
+// every httpc request pays for its own handshake.
+typedef struct http_pool_stats_s {
+    u32 requests;
+    u32 connections;
+    u32 reused;
+    u32 idle;
+    u32 cached;
+    u64 firstByteMs;
+} http_pool_stats;
+
+void http_init();
+void http_exit();
+void http_get_pool_stats(http_pool_stats* stats);
 
 Result http_open(http_context* context, const char* url, bool userAgent);
-Result http_open_ranged(http_context* context, const char* url, bool userAgent, u32 rangeStart, u32 rangeEnd);
+Result http_open_ranged(http_context* context, const char* url, bool userAgent, u64 rangeStart, u64 rangeEnd);
 Result http_close(http_context context);
 Result http_get_size(http_context context, u32* size);
+Result http_get_total_size(http_context context, u64* size);
 Result http_get_file_name(http_context context, char* out, u32 size);
 Result http_read(http_context context, u32* bytesRead, void* buffer, u32 size);
 
+bool http_is_transient_error(Result res);
+
+// Fetches a resource over up to maxConnections ranged requests at once, returning its bytes in order.
+// Falls back to a single connection when the server ignores ranges or only one connection is allowed. Reads return R_FBI_CANCELLED once cancelEvent,
+// which may be 0, is signalled.
+Result http_segmented_open(http_segmented* download, const char* url, bool userAgent, u64 rangeStart, u32 maxConnections, Handle cancelEvent);
+Result http_segmented_get_size(http_segmented download, u64* size);
+Result http_segmented_read(http_segmented download, u32* bytesRead, void* buffer, u32 size);
+Result http_segmented_close(http_segmented download);
+
 Result http_download_callback(const char* url, u32 bufferSize, u64* contentLength, void* userData, Result (*callback)(void* userData, void* buffer, size_t size));
+Result http_download_callback_ranged(const char* url, u64 rangeStart, u32 bufferSize, u64* contentLength, void* userData, Result (*callback)(void* userData, void* buffer, size_t size));
+Result http_download_callback_segmented(const char* url, u64 rangeStart, u32 bufferSize, u32 maxConnections, Handle cancelEvent, u64* contentLength, void* userData, Result (*callback)(void* userData, void* buffer, size_t size));
 Result http_download_buffer(const char* url, u32* downloadedSize, void* buf, size_t size);
+
+#ifndef FBI_HOST
 Result http_download_json(const char* url, json_t** json, size_t maxSize);
-Result http_download_seed(u64 titleId);
\ No newline at end of file
+Result http_download_seed(u64 titleId);
+#endif
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include "io.h"
+#include "../ui/error.h"
+
+Result io_get_size(io_stream* stream, u64* size) {
+    if(stream == NULL || size == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(stream->ops->getSize == NULL) {
+        return R_FBI_NOT_IMPLEMENTED;
+    }
+
+    return stream->ops->getSize(stream, size);
+}
+
+Result io_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    if(stream == NULL || bytesRead == NULL || buffer == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(stream->ops->read == NULL) {
+        return R_FBI_NOT_IMPLEMENTED;
+    }
+
+    return stream->ops->read(stream, bytesRead, buffer, offset, size);
+}
+
+Result io_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    if(stream == NULL || bytesWritten == NULL || buffer == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(stream->ops->write == NULL) {
+        return R_FBI_NOT_IMPLEMENTED;
+    }
+
+    return stream->ops->write(stream, bytesWritten, buffer, offset, size);
+}
+
+Result io_close(io_stream* stream, bool succeeded) {
+    if(stream == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    if(stream->ops->close != NULL) {
+        res = stream->ops->close(stream, succeeded);
+    }
+
+    free(stream);
+
+    return res;
+}
+
+bool io_is_local(io_stream* stream) {
+    return stream != NULL && stream->ops->local;
+}
+
+Result io_open(io_stream** stream, const io_ops* ops, void* data, u32 handle, u64 size) {
+    if(stream == NULL || ops == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    io_stream* newStream = (io_stream*) calloc(1, sizeof(io_stream));
+    if(newStream == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    newStream->ops = ops;
+    newStream->data = data;
+    newStream->handle = handle;
+    newStream->size = size;
+
+    *stream = newStream;
+    return 0;
+}
+
+static Result io_memory_get_size(io_stream* stream, u64* size) {
+    *size = stream->size;
+    return 0;
+}
+
+static Result io_memory_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    if(offset > stream->size) {
+        return R_FBI_OUT_OF_RANGE;
+    }
+
+    if(size > stream->size - offset) {
+        size = (u32) (stream->size - offset);
+    }
+
+    memcpy(buffer, (u8*) stream->data + offset, size);
+
+    *bytesRead = size;
+    return 0;
+}
+
+static Result io_memory_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    if(offset > stream->size || size > stream->size - offset) {
+        return R_FBI_OUT_OF_RANGE;
+    }
+
+    memcpy((u8*) stream->data + offset, buffer, size);
+
+    *bytesWritten = size;
+    return 0;
+}
+
+static const io_ops io_memory_ops = {
+    .getSize = io_memory_get_size,
+    .read = io_memory_read,
+    .write = io_memory_write,
+    .close = NULL,
+    .local = true
+};
+
+Result io_open_memory(io_stream** stream, void* buffer, u64 size) {
+    if(buffer == NULL && size > 0) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    return io_open(stream, &io_memory_ops, buffer, 0, size);
+}
+
+static Result io_posix_get_size(io_stream* stream, u64* size) {
+    FILE* fd = (FILE*) stream->data;
+
+    off_t pos = 0;
+    if(fseeko(fd, 0, SEEK_END) != 0 || (pos = ftello(fd)) < 0) {
+        return R_FBI_BAD_DATA;
+    }
+
+    *size = (u64) pos;
+    return 0;
+}
+
+static Result io_posix_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    FILE* fd = (FILE*) stream->data;
+
+    if(fseeko(fd, (off_t) offset, SEEK_SET) != 0) {
+        return R_FBI_BAD_DATA;
+    }
+
+    size_t read = fread(buffer, 1, size, fd);
+    if(read < size && ferror(fd)) {
+        return R_FBI_BAD_DATA;
+    }
+
+    *bytesRead = (u32) read;
+    return 0;
+}
+
+static Result io_posix_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    FILE* fd = (FILE*) stream->data;
+
+    if(fseeko(fd, (off_t) offset, SEEK_SET) != 0) {
+        return R_FBI_BAD_DATA;
+    }
+
+    size_t written = fwrite(buffer, 1, size, fd);
+    if(written < size) {
+        return R_FBI_BAD_DATA;
+    }
+
+    *bytesWritten = (u32) written;
+    return 0;
+}
+
+// A failed close only matters if the data written so far was meant to be kept.
+static Result io_posix_close(io_stream* stream, bool succeeded) {
+    return fclose((FILE*) stream->data) == 0 || !succeeded ? 0 : R_FBI_BAD_DATA;
+}
+
+static const io_ops io_posix_ops = {
+    .getSize = io_posix_get_size,
+    .read = io_posix_read,
+    .write = io_posix_write,
+    .close = io_posix_close,
+    .local = true
+};
+
+Result io_open_posix(io_stream** stream, const char* path, const char* mode) {
+    if(stream == NULL || path == NULL || mode == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    FILE* fd = fopen(path, mode);
+    if(fd == NULL) {
+        return R_FBI_BAD_DATA;
+    }
+
+    Result res = io_open(stream, &io_posix_ops, fd, 0, 0);
+    if(R_FAILED(res)) {
+        fclose(fd);
+    }
+
+    return res;
+}
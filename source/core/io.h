@@ -0,0 +1,44 @@
+#pragma once
+
+typedef struct io_stream_s io_stream;
+
+typedef struct io_ops_s {
+    Result (*getSize)(io_stream* stream, u64* size);
+    Result (*read)(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size);
+    Result (*write)(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size);
+    Result (*close)(io_stream* stream, bool succeeded);
+
+    // Served from memory or the local file system, with no latency for a pipelined copy to hide.
+    bool local;
+} io_ops;
+
+struct io_stream_s {
+    const io_ops* ops;
+
+    void* data;
+    u32 handle;
+    u64 size;
+};
+
+Result io_get_size(io_stream* stream, u64* size);
+Result io_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size);
+Result io_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size);
+Result io_close(io_stream* stream, bool succeeded);
+bool io_is_local(io_stream* stream);
+
+Result io_open(io_stream** stream, const io_ops* ops, void* data, u32 handle, u64 size);
+
+Result io_open_memory(io_stream** stream, void* buffer, u64 size);
+Result io_open_posix(io_stream** stream, const char* path, const char* mode);
+// Reads a resource from rangeStart on, over up to maxConnections connections. Reads come in order and fill the buffer
+// unless the body ends; they return R_FBI_CANCELLED once cancelEvent, which may be 0, is signalled.
+Result io_open_http(io_stream** stream, const char* url, bool userAgent, u64 rangeStart, u32 maxConnections, Handle cancelEvent);
+
+#ifndef FBI_HOST
+Result io_open_file(io_stream** stream, FS_Archive archive, const char* path, u32 flags, u32 attributes);
+Result io_open_file_directly(io_stream** stream, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags);
+Result io_open_sd_file(io_stream** stream, const char* path, u32 flags);
+Result io_open_cia_install(io_stream** stream, FS_MediaType dest, bool verify);
+Result io_open_ticket_install(io_stream** stream);
+Result io_open_spi_save(io_stream** stream);
+#endif
@@ -0,0 +1,231 @@
+#include <malloc.h>
+#include <stdio.h>
+
+#include <3ds.h>
+
+#include "ciaverify.h"
+#include "io.h"
+#include "spi.h"
+#include "util.h"
+#include "../ui/error.h"
+
+static Result io_file_get_size(io_stream* stream, u64* size) {
+    return FSFILE_GetSize(stream->handle, size);
+}
+
+static Result io_file_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    return FSFILE_Read(stream->handle, bytesRead, offset, buffer, size);
+}
+
+static Result io_file_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    return FSFILE_Write(stream->handle, bytesWritten, offset, buffer, size, 0);
+}
+
+static Result io_file_close(io_stream* stream, bool succeeded) {
+    return FSFILE_Close(stream->handle);
+}
+
+static const io_ops io_file_ops = {
+    .getSize = io_file_get_size,
+    .read = io_file_read,
+    .write = io_file_write,
+    .close = io_file_close,
+    .local = true
+};
+
+static Result io_wrap_file(io_stream** stream, Handle handle) {
+    Result res = io_open(stream, &io_file_ops, NULL, handle, 0);
+    if(R_FAILED(res)) {
+        FSFILE_Close(handle);
+    }
+
+    return res;
+}
+
+Result io_open_file(io_stream** stream, FS_Archive archive, const char* path, u32 flags, u32 attributes) {
+    if(stream == NULL || path == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    FS_Path* fsPath = util_make_path_utf8(path);
+    if(fsPath != NULL) {
+        Handle handle = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenFile(&handle, archive, *fsPath, flags, attributes))) {
+            res = io_wrap_file(stream, handle);
+        }
+
+        util_free_path_utf8(fsPath);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+Result io_open_file_directly(io_stream** stream, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags) {
+    if(stream == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    Handle handle = 0;
+    if(R_SUCCEEDED(res = FSUSER_OpenFileDirectly(&handle, archiveId, archivePath, filePath, flags, 0))) {
+        res = io_wrap_file(stream, handle);
+    }
+
+    return res;
+}
+
+Result io_open_sd_file(io_stream** stream, const char* path, u32 flags) {
+    if(stream == NULL || path == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    FS_Path* fsPath = util_make_path_utf8(path);
+    if(fsPath != NULL) {
+        res = io_open_file_directly(stream, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), *fsPath, flags);
+
+        util_free_path_utf8(fsPath);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+static Result io_cia_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    Result res = 0;
+
+    if(stream->data != NULL && R_FAILED(res = cia_verify_update((cia_verifier*) stream->data, buffer, offset, size))) {
+        return res;
+    }
+
+    return FSFILE_Write(stream->handle, bytesWritten, offset, buffer, size, 0);
+}
+
+static Result io_cia_close(io_stream* stream, bool succeeded) {
+    Result res = 0;
+
+    cia_verifier* verifier = (cia_verifier*) stream->data;
+    if(verifier != NULL) {
+        if(succeeded && R_FAILED(res = cia_verify_finish(verifier))) {
+            succeeded = false;
+        }
+
+        cia_verify_free(verifier);
+        free(verifier);
+    }
+
+    Result closeRes = succeeded ? AM_FinishCiaInstall(stream->handle) : AM_CancelCIAInstall(stream->handle);
+    return R_SUCCEEDED(res) ? closeRes : res;
+}
+
+static const io_ops io_cia_ops = {
+    .getSize = NULL,
+    .read = NULL,
+    .write = io_cia_write,
+    .close = io_cia_close
+};
+
+Result io_open_cia_install(io_stream** stream, FS_MediaType dest, bool verify) {
+    if(stream == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    cia_verifier* verifier = NULL;
+    if(verify) {
+        if((verifier = (cia_verifier*) calloc(1, sizeof(cia_verifier))) == NULL) {
+            return R_FBI_OUT_OF_MEMORY;
+        }
+
+        cia_verify_init(verifier);
+    }
+
+    Result res = 0;
+
+    Handle handle = 0;
+    if(R_SUCCEEDED(res = AM_StartCiaInstall(dest, &handle)) && R_FAILED(res = io_open(stream, &io_cia_ops, verifier, handle, 0))) {
+        AM_CancelCIAInstall(handle);
+    }
+
+    if(R_FAILED(res) && verifier != NULL) {
+        free(verifier);
+    }
+
+    return res;
+}
+
+static Result io_ticket_close(io_stream* stream, bool succeeded) {
+    return succeeded ? AM_InstallTicketFinish(stream->handle) : AM_InstallTicketAbort(stream->handle);
+}
+
+static const io_ops io_ticket_ops = {
+    .getSize = NULL,
+    .read = NULL,
+    .write = io_file_write,
+    .close = io_ticket_close
+};
+
+Result io_open_ticket_install(io_stream** stream) {
+    if(stream == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    Handle handle = 0;
+    if(R_SUCCEEDED(res = AM_InstallTicketBegin(&handle)) && R_FAILED(res = io_open(stream, &io_ticket_ops, NULL, handle, 0))) {
+        AM_InstallTicketAbort(handle);
+    }
+
+    return res;
+}
+
+static Result io_spi_get_size(io_stream* stream, u64* size) {
+    Result res = 0;
+
+    u32 saveSize = 0;
+    if(R_SUCCEEDED(res = spi_get_save_size(&saveSize))) {
+        *size = saveSize;
+    }
+
+    return res;
+}
+
+static Result io_spi_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    return spi_read_save(bytesRead, buffer, (u32) offset, size);
+}
+
+static Result io_spi_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    return spi_write_save(bytesWritten, buffer, (u32) offset, size);
+}
+
+static Result io_spi_close(io_stream* stream, bool succeeded) {
+    return spi_deinit_card();
+}
+
+static const io_ops io_spi_ops = {
+    .getSize = io_spi_get_size,
+    .read = io_spi_read,
+    .write = io_spi_write,
+    .close = io_spi_close
+};
+
+Result io_open_spi_save(io_stream** stream) {
+    if(stream == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    if(R_SUCCEEDED(res = spi_init_card()) && R_FAILED(res = io_open(stream, &io_spi_ops, NULL, 0, 0))) {
+        spi_deinit_card();
+    }
+
+    return res;
+}
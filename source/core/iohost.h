@@ -0,0 +1,168 @@
+#pragma once
+
+// Minimal libctru type, result and system call definitions, for building the portable core and the data operation
+// engine off-device with -DFBI_HOST. The calls are implemented on top of pthreads by the host target in host/.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef s32 Result;
+typedef u32 Handle;
+
+#define U64_MAX UINT64_MAX
+
+#define R_SUCCEEDED(res) ((res) >= 0)
+#define R_FAILED(res) ((res) < 0)
+#define R_LEVEL(res) (((res) >> 27) & 0x1F)
+#define R_MODULE(res) (((res) >> 10) & 0xFF)
+#define R_DESCRIPTION(res) ((res) & 0x3FF)
+
+#define MAKERESULT(level, summary, module, description) \
+    ((((level) & 0x1F) << 27) | (((summary) & 0x3F) << 21) | (((module) & 0xFF) << 10) | ((description) & 0x3FF))
+
+#define RL_FATAL 31
+#define RL_PERMANENT 27
+#define RL_TEMPORARY 26
+
+#define RS_OUTOFRESOURCE 3
+#define RS_NOTSUPPORTED 6
+#define RS_INVALIDARG 7
+#define RS_CANCELED 9
+#define RS_INTERNAL 11
+
+#define RM_SOC 28
+#define RM_HTTP 40
+#define RM_APPLICATION 254
+
+#define RD_OUT_OF_RANGE 1021
+#define RD_NOT_IMPLEMENTED 1012
+#define RD_OUT_OF_MEMORY 1011
+
+// Returned by svcWaitSynchronization and svcWaitSynchronizationN when the timeout expires.
+#define RES_TIMEOUT ((Result) 0x09401BFE)
+
+#define SYSCLOCK_ARM11 268111856
+#define CUR_THREAD_HANDLE 0xFFFF8000
+
+typedef u32 FS_MediaType;
+typedef u64 FS_Archive;
+
+typedef enum {
+    ARCHIVE_SDMC = 0x00000009
+} FS_ArchiveID;
+
+typedef enum {
+    PATH_INVALID = 0,
+    PATH_EMPTY = 1,
+    PATH_BINARY = 2,
+    PATH_ASCII = 3,
+    PATH_UTF16 = 4
+} FS_PathType;
+
+typedef struct {
+    FS_PathType type;
+    u32 size;
+    const void* data;
+} FS_Path;
+
+#define FS_OPEN_READ 0x1
+#define FS_OPEN_WRITE 0x2
+#define FS_OPEN_CREATE 0x4
+
+#define FS_ATTRIBUTE_DIRECTORY 0x1
+
+typedef struct {
+    u16 name[0x106];
+    u32 attributes;
+    u64 fileSize;
+} FS_DirectoryEntry;
+
+// Plain http:// only, over one socket per context.
+typedef struct {
+    Handle servhandle;
+    u32 httphandle;
+} httpcContext;
+
+typedef enum {
+    HTTPC_METHOD_GET = 0x1
+} HTTPC_RequestMethod;
+
+typedef enum {
+    HTTPC_KEEPALIVE_DISABLED = 0x0,
+    HTTPC_KEEPALIVE_ENABLED = 0x1
+} HTTPC_KeepAlive;
+
+#define SSLCOPT_DisableVerify 0x200
+
+#define HTTPC_RESULTCODE_DOWNLOADPENDING ((Result) 0xD840A02B)
+
+typedef enum {
+    RESET_ONESHOT = 0,
+    RESET_STICKY = 1,
+    RESET_PULSE = 2
+} ResetType;
+
+typedef struct Thread_tag* Thread;
+typedef void (*ThreadFunc)(void* arg);
+
+Result svcCreateEvent(Handle* event, ResetType resetType);
+Result svcSignalEvent(Handle event);
+Result svcClearEvent(Handle event);
+Result svcCreateMutex(Handle* mutex, bool initiallyLocked);
+Result svcReleaseMutex(Handle mutex);
+Result svcCreateSemaphore(Handle* semaphore, s32 initialCount, s32 maxCount);
+Result svcReleaseSemaphore(s32* count, Handle semaphore, s32 releaseCount);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcWaitSynchronizationN(s32* out, const Handle* handles, s32 handlesNum, bool waitAll, s64 nanoseconds);
+Result svcCloseHandle(Handle handle);
+Result svcGetThreadId(u32* threadId, Handle handle);
+void svcSleepThread(s64 nanoseconds);
+u64 svcGetSystemTick();
+
+Result svcGetThreadPriority(s32* out, Handle handle);
+
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stackSize, int prio, int coreId, bool detached);
+Result threadJoin(Thread thread, u64 timeoutNs);
+void threadFree(Thread thread);
+
+void* linearAlloc(size_t size);
+void linearFree(void* mem);
+
+u64 osGetTime();
+void aptSetSleepAllowed(bool allowed);
+
+// Archives are the working directory, which stands in for the SD card root.
+FS_Path fsMakePath(FS_PathType type, const void* path);
+Result FSUSER_OpenArchive(FS_Archive* archive, FS_ArchiveID id, FS_Path path);
+Result FSUSER_CloseArchive(FS_Archive archive);
+Result FSUSER_OpenFile(Handle* out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes);
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path);
+Result FSUSER_OpenDirectory(Handle* out, FS_Archive archive, FS_Path path);
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes);
+Result FSFILE_Read(Handle handle, u32* bytesRead, u64 offset, void* buffer, u32 size);
+Result FSFILE_Write(Handle handle, u32* bytesWritten, u64 offset, const void* buffer, u32 size, u32 flags);
+Result FSFILE_Close(Handle handle);
+Result FSDIR_Read(Handle handle, u32* entriesRead, u32 entryCount, FS_DirectoryEntry* entries);
+Result FSDIR_Close(Handle handle);
+ssize_t utf16_to_utf8(uint8_t* out, const uint16_t* in, size_t len);
+
+Result httpcOpenContext(httpcContext* context, HTTPC_RequestMethod method, const char* url, u32 useDefaultProxy);
+Result httpcCloseContext(httpcContext* context);
+Result httpcAddRequestHeaderField(httpcContext* context, const char* name, const char* value);
+Result httpcSetSSLOpt(httpcContext* context, u32 options);
+Result httpcSetKeepAlive(httpcContext* context, HTTPC_KeepAlive option);
+Result httpcBeginRequest(httpcContext* context);
+Result httpcGetResponseStatusCodeTimeout(httpcContext* context, u32* out, u64 timeout);
+Result httpcGetResponseHeader(httpcContext* context, const char* name, char* value, u32 valueBufferSize);
+Result httpcGetDownloadSizeState(httpcContext* context, u32* downloadedSize, u32* contentSize);
+Result httpcReceiveDataTimeout(httpcContext* context, u8* buffer, u32 size, u64 timeout);
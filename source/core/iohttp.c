@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#include <jansson.h>
+#endif
+
+#include "bandwidth.h"
+#include "http.h"
+#include "io.h"
+#include "stringutil.h"
+#include "../ui/error.h"
+
+#define IO_HTTP_URL_MAX 1024
+#define IO_HTTP_CURL_BUFFER_SIZE (64 * 1024)
+
+// Responses can only be consumed in order, so read offsets are ignored. Servers the system TLS stack can't talk to
+// are fetched through curl on a thread of its own, which hands each block it receives straight to the reader.
+typedef struct {
+    http_segmented download;
+
+    char url[IO_HTTP_URL_MAX];
+    u64 rangeStart;
+    Handle cancelEvent;
+    bandwidth_class cls;
+
+    Handle mutex;
+    Handle dataEvent;
+    Handle consumedEvent;
+    Thread thread;
+
+    u64 contentLength;
+    const u8* pending;
+    u32 pendingSize;
+    bool closing;
+    bool done;
+    Result result;
+} io_http_data;
+
+static Result io_http_curl_callback(void* userData, void* buffer, size_t size) {
+    io_http_data* http = (io_http_data*) userData;
+
+    Result res = 0;
+
+    svcWaitSynchronization(http->mutex, U64_MAX);
+
+    http->pending = (const u8*) buffer;
+    http->pendingSize = size;
+    svcSignalEvent(http->dataEvent);
+
+    while(http->pendingSize > 0 && !http->closing) {
+        svcReleaseMutex(http->mutex);
+        svcWaitSynchronization(http->consumedEvent, U64_MAX);
+        svcWaitSynchronization(http->mutex, U64_MAX);
+    }
+
+    if(http->closing) {
+        res = R_FBI_CANCELLED;
+    }
+
+    http->pending = NULL;
+    http->pendingSize = 0;
+
+    svcReleaseMutex(http->mutex);
+
+    return res;
+}
+
+static void io_http_curl_thread(void* arg) {
+    io_http_data* http = (io_http_data*) arg;
+
+    bandwidth_set_class(http->cls);
+
+    // The length is set before the first callback, so it is in place by the time anything can be read.
+    Result res = http_download_callback_ranged(http->url, http->rangeStart, IO_HTTP_CURL_BUFFER_SIZE, &http->contentLength, http, io_http_curl_callback);
+
+    svcWaitSynchronization(http->mutex, U64_MAX);
+
+    http->result = res;
+    http->done = true;
+
+    svcSignalEvent(http->dataEvent);
+    svcReleaseMutex(http->mutex);
+}
+
+// Waits for the curl thread to hand over a block or finish. Returns R_FBI_CANCELLED if the cancel event fires first.
+static Result io_http_curl_wait(io_http_data* http) {
+    svcWaitSynchronization(http->mutex, U64_MAX);
+
+    while(http->pendingSize == 0 && !http->done) {
+        svcReleaseMutex(http->mutex);
+
+        Handle handles[2] = {http->dataEvent, http->cancelEvent};
+        s32 index = 0;
+        svcWaitSynchronizationN(&index, handles, http->cancelEvent != 0 ? 2 : 1, false, U64_MAX);
+
+        if(index == 1) {
+            return R_FBI_CANCELLED;
+        }
+
+        svcWaitSynchronization(http->mutex, U64_MAX);
+    }
+
+    svcReleaseMutex(http->mutex);
+
+    return 0;
+}
+
+static Result io_http_curl_read(io_http_data* http, u32* bytesRead, void* buffer, u32 size) {
+    Result res = 0;
+
+    if(R_SUCCEEDED(res = io_http_curl_wait(http))) {
+        svcWaitSynchronization(http->mutex, U64_MAX);
+
+        if(http->pendingSize > 0) {
+            u32 copySize = http->pendingSize < size ? http->pendingSize : size;
+            memcpy(buffer, http->pending, copySize);
+
+            http->pending += copySize;
+            http->pendingSize -= copySize;
+
+            if(http->pendingSize == 0) {
+                svcSignalEvent(http->consumedEvent);
+            }
+
+            *bytesRead = copySize;
+        } else {
+            res = http->result;
+        }
+
+        svcReleaseMutex(http->mutex);
+    }
+
+    return res;
+}
+
+static void io_http_curl_close(io_http_data* http) {
+    svcWaitSynchronization(http->mutex, U64_MAX);
+    http->closing = true;
+    svcSignalEvent(http->consumedEvent);
+    svcReleaseMutex(http->mutex);
+
+    threadJoin(http->thread, U64_MAX);
+    threadFree(http->thread);
+}
+
+static Result io_http_curl_open(io_http_data* http) {
+    Result res = 0;
+
+    if(R_SUCCEEDED(res = svcCreateMutex(&http->mutex, false))) {
+        if(R_SUCCEEDED(res = svcCreateEvent(&http->dataEvent, RESET_ONESHOT))) {
+            if(R_SUCCEEDED(res = svcCreateEvent(&http->consumedEvent, RESET_ONESHOT))) {
+                if((http->thread = threadCreate(io_http_curl_thread, http, 0x10000, 0x18, 1, false)) != NULL) {
+                    // Response codes and range support are only known once the body starts or the request fails.
+                    if(R_SUCCEEDED(res = io_http_curl_wait(http))) {
+                        svcWaitSynchronization(http->mutex, U64_MAX);
+
+                        if(http->pendingSize == 0 && R_FAILED(http->result)) {
+                            res = http->result;
+                        }
+
+                        svcReleaseMutex(http->mutex);
+                    }
+
+                    if(R_FAILED(res)) {
+                        io_http_curl_close(http);
+                    }
+                } else {
+                    res = R_FBI_THREAD_CREATE_FAILED;
+                }
+
+                if(R_FAILED(res)) {
+                    svcCloseHandle(http->consumedEvent);
+                }
+            }
+
+            if(R_FAILED(res)) {
+                svcCloseHandle(http->dataEvent);
+            }
+        }
+
+        if(R_FAILED(res)) {
+            svcCloseHandle(http->mutex);
+        }
+    }
+
+    return res;
+}
+
+static Result io_http_get_size(io_stream* stream, u64* size) {
+    *size = stream->size;
+    return 0;
+}
+
+// Fills the buffer unless the body ends first, so the first block handed on is always a whole one.
+static Result io_http_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    io_http_data* http = (io_http_data*) stream->data;
+
+    Result res = 0;
+
+    u32 total = 0;
+    while(total < size) {
+        u32 currRead = 0;
+        if(http->download != NULL) {
+            res = http_segmented_read(http->download, &currRead, (u8*) buffer + total, size - total);
+        } else {
+            res = io_http_curl_read(http, &currRead, (u8*) buffer + total, size - total);
+        }
+
+        if(R_FAILED(res) || currRead == 0) {
+            break;
+        }
+
+        total += currRead;
+    }
+
+    *bytesRead = total;
+    return res;
+}
+
+static Result io_http_free(io_http_data* http) {
+    Result res = 0;
+
+    if(http->download != NULL) {
+        res = http_segmented_close(http->download);
+    } else {
+        io_http_curl_close(http);
+
+        svcCloseHandle(http->consumedEvent);
+        svcCloseHandle(http->dataEvent);
+        svcCloseHandle(http->mutex);
+    }
+
+    free(http);
+
+    return res;
+}
+
+static Result io_http_close(io_stream* stream, bool succeeded) {
+    return io_http_free((io_http_data*) stream->data);
+}
+
+static const io_ops io_http_ops = {
+    .getSize = io_http_get_size,
+    .read = io_http_read,
+    .write = NULL,
+    .close = io_http_close
+};
+
+Result io_open_http(io_stream** stream, const char* url, bool userAgent, u64 rangeStart, u32 maxConnections, Handle cancelEvent) {
+    if(stream == NULL || url == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    io_http_data* http = (io_http_data*) calloc(1, sizeof(io_http_data));
+    if(http == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    string_copy(http->url, url, sizeof(http->url));
+    http->rangeStart = rangeStart;
+    http->cancelEvent = cancelEvent;
+    http->cls = bandwidth_get_class();
+
+    Result res = 0;
+
+    u64 size = 0;
+    if(R_SUCCEEDED(res = http_segmented_open(&http->download, url, userAgent, rangeStart, maxConnections, cancelEvent))) {
+        http_segmented_get_size(http->download, &size);
+    } else if(res == R_HTTP_TLS_VERIFY_FAILED) {
+        http->download = NULL;
+
+        if(R_SUCCEEDED(res = io_http_curl_open(http))) {
+            size = http->contentLength;
+        }
+    }
+
+    if(R_FAILED(res)) {
+        free(http);
+    } else if(R_FAILED(res = io_open(stream, &io_http_ops, http, 0, size))) {
+        io_http_free(http);
+    }
+
+    return res;
+}
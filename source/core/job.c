@@ -0,0 +1,219 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include <jansson.h>
+
+#include "io.h"
+#include "job.h"
+#include "stringutil.h"
+#include "../ui/error.h"
+
+#define JOB_DEFAULT_BUFFER_SIZE (128 * 1024)
+#define JOB_LOG_LINE_MAX (JOB_PATH_MAX * 2 + 64)
+
+static const char* job_op_names[JOB_OP_COUNT] = {"install-cia", "install-url", "paste", "delete", "dump-nand", "export-save"};
+
+const char* job_op_name(job_op op) {
+    return op < JOB_OP_COUNT ? job_op_names[op] : "unknown";
+}
+
+static bool job_get_string(json_t* obj, const char* key, char* out, size_t size) {
+    json_t* val = json_object_get(obj, key);
+    if(!json_is_string(val)) {
+        return false;
+    }
+
+    string_copy(out, json_string_value(val), size);
+    return true;
+}
+
+static Result job_parse_step(job_step* step, json_t* obj) {
+    if(!json_is_object(obj)) {
+        return R_FBI_BAD_DATA;
+    }
+
+    char opName[32];
+    if(!job_get_string(obj, "op", opName, sizeof(opName))) {
+        return R_FBI_BAD_DATA;
+    }
+
+    u32 op = 0;
+    while(op < JOB_OP_COUNT && strcmp(opName, job_op_names[op]) != 0) {
+        op++;
+    }
+
+    if(op >= JOB_OP_COUNT) {
+        return R_FBI_BAD_DATA;
+    }
+
+    step->op = (job_op) op;
+
+    bool hasSrc = job_get_string(obj, "src", step->src, sizeof(step->src));
+    bool hasDst = job_get_string(obj, "dst", step->dst, sizeof(step->dst));
+
+    char media[16];
+    step->nand = job_get_string(obj, "media", media, sizeof(media)) && strcmp(media, "nand") == 0;
+
+    // Installs check content hashes unless the step opts out.
+    step->verify = !json_is_false(json_object_get(obj, "verify"));
+
+    switch(step->op) {
+        case JOB_OP_INSTALL_CIA:
+        case JOB_OP_INSTALL_URL:
+        case JOB_OP_DELETE:
+            return hasSrc ? 0 : R_FBI_BAD_DATA;
+        case JOB_OP_PASTE:
+            return hasSrc && hasDst ? 0 : R_FBI_BAD_DATA;
+        case JOB_OP_DUMP_NAND:
+        case JOB_OP_EXPORT_SAVE:
+            return hasDst ? 0 : R_FBI_BAD_DATA;
+        default:
+            return R_FBI_BAD_DATA;
+    }
+}
+
+Result job_parse(job* j, const char* text, size_t size) {
+    if(j == NULL || text == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    memset(j, 0, sizeof(*j));
+
+    Result res = 0;
+
+    json_error_t error;
+    json_t* json = json_loadb(text, size, 0, &error);
+    if(json != NULL) {
+        if(json_is_object(json)) {
+            if(!job_get_string(json, "name", j->name, sizeof(j->name))) {
+                string_copy(j->name, "job", sizeof(j->name));
+            }
+
+            json_t* bufferSize = json_object_get(json, "bufferSize");
+            j->bufferSize = json_is_integer(bufferSize) && json_integer_value(bufferSize) > 0 ? (u32) json_integer_value(bufferSize) : JOB_DEFAULT_BUFFER_SIZE;
+
+            json_t* steps = json_object_get(json, "steps");
+            if(json_is_array(steps) && json_array_size(steps) <= JOB_STEPS_MAX) {
+                for(u32 i = 0; i < json_array_size(steps) && R_SUCCEEDED(res); i++) {
+                    res = job_parse_step(&j->steps[i], json_array_get(steps, i));
+                    j->stepCount++;
+                }
+            } else {
+                res = R_FBI_BAD_DATA;
+            }
+        } else {
+            res = R_FBI_BAD_DATA;
+        }
+
+        json_decref(json);
+    } else {
+        res = R_FBI_PARSE_FAILED;
+    }
+
+    return res;
+}
+
+Result job_load(job* j, io_stream* stream) {
+    if(j == NULL || stream == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    u64 size = 0;
+    if(R_SUCCEEDED(res = io_get_size(stream, &size))) {
+        if(size <= JOB_FILE_SIZE_MAX) {
+            char* text = (char*) malloc((size_t) size);
+            if(text != NULL) {
+                u32 bytesRead = 0;
+                if(R_SUCCEEDED(res = io_read(stream, &bytesRead, text, 0, (u32) size))) {
+                    res = job_parse(j, text, bytesRead);
+                }
+
+                free(text);
+            } else {
+                res = R_FBI_OUT_OF_MEMORY;
+            }
+        } else {
+            res = R_FBI_OUT_OF_RANGE;
+        }
+    }
+
+    return res;
+}
+
+static void job_log(const job_backend* backend, void* data, const char* format, ...) {
+    if(backend->log == NULL) {
+        return;
+    }
+
+    char line[JOB_LOG_LINE_MAX];
+
+    va_list list;
+    va_start(list, format);
+    vsnprintf(line, sizeof(line), format, list);
+    va_end(list);
+
+    backend->log(data, line);
+}
+
+static u64 job_bytes_per_second(u64 bytes, u64 elapsedMs) {
+    return elapsedMs > 0 ? bytes * 1000 / elapsedMs : 0;
+}
+
+Result job_run(job* j, const job_backend* backend, void* data) {
+    if(j == NULL || backend == NULL || backend->now == NULL || backend->run == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result firstRes = 0;
+    u64 totalBytes = 0;
+
+    job_log(backend, data, "job %s: %lu step(s)", j->name, (unsigned long) j->stepCount);
+
+    u64 jobStart = backend->now(data);
+
+    for(j->currStep = 0; j->currStep < j->stepCount; j->currStep++) {
+        job_step* step = &j->steps[j->currStep];
+
+        if(backend->cancelled != NULL && backend->cancelled(data)) {
+            step->result = R_FBI_CANCELLED;
+        } else {
+            job_log(backend, data, "[%lu] %s %s%s%s", (unsigned long) j->currStep + 1, job_op_name(step->op), step->src, step->src[0] != '\0' && step->dst[0] != '\0' ? " -> " : "", step->dst);
+
+            u64 start = backend->now(data);
+
+            step->bytes = 0;
+            step->result = backend->run(data, j, step, &step->bytes);
+            step->elapsedMs = backend->now(data) - start;
+        }
+
+        if(R_SUCCEEDED(step->result)) {
+            totalBytes += step->bytes;
+
+            job_log(backend, data, "[%lu] ok: %llu bytes in %llu ms, %llu B/s", (unsigned long) j->currStep + 1,
+                    (unsigned long long) step->bytes, (unsigned long long) step->elapsedMs, (unsigned long long) job_bytes_per_second(step->bytes, step->elapsedMs));
+        } else {
+            if(R_SUCCEEDED(firstRes)) {
+                firstRes = step->result;
+            }
+
+            job_log(backend, data, "[%lu] failed: 0x%08lX after %llu ms", (unsigned long) j->currStep + 1, (unsigned long) (u32) step->result, (unsigned long long) step->elapsedMs);
+        }
+    }
+
+    j->elapsedMs = backend->now(data) - jobStart;
+
+    job_log(backend, data, "job %s: %s, %llu bytes in %llu ms, %llu B/s", j->name, R_SUCCEEDED(firstRes) ? "ok" : "failed",
+            (unsigned long long) totalBytes, (unsigned long long) j->elapsedMs, (unsigned long long) job_bytes_per_second(totalBytes, j->elapsedMs));
+
+    return firstRes;
+}
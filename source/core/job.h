@@ -0,0 +1,78 @@
+#pragma once
+
+// Job files describe a sequence of operations to run unattended, e.g. /fbi/jobs/nightly.json:
+//
+// {
+//     "name": "nightly",
+//     "bufferSize": 131072,
+//     "steps": [
+//         {"op": "install-url", "src": "https://example.com/title.cia", "media": "sd"},
+//         {"op": "install-cia", "src": "/cias/title.cia", "media": "nand", "verify": false},
+//         {"op": "paste", "src": "/data/a.bin", "dst": "/data/b.bin"},
+//         {"op": "delete", "src": "/data/b.bin"},
+//         {"op": "dump-nand", "dst": "/fbi/nand/bench.bin"},
+//         {"op": "export-save", "dst": "/fbi/save/card.sav"}
+//     ]
+// }
+
+#define JOB_NAME_MAX 64
+#define JOB_PATH_MAX 512
+#define JOB_STEPS_MAX 64
+#define JOB_FILE_SIZE_MAX (64 * 1024)
+
+typedef struct io_stream_s io_stream;
+
+typedef enum job_op_e {
+    JOB_OP_INSTALL_CIA,
+    JOB_OP_INSTALL_URL,
+    JOB_OP_PASTE,
+    JOB_OP_DELETE,
+    JOB_OP_DUMP_NAND,
+    JOB_OP_EXPORT_SAVE,
+    JOB_OP_COUNT
+} job_op;
+
+typedef struct job_step_s {
+    job_op op;
+    char src[JOB_PATH_MAX];
+    char dst[JOB_PATH_MAX];
+    bool nand;
+    bool verify;
+
+    Result result;
+    u64 bytes;
+    u64 elapsedMs;
+} job_step;
+
+typedef struct job_s {
+    char name[JOB_NAME_MAX];
+    u32 bufferSize;
+
+    u32 stepCount;
+    job_step steps[JOB_STEPS_MAX];
+
+    u32 currStep;
+    u64 elapsedMs;
+} job;
+
+typedef struct job_backend_s {
+    u64 (*now)(void* data);
+    Result (*run)(void* data, job* j, job_step* step, u64* bytes);
+    void (*log)(void* data, const char* line);
+    bool (*cancelled)(void* data);
+} job_backend;
+
+const char* job_op_name(job_op op);
+
+Result job_parse(job* j, const char* text, size_t size);
+Result job_load(job* j, io_stream* stream);
+
+// Runs every step in order, logging per-step timing and throughput. Failed steps don't stop the job;
+// the first failure is returned.
+Result job_run(job* j, const job_backend* backend, void* data);
+
+#ifdef FBI_HOST
+// Runs paste, delete and install-cia steps through the data operation engine, against a directory standing in
+// for the SD card; installs read the CIA into a discarding sink. The backend data is the root directory path.
+extern const job_backend job_host_backend;
+#endif
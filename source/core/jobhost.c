@@ -0,0 +1,138 @@
+#ifdef FBI_HOST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iohost.h"
+
+#include "io.h"
+#include "job.h"
+#include "../ui/error.h"
+#include "../ui/section/task/task.h"
+
+typedef struct {
+    const char* root;
+    job_step* step;
+
+    char src[JOB_PATH_MAX * 2];
+    char dst[JOB_PATH_MAX * 2];
+
+    data_op_data op;
+} job_host_data;
+
+static u64 job_host_now(void* data) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64) ts.tv_sec * 1000 + (u64) ts.tv_nsec / 1000000;
+}
+
+static void job_host_log(void* data, const char* line) {
+    printf("%s\n", line);
+}
+
+static Result job_host_sink_write(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    *bytesWritten = size;
+    return 0;
+}
+
+static const io_ops job_host_sink_ops = {
+    .getSize = NULL,
+    .read = NULL,
+    .write = job_host_sink_write,
+    .close = NULL
+};
+
+static Result job_host_is_src_directory(void* data, u32 index, bool* isDirectory) {
+    *isDirectory = false;
+    return 0;
+}
+
+static Result job_host_make_dst_directory(void* data, u32 index) {
+    return 0;
+}
+
+static Result job_host_open_src(void* data, u32 index, io_stream** stream) {
+    return io_open_posix(stream, ((job_host_data*) data)->src, "rb");
+}
+
+static Result job_host_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    job_host_data* hostData = (job_host_data*) data;
+
+    if(hostData->step->op == JOB_OP_INSTALL_CIA) {
+        return io_open(stream, &job_host_sink_ops, NULL, 0, 0);
+    }
+
+    return io_open_posix(stream, hostData->dst, "wb");
+}
+
+static Result job_host_delete(void* data, u32 index) {
+    return remove(((job_host_data*) data)->src) == 0 ? 0 : R_FBI_BAD_DATA;
+}
+
+static Result job_host_run(void* data, job* j, job_step* step, u64* bytes) {
+    if(step->op != JOB_OP_PASTE && step->op != JOB_OP_INSTALL_CIA && step->op != JOB_OP_DELETE) {
+        return R_FBI_NOT_IMPLEMENTED;
+    }
+
+    job_host_data* hostData = (job_host_data*) calloc(1, sizeof(job_host_data));
+    if(hostData == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    hostData->root = (const char*) data;
+    hostData->step = step;
+
+    snprintf(hostData->src, sizeof(hostData->src), "%s%s", hostData->root, step->src);
+    snprintf(hostData->dst, sizeof(hostData->dst), "%s%s", hostData->root, step->dst);
+
+    data_op_data* op = &hostData->op;
+
+    op->data = hostData;
+    op->total = 1;
+    op->bufferSize = j->bufferSize;
+    op->copyEmpty = true;
+
+    op->batch = true;
+    op->headless = true;
+
+    if(step->op == JOB_OP_DELETE) {
+        op->op = DATAOP_DELETE;
+        op->delete = job_host_delete;
+    } else {
+        op->op = DATAOP_COPY;
+        op->isSrcDirectory = job_host_is_src_directory;
+        op->makeDstDirectory = job_host_make_dst_directory;
+        op->openSrc = job_host_open_src;
+        op->openDst = job_host_open_dst;
+    }
+
+    Result res = task_data_op_run(op);
+
+    for(u32 phase = 0; phase < DATAOP_PHASE_COUNT; phase++) {
+        data_op_histogram* histogram = &op->histograms[phase];
+        if(histogram->count > 0) {
+            char line[128];
+            snprintf(line, sizeof(line), "  %s: %lu calls, %llu ms, p50 %llu us, p99 %llu us, max %llu us", task_trace_phase_name((data_op_phase) phase),
+                     (unsigned long) histogram->count, (unsigned long long) histogram->totalUs / 1000, (unsigned long long) task_trace_histogram_percentile(histogram, 50),
+                     (unsigned long long) task_trace_histogram_percentile(histogram, 99), (unsigned long long) histogram->maxUs);
+            job_host_log(hostData, line);
+        }
+    }
+
+    *bytes = op->currProcessed;
+
+    free(hostData);
+    return res;
+}
+
+const job_backend job_host_backend = {
+    .now = job_host_now,
+    .run = job_host_run,
+    .log = job_host_log,
+    .cancelled = NULL
+};
+
+#endif
@@ -0,0 +1,474 @@
+#include <string.h>
+
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include "jsonstream.h"
+#include "../ui/error.h"
+
+enum {
+    JSON_STATE_VALUE,
+    JSON_STATE_VALUE_OR_CLOSE,
+    JSON_STATE_KEY,
+    JSON_STATE_KEY_OR_CLOSE,
+    JSON_STATE_COLON,
+    JSON_STATE_AFTER_VALUE,
+    JSON_STATE_STRING,
+    JSON_STATE_STRING_ESCAPE,
+    JSON_STATE_STRING_UNICODE,
+    JSON_STATE_NUMBER,
+    JSON_STATE_LITERAL,
+    JSON_STATE_DONE
+};
+
+void json_stream_init(json_stream* stream, void* userData, json_stream_callback callback) {
+    memset(stream, 0, sizeof(*stream));
+
+    stream->userData = userData;
+    stream->callback = callback;
+    stream->state = JSON_STATE_VALUE;
+}
+
+static bool json_stream_is_space(u8 c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool json_stream_is_number_char(u8 c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static bool json_stream_is_number(const char* str) {
+    if(*str == '-') {
+        str++;
+    }
+
+    if(*str == '0') {
+        str++;
+    } else if(*str >= '1' && *str <= '9') {
+        while(*str >= '0' && *str <= '9') {
+            str++;
+        }
+    } else {
+        return false;
+    }
+
+    if(*str == '.') {
+        str++;
+
+        if(!(*str >= '0' && *str <= '9')) {
+            return false;
+        }
+
+        while(*str >= '0' && *str <= '9') {
+            str++;
+        }
+    }
+
+    if(*str == 'e' || *str == 'E') {
+        str++;
+
+        if(*str == '+' || *str == '-') {
+            str++;
+        }
+
+        if(!(*str >= '0' && *str <= '9')) {
+            return false;
+        }
+
+        while(*str >= '0' && *str <= '9') {
+            str++;
+        }
+    }
+
+    return *str == '\0';
+}
+
+static void json_stream_append(json_stream* stream, const void* data, u32 size) {
+    if(stream->tokenLength + size < JSON_STREAM_TOKEN_MAX) {
+        memcpy(stream->token + stream->tokenLength, data, size);
+        stream->tokenLength += size;
+    } else {
+        // Keep filling up to the limit; a partial trailing character is dropped when the token is emitted.
+        u32 room = JSON_STREAM_TOKEN_MAX - 1 - stream->tokenLength;
+        memcpy(stream->token + stream->tokenLength, data, room);
+        stream->tokenLength += room;
+    }
+}
+
+static void json_stream_append_codepoint(json_stream* stream, u32 codepoint) {
+    u8 utf8[4];
+    u32 size = 0;
+
+    if(codepoint < 0x80) {
+        utf8[size++] = (u8) codepoint;
+    } else if(codepoint < 0x800) {
+        utf8[size++] = (u8) (0xC0 | (codepoint >> 6));
+        utf8[size++] = (u8) (0x80 | (codepoint & 0x3F));
+    } else if(codepoint < 0x10000) {
+        utf8[size++] = (u8) (0xE0 | (codepoint >> 12));
+        utf8[size++] = (u8) (0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[size++] = (u8) (0x80 | (codepoint & 0x3F));
+    } else {
+        utf8[size++] = (u8) (0xF0 | (codepoint >> 18));
+        utf8[size++] = (u8) (0x80 | ((codepoint >> 12) & 0x3F));
+        utf8[size++] = (u8) (0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[size++] = (u8) (0x80 | (codepoint & 0x3F));
+    }
+
+    // Multi-byte characters are only ever added whole.
+    if(stream->tokenLength + size < JSON_STREAM_TOKEN_MAX) {
+        json_stream_append(stream, utf8, size);
+    }
+}
+
+// A high surrogate escape that isn't followed by a low one stands for nothing; replace it.
+static void json_stream_flush_surrogate(json_stream* stream) {
+    if(stream->highSurrogate != 0) {
+        json_stream_append_codepoint(stream, 0xFFFD);
+        stream->highSurrogate = 0;
+    }
+}
+
+// Drops a character left incomplete by the length limit.
+static void json_stream_trim_token(json_stream* stream) {
+    if(stream->tokenLength < JSON_STREAM_TOKEN_MAX - 4) {
+        return;
+    }
+
+    u32 start = stream->tokenLength;
+    while(start > 0 && stream->tokenLength - start < 4 && (stream->token[start - 1] & 0xC0) == 0x80) {
+        start--;
+    }
+
+    if(start > 0) {
+        u8 lead = (u8) stream->token[start - 1];
+        if(lead >= 0xC0 && stream->tokenLength - (start - 1) < (lead >= 0xF0 ? 4u : lead >= 0xE0 ? 3u : 2u)) {
+            stream->tokenLength = start - 1;
+        }
+    }
+}
+
+static Result json_stream_emit(json_stream* stream, json_stream_event event, const char* value, u32 length) {
+    return stream->callback(stream->userData, event, stream->depth, value, length);
+}
+
+static Result json_stream_emit_token(json_stream* stream, json_stream_event event) {
+    json_stream_trim_token(stream);
+    stream->token[stream->tokenLength] = '\0';
+
+    return json_stream_emit(stream, event, stream->token, stream->tokenLength);
+}
+
+static void json_stream_value_done(json_stream* stream) {
+    stream->state = stream->depth == 0 ? JSON_STATE_DONE : JSON_STATE_AFTER_VALUE;
+}
+
+static Result json_stream_open(json_stream* stream, u8 container) {
+    if(stream->depth >= JSON_STREAM_DEPTH_MAX) {
+        return R_FBI_PARSE_FAILED;
+    }
+
+    Result res = json_stream_emit(stream, container == '{' ? JSON_STREAM_OBJECT_START : JSON_STREAM_ARRAY_START, NULL, 0);
+
+    stream->containers[stream->depth++] = container;
+    stream->state = container == '{' ? JSON_STATE_KEY_OR_CLOSE : JSON_STATE_VALUE_OR_CLOSE;
+
+    return res;
+}
+
+static Result json_stream_close(json_stream* stream, u8 c) {
+    if(stream->depth == 0 || stream->containers[stream->depth - 1] != (c == '}' ? '{' : '[')) {
+        return R_FBI_PARSE_FAILED;
+    }
+
+    stream->depth--;
+    json_stream_value_done(stream);
+
+    return json_stream_emit(stream, c == '}' ? JSON_STREAM_OBJECT_END : JSON_STREAM_ARRAY_END, NULL, 0);
+}
+
+static Result json_stream_start_value(json_stream* stream, u8 c) {
+    stream->tokenLength = 0;
+
+    switch(c) {
+        case '{':
+        case '[':
+            return json_stream_open(stream, c);
+        case '"':
+            stream->tokenKey = false;
+            stream->state = JSON_STATE_STRING;
+            return 0;
+        case 't':
+            stream->literal = "true";
+            break;
+        case 'f':
+            stream->literal = "false";
+            break;
+        case 'n':
+            stream->literal = "null";
+            break;
+        default:
+            if(c == '-' || (c >= '0' && c <= '9')) {
+                stream->token[stream->tokenLength++] = (char) c;
+                stream->state = JSON_STATE_NUMBER;
+                return 0;
+            }
+
+            return R_FBI_PARSE_FAILED;
+    }
+
+    stream->literalPos = 1;
+    stream->state = JSON_STATE_LITERAL;
+    return 0;
+}
+
+static Result json_stream_end_number(json_stream* stream) {
+    stream->token[stream->tokenLength] = '\0';
+    if(!json_stream_is_number(stream->token)) {
+        return R_FBI_PARSE_FAILED;
+    }
+
+    json_stream_value_done(stream);
+    return json_stream_emit(stream, JSON_STREAM_NUMBER, stream->token, stream->tokenLength);
+}
+
+Result json_stream_feed(json_stream* stream, const void* data, u32 size) {
+    if(stream == NULL || (data == NULL && size > 0)) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    const u8* bytes = (const u8*) data;
+    u32 pos = 0;
+
+    while(pos < size && R_SUCCEEDED(res)) {
+        u8 c = bytes[pos];
+
+        switch(stream->state) {
+            case JSON_STATE_VALUE:
+            case JSON_STATE_VALUE_OR_CLOSE:
+                if(!json_stream_is_space(c)) {
+                    if(c == ']' && stream->state == JSON_STATE_VALUE_OR_CLOSE) {
+                        res = json_stream_close(stream, c);
+                    } else {
+                        res = json_stream_start_value(stream, c);
+                    }
+                }
+
+                pos++;
+                break;
+            case JSON_STATE_KEY:
+            case JSON_STATE_KEY_OR_CLOSE:
+                if(c == '"') {
+                    stream->tokenLength = 0;
+                    stream->tokenKey = true;
+                    stream->state = JSON_STATE_STRING;
+                } else if(c == '}' && stream->state == JSON_STATE_KEY_OR_CLOSE) {
+                    res = json_stream_close(stream, c);
+                } else if(!json_stream_is_space(c)) {
+                    res = R_FBI_PARSE_FAILED;
+                }
+
+                pos++;
+                break;
+            case JSON_STATE_COLON:
+                if(c == ':') {
+                    stream->state = JSON_STATE_VALUE;
+                } else if(!json_stream_is_space(c)) {
+                    res = R_FBI_PARSE_FAILED;
+                }
+
+                pos++;
+                break;
+            case JSON_STATE_AFTER_VALUE:
+                if(c == ',') {
+                    stream->state = stream->containers[stream->depth - 1] == '{' ? JSON_STATE_KEY : JSON_STATE_VALUE;
+                } else if(c == '}' || c == ']') {
+                    res = json_stream_close(stream, c);
+                } else if(!json_stream_is_space(c)) {
+                    res = R_FBI_PARSE_FAILED;
+                }
+
+                pos++;
+                break;
+            case JSON_STATE_STRING: {
+                // Copy plain runs in one go; only quotes, escapes and control characters need a closer look.
+                u32 end = pos;
+                while(end < size && bytes[end] != '"' && bytes[end] != '\\' && bytes[end] >= 0x20) {
+                    end++;
+                }
+
+                if(end > pos) {
+                    json_stream_flush_surrogate(stream);
+                    json_stream_append(stream, bytes + pos, end - pos);
+
+                    pos = end;
+                    break;
+                }
+
+                if(c == '"') {
+                    json_stream_flush_surrogate(stream);
+
+                    if(stream->tokenKey) {
+                        stream->state = JSON_STATE_COLON;
+                        res = json_stream_emit_token(stream, JSON_STREAM_KEY);
+                    } else {
+                        json_stream_value_done(stream);
+                        res = json_stream_emit_token(stream, JSON_STREAM_STRING);
+                    }
+                } else if(c == '\\') {
+                    stream->state = JSON_STATE_STRING_ESCAPE;
+                } else {
+                    res = R_FBI_PARSE_FAILED;
+                }
+
+                pos++;
+                break;
+            }
+            case JSON_STATE_STRING_ESCAPE: {
+                char escaped = 0;
+
+                switch(c) {
+                    case '"':
+                    case '\\':
+                    case '/':
+                        escaped = (char) c;
+                        break;
+                    case 'b':
+                        escaped = '\b';
+                        break;
+                    case 'f':
+                        escaped = '\f';
+                        break;
+                    case 'n':
+                        escaped = '\n';
+                        break;
+                    case 'r':
+                        escaped = '\r';
+                        break;
+                    case 't':
+                        escaped = '\t';
+                        break;
+                    case 'u':
+                        stream->escape = 0;
+                        stream->escapeDigits = 0;
+                        stream->state = JSON_STATE_STRING_UNICODE;
+                        break;
+                    default:
+                        res = R_FBI_PARSE_FAILED;
+                        break;
+                }
+
+                if(escaped != 0) {
+                    json_stream_flush_surrogate(stream);
+                    json_stream_append(stream, &escaped, 1);
+
+                    stream->state = JSON_STATE_STRING;
+                }
+
+                pos++;
+                break;
+            }
+            case JSON_STATE_STRING_UNICODE: {
+                u32 digit = 0;
+                if(c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if(c >= 'a' && c <= 'f') {
+                    digit = c - 'a' + 10;
+                } else if(c >= 'A' && c <= 'F') {
+                    digit = c - 'A' + 10;
+                } else {
+                    res = R_FBI_PARSE_FAILED;
+                    break;
+                }
+
+                stream->escape = (stream->escape << 4) | digit;
+
+                if(++stream->escapeDigits == 4) {
+                    u32 codepoint = stream->escape;
+
+                    if(stream->highSurrogate != 0 && codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                        json_stream_append_codepoint(stream, 0x10000 + ((stream->highSurrogate - 0xD800) << 10) + (codepoint - 0xDC00));
+                        stream->highSurrogate = 0;
+                    } else {
+                        json_stream_flush_surrogate(stream);
+
+                        if(codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                            stream->highSurrogate = (u16) codepoint;
+                        } else {
+                            json_stream_append_codepoint(stream, codepoint >= 0xDC00 && codepoint <= 0xDFFF ? 0xFFFD : codepoint);
+                        }
+                    }
+
+                    stream->state = JSON_STATE_STRING;
+                }
+
+                pos++;
+                break;
+            }
+            case JSON_STATE_NUMBER:
+                if(json_stream_is_number_char(c)) {
+                    if(stream->tokenLength + 1 < JSON_STREAM_TOKEN_MAX) {
+                        stream->token[stream->tokenLength++] = (char) c;
+                    } else {
+                        res = R_FBI_PARSE_FAILED;
+                    }
+
+                    pos++;
+                } else {
+                    // The terminating character belongs to whatever follows; look at it again.
+                    res = json_stream_end_number(stream);
+                }
+
+                break;
+            case JSON_STATE_LITERAL:
+                if(c != (u8) stream->literal[stream->literalPos]) {
+                    res = R_FBI_PARSE_FAILED;
+                    break;
+                }
+
+                if(stream->literal[++stream->literalPos] == '\0') {
+                    json_stream_value_done(stream);
+                    res = json_stream_emit(stream, stream->literal[0] == 't' ? JSON_STREAM_TRUE : stream->literal[0] == 'f' ? JSON_STREAM_FALSE : JSON_STREAM_NULL, NULL, 0);
+                }
+
+                pos++;
+                break;
+            case JSON_STATE_DONE:
+                if(!json_stream_is_space(c)) {
+                    res = R_FBI_PARSE_FAILED;
+                }
+
+                pos++;
+                break;
+            default:
+                res = R_FBI_PARSE_FAILED;
+                break;
+        }
+    }
+
+    return res;
+}
+
+Result json_stream_finish(json_stream* stream) {
+    if(stream == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    // A bare top-level number only ends with the input.
+    if(stream->state == JSON_STATE_NUMBER && stream->depth == 0) {
+        res = json_stream_end_number(stream);
+    }
+
+    if(R_SUCCEEDED(res) && stream->state != JSON_STATE_DONE) {
+        res = R_FBI_PARSE_FAILED;
+    }
+
+    return res;
+}
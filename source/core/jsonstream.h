@@ -0,0 +1,47 @@
+#pragma once
+
+#define JSON_STREAM_DEPTH_MAX 32
+#define JSON_STREAM_TOKEN_MAX 1024
+
+typedef enum json_stream_event_e {
+    JSON_STREAM_OBJECT_START,
+    JSON_STREAM_OBJECT_END,
+    JSON_STREAM_ARRAY_START,
+    JSON_STREAM_ARRAY_END,
+    JSON_STREAM_KEY,
+    JSON_STREAM_STRING,
+    JSON_STREAM_NUMBER,
+    JSON_STREAM_TRUE,
+    JSON_STREAM_FALSE,
+    JSON_STREAM_NULL
+} json_stream_event;
+
+// Depth is the number of containers enclosing the event; a container's start and end share the depth of the
+// container itself. Keys, strings and numbers are passed as null-terminated text, other events pass NULL.
+typedef Result (*json_stream_callback)(void* userData, json_stream_event event, u32 depth, const char* value, u32 length);
+
+typedef struct json_stream_s {
+    void* userData;
+    json_stream_callback callback;
+
+    u32 state;
+    u32 depth;
+    u8 containers[JSON_STREAM_DEPTH_MAX];
+
+    // Strings longer than the token buffer are cut short at a character boundary.
+    char token[JSON_STREAM_TOKEN_MAX];
+    u32 tokenLength;
+    bool tokenKey;
+    const char* literal;
+    u32 literalPos;
+
+    u32 escape;
+    u32 escapeDigits;
+    u16 highSurrogate;
+} json_stream;
+
+void json_stream_init(json_stream* stream, void* userData, json_stream_callback callback);
+// Fails with the callback's result if it returns one, or R_FBI_PARSE_FAILED on malformed input.
+Result json_stream_feed(json_stream* stream, const void* data, u32 size);
+// Fails unless exactly one complete top-level value was fed.
+Result json_stream_finish(json_stream* stream);
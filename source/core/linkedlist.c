@@ -240,6 +240,12 @@ void linked_list_iterate(linked_list* list, linked_list_iter* iter) {
     linked_list_iter_restart(iter);
 }
 
+void linked_list_iterate_from(linked_list* list, linked_list_iter* iter, unsigned int index) {
+    iter->list = list;
+    iter->curr = NULL;
+    iter->next = linked_list_get_node(list, index);
+}
+
 void linked_list_iter_restart(linked_list_iter* iter) {
     if(iter->list == NULL) {
         return;
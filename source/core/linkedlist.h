@@ -36,6 +36,7 @@ bool linked_list_remove_at(linked_list* list, unsigned int index);
 void linked_list_sort(linked_list* list, void* userData, int (*compare)(void* userData, const void* p1, const void* p2));
 
 void linked_list_iterate(linked_list* list, linked_list_iter* iter);
+void linked_list_iterate_from(linked_list* list, linked_list_iter* iter, unsigned int index);
 
 void linked_list_iter_restart(linked_list_iter* iter);
 bool linked_list_iter_has_next(linked_list_iter* iter);
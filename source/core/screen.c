@@ -2,11 +2,13 @@
 #include <malloc.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <3ds.h>
 #include <citro3d.h>
 
 #include "../stb_image/stb_image.h"
+#include "bufpool.h"
 #include "screen.h"
 #include "util.h"
 
@@ -52,6 +54,41 @@ static struct {
     u32 height;
 } textures[MAX_TEXTURES];
 
+// Icons are packed into shared sheets of fixed-size cells rather than each taking a texture of its own. Atlas IDs are
+// tagged so they can be told apart from texture IDs, and carry the cell's generation so that an ID whose cell has
+// since been evicted or reused simply stops drawing.
+#define ATLAS_SHEET_SIZE 256
+#define ATLAS_CELL_SIZE 48
+#define ATLAS_CELLS_PER_ROW (ATLAS_SHEET_SIZE / ATLAS_CELL_SIZE)
+#define ATLAS_CELLS_PER_SHEET (ATLAS_CELLS_PER_ROW * ATLAS_CELLS_PER_ROW)
+#define ATLAS_SHEETS_MAX 64
+
+#define ATLAS_ID_FLAG 0x80000000
+#define ATLAS_ID_CELL_BITS 5
+#define ATLAS_ID_SHEET_BITS 6
+#define ATLAS_ID_GENERATION_SHIFT (ATLAS_ID_CELL_BITS + ATLAS_ID_SHEET_BITS)
+#define ATLAS_ID_GENERATION_MASK 0xFFFFF
+
+typedef struct {
+    bool used;
+    u32 generation;
+    u32 width;
+    u32 height;
+    u32 lastDrawn;
+} atlas_cell;
+
+static struct {
+    C3D_Tex tex;
+    u32 used;
+    atlas_cell cells[ATLAS_CELLS_PER_SHEET];
+} atlas_sheets[ATLAS_SHEETS_MAX];
+
+// List tasks load icons from worker threads while the main thread draws and evicts them.
+static Handle atlas_mutex;
+
+static u32 frame_count;
+static C3D_Tex* bound_texture;
+
 static FILE* screen_open_resource(const char* path) {
     u32 realPathSize = strlen(path) + 17;
     char realPath[realPathSize];
@@ -102,6 +139,12 @@ void screen_init() {
 
     c3d_initialized = true;
 
+    Result res = 0;
+    if(R_FAILED(res = svcCreateMutex(&atlas_mutex, false))) {
+        util_panic("Failed to create texture atlas mutex: 0x%08lX", res);
+        return;
+    }
+
     u32 displayFlags = GX_TRANSFER_FLIP_VERT(0) | GX_TRANSFER_OUT_TILED(0) | GX_TRANSFER_RAW_COPY(0) | GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGB8) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB8) | GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO);
 
     target_top = C3D_RenderTargetCreate(TOP_SCREEN_HEIGHT, TOP_SCREEN_WIDTH, GPU_RB_RGB8, 0);
@@ -277,6 +320,19 @@ void screen_exit() {
         screen_unload_texture(id);
     }
 
+    for(u32 sheet = 0; sheet < ATLAS_SHEETS_MAX; sheet++) {
+        if(atlas_sheets[sheet].tex.data != NULL) {
+            C3D_TexDelete(&atlas_sheets[sheet].tex);
+        }
+    }
+
+    memset(atlas_sheets, 0, sizeof(atlas_sheets));
+
+    if(atlas_mutex != 0) {
+        svcCloseHandle(atlas_mutex);
+        atlas_mutex = 0;
+    }
+
     if(glyph_sheets != NULL) {
         free(glyph_sheets);
         glyph_sheets = NULL;
@@ -361,13 +417,15 @@ void screen_load_texture(u32 id, void* data, u32 size, u32 width, u32 height, GP
 
     u32 pixelSize = size / width / height;
 
-    u8* pow2Tex = linearAlloc(pow2Width * pow2Height * pixelSize);
+    u32 pow2Size = pow2Width * pow2Height * pixelSize;
+
+    u8* pow2Tex = bufpool_alloc(BUFPOOL_LINEAR, pow2Size);
     if(pow2Tex == NULL) {
         util_panic("Failed to allocate temporary texture buffer.");
         return;
     }
 
-    memset(pow2Tex, 0, pow2Width * pow2Height * pixelSize);
+    memset(pow2Tex, 0, pow2Size);
 
     for(u32 x = 0; x < width; x++) {
         for(u32 y = 0; y < height; y++) {
@@ -391,7 +449,9 @@ void screen_load_texture(u32 id, void* data, u32 size, u32 width, u32 height, GP
 
     C3D_TexSetFilter(&textures[id].tex, linearFilter ? GPU_LINEAR : GPU_NEAREST, GPU_NEAREST);
 
-    Result flushRes = GSPGPU_FlushDataCache(pow2Tex, pow2Width * pow2Height * pixelSize);
+    bound_texture = NULL;
+
+    Result flushRes = GSPGPU_FlushDataCache(pow2Tex, pow2Size);
     if(R_FAILED(flushRes)) {
         util_panic("Failed to flush buffer for texture ID \"%lu\": 0x%08lX", id, flushRes);
         return;
@@ -404,7 +464,7 @@ void screen_load_texture(u32 id, void* data, u32 size, u32 width, u32 height, GP
     textures[id].width = width;
     textures[id].height = height;
 
-    linearFree(pow2Tex);
+    bufpool_free(BUFPOOL_LINEAR, pow2Tex, pow2Size);
 }
 
 void screen_load_texture_file(u32 id, const char* path, bool linearFilter) {
@@ -485,13 +545,219 @@ void screen_load_texture_tiled(u32 id, void* tiledData, u32 size, u32 width, u32
     free(untiledData);
 }
 
+static atlas_cell* screen_get_atlas_cell(u32 id, u32* sheetOut, u32* cellOut) {
+    u32 cell = id & ((1 << ATLAS_ID_CELL_BITS) - 1);
+    u32 sheet = (id >> ATLAS_ID_CELL_BITS) & ((1 << ATLAS_ID_SHEET_BITS) - 1);
+    u32 generation = (id >> ATLAS_ID_GENERATION_SHIFT) & ATLAS_ID_GENERATION_MASK;
+
+    if(!(id & ATLAS_ID_FLAG) || cell >= ATLAS_CELLS_PER_SHEET || sheet >= ATLAS_SHEETS_MAX || atlas_sheets[sheet].tex.data == NULL) {
+        return NULL;
+    }
+
+    atlas_cell* atlasCell = &atlas_sheets[sheet].cells[cell];
+    if(!atlasCell->used || (atlasCell->generation & ATLAS_ID_GENERATION_MASK) != generation) {
+        return NULL;
+    }
+
+    if(sheetOut != NULL) {
+        *sheetOut = sheet;
+    }
+
+    if(cellOut != NULL) {
+        *cellOut = cell;
+    }
+
+    return atlasCell;
+}
+
+static void screen_free_atlas_cell(u32 sheet, u32 cell) {
+    atlas_cell* atlasCell = &atlas_sheets[sheet].cells[cell];
+
+    atlasCell->used = false;
+    atlasCell->generation++;
+
+    if(--atlas_sheets[sheet].used == 0) {
+        C3D_TexDelete(&atlas_sheets[sheet].tex);
+        memset(&atlas_sheets[sheet].tex, 0, sizeof(atlas_sheets[sheet].tex));
+
+        bound_texture = NULL;
+    }
+}
+
+static bool screen_find_atlas_cell(u32* sheetOut, u32* cellOut, GPU_TEXCOLOR format) {
+    u32 emptySheet = ATLAS_SHEETS_MAX;
+
+    for(u32 sheet = 0; sheet < ATLAS_SHEETS_MAX; sheet++) {
+        if(atlas_sheets[sheet].tex.data == NULL) {
+            if(emptySheet == ATLAS_SHEETS_MAX) {
+                emptySheet = sheet;
+            }
+
+            continue;
+        }
+
+        if(atlas_sheets[sheet].tex.fmt != format || atlas_sheets[sheet].used >= ATLAS_CELLS_PER_SHEET) {
+            continue;
+        }
+
+        for(u32 cell = 0; cell < ATLAS_CELLS_PER_SHEET; cell++) {
+            if(!atlas_sheets[sheet].cells[cell].used) {
+                *sheetOut = sheet;
+                *cellOut = cell;
+                return true;
+            }
+        }
+    }
+
+    if(emptySheet < ATLAS_SHEETS_MAX) {
+        C3D_Tex* tex = &atlas_sheets[emptySheet].tex;
+        if(C3D_TexInit(tex, ATLAS_SHEET_SIZE, ATLAS_SHEET_SIZE, format)) {
+            C3D_TexSetFilter(tex, GPU_NEAREST, GPU_NEAREST);
+
+            memset(tex->data, 0, tex->size);
+            GSPGPU_FlushDataCache(tex->data, tex->size);
+
+            *sheetOut = emptySheet;
+            *cellOut = 0;
+            return true;
+        }
+
+        memset(tex, 0, sizeof(*tex));
+    }
+
+    // Out of sheets or linear memory; evict whichever cell has gone longest without being drawn. Cells drawn in the
+    // last frame may still be in use by the GPU, so they are left alone.
+    u32 oldestSheet = ATLAS_SHEETS_MAX;
+    u32 oldestCell = 0;
+    u32 oldestAge = 1;
+
+    for(u32 sheet = 0; sheet < ATLAS_SHEETS_MAX; sheet++) {
+        if(atlas_sheets[sheet].tex.data == NULL || atlas_sheets[sheet].tex.fmt != format) {
+            continue;
+        }
+
+        for(u32 cell = 0; cell < ATLAS_CELLS_PER_SHEET; cell++) {
+            u32 age = frame_count - atlas_sheets[sheet].cells[cell].lastDrawn;
+            if(atlas_sheets[sheet].cells[cell].used && age > oldestAge) {
+                oldestSheet = sheet;
+                oldestCell = cell;
+                oldestAge = age;
+            }
+        }
+    }
+
+    if(oldestSheet == ATLAS_SHEETS_MAX) {
+        return false;
+    }
+
+    atlas_cell* atlasCell = &atlas_sheets[oldestSheet].cells[oldestCell];
+    atlasCell->used = false;
+    atlasCell->generation++;
+    atlas_sheets[oldestSheet].used--;
+
+    *sheetOut = oldestSheet;
+    *cellOut = oldestCell;
+    return true;
+}
+
+u32 screen_load_texture_atlas(void* data, u32 size, u32 width, u32 height, GPU_TEXCOLOR format, bool tiled) {
+    u32 pixelSize = width > 0 && height > 0 ? size / width / height : 0;
+
+    bool fits = width <= ATLAS_CELL_SIZE && height <= ATLAS_CELL_SIZE && pixelSize >= 2 && pixelSize <= 4;
+    if(fits) {
+        svcWaitSynchronization(atlas_mutex, U64_MAX);
+    }
+
+    u32 sheet = 0;
+    u32 cell = 0;
+    if(!fits || !screen_find_atlas_cell(&sheet, &cell, format)) {
+        if(fits) {
+            svcReleaseMutex(atlas_mutex);
+        }
+
+        u32 id = screen_allocate_free_texture();
+
+        if(tiled) {
+            screen_load_texture_tiled(id, data, size, width, height, format, false);
+        } else {
+            screen_load_texture(id, data, size, width, height, format, false);
+        }
+
+        return id;
+    }
+
+    C3D_Tex* tex = &atlas_sheets[sheet].tex;
+
+    u32 cellX = (cell % ATLAS_CELLS_PER_ROW) * ATLAS_CELL_SIZE;
+    u32 cellY = (cell / ATLAS_CELLS_PER_ROW) * ATLAS_CELL_SIZE;
+
+    // Sheets are written in place, already tiled and flipped the way screen_load_texture's transfer would leave them.
+    for(u32 x = 0; x < width; x++) {
+        for(u32 y = 0; y < height; y++) {
+            u32 dataPos = (tiled ? screen_tiled_texture_index(x, y, width, height) : y * width + x) * pixelSize;
+            u32 texPos = screen_tiled_texture_index(cellX + x, ATLAS_SHEET_SIZE - 1 - (cellY + y), ATLAS_SHEET_SIZE, ATLAS_SHEET_SIZE) * pixelSize;
+
+            for(u32 i = 0; i < pixelSize; i++) {
+                ((u8*) tex->data)[texPos + i] = ((u8*) data)[dataPos + i];
+            }
+        }
+    }
+
+    u32 rowSize = ATLAS_SHEET_SIZE * 8 * pixelSize;
+    GSPGPU_FlushDataCache((u8*) tex->data + (ATLAS_SHEET_SIZE - cellY - ATLAS_CELL_SIZE) / 8 * rowSize, ATLAS_CELL_SIZE / 8 * rowSize);
+
+    atlas_cell* atlasCell = &atlas_sheets[sheet].cells[cell];
+    atlasCell->used = true;
+    atlasCell->width = width;
+    atlasCell->height = height;
+    atlasCell->lastDrawn = frame_count;
+
+    atlas_sheets[sheet].used++;
+
+    u32 id = ATLAS_ID_FLAG | ((atlasCell->generation & ATLAS_ID_GENERATION_MASK) << ATLAS_ID_GENERATION_SHIFT) | (sheet << ATLAS_ID_CELL_BITS) | cell;
+
+    svcReleaseMutex(atlas_mutex);
+
+    return id;
+}
+
+static void screen_unload_atlas_cell(u32 id) {
+    svcWaitSynchronization(atlas_mutex, U64_MAX);
+
+    u32 sheet = 0;
+    u32 cell = 0;
+    if(screen_get_atlas_cell(id, &sheet, &cell) != NULL) {
+        screen_free_atlas_cell(sheet, cell);
+    }
+
+    svcReleaseMutex(atlas_mutex);
+}
+
+bool screen_is_texture_loaded(u32 id) {
+    if(id & ATLAS_ID_FLAG) {
+        svcWaitSynchronization(atlas_mutex, U64_MAX);
+        bool loaded = screen_get_atlas_cell(id, NULL, NULL) != NULL;
+        svcReleaseMutex(atlas_mutex);
+
+        return loaded;
+    }
+
+    return id < MAX_TEXTURES && textures[id].tex.data != NULL;
+}
+
 void screen_unload_texture(u32 id) {
+    if(id & ATLAS_ID_FLAG) {
+        screen_unload_atlas_cell(id);
+        return;
+    }
+
     if(id >= MAX_TEXTURES) {
         util_panic("Attempted to unload invalid texture ID \"%lu\".", id);
         return;
     }
 
     C3D_TexDelete(&textures[id].tex);
+    bound_texture = NULL;
 
     textures[id].allocated = false;
     textures[id].width = 0;
@@ -499,6 +765,24 @@ void screen_unload_texture(u32 id) {
 }
 
 void screen_get_texture_size(u32* width, u32* height, u32 id) {
+    if(id & ATLAS_ID_FLAG) {
+        svcWaitSynchronization(atlas_mutex, U64_MAX);
+
+        atlas_cell* atlasCell = screen_get_atlas_cell(id, NULL, NULL);
+
+        if(width) {
+            *width = atlasCell != NULL ? atlasCell->width : 0;
+        }
+
+        if(height) {
+            *height = atlasCell != NULL ? atlasCell->height : 0;
+        }
+
+        svcReleaseMutex(atlas_mutex);
+
+        return;
+    }
+
     if(id >= MAX_TEXTURES) {
         util_panic("Attempted to get size of invalid texture ID \"%lu\".", id);
         return;
@@ -542,6 +826,9 @@ void screen_begin_frame() {
         util_panic("Failed to begin frame.");
         return;
     }
+
+    frame_count++;
+    bound_texture = NULL;
 }
 
 void screen_end_frame() {
@@ -557,29 +844,56 @@ void screen_select(gfxScreen_t screen) {
     C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, shaderInstanceGetUniformLocation(program.vertexShader, "projection"), screen == GFX_TOP ? &projection_top : &projection_bottom);
 }
 
-void screen_draw_texture(u32 id, float x, float y, float width, float height) {
-    if(id >= MAX_TEXTURES) {
-        util_panic("Attempted to draw invalid texture ID \"%lu\".", id);
-        return;
-    }
-
-    if(textures[id].tex.data == NULL) {
-        return;
+// Consecutive draws from the same texture or atlas sheet skip rebinding it.
+static void screen_bind_texture(C3D_Tex* tex) {
+    if(bound_texture != tex) {
+        C3D_TexBind(0, tex);
+        bound_texture = tex;
     }
+}
 
+static void screen_draw_texture_region(C3D_Tex* tex, float x, float y, float width, float height, float tx1, float ty1, float tx2, float ty2) {
     if(base_alpha != 0xFF) {
         screen_set_blend(base_alpha << 24, false, true);
     }
 
-    C3D_TexBind(0, &textures[id].tex);
-    screen_draw_quad(x, y, x + width, y + height, 0, 0, (float) textures[id].width / (float) textures[id].tex.width, (float) textures[id].height / (float) textures[id].tex.height);
+    screen_bind_texture(tex);
+    screen_draw_quad(x, y, x + width, y + height, tx1, ty1, tx2, ty2);
 
     if(base_alpha != 0xFF) {
         screen_set_blend(0, false, false);
     }
 }
 
-void screen_draw_texture_crop(u32 id, float x, float y, float width, float height) {
+static void screen_draw_atlas_cell(u32 id, float x, float y, float width, float height, bool crop) {
+    svcWaitSynchronization(atlas_mutex, U64_MAX);
+
+    u32 sheet = 0;
+    u32 cell = 0;
+    atlas_cell* atlasCell = screen_get_atlas_cell(id, &sheet, &cell);
+    if(atlasCell == NULL) {
+        svcReleaseMutex(atlas_mutex);
+        return;
+    }
+
+    atlasCell->lastDrawn = frame_count;
+
+    float cellX = (float) ((cell % ATLAS_CELLS_PER_ROW) * ATLAS_CELL_SIZE);
+    float cellY = (float) ((cell / ATLAS_CELLS_PER_ROW) * ATLAS_CELL_SIZE);
+    float srcWidth = crop ? width : (float) atlasCell->width;
+    float srcHeight = crop ? height : (float) atlasCell->height;
+
+    screen_draw_texture_region(&atlas_sheets[sheet].tex, x, y, width, height, cellX / ATLAS_SHEET_SIZE, cellY / ATLAS_SHEET_SIZE, (cellX + srcWidth) / ATLAS_SHEET_SIZE, (cellY + srcHeight) / ATLAS_SHEET_SIZE);
+
+    svcReleaseMutex(atlas_mutex);
+}
+
+void screen_draw_texture(u32 id, float x, float y, float width, float height) {
+    if(id & ATLAS_ID_FLAG) {
+        screen_draw_atlas_cell(id, x, y, width, height, false);
+        return;
+    }
+
     if(id >= MAX_TEXTURES) {
         util_panic("Attempted to draw invalid texture ID \"%lu\".", id);
         return;
@@ -589,16 +903,25 @@ void screen_draw_texture_crop(u32 id, float x, float y, float width, float heigh
         return;
     }
 
-    if(base_alpha != 0xFF) {
-        screen_set_blend(base_alpha << 24, false, true);
+    screen_draw_texture_region(&textures[id].tex, x, y, width, height, 0, 0, (float) textures[id].width / (float) textures[id].tex.width, (float) textures[id].height / (float) textures[id].tex.height);
+}
+
+void screen_draw_texture_crop(u32 id, float x, float y, float width, float height) {
+    if(id & ATLAS_ID_FLAG) {
+        screen_draw_atlas_cell(id, x, y, width, height, true);
+        return;
     }
 
-    C3D_TexBind(0, &textures[id].tex);
-    screen_draw_quad(x, y, x + width, y + height, 0, 0, width / (float) textures[id].tex.width, height / (float) textures[id].tex.height);
+    if(id >= MAX_TEXTURES) {
+        util_panic("Attempted to draw invalid texture ID \"%lu\".", id);
+        return;
+    }
 
-    if(base_alpha != 0xFF) {
-        screen_set_blend(0, false, false);
+    if(textures[id].tex.data == NULL) {
+        return;
     }
+
+    screen_draw_texture_region(&textures[id].tex, x, y, width, height, 0, 0, width / (float) textures[id].tex.width, height / (float) textures[id].tex.height);
 }
 
 float screen_get_font_height(float scaleY) {
@@ -735,7 +1058,7 @@ static void screen_draw_string_internal(const char* text, float x, float y, floa
 
             if(data.sheetIndex != lastSheet) {
                 lastSheet = data.sheetIndex;
-                C3D_TexBind(0, &glyph_sheets[lastSheet]);
+                screen_bind_texture(&glyph_sheets[lastSheet]);
             }
 
             for(u32 i = 0; i < num; i++) {
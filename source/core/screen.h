@@ -58,6 +58,7 @@
 #define COLOR_INSTALLED 9
 #define COLOR_NOT_INSTALLED 10
 
+#ifndef FBI_HOST
 void screen_init();
 void screen_exit();
 void screen_set_base_alpha(u8 alpha);
@@ -66,6 +67,11 @@ void screen_load_texture(u32 id, void* data, u32 size, u32 width, u32 height, GP
 void screen_load_texture_file(u32 id, const char* path, bool linearFilter);
 void screen_load_texture_tiled(u32 id, void* tiledData, u32 size, u32 width, u32 height, GPU_TEXCOLOR format, bool linearFilter);
 void screen_load_texture_screenshot(u32 id, gfxScreen_t screen);
+// Packs an icon into a shared atlas sheet, evicting the least recently drawn icon if needed; icons that don't fit a
+// cell get a texture of their own. Returns an ID usable anywhere a texture ID is.
+u32 screen_load_texture_atlas(void* data, u32 size, u32 width, u32 height, GPU_TEXCOLOR format, bool tiled);
+// False once an atlas icon has been evicted.
+bool screen_is_texture_loaded(u32 id);
 void screen_unload_texture(u32 id);
 void screen_get_texture_size(u32* width, u32* height, u32 id);
 void screen_begin_frame();
@@ -77,4 +83,5 @@ float screen_get_font_height(float scaleY);
 void screen_get_string_size(float* width, float* height, const char* text, float scaleX, float scaleY);
 void screen_get_string_size_wrap(float* width, float* height, const char* text, float scaleX, float scaleY, float wrapX);
 void screen_draw_string(const char* text, float x, float y, float scaleX, float scaleY, u32 colorId, bool centerLines);
-void screen_draw_string_wrap(const char* text, float x, float y, float scaleX, float scaleY, u32 colorId, bool centerLines, float wrapX);
\ No newline at end of file
+void screen_draw_string_wrap(const char* text, float x, float y, float scaleX, float scaleY, u32 colorId, bool centerLines, float wrapX);
+#endif
@@ -0,0 +1,167 @@
+#include <string.h>
+
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include "sha256.h"
+
+static const u32 sha256_k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define S0(x) (ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define S1(x) (ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define G0(x) (ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define G1(x) (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+
+#define CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+
+// The message schedule is kept as a rolling 16-word window rather than the full 64 words.
+#define ROUND(a, b, c, d, e, f, g, h, i, w) do { \
+    u32 t1 = (h) + S1(e) + CH(e, f, g) + sha256_k[i] + (w); \
+    u32 t2 = S0(a) + MAJ(a, b, c); \
+    (d) += t1; \
+    (h) = t1 + t2; \
+} while(0)
+
+#define SCHEDULE(w, i) ((w)[(i) & 15] += G1((w)[((i) - 2) & 15]) + (w)[((i) - 7) & 15] + G0((w)[((i) - 15) & 15]))
+
+static void sha256_transform(u32* state, const u8* data, u32 blocks) {
+    u32 w[16];
+
+    while(blocks-- > 0) {
+        for(u32 i = 0; i < 16; i++) {
+            w[i] = ((u32) data[i * 4] << 24) | ((u32) data[i * 4 + 1] << 16) | ((u32) data[i * 4 + 2] << 8) | (u32) data[i * 4 + 3];
+        }
+
+        u32 a = state[0];
+        u32 b = state[1];
+        u32 c = state[2];
+        u32 d = state[3];
+        u32 e = state[4];
+        u32 f = state[5];
+        u32 g = state[6];
+        u32 h = state[7];
+
+        for(u32 i = 0; i < 64; i += 8) {
+            if(i >= 16) {
+                for(u32 j = i; j < i + 8; j++) {
+                    SCHEDULE(w, j);
+                }
+            }
+
+            ROUND(a, b, c, d, e, f, g, h, i + 0, w[(i + 0) & 15]);
+            ROUND(h, a, b, c, d, e, f, g, i + 1, w[(i + 1) & 15]);
+            ROUND(g, h, a, b, c, d, e, f, i + 2, w[(i + 2) & 15]);
+            ROUND(f, g, h, a, b, c, d, e, i + 3, w[(i + 3) & 15]);
+            ROUND(e, f, g, h, a, b, c, d, i + 4, w[(i + 4) & 15]);
+            ROUND(d, e, f, g, h, a, b, c, i + 5, w[(i + 5) & 15]);
+            ROUND(c, d, e, f, g, h, a, b, i + 6, w[(i + 6) & 15]);
+            ROUND(b, c, d, e, f, g, h, a, i + 7, w[(i + 7) & 15]);
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+
+        data += SHA256_BLOCK_SIZE;
+    }
+}
+
+void sha256_init(sha256_context* context) {
+    context->state[0] = 0x6A09E667;
+    context->state[1] = 0xBB67AE85;
+    context->state[2] = 0x3C6EF372;
+    context->state[3] = 0xA54FF53A;
+    context->state[4] = 0x510E527F;
+    context->state[5] = 0x9B05688C;
+    context->state[6] = 0x1F83D9AB;
+    context->state[7] = 0x5BE0CD19;
+
+    context->length = 0;
+    context->blockUsed = 0;
+}
+
+void sha256_update(sha256_context* context, const void* data, u32 size) {
+    const u8* bytes = (const u8*) data;
+
+    context->length += size;
+
+    if(context->blockUsed > 0) {
+        u32 copySize = SHA256_BLOCK_SIZE - context->blockUsed;
+        if(copySize > size) {
+            copySize = size;
+        }
+
+        memcpy(&context->block[context->blockUsed], bytes, copySize);
+        context->blockUsed += copySize;
+
+        bytes += copySize;
+        size -= copySize;
+
+        if(context->blockUsed < SHA256_BLOCK_SIZE) {
+            return;
+        }
+
+        sha256_transform(context->state, context->block, 1);
+        context->blockUsed = 0;
+    }
+
+    u32 blocks = size / SHA256_BLOCK_SIZE;
+    if(blocks > 0) {
+        sha256_transform(context->state, bytes, blocks);
+
+        bytes += blocks * SHA256_BLOCK_SIZE;
+        size -= blocks * SHA256_BLOCK_SIZE;
+    }
+
+    if(size > 0) {
+        memcpy(context->block, bytes, size);
+        context->blockUsed = size;
+    }
+}
+
+void sha256_final(sha256_context* context, u8* hash) {
+    u64 bits = context->length * 8;
+
+    context->block[context->blockUsed++] = 0x80;
+
+    if(context->blockUsed > SHA256_BLOCK_SIZE - 8) {
+        memset(&context->block[context->blockUsed], 0, SHA256_BLOCK_SIZE - context->blockUsed);
+        sha256_transform(context->state, context->block, 1);
+        context->blockUsed = 0;
+    }
+
+    memset(&context->block[context->blockUsed], 0, SHA256_BLOCK_SIZE - 8 - context->blockUsed);
+
+    for(u32 i = 0; i < 8; i++) {
+        context->block[SHA256_BLOCK_SIZE - 1 - i] = (u8) (bits >> (i * 8));
+    }
+
+    sha256_transform(context->state, context->block, 1);
+
+    for(u32 i = 0; i < 8; i++) {
+        hash[i * 4] = (u8) (context->state[i] >> 24);
+        hash[i * 4 + 1] = (u8) (context->state[i] >> 16);
+        hash[i * 4 + 2] = (u8) (context->state[i] >> 8);
+        hash[i * 4 + 3] = (u8) context->state[i];
+    }
+}
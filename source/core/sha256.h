@@ -0,0 +1,16 @@
+#pragma once
+
+#define SHA256_HASH_SIZE 0x20
+#define SHA256_BLOCK_SIZE 0x40
+
+typedef struct sha256_context_s {
+    u32 state[8];
+    u64 length;
+
+    u8 block[SHA256_BLOCK_SIZE];
+    u32 blockUsed;
+} sha256_context;
+
+void sha256_init(sha256_context* context);
+void sha256_update(sha256_context* context, const void* data, u32 size);
+void sha256_final(sha256_context* context, u8* hash);
@@ -1,6 +1,10 @@
 #include <string.h>
 
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
 #include <3ds.h>
+#endif
 
 #include "stringutil.h"
 
@@ -0,0 +1,174 @@
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FBI_HOST
+#include "iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include "titledbcache.h"
+#include "../ui/error.h"
+
+Result titledb_cache_open(titledb_cache* cache, const void* buffer, u32 size) {
+    if(cache == NULL || buffer == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(size < sizeof(titledb_cache_header)) {
+        return R_FBI_BAD_DATA;
+    }
+
+    const titledb_cache_header* header = (const titledb_cache_header*) buffer;
+    if(header->magic != TITLEDB_CACHE_MAGIC || header->version != TITLEDB_CACHE_VERSION) {
+        return R_FBI_BAD_DATA;
+    }
+
+    u64 recordsSize = (u64) header->recordCount * sizeof(titledb_cache_record);
+    if(sizeof(titledb_cache_header) + recordsSize + header->stringsSize != size) {
+        return R_FBI_BAD_DATA;
+    }
+
+    // A terminated table means every in-range offset yields a terminated string.
+    const char* strings = (const char*) buffer + sizeof(titledb_cache_header) + recordsSize;
+    if(header->stringsSize == 0 || strings[header->stringsSize - 1] != '\0') {
+        return R_FBI_BAD_DATA;
+    }
+
+    const titledb_cache_record* records = (const titledb_cache_record*) ((const u8*) buffer + sizeof(titledb_cache_header));
+    for(u32 i = 0; i < header->recordCount; i++) {
+        if(records[i].name >= header->stringsSize || records[i].description >= header->stringsSize || records[i].author >= header->stringsSize) {
+            return R_FBI_BAD_DATA;
+        }
+    }
+
+    cache->records = records;
+    cache->recordCount = header->recordCount;
+    cache->strings = strings;
+    cache->stringsSize = header->stringsSize;
+
+    return 0;
+}
+
+const char* titledb_cache_get_string(const titledb_cache* cache, u32 offset) {
+    return offset < cache->stringsSize ? cache->strings + offset : "";
+}
+
+void titledb_cache_builder_init(titledb_cache_builder* builder) {
+    memset(builder, 0, sizeof(*builder));
+}
+
+static Result titledb_cache_builder_add_string(titledb_cache_builder* builder, u32* offset, const char* str) {
+    u32 length = strlen(str) + 1;
+
+    if(builder->stringsSize + length > builder->stringsCapacity) {
+        u32 newCapacity = builder->stringsCapacity > 0 ? builder->stringsCapacity : 16 * 1024;
+        while(builder->stringsSize + length > newCapacity) {
+            newCapacity *= 2;
+        }
+
+        char* newStrings = (char*) realloc(builder->strings, newCapacity);
+        if(newStrings == NULL) {
+            return R_FBI_OUT_OF_MEMORY;
+        }
+
+        builder->strings = newStrings;
+        builder->stringsCapacity = newCapacity;
+    }
+
+    memcpy(builder->strings + builder->stringsSize, str, length);
+
+    *offset = builder->stringsSize;
+    builder->stringsSize += length;
+
+    return 0;
+}
+
+Result titledb_cache_builder_add(titledb_cache_builder* builder, u64 titleId, u64 size, const char* name, const char* description, const char* author) {
+    if(builder == NULL || name == NULL || description == NULL || author == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(builder->recordCount >= builder->recordCapacity) {
+        u32 newCapacity = builder->recordCapacity > 0 ? builder->recordCapacity * 2 : 256;
+
+        titledb_cache_record* newRecords = (titledb_cache_record*) realloc(builder->records, newCapacity * sizeof(titledb_cache_record));
+        if(newRecords == NULL) {
+            return R_FBI_OUT_OF_MEMORY;
+        }
+
+        builder->records = newRecords;
+        builder->recordCapacity = newCapacity;
+    }
+
+    titledb_cache_record* record = &builder->records[builder->recordCount];
+    memset(record, 0, sizeof(*record));
+
+    record->titleId = titleId;
+    record->size = size;
+
+    Result res = 0;
+    if(R_SUCCEEDED(res = titledb_cache_builder_add_string(builder, &record->name, name))
+       && R_SUCCEEDED(res = titledb_cache_builder_add_string(builder, &record->description, description))
+       && R_SUCCEEDED(res = titledb_cache_builder_add_string(builder, &record->author, author))) {
+        builder->recordCount++;
+    }
+
+    return res;
+}
+
+Result titledb_cache_builder_finish(titledb_cache_builder* builder, void** buffer, u32* size) {
+    if(builder == NULL || buffer == NULL || size == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    // An empty catalogue still gets a terminator, so every snapshot has a non-empty string table.
+    if(builder->stringsSize == 0) {
+        u32 offset = 0;
+
+        Result res = titledb_cache_builder_add_string(builder, &offset, "");
+        if(R_FAILED(res)) {
+            return res;
+        }
+    }
+
+    u32 recordsSize = builder->recordCount * sizeof(titledb_cache_record);
+    u32 totalSize = sizeof(titledb_cache_header) + recordsSize + builder->stringsSize;
+    if(totalSize > TITLEDB_CACHE_SIZE_MAX) {
+        return R_FBI_OUT_OF_RANGE;
+    }
+
+    u8* data = (u8*) malloc(totalSize);
+    if(data == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    titledb_cache_header* header = (titledb_cache_header*) data;
+    header->magic = TITLEDB_CACHE_MAGIC;
+    header->version = TITLEDB_CACHE_VERSION;
+    header->recordCount = builder->recordCount;
+    header->stringsSize = builder->stringsSize;
+
+    if(recordsSize > 0) {
+        memcpy(data + sizeof(titledb_cache_header), builder->records, recordsSize);
+    }
+
+    memcpy(data + sizeof(titledb_cache_header) + recordsSize, builder->strings, builder->stringsSize);
+
+    *buffer = data;
+    *size = totalSize;
+
+    return 0;
+}
+
+void titledb_cache_builder_free(titledb_cache_builder* builder) {
+    if(builder == NULL) {
+        return;
+    }
+
+    free(builder->records);
+    free(builder->strings);
+
+    titledb_cache_builder_init(builder);
+}
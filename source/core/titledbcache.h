@@ -0,0 +1,53 @@
+#pragma once
+
+// Binary snapshot of the TitleDB catalogue: a header, fixed-size records and a table of null-terminated strings the
+// records refer to by offset. Values are stored little-endian.
+
+#define TITLEDB_CACHE_MAGIC 0x42445446 // "FTDB"
+#define TITLEDB_CACHE_VERSION 1
+
+#define TITLEDB_CACHE_SIZE_MAX (16 * 1024 * 1024)
+
+typedef struct titledb_cache_header_s {
+    u32 magic;
+    u32 version;
+    u32 recordCount;
+    u32 stringsSize;
+} titledb_cache_header;
+
+typedef struct titledb_cache_record_s {
+    u64 titleId;
+    u64 size;
+    u32 name;
+    u32 description;
+    u32 author;
+    u32 reserved;
+} titledb_cache_record;
+
+// A snapshot as laid out in memory; records and strings point into the buffer it was opened from.
+typedef struct titledb_cache_s {
+    const titledb_cache_record* records;
+    u32 recordCount;
+    const char* strings;
+    u32 stringsSize;
+} titledb_cache;
+
+typedef struct titledb_cache_builder_s {
+    titledb_cache_record* records;
+    u32 recordCount;
+    u32 recordCapacity;
+
+    char* strings;
+    u32 stringsSize;
+    u32 stringsCapacity;
+} titledb_cache_builder;
+
+// Fails with R_FBI_BAD_DATA unless the whole buffer is a snapshot of the current version.
+Result titledb_cache_open(titledb_cache* cache, const void* buffer, u32 size);
+const char* titledb_cache_get_string(const titledb_cache* cache, u32 offset);
+
+void titledb_cache_builder_init(titledb_cache_builder* builder);
+Result titledb_cache_builder_add(titledb_cache_builder* builder, u64 titleId, u64 size, const char* name, const char* description, const char* author);
+// Lays the snapshot out in a single malloc'd buffer, ready to be written in one go.
+Result titledb_cache_builder_finish(titledb_cache_builder* builder, void** buffer, u32* size);
+void titledb_cache_builder_free(titledb_cache_builder* builder);
@@ -6,6 +6,7 @@
 
 #include <3ds.h>
 
+#include "bandwidth.h"
 #include "util.h"
 #include "../ui/error.h"
 #include "../ui/list.h"
@@ -736,6 +737,10 @@ Result util_http_read(httpcContext* context, u32* bytesRead, void* buffer, u32 s
     }
 
     Result res = httpcDownloadData(context, buffer, size, bytesRead);
+    if(R_SUCCEEDED(res) || res == HTTPC_RESULTCODE_DOWNLOADPENDING) {
+        bandwidth_consume(bytesRead != NULL ? *bytesRead : 0);
+    }
+
     return res != HTTPC_RESULTCODE_DOWNLOADPENDING ? res : 0;
 }
 
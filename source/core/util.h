@@ -1,7 +1,9 @@
 #pragma once
 
+#ifndef FBI_HOST
 int util_get_line_length(PrintConsole* console, const char* str);
 int util_get_lines(PrintConsole* console, const char* str);
+#endif
 
 typedef struct {
     u16 shortDescription[0x40];
@@ -43,6 +45,7 @@ typedef struct {
 
 void util_panic(const char* s, ...);
 
+#ifndef FBI_HOST
 FS_Path* util_make_path_utf8(const char* path);
 void util_free_path_utf8(FS_Path* path);
 
@@ -94,3 +97,4 @@ Result util_http_open_ranged(httpcContext* context, u32* responseCode, const cha
 Result util_http_get_size(httpcContext* context, u32* size);
 Result util_http_read(httpcContext* context, u32* bytesRead, void* buffer, u32 size);
 Result util_http_close(httpcContext* context);
+#endif
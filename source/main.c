@@ -2,8 +2,12 @@
 #include <malloc.h>
 
 #include <3ds.h>
+#include <jansson.h>
 
+#include "core/bandwidth.h"
+#include "core/bufpool.h"
 #include "core/clipboard.h"
+#include "core/http.h"
 #include "core/screen.h"
 #include "core/util.h"
 #include "ui/error.h"
@@ -147,8 +151,11 @@ void init() {
 
     AM_InitializeExternalTitleDatabase(false);
 
+    bufpool_init();
     screen_init();
     ui_init();
+    bandwidth_init();
+    http_init();
     task_init();
 }
 
@@ -156,8 +163,11 @@ void cleanup() {
     clipboard_clear();
 
     task_exit();
+    http_exit();
+    bandwidth_exit();
     ui_exit();
     screen_exit();
+    bufpool_exit();
 
     if(old_time_limit != UINT32_MAX) {
         APT_SetAppCpuTimeLimit(old_time_limit);
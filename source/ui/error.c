@@ -502,6 +502,10 @@ static const char* description_to_string(Result res) {
                     return "Bad data";
                 case R_FBI_HTTP_TOO_MANY_REDIRECTS:
                     return "Too many redirects";
+                case R_FBI_HTTP_RANGE_NOT_SUPPORTED:
+                    return "Server does not support ranged requests";
+                case R_FBI_HASH_MISMATCH:
+                    return "Content hash mismatch";
                 default:
                     if(res >= R_FBI_HTTP_ERROR_BASE && res < R_FBI_HTTP_ERROR_END) {
                         switch(res - R_FBI_HTTP_ERROR_BASE) {
@@ -696,6 +700,10 @@ static const char* description_to_string(Result res) {
     }
 }
 
+const char* error_get_description(Result result) {
+    return description_to_string(result);
+}
+
 typedef struct {
     char fullText[4096];
     void* data;
@@ -710,7 +718,7 @@ static void error_draw_top(ui_view* view, void* data, float x1, float y1, float
     }
 }
 
-static void error_onresponse(ui_view* view, void* data, u32 response) {
+static void error_onresponse(ui_view* view, void* data, bool response) {
     free(data);
 }
 
@@ -1,7 +1,5 @@
 #pragma once
 
-#define R_FBI_INVALID_ARGUMENT MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_APPLICATION, 1)
-#define R_FBI_CANCELLED MAKERESULT(RL_PERMANENT, RS_CANCELED, RM_APPLICATION, 2)
 #define R_FBI_SKIPPED MAKERESULT(RL_PERMANENT, RS_NOTSUPPORTED, RM_APPLICATION, 3)
 
 #define R_FBI_CANCELLED MAKERESULT(RL_PERMANENT, RS_CANCELED, RM_APPLICATION, 4)
@@ -19,6 +17,9 @@
 #define R_FBI_CURL_ERROR_BASE (R_FBI_CURL_INIT_FAILED + 1)
 #define R_FBI_CURL_ERROR_END (R_FBI_CURL_ERROR_BASE + 100)
 
+#define R_FBI_HTTP_RANGE_NOT_SUPPORTED R_FBI_CURL_ERROR_END
+#define R_FBI_HASH_MISMATCH (R_FBI_HTTP_RANGE_NOT_SUPPORTED + 1)
+
 #define R_FBI_NOT_IMPLEMENTED MAKERESULT(RL_PERMANENT, RS_INTERNAL, RM_APPLICATION, RD_NOT_IMPLEMENTED)
 #define R_FBI_OUT_OF_MEMORY MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY)
 #define R_FBI_OUT_OF_RANGE MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_APPLICATION, RD_OUT_OF_RANGE)
@@ -29,3 +30,4 @@ ui_view* error_display(void* data, void (*drawTop)(ui_view* view, void* data, fl
 ui_view* error_display_res(void* data, void (* drawTop)(ui_view* view, void* data, float x1, float y1, float x2, float y2), Result result, const char* text, ...);
 ui_view* error_display_errno(void* data, void (*drawTop)(ui_view* view, void* data, float x1, float y1, float x2, float y2), int err, const char* text, ...);
 void error_panic(const char* s, ...);
+const char* error_get_description(Result result);
@@ -1,13 +1,70 @@
 #include <malloc.h>
+#include <string.h>
 
 #include <3ds.h>
 
 #include "error.h"
 #include "list.h"
 #include "ui.h"
+#include "section/task/task.h"
 #include "../core/screen.h"
 #include "../core/linkedlist.h"
 
+// Rows beyond the screen to load ahead of scrolling, and how far away icons are kept before being released.
+#define LIST_ICON_PREFETCH_ROWS 16
+#define LIST_ICON_RELEASE_ROWS 64
+
+#define LIST_ICON_UPLOADS_PER_FRAME 8
+#define LIST_ICON_FAILED_MAX 64
+
+typedef struct list_icon_loader_s list_icon_loader;
+
+typedef struct list_icon_request_s {
+    struct list_icon_request_s* next;
+    list_icon_loader* loader;
+
+    // Only used to recognize the item on the main thread; it may be freed while the request is running.
+    list_item* item;
+    u64 key[LIST_ICON_KEY_MAX / sizeof(u64)];
+    u32 hash;
+
+    volatile bool cancel;
+    bool wanted;
+
+    list_icon icon;
+    Result result;
+} list_icon_request;
+
+struct list_icon_loader_s {
+    const list_icon_ops* ops;
+    u32 connections;
+
+    Handle mutex;
+    // Requests submitted but not yet done; idleEvent is signaled while there are none.
+    u32 pending;
+    Handle idleEvent;
+    list_icon_request* decodeHead;
+    list_icon_request* decodeTail;
+    bool decoding;
+    list_icon_request* doneHead;
+    list_icon_request* doneTail;
+
+    // Main thread only.
+    list_icon_request* active[LIST_ICON_CONNECTIONS_MAX];
+    u32 activeCount;
+
+    // The rows visited last frame; only they and the current window are looked at again.
+    u32 lastSize;
+    u32 lastKeepFirst;
+    u32 lastKeepLast;
+
+    struct {
+        list_item* item;
+        u32 hash;
+    } failed[LIST_ICON_FAILED_MAX];
+    u32 failedNext;
+};
+
 typedef struct {
     void* data;
     linked_list items;
@@ -20,6 +77,7 @@ typedef struct {
     u64 nextActionTime;
     void (*update)(ui_view* view, void* data, linked_list* items, list_item* selected, bool selectedTouched);
     void (*drawTop)(ui_view* view, void* data, float x1, float y1, float x2, float y2, list_item* selected);
+    list_icon_loader* icons;
 } list_data;
 
 static void list_validate(list_data* listData, float by1, float by2) {
@@ -85,6 +143,378 @@ static void list_validate(list_data* listData, float by1, float by2) {
     }
 }
 
+static u32 list_icon_hash(const void* key) {
+    const u8* bytes = (const u8*) key;
+
+    u32 hash = 2166136261u;
+    for(u32 i = 0; i < LIST_ICON_KEY_MAX; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void list_icon_push_done(list_icon_loader* loader, list_icon_request* request) {
+    request->next = NULL;
+    if(loader->doneTail != NULL) {
+        loader->doneTail->next = request;
+    } else {
+        loader->doneHead = request;
+    }
+
+    loader->doneTail = request;
+
+    if(--loader->pending == 0) {
+        svcSignalEvent(loader->idleEvent);
+    }
+}
+
+static void list_icon_finish(list_icon_loader* loader, list_icon_request* request) {
+    svcWaitSynchronization(loader->mutex, U64_MAX);
+    list_icon_push_done(loader, request);
+    svcReleaseMutex(loader->mutex);
+}
+
+static list_icon_request* list_icon_pop_decode(list_icon_loader* loader) {
+    list_icon_request* request = loader->decodeHead;
+    if(request != NULL) {
+        if((loader->decodeHead = request->next) == NULL) {
+            loader->decodeTail = NULL;
+        }
+    } else {
+        loader->decoding = false;
+    }
+
+    return request;
+}
+
+static void list_icon_decode_thread(void* arg) {
+    list_icon_loader* loader = (list_icon_loader*) arg;
+
+    svcWaitSynchronization(loader->mutex, U64_MAX);
+    list_icon_request* request = list_icon_pop_decode(loader);
+    svcReleaseMutex(loader->mutex);
+
+    while(request != NULL) {
+        if(request->cancel || task_is_quit_all()) {
+            request->result = R_FBI_CANCELLED;
+        } else {
+            request->result = loader->ops->decode(&request->icon);
+        }
+
+        // Finishing and taking the next request happen under one lock; once the last request is handed back, the
+        // loader may be freed.
+        svcWaitSynchronization(loader->mutex, U64_MAX);
+        list_icon_push_done(loader, request);
+        request = list_icon_pop_decode(loader);
+        svcReleaseMutex(loader->mutex);
+    }
+}
+
+static void list_icon_fetch_thread(void* arg) {
+    list_icon_request* request = (list_icon_request*) arg;
+    list_icon_loader* loader = request->loader;
+
+    // Requests for rows scrolled away before their turn came are dropped here.
+    if(request->cancel || task_is_quit_all()) {
+        request->result = R_FBI_CANCELLED;
+    } else {
+        request->result = loader->ops->fetch(request->key, &request->icon);
+    }
+
+    if(R_SUCCEEDED(request->result) && loader->ops->decode != NULL) {
+        svcWaitSynchronization(loader->mutex, U64_MAX);
+
+        request->next = NULL;
+        if(loader->decodeTail != NULL) {
+            loader->decodeTail->next = request;
+        } else {
+            loader->decodeHead = request;
+        }
+
+        loader->decodeTail = request;
+
+        bool start = !loader->decoding;
+        loader->decoding = true;
+
+        svcReleaseMutex(loader->mutex);
+
+        if(start && R_FAILED(task_submit("List icon decode", TASK_PRIORITY_ICON, list_icon_decode_thread, loader))) {
+            list_icon_decode_thread(loader);
+        }
+
+        return;
+    }
+
+    list_icon_finish(loader, request);
+}
+
+static bool list_icon_has_failed(list_icon_loader* loader, list_item* item, u32 hash) {
+    for(u32 i = 0; i < LIST_ICON_FAILED_MAX; i++) {
+        if(loader->failed[i].item == item && loader->failed[i].hash == hash) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static list_icon_request* list_icon_find_active(list_icon_loader* loader, list_item* item) {
+    for(u32 i = 0; i < loader->activeCount; i++) {
+        if(loader->active[i]->item == item) {
+            return loader->active[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void list_icon_remove_active(list_icon_loader* loader, list_icon_request* request) {
+    for(u32 i = 0; i < loader->activeCount; i++) {
+        if(loader->active[i] == request) {
+            loader->active[i] = loader->active[--loader->activeCount];
+            break;
+        }
+    }
+}
+
+static list_icon_request* list_icon_take_done(list_icon_loader* loader, u32 max) {
+    list_icon_request* batch = NULL;
+    list_icon_request* batchTail = NULL;
+
+    svcWaitSynchronization(loader->mutex, U64_MAX);
+
+    for(u32 i = 0; i < max && loader->doneHead != NULL; i++) {
+        list_icon_request* request = loader->doneHead;
+        if((loader->doneHead = request->next) == NULL) {
+            loader->doneTail = NULL;
+        }
+
+        request->next = NULL;
+        if(batchTail != NULL) {
+            batchTail->next = request;
+        } else {
+            batch = request;
+        }
+
+        batchTail = request;
+    }
+
+    svcReleaseMutex(loader->mutex);
+
+    return batch;
+}
+
+static void list_icon_free_request(list_icon_request* request) {
+    if(request->icon.data != NULL) {
+        free(request->icon.data);
+    }
+
+    free(request);
+}
+
+static void list_icon_update(list_data* listData, float by1, float by2) {
+    list_icon_loader* loader = listData->icons;
+    if(loader == NULL) {
+        return;
+    }
+
+    task_set_icon_limit(loader->connections + (loader->ops->decode != NULL ? 1 : 0));
+
+    float fontHeight = screen_get_font_height(0.5f);
+
+    u32 first = (u32) (listData->scrollPos / fontHeight);
+    u32 last = first + (u32) ((by2 - by1) / fontHeight) + 1;
+
+    u32 wantFirst = first > LIST_ICON_PREFETCH_ROWS ? first - LIST_ICON_PREFETCH_ROWS : 0;
+    u32 wantLast = last + LIST_ICON_PREFETCH_ROWS;
+    u32 keepFirst = first > LIST_ICON_RELEASE_ROWS ? first - LIST_ICON_RELEASE_ROWS : 0;
+    u32 keepLast = last + LIST_ICON_RELEASE_ROWS;
+
+    u64 key[LIST_ICON_KEY_MAX / sizeof(u64)];
+
+    // Textures are created here, on the main thread, a few per frame.
+    list_icon_request* request = list_icon_take_done(loader, LIST_ICON_UPLOADS_PER_FRAME);
+    while(request != NULL) {
+        list_icon_request* next = request->next;
+
+        list_icon_remove_active(loader, request);
+
+        int index = linked_list_index_of(&listData->items, request->item);
+        if(index >= 0 && (u32) index >= keepFirst && (u32) index < keepLast) {
+            if(R_SUCCEEDED(request->result)) {
+                memset(key, 0, sizeof(key));
+                loader->ops->getKey(request->item, key);
+
+                u32* texture = loader->ops->getTexture(request->item);
+                if(texture != NULL && *texture == 0 && memcmp(key, request->key, sizeof(key)) == 0) {
+                    list_icon* icon = &request->icon;
+                    *texture = screen_load_texture_atlas(icon->data, icon->size, icon->width, icon->height, icon->format, icon->tiled);
+                }
+            } else if(request->result != R_FBI_CANCELLED) {
+                loader->failed[loader->failedNext].item = request->item;
+                loader->failed[loader->failedNext].hash = request->hash;
+                loader->failedNext = (loader->failedNext + 1) % LIST_ICON_FAILED_MAX;
+            }
+        }
+
+        list_icon_free_request(request);
+        request = next;
+    }
+
+    for(u32 i = 0; i < loader->activeCount; i++) {
+        loader->active[i]->wanted = false;
+    }
+
+    // Visible rows are requested before the margin around them.
+    list_item* visible[LIST_ICON_CONNECTIONS_MAX];
+    u32 visibleCount = 0;
+    list_item* margin[LIST_ICON_CONNECTIONS_MAX];
+    u32 marginCount = 0;
+
+    u32 slots = loader->connections - loader->activeCount;
+
+    // Rows that left the window since last frame still need their textures released. A change in size may have
+    // moved rows anywhere, so that costs one pass over the whole list.
+    u32 size = linked_list_size(&listData->items);
+
+    u32 visitFirst = 0;
+    u32 visitLast = size;
+    if(size == loader->lastSize) {
+        visitFirst = keepFirst < loader->lastKeepFirst ? keepFirst : loader->lastKeepFirst;
+        visitLast = keepLast > loader->lastKeepLast ? keepLast : loader->lastKeepLast;
+    }
+
+    loader->lastSize = size;
+    loader->lastKeepFirst = keepFirst;
+    loader->lastKeepLast = keepLast;
+
+    linked_list_iter iter;
+    linked_list_iterate_from(&listData->items, &iter, visitFirst);
+
+    for(u32 index = visitFirst; index < visitLast && linked_list_iter_has_next(&iter); index++) {
+        list_item* item = (list_item*) linked_list_iter_next(&iter);
+
+        u32* texture = loader->ops->getTexture(item);
+        if(texture == NULL) {
+            continue;
+        }
+
+        // Atlas icons can be evicted behind the list's back; those are loaded again like any other.
+        if(*texture != 0 && !screen_is_texture_loaded(*texture)) {
+            *texture = 0;
+        }
+
+        if(index < keepFirst || index >= keepLast) {
+            if(*texture != 0) {
+                screen_unload_texture(*texture);
+                *texture = 0;
+            }
+
+            continue;
+        }
+
+        if(*texture != 0 || index < wantFirst || index >= wantLast) {
+            continue;
+        }
+
+        list_icon_request* active = list_icon_find_active(loader, item);
+        if(active != NULL) {
+            active->wanted = true;
+            continue;
+        }
+
+        bool isVisible = index >= first && index < last;
+        if((isVisible ? visibleCount : marginCount) >= slots) {
+            continue;
+        }
+
+        memset(key, 0, sizeof(key));
+        loader->ops->getKey(item, key);
+        if(list_icon_has_failed(loader, item, list_icon_hash(key))) {
+            continue;
+        }
+
+        if(isVisible) {
+            visible[visibleCount++] = item;
+        } else {
+            margin[marginCount++] = item;
+        }
+    }
+
+    for(u32 i = 0; i < loader->activeCount; i++) {
+        if(!loader->active[i]->wanted) {
+            loader->active[i]->cancel = true;
+        }
+    }
+
+    for(u32 i = 0; i < visibleCount + marginCount && loader->activeCount < loader->connections; i++) {
+        list_item* item = i < visibleCount ? visible[i] : margin[i - visibleCount];
+
+        list_icon_request* newRequest = (list_icon_request*) calloc(1, sizeof(list_icon_request));
+        if(newRequest == NULL) {
+            break;
+        }
+
+        newRequest->loader = loader;
+        newRequest->item = item;
+        loader->ops->getKey(item, newRequest->key);
+        newRequest->hash = list_icon_hash(newRequest->key);
+        newRequest->wanted = true;
+
+        svcWaitSynchronization(loader->mutex, U64_MAX);
+        if(loader->pending++ == 0) {
+            svcClearEvent(loader->idleEvent);
+        }
+        svcReleaseMutex(loader->mutex);
+
+        if(R_FAILED(task_submit("List icon", TASK_PRIORITY_ICON, list_icon_fetch_thread, newRequest))) {
+            svcWaitSynchronization(loader->mutex, U64_MAX);
+            if(--loader->pending == 0) {
+                svcSignalEvent(loader->idleEvent);
+            }
+            svcReleaseMutex(loader->mutex);
+
+            free(newRequest);
+            break;
+        }
+
+        loader->active[loader->activeCount++] = newRequest;
+    }
+}
+
+static void list_icon_destroy(list_icon_loader* loader) {
+    for(u32 i = 0; i < loader->activeCount; i++) {
+        loader->active[i]->cancel = true;
+    }
+
+    // Running requests point back at the loader; the last one to finish signals idleEvent.
+    while(svcWaitSynchronization(loader->idleEvent, 100000000) != 0) {
+        // Queued jobs are dropped on exit and never finish; the loader is left to them.
+        if(task_is_quit_all()) {
+            return;
+        }
+    }
+
+    // The worker that signaled may not have released the mutex yet.
+    svcWaitSynchronization(loader->mutex, U64_MAX);
+    svcReleaseMutex(loader->mutex);
+
+    list_icon_request* request = list_icon_take_done(loader, UINT32_MAX);
+    while(request != NULL) {
+        list_icon_request* next = request->next;
+
+        list_icon_remove_active(loader, request);
+        list_icon_free_request(request);
+
+        request = next;
+    }
+
+    svcCloseHandle(loader->idleEvent);
+    svcCloseHandle(loader->mutex);
+    free(loader);
+}
+
 static void list_update(ui_view* view, void* data, float bx1, float by1, float bx2, float by2) {
     list_data* listData = (list_data*) data;
 
@@ -193,6 +623,8 @@ static void list_update(ui_view* view, void* data, float bx1, float by1, float b
         list_validate(listData, by1, by2);
     }
 
+    list_icon_update(listData, by1, by2);
+
     if(listData->update != NULL) {
         listData->update(view, listData->data, &listData->items, listData->selectedItem, selectedTouched);
     }
@@ -295,8 +727,46 @@ ui_view* list_display(const char* name, const char* info, void* data, void (*upd
     return view;
 }
 
+void list_set_icon_ops(ui_view* view, const list_icon_ops* ops, u32 connections) {
+    if(view == NULL || ops == NULL) {
+        return;
+    }
+
+    list_data* listData = (list_data*) view->data;
+    if(listData->icons != NULL) {
+        return;
+    }
+
+    list_icon_loader* loader = (list_icon_loader*) calloc(1, sizeof(list_icon_loader));
+    if(loader == NULL) {
+        return;
+    }
+
+    loader->ops = ops;
+    loader->connections = connections < 1 ? 1 : connections > LIST_ICON_CONNECTIONS_MAX ? LIST_ICON_CONNECTIONS_MAX : connections;
+
+    if(R_FAILED(svcCreateMutex(&loader->mutex, false))) {
+        free(loader);
+        return;
+    }
+
+    if(R_FAILED(svcCreateEvent(&loader->idleEvent, RESET_STICKY))) {
+        svcCloseHandle(loader->mutex);
+        free(loader);
+        return;
+    }
+
+    svcSignalEvent(loader->idleEvent);
+
+    listData->icons = loader;
+}
+
 void list_destroy(ui_view* view) {
     if(view != NULL) {
+        if(((list_data*) view->data)->icons != NULL) {
+            list_icon_destroy(((list_data*) view->data)->icons);
+        }
+
         linked_list_destroy(&((list_data*) view->data)->items);
 
         free(view->data);
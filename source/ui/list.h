@@ -2,6 +2,9 @@
 
 #define LIST_ITEM_NAME_MAX 512
 
+#define LIST_ICON_KEY_MAX 528
+#define LIST_ICON_CONNECTIONS_MAX 4
+
 typedef struct linked_list_s linked_list;
 typedef struct ui_view_s ui_view;
 
@@ -11,6 +14,29 @@ typedef struct list_item_s {
     void* data;
 } list_item;
 
+typedef struct list_icon_s {
+    void* data;
+    u32 size;
+    u32 width;
+    u32 height;
+    GPU_TEXCOLOR format;
+    bool tiled;
+} list_icon;
+
+// Icons are only loaded for rows on or near the screen, and released again once they are scrolled far away.
+typedef struct list_icon_ops_s {
+    // Returns the item's texture slot, or NULL if the item has no icon.
+    u32* (*getTexture)(list_item* item);
+    // Describes the icon to load in a LIST_ICON_KEY_MAX byte key, so that loading never touches the item itself.
+    void (*getKey)(list_item* item, void* key);
+    // Reads the icon into a malloc'd buffer; runs on a task worker.
+    Result (*fetch)(const void* key, list_icon* icon);
+    // Optional; turns fetched data into pixels, replacing the buffer. Runs on a single worker apart from the fetches.
+    Result (*decode)(list_icon* icon);
+} list_icon_ops;
+
 ui_view* list_display(const char* name, const char* info, void* data, void (*update)(ui_view* view, void* data, linked_list* items, list_item* selected, bool selectedTouched),
                                                                       void (*drawTop)(ui_view* view, void* data, float x1, float y1, float x2, float y2, list_item* selected));
-void list_destroy(ui_view* view);
\ No newline at end of file
+void list_destroy(ui_view* view);
+// Up to connections icons are fetched at once.
+void list_set_icon_ops(ui_view* view, const list_icon_ops* ops, u32 connections);
\ No newline at end of file
@@ -24,6 +24,8 @@ static list_item system_save_data = {"System Save Data", COLOR_TEXT, systemsaved
 static list_item titledb = {"TitleDB", COLOR_TEXT, titledb_open};
 static list_item remote_install = {"Remote Install", COLOR_TEXT, remoteinstall_open};
 static list_item update = {"Update", COLOR_TEXT, update_open};
+static list_item jobs = {"Run Jobs", COLOR_TEXT, jobs_open};
+static list_item task_metrics = {"Task Metrics", COLOR_TEXT, taskmetrics_open};
 
 static void mainmenu_draw_top(ui_view* view, void* data, float x1, float y1, float x2, float y2, list_item* selected) {
     u32 logoWidth;
@@ -63,6 +65,8 @@ static void mainmenu_update(ui_view* view, void* data, linked_list* items, list_
         linked_list_add(items, &titledb);
         linked_list_add(items, &remote_install);
         linked_list_add(items, &update);
+        linked_list_add(items, &jobs);
+        linked_list_add(items, &task_metrics);
     }
 }
 
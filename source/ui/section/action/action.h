@@ -29,6 +29,7 @@ void action_delete_dir_cias(linked_list* items, list_item* selected);
 void action_delete_dir_tickets(linked_list* items, list_item* selected);
 void action_new_folder(linked_list* items, list_item* selected);
 void action_paste_contents(linked_list* items, list_item* selected);
+void action_paste_contents_sync(linked_list* items, list_item* selected);
 void action_rename(linked_list* items, list_item* selected);
 
 void action_delete_pending_title(linked_list* items, list_item* selected);
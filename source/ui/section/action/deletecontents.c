@@ -1,5 +1,6 @@
 #include <malloc.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <3ds.h>
@@ -15,6 +16,8 @@
 #include "../../../core/screen.h"
 #include "../../../core/util.h"
 
+#define DELETE_BATCH_SIZE 32
+
 typedef struct {
     linked_list* items;
 
@@ -22,6 +25,9 @@ typedef struct {
     file_info* target;
 
     linked_list contents;
+    bool* deleted;
+
+    bool recursive;
 
     data_op_data deleteInfo;
 } delete_data;
@@ -37,17 +43,79 @@ static void action_delete_draw_top(ui_view* view, void* data, float x1, float y1
     }
 }
 
+// Fallback for archives without recursive delete support; removes a batch of entries at a time, bottom-up.
+static Result action_delete_walk(FS_Archive archive, const char* path) {
+    Result res = 0;
+
+    FS_DirectoryEntry* entries = (FS_DirectoryEntry*) calloc(DELETE_BATCH_SIZE, sizeof(FS_DirectoryEntry));
+    if(entries == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    FS_Path* fsPath = util_make_path_utf8(path);
+    if(fsPath != NULL) {
+        u32 entryCount = 0;
+        do {
+            // Entries are deleted with the directory closed, so each batch starts from a fresh handle.
+            Handle dirHandle = 0;
+            if(R_SUCCEEDED(res = FSUSER_OpenDirectory(&dirHandle, archive, *fsPath))) {
+                res = FSDIR_Read(dirHandle, &entryCount, DELETE_BATCH_SIZE, entries);
+                FSDIR_Close(dirHandle);
+            }
+
+            for(u32 i = 0; i < entryCount && R_SUCCEEDED(res); i++) {
+                char name[FILE_NAME_MAX] = {'\0'};
+                utf16_to_utf8((uint8_t*) name, entries[i].name, FILE_NAME_MAX - 1);
+
+                char childPath[FILE_PATH_MAX];
+                if(entries[i].attributes & FS_ATTRIBUTE_DIRECTORY) {
+                    snprintf(childPath, sizeof(childPath), "%s%s/", path, name);
+                    res = action_delete_walk(archive, childPath);
+                } else {
+                    snprintf(childPath, sizeof(childPath), "%s%s", path, name);
+
+                    FS_Path* childFsPath = util_make_path_utf8(childPath);
+                    if(childFsPath != NULL) {
+                        res = FSUSER_DeleteFile(archive, *childFsPath);
+
+                        util_free_path_utf8(childFsPath);
+                    } else {
+                        res = R_FBI_OUT_OF_MEMORY;
+                    }
+                }
+            }
+        } while(R_SUCCEEDED(res) && entryCount > 0);
+
+        if(R_SUCCEEDED(res)) {
+            res = FSUSER_DeleteDirectory(archive, *fsPath);
+        }
+
+        util_free_path_utf8(fsPath);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    free(entries);
+
+    return res;
+}
+
 static Result action_delete_delete(void* data, u32 index) {
     delete_data* deleteData = (delete_data*) data;
 
     Result res = 0;
 
-    file_info* info = (file_info*) ((list_item*) linked_list_get(&deleteData->contents, linked_list_size(&deleteData->contents) - index - 1))->data;
+    u32 contentIndex = linked_list_size(&deleteData->contents) - index - 1;
+    file_info* info = (file_info*) ((list_item*) linked_list_get(&deleteData->contents, contentIndex))->data;
 
     FS_Path* fsPath = util_make_path_utf8(info->path);
     if(fsPath != NULL) {
-        if(util_is_dir(deleteData->target->archive, info->path)) {
-            res = FSUSER_DeleteDirectory(deleteData->target->archive, *fsPath);
+        if(info->attributes & FS_ATTRIBUTE_DIRECTORY) {
+            if(!deleteData->recursive) {
+                res = FSUSER_DeleteDirectory(deleteData->target->archive, *fsPath);
+            } else if(R_FAILED(res = FSUSER_DeleteDirectoryRecursively(deleteData->target->archive, *fsPath))) {
+                res = action_delete_walk(deleteData->target->archive, info->path);
+            }
         } else {
             res = FSUSER_DeleteFile(deleteData->target->archive, *fsPath);
         }
@@ -58,18 +126,7 @@ static Result action_delete_delete(void* data, u32 index) {
     }
 
     if(R_SUCCEEDED(res)) {
-        linked_list_iter iter;
-        linked_list_iterate(deleteData->items, &iter);
-
-        while(linked_list_iter_has_next(&iter)) {
-            list_item* item = (list_item*) linked_list_iter_next(&iter);
-            file_info* currInfo = (file_info*) item->data;
-
-            if(strncmp(currInfo->path, info->path, FILE_PATH_MAX) == 0) {
-                linked_list_iter_remove(&iter);
-                task_free_file(item);
-            }
-        }
+        deleteData->deleted[contentIndex] = true;
     }
 
     return res;
@@ -100,6 +157,11 @@ static bool action_delete_error(void* data, u32 index, Result res) {
 }
 
 static void action_delete_free_data(delete_data* data) {
+    if(data->deleted != NULL) {
+        free(data->deleted);
+        data->deleted = NULL;
+    }
+
     task_clear_files(&data->contents);
     linked_list_destroy(&data->contents);
 
@@ -112,12 +174,54 @@ static void action_delete_free_data(delete_data* data) {
     free(data);
 }
 
+static int action_delete_compare_paths(const void* p1, const void* p2) {
+    return strncmp(*(const char**) p1, *(const char**) p2, FILE_PATH_MAX);
+}
+
+// Removes deleted entries from the visible list in one pass, rather than scanning it once per deleted item.
+static void action_delete_update_items(delete_data* data) {
+    u32 count = linked_list_size(&data->contents);
+
+    const char** paths = (const char**) calloc(count > 0 ? count : 1, sizeof(const char*));
+    if(paths == NULL) {
+        return;
+    }
+
+    u32 deletedCount = 0;
+    for(u32 i = 0; i < count; i++) {
+        if(data->deleted[i]) {
+            paths[deletedCount++] = ((file_info*) ((list_item*) linked_list_get(&data->contents, i))->data)->path;
+        }
+    }
+
+    if(deletedCount > 0) {
+        qsort(paths, deletedCount, sizeof(const char*), action_delete_compare_paths);
+
+        linked_list_iter iter;
+        linked_list_iterate(data->items, &iter);
+
+        while(linked_list_iter_has_next(&iter)) {
+            list_item* item = (list_item*) linked_list_iter_next(&iter);
+            const char* path = ((file_info*) item->data)->path;
+
+            if(bsearch(&path, paths, deletedCount, sizeof(const char*), action_delete_compare_paths) != NULL) {
+                linked_list_iter_remove(&iter);
+                task_free_file(item);
+            }
+        }
+    }
+
+    free(paths);
+}
+
 static void action_delete_update(ui_view* view, void* data, float* progress, char* text) {
     delete_data* deleteData = (delete_data*) data;
 
     if(deleteData->deleteInfo.finished) {
         FSUSER_ControlArchive(deleteData->target->archive, ARCHIVE_ACTION_COMMIT_SAVE_DATA, NULL, 0, NULL, 0);
 
+        action_delete_update_items(deleteData);
+
         ui_pop();
         info_destroy(view);
 
@@ -178,7 +282,14 @@ static void action_delete_loading_update(ui_view* view, void* data, float* progr
             loadingData->deleteData->deleteInfo.total = linked_list_size(&loadingData->deleteData->contents);
             loadingData->deleteData->deleteInfo.processed = loadingData->deleteData->deleteInfo.total;
 
-            prompt_display("Confirmation", loadingData->message, COLOR_TEXT, true, loadingData->deleteData, action_delete_draw_top, action_delete_onresponse);
+            loadingData->deleteData->deleted = (bool*) calloc(loadingData->deleteData->deleteInfo.total > 0 ? loadingData->deleteData->deleteInfo.total : 1, sizeof(bool));
+            if(loadingData->deleteData->deleted != NULL) {
+                prompt_display("Confirmation", loadingData->message, COLOR_TEXT, true, loadingData->deleteData, action_delete_draw_top, action_delete_onresponse);
+            } else {
+                error_display(NULL, NULL, "Failed to allocate delete state.");
+
+                action_delete_free_data(loadingData->deleteData);
+            }
         } else {
             error_display_res(NULL, NULL, loadingData->popData.result, "Failed to populate content list.");
 
@@ -205,6 +316,7 @@ static void action_delete_internal(linked_list* items, list_item* selected, cons
     }
 
     data->items = items;
+    data->recursive = recursive;
 
     file_info* targetInfo = (file_info*) selected->data;
     Result targetCreateRes = task_create_file_item(&data->targetItem, targetInfo->archive, targetInfo->path, targetInfo->attributes);
@@ -246,7 +358,8 @@ static void action_delete_internal(linked_list* items, list_item* selected, cons
     loadingData->popData.items = &data->contents;
     loadingData->popData.archive = data->target->archive;
     strncpy(loadingData->popData.path, data->target->path, FILE_PATH_MAX);
-    loadingData->popData.recursive = recursive;
+    // Directories are removed whole, so only the top level needs listing.
+    loadingData->popData.recursive = false;
     loadingData->popData.includeBase = includeBase;
     loadingData->popData.filter = ciasOnly ? util_filter_cias : ticketsOnly ? util_filter_tickets : NULL;
     loadingData->popData.filterData = NULL;
@@ -11,6 +11,7 @@
 #include "../../list.h"
 #include "../../prompt.h"
 #include "../../ui.h"
+#include "../../../core/io.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
 #include "../../../core/spi.h"
@@ -35,42 +36,39 @@ static Result action_erase_twl_save_make_dst_directory(void* data, u32 index) {
     return 0;
 }
 
-static Result action_erase_twl_save_open_src(void* data, u32 index, u32* handle) {
+static Result action_erase_twl_save_read_src(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    memset(buffer, 0, size);
+    *bytesRead = size;
+
     return 0;
 }
 
-static Result action_erase_twl_save_close_src(void* data, u32 index, bool succeeded, u32 handle) {
+static Result action_erase_twl_save_get_src_size(io_stream* stream, u64* size) {
+    *size = stream->size;
     return 0;
 }
 
-static Result action_erase_twl_save_get_src_size(void* data, u32 handle, u64* size) {
+// Reads as zeros for the size of the save.
+static const io_ops action_erase_twl_save_src_ops = {
+    .getSize = action_erase_twl_save_get_src_size,
+    .read = action_erase_twl_save_read_src,
+    .write = NULL,
+    .close = NULL
+};
+
+static Result action_erase_twl_save_open_src(void* data, u32 index, io_stream** stream) {
     Result res = 0;
 
     u32 saveSize = 0;
     if(R_SUCCEEDED(res = spi_init_card()) && R_SUCCEEDED(res = spi_get_save_size(&saveSize)) && R_SUCCEEDED(res = spi_deinit_card())) {
-        *size = saveSize;
+        res = io_open(stream, &action_erase_twl_save_src_ops, NULL, 0, saveSize);
     }
 
     return res;
 }
 
-static Result action_erase_twl_save_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    memset(buffer, 0, size);
-    *bytesRead = size;
-
-    return 0;
-}
-
-static Result action_erase_twl_save_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
-    return spi_init_card();
-}
-
-static Result action_erase_twl_save_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
-    return spi_deinit_card();
-}
-
-static Result action_erase_twl_save_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return spi_write_save(bytesWritten, buffer, (u32) offset, size);
+static Result action_erase_twl_save_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    return io_open_spi_save(stream);
 }
 
 static Result action_erase_twl_save_suspend(void* data, u32 index) {
@@ -156,13 +154,7 @@ void action_erase_twl_save(linked_list* items, list_item* selected) {
     data->eraseInfo.makeDstDirectory = action_erase_twl_save_make_dst_directory;
 
     data->eraseInfo.openSrc = action_erase_twl_save_open_src;
-    data->eraseInfo.closeSrc = action_erase_twl_save_close_src;
-    data->eraseInfo.getSrcSize = action_erase_twl_save_get_src_size;
-    data->eraseInfo.readSrc = action_erase_twl_save_read_src;
-
     data->eraseInfo.openDst = action_erase_twl_save_open_dst;
-    data->eraseInfo.closeDst = action_erase_twl_save_close_dst;
-    data->eraseInfo.writeDst = action_erase_twl_save_write_dst;
 
     data->eraseInfo.suspend = action_erase_twl_save_suspend;
     data->eraseInfo.restore = action_erase_twl_save_restore;
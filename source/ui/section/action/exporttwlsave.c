@@ -10,9 +10,9 @@
 #include "../../list.h"
 #include "../../prompt.h"
 #include "../../ui.h"
+#include "../../../core/io.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
-#include "../../../core/spi.h"
 #include "../../../core/util.h"
 
 typedef struct {
@@ -34,30 +34,11 @@ static Result action_export_twl_save_make_dst_directory(void* data, u32 index) {
     return 0;
 }
 
-static Result action_export_twl_save_open_src(void* data, u32 index, u32* handle) {
-    return spi_init_card();
+static Result action_export_twl_save_open_src(void* data, u32 index, io_stream** stream) {
+    return io_open_spi_save(stream);
 }
 
-static Result action_export_twl_save_close_src(void* data, u32 index, bool succeeded, u32 handle) {
-    return spi_deinit_card();
-}
-
-static Result action_export_twl_save_get_src_size(void* data, u32 handle, u64* size) {
-    Result res = 0;
-
-    u32 saveSize = 0;
-    if(R_SUCCEEDED(res = spi_get_save_size(&saveSize))) {
-        *size = saveSize;
-    }
-
-    return res;
-}
-
-static Result action_export_twl_save_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    return spi_read_save(bytesRead, buffer, (u32) offset, size);
-}
-
-static Result action_export_twl_save_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
+static Result action_export_twl_save_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
     export_twl_save_data* exportData = (export_twl_save_data*) data;
 
     Result res = 0;
@@ -71,14 +52,7 @@ static Result action_export_twl_save_open_dst(void* data, u32 index, void* initi
             char path[FILE_PATH_MAX];
             snprintf(path, sizeof(path), "/fbi/save/%s.sav", gameName);
 
-            FS_Path* fsPath = util_make_path_utf8(path);
-            if(fsPath != NULL) {
-                res = FSUSER_OpenFileDirectly(handle, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), *fsPath, FS_OPEN_WRITE | FS_OPEN_CREATE, 0);
-
-                util_free_path_utf8(fsPath);
-            } else {
-                res = R_FBI_OUT_OF_MEMORY;
-            }
+            res = io_open_sd_file(stream, path, FS_OPEN_WRITE | FS_OPEN_CREATE);
         }
 
         FSUSER_CloseArchive(sdmcArchive);
@@ -87,14 +61,6 @@ static Result action_export_twl_save_open_dst(void* data, u32 index, void* initi
     return res;
 }
 
-static Result action_export_twl_save_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
-    return FSFILE_Close(handle);
-}
-
-static Result action_export_twl_save_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Write(handle, bytesWritten, offset, buffer, size, 0);
-}
-
 static Result action_export_twl_save_suspend(void* data, u32 index) {
     return 0;
 }
@@ -170,6 +136,7 @@ void action_export_twl_save(linked_list* items, list_item* selected) {
     data->exportInfo.op = DATAOP_COPY;
 
     data->exportInfo.copyBufferSize = 128 * 1024;
+    data->exportInfo.bufferSizeKey = "export_twl_save";
     data->exportInfo.copyEmpty = true;
 
     data->exportInfo.total = 1;
@@ -178,13 +145,7 @@ void action_export_twl_save(linked_list* items, list_item* selected) {
     data->exportInfo.makeDstDirectory = action_export_twl_save_make_dst_directory;
 
     data->exportInfo.openSrc = action_export_twl_save_open_src;
-    data->exportInfo.closeSrc = action_export_twl_save_close_src;
-    data->exportInfo.getSrcSize = action_export_twl_save_get_src_size;
-    data->exportInfo.readSrc = action_export_twl_save_read_src;
-
     data->exportInfo.openDst = action_export_twl_save_open_dst;
-    data->exportInfo.closeDst = action_export_twl_save_close_dst;
-    data->exportInfo.writeDst = action_export_twl_save_write_dst;
 
     data->exportInfo.suspend = action_export_twl_save_suspend;
     data->exportInfo.restore = action_export_twl_save_restore;
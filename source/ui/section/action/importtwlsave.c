@@ -10,9 +10,9 @@
 #include "../../list.h"
 #include "../../prompt.h"
 #include "../../ui.h"
+#include "../../../core/io.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
-#include "../../../core/spi.h"
 #include "../../../core/util.h"
 
 typedef struct {
@@ -34,51 +34,20 @@ static Result action_import_twl_save_make_dst_directory(void* data, u32 index) {
     return 0;
 }
 
-static Result action_import_twl_save_open_src(void* data, u32 index, u32* handle) {
+static Result action_import_twl_save_open_src(void* data, u32 index, io_stream** stream) {
     import_twl_save_data* importData = (import_twl_save_data*) data;
 
-    Result res = 0;
-
     char gameName[0x10] = {'\0'};
     util_escape_file_name(gameName, importData->title->productCode, sizeof(gameName));
 
     char path[FILE_PATH_MAX];
     snprintf(path, sizeof(path), "/fbi/save/%s.sav", gameName);
 
-    FS_Path* fsPath = util_make_path_utf8(path);
-    if(fsPath != NULL) {
-        res = FSUSER_OpenFileDirectly(handle, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), *fsPath, FS_OPEN_READ, 0);
-
-        util_free_path_utf8(fsPath);
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
-    }
-
-    return res;
-}
-
-static Result action_import_twl_save_close_src(void* data, u32 index, bool succeeded, u32 handle) {
-    return FSFILE_Close(handle);
-}
-
-static Result action_import_twl_save_get_src_size(void* data, u32 handle, u64* size) {
-    return FSFILE_GetSize(handle, size);
-}
-
-static Result action_import_twl_save_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Read(handle, bytesRead, offset, buffer, size);
-}
-
-static Result action_import_twl_save_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
-    return spi_init_card();
-}
-
-static Result action_import_twl_save_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
-    return spi_deinit_card();
+    return io_open_sd_file(stream, path, FS_OPEN_READ);
 }
 
-static Result action_import_twl_save_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return spi_write_save(bytesWritten, buffer, (u32) offset, size);
+static Result action_import_twl_save_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    return io_open_spi_save(stream);
 }
 
 static Result action_import_twl_save_suspend(void* data, u32 index) {
@@ -156,6 +125,7 @@ void action_import_twl_save(linked_list* items, list_item* selected) {
     data->importInfo.op = DATAOP_COPY;
 
     data->importInfo.copyBufferSize = 16 * 1024;
+    data->importInfo.bufferSizeKey = "import_twl_save";
     data->importInfo.copyEmpty = true;
 
     data->importInfo.total = 1;
@@ -164,13 +134,7 @@ void action_import_twl_save(linked_list* items, list_item* selected) {
     data->importInfo.makeDstDirectory = action_import_twl_save_make_dst_directory;
 
     data->importInfo.openSrc = action_import_twl_save_open_src;
-    data->importInfo.closeSrc = action_import_twl_save_close_src;
-    data->importInfo.getSrcSize = action_import_twl_save_get_src_size;
-    data->importInfo.readSrc = action_import_twl_save_read_src;
-
     data->importInfo.openDst = action_import_twl_save_open_dst;
-    data->importInfo.closeDst = action_import_twl_save_close_dst;
-    data->importInfo.writeDst = action_import_twl_save_write_dst;
 
     data->importInfo.suspend = action_import_twl_save_suspend;
     data->importInfo.restore = action_import_twl_save_restore;
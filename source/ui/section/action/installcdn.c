@@ -11,6 +11,8 @@
 #include "../../list.h"
 #include "../../prompt.h"
 #include "../../ui.h"
+#include "../../../core/http.h"
+#include "../../../core/io.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
 #include "../../../core/util.h"
@@ -26,6 +28,8 @@ typedef struct {
     u32 contentCount;
     u16 contentIndices[CONTENTS_MAX];
     u32 contentIds[CONTENTS_MAX];
+    u64 contentSizes[CONTENTS_MAX];
+    u64 contentWritten;
 
     u32 responseCode;
 
@@ -41,55 +45,58 @@ static Result action_install_cdn_make_dst_directory(void* data, u32 index) {
     return 0;
 }
 
-static Result action_install_cdn_open_src(void* data, u32 index, u32* handle) {
+static Result action_install_cdn_open_src(void* data, u32 index, io_stream** stream) {
     install_cdn_data* installData = (install_cdn_data*) data;
 
     Result res = 0;
 
-    httpcContext* context = (httpcContext*) calloc(1, sizeof(httpcContext));
-    if(context != NULL) {
-        char url[256];
-        if(index == 0) {
-            if(strlen(installData->tmdVersion) > 0) {
-                snprintf(url, 256, "http://ccs.cdn.c.shop.nintendowifi.net/ccs/download/%016llX/tmd.%s", installData->ticket->titleId, installData->tmdVersion);
-            } else {
-                snprintf(url, 256, "http://ccs.cdn.c.shop.nintendowifi.net/ccs/download/%016llX/tmd", installData->ticket->titleId);
-            }
-        } else {
-            snprintf(url, 256, "http://ccs.cdn.c.shop.nintendowifi.net/ccs/download/%016llX/%08lX", installData->ticket->titleId, installData->contentIds[index - 1]);
-        }
-
-        if(R_SUCCEEDED(res = util_http_open(context, &installData->responseCode, url, false))) {
-            *handle = (u32) context;
+    char url[256];
+    if(index == 0) {
+        if(strlen(installData->tmdVersion) > 0) {
+            snprintf(url, 256, "http://ccs.cdn.c.shop.nintendowifi.net/ccs/download/%016llX/tmd.%s", installData->ticket->titleId, installData->tmdVersion);
         } else {
-            free(context);
+            snprintf(url, 256, "http://ccs.cdn.c.shop.nintendowifi.net/ccs/download/%016llX/tmd", installData->ticket->titleId);
         }
     } else {
-        res = R_FBI_OUT_OF_MEMORY;
+        snprintf(url, 256, "http://ccs.cdn.c.shop.nintendowifi.net/ccs/download/%016llX/%08lX", installData->ticket->titleId, installData->contentIds[index - 1]);
+    }
+
+    // Contents can be hundreds of megabytes; fetch them over several connections.
+    if(R_FAILED(res = io_open_http(stream, url, false, 0, HTTP_SEGMENTED_CONNECTIONS_DEFAULT, installData->installInfo.cancelEvent))
+       && res >= R_FBI_HTTP_ERROR_BASE && res < R_FBI_HTTP_ERROR_END) {
+        installData->responseCode = (u32) (res - R_FBI_HTTP_ERROR_BASE);
+        res = R_FBI_HTTP_RESPONSE_CODE;
     }
 
     return res;
 }
 
-static Result action_install_cdn_close_src(void* data, u32 index, bool succeeded, u32 handle) {
-    return util_http_close((httpcContext*) handle);
-}
+static Result action_install_cdn_write_dst(io_stream* stream, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    install_cdn_data* installData = (install_cdn_data*) stream->data;
+
+    Result res = 0;
 
-static Result action_install_cdn_get_src_size(void* data, u32 handle, u64* size) {
-    u32 downloadSize = 0;
-    Result res = util_http_get_size((httpcContext*) handle, &downloadSize);
+    if(R_SUCCEEDED(res = FSFILE_Write(stream->handle, bytesWritten, offset, buffer, size, 0)) && offset + *bytesWritten > installData->contentWritten) {
+        installData->contentWritten = offset + *bytesWritten;
+    }
 
-    *size = downloadSize;
     return res;
 }
 
-static Result action_install_cdn_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    return util_http_read((httpcContext*) handle, bytesRead, buffer, size);
-}
+// Finishing or cancelling the install is up to action_install_cdn_close_dst, which knows which kind it was.
+static const io_ops action_install_cdn_dst_ops = {
+    .getSize = NULL,
+    .read = NULL,
+    .write = action_install_cdn_write_dst,
+    .close = NULL
+};
 
-static Result action_install_cdn_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
+static Result action_install_cdn_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
     install_cdn_data* installData = (install_cdn_data*) data;
 
+    Result res = 0;
+
+    Handle handle = 0;
     if(index == 0) {
         installData->contentCount = util_get_tmd_content_count((u8*) initialReadBlock);
         if(installData->contentCount > CONTENTS_MAX) {
@@ -101,23 +108,43 @@ static Result action_install_cdn_open_dst(void* data, u32 index, void* initialRe
 
             installData->contentIds[i] = __builtin_bswap32(*(u32*) &contentChunk[0x00]);
             installData->contentIndices[i] = __builtin_bswap16(*(u16*) &contentChunk[0x04]);
+            installData->contentSizes[i] = __builtin_bswap64(*(u64*) &contentChunk[0x08]);
         }
 
         installData->installInfo.total += installData->contentCount;
 
-        return AM_InstallTmdBegin(handle);
+        if(R_SUCCEEDED(res = AM_InstallTmdBegin(&handle)) && R_FAILED(res = io_open(stream, &action_install_cdn_dst_ops, installData, handle, 0))) {
+            AM_InstallTmdAbort(handle);
+        }
     } else {
-        return AM_InstallContentBegin(handle, installData->contentIndices[index - 1]);
+        installData->contentWritten = 0;
+
+        if(R_SUCCEEDED(res = AM_InstallContentBegin(&handle, installData->contentIndices[index - 1]))
+           && R_FAILED(res = io_open(stream, &action_install_cdn_dst_ops, installData, handle, 0))) {
+            AM_InstallContentCancel(handle);
+        }
     }
+
+    return res;
 }
 
-static Result action_install_cdn_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
+static Result action_install_cdn_close_dst(void* data, u32 index, bool succeeded, io_stream* stream) {
     install_cdn_data* installData = (install_cdn_data*) data;
 
+    Handle handle = stream->handle;
+    io_close(stream, succeeded);
+
     if(succeeded) {
         if(index == 0) {
             return AM_InstallTmdFinish(handle, true);
         } else {
+            // CDN contents arrive encrypted with the title key, which only AM can unwrap, while the TMD hashes cover
+            // the decrypted data. Only the size can be checked here; the hashes are left to AM.
+            if(installData->contentWritten != installData->contentSizes[index - 1]) {
+                AM_InstallContentCancel(handle);
+                return R_FBI_BAD_DATA;
+            }
+
             Result res = 0;
             if(R_SUCCEEDED(res = AM_InstallContentFinish(handle)) && index == 1 && installData->contentCount > 1 && (installData->ticket->titleId >> 32) == 0x0004008C) {
                 FS_MediaType dest = util_get_title_destination(installData->ticket->titleId);
@@ -139,10 +166,6 @@ static Result action_install_cdn_close_dst(void* data, u32 index, bool succeeded
     }
 }
 
-static Result action_install_cdn_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Write(handle, bytesWritten, offset, buffer, size, 0);
-}
-
 static Result action_install_cdn_suspend(void* data, u32 index) {
     return AM_InstallTitleStop();
 }
@@ -291,13 +314,9 @@ static void action_install_cdn_internal(volatile bool* done, ticket_info* info,
     data->installInfo.makeDstDirectory = action_install_cdn_make_dst_directory;
 
     data->installInfo.openSrc = action_install_cdn_open_src;
-    data->installInfo.closeSrc = action_install_cdn_close_src;
-    data->installInfo.getSrcSize = action_install_cdn_get_src_size;
-    data->installInfo.readSrc = action_install_cdn_read_src;
 
     data->installInfo.openDst = action_install_cdn_open_dst;
     data->installInfo.closeDst = action_install_cdn_close_dst;
-    data->installInfo.writeDst = action_install_cdn_write_dst;
 
     data->installInfo.suspend = action_install_cdn_suspend;
     data->installInfo.restore = action_install_cdn_restore;
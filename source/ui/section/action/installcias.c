@@ -11,6 +11,7 @@
 #include "../../list.h"
 #include "../../prompt.h"
 #include "../../ui.h"
+#include "../../../core/io.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
 #include "../../../core/util.h"
@@ -24,6 +25,7 @@ typedef struct {
     linked_list contents;
 
     bool delete;
+    bool verify;
 
     volatile bool n3dsContinue;
 
@@ -54,33 +56,22 @@ static Result action_install_cias_make_dst_directory(void* data, u32 index) {
     return 0;
 }
 
-static Result action_install_cias_open_src(void* data, u32 index, u32* handle) {
+static Result action_install_cias_open_src(void* data, u32 index, io_stream** stream) {
     install_cias_data* installData = (install_cias_data*) data;
 
     file_info* info = (file_info*) ((list_item*) linked_list_get(&installData->contents, index))->data;
 
-    Result res = 0;
-
-    FS_Path* fsPath = util_make_path_utf8(info->path);
-    if(fsPath != NULL) {
-        res = FSUSER_OpenFile(handle, info->archive, *fsPath, FS_OPEN_READ, 0);
-
-        util_free_path_utf8(fsPath);
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
-    }
-
-    return res;
+    return io_open_file(stream, info->archive, info->path, FS_OPEN_READ, 0);
 }
 
-static Result action_install_cias_close_src(void* data, u32 index, bool succeeded, u32 handle) {
+static Result action_install_cias_close_src(void* data, u32 index, bool succeeded, io_stream* stream) {
     install_cias_data* installData = (install_cias_data*) data;
 
     file_info* info = (file_info*) ((list_item*) linked_list_get(&installData->contents, index))->data;
 
     Result res = 0;
 
-    if(R_SUCCEEDED(res = FSFILE_Close(handle)) && installData->delete && succeeded) {
+    if(R_SUCCEEDED(res = io_close(stream, succeeded)) && installData->delete && succeeded) {
         FS_Path* fsPath = util_make_path_utf8(info->path);
         if(fsPath != NULL) {
             if(R_SUCCEEDED(FSUSER_DeleteFile(info->archive, *fsPath))) {
@@ -107,15 +98,7 @@ static Result action_install_cias_close_src(void* data, u32 index, bool succeede
     return res;
 }
 
-static Result action_install_cias_get_src_size(void* data, u32 handle, u64* size) {
-    return FSFILE_GetSize(handle, size);
-}
-
-static Result action_install_cias_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Read(handle, bytesRead, offset, buffer, size);
-}
-
-static Result action_install_cias_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
+static Result action_install_cias_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
     install_cias_data* installData = (install_cias_data*) data;
 
     installData->n3dsContinue = false;
@@ -149,32 +132,25 @@ static Result action_install_cias_open_dst(void* data, u32 index, void* initialR
         }
     }
 
-    return AM_StartCiaInstall(dest, handle);
+    return io_open_cia_install(stream, dest, installData->verify);
 }
 
-static Result action_install_cias_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
-    if(succeeded) {
+static Result action_install_cias_close_dst(void* data, u32 index, bool succeeded, io_stream* stream) {
+    Result res = 0;
+
+    if(R_SUCCEEDED(res = io_close(stream, succeeded)) && succeeded) {
         install_cias_data* installData = (install_cias_data*) data;
 
         file_info* info = (file_info*) ((list_item*) linked_list_get(&installData->contents, index))->data;
 
-        Result res = 0;
-        if(R_SUCCEEDED(res = AM_FinishCiaInstall(handle))) {
-            util_import_seed(NULL, info->ciaInfo.titleId);
+        util_import_seed(NULL, info->ciaInfo.titleId);
 
-            if((info->ciaInfo.titleId & 0xFFFFFFF) == 0x0000002) {
-                res = AM_InstallFirm(info->ciaInfo.titleId);
-            }
+        if((info->ciaInfo.titleId & 0xFFFFFFF) == 0x0000002) {
+            res = AM_InstallFirm(info->ciaInfo.titleId);
         }
-
-        return res;
-    } else {
-        return AM_CancelCIAInstall(handle);
     }
-}
 
-static Result action_install_cias_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Write(handle, bytesWritten, offset, buffer, size, 0);
+    return res;
 }
 
 static Result action_install_cias_suspend(void* data, u32 index) {
@@ -242,18 +218,26 @@ static void action_install_cias_update(ui_view* view, void* data, float* progres
     snprintf(text, PROGRESS_TEXT_MAX, "%lu / %lu\n%.2f %s / %.2f %s\n%.2f %s/s", installData->installInfo.processed, installData->installInfo.total, util_get_display_size(installData->installInfo.currProcessed), util_get_display_size_units(installData->installInfo.currProcessed), util_get_display_size(installData->installInfo.currTotal), util_get_display_size_units(installData->installInfo.currTotal), util_get_display_size(installData->installInfo.copyBytesPerSecond), util_get_display_size_units(installData->installInfo.copyBytesPerSecond));
 }
 
+static void action_install_cias_verify_onresponse(ui_view* view, void* data, bool response) {
+    install_cias_data* installData = (install_cias_data*) data;
+
+    installData->verify = response;
+
+    Result res = task_data_op(&installData->installInfo);
+    if(R_SUCCEEDED(res)) {
+        info_display("Installing CIA(s)", "Press B to cancel.", true, data, action_install_cias_update, action_install_cias_draw_top);
+    } else {
+        error_display_res(NULL, NULL, res, "Failed to initiate CIA installation.");
+
+        action_install_cias_free_data(installData);
+    }
+}
+
 static void action_install_cias_onresponse(ui_view* view, void* data, bool response) {
     install_cias_data* installData = (install_cias_data*) data;
 
     if(response) {
-        Result res = task_data_op(&installData->installInfo);
-        if(R_SUCCEEDED(res)) {
-            info_display("Installing CIA(s)", "Press B to cancel.", true, data, action_install_cias_update, action_install_cias_draw_top);
-        } else {
-            error_display_res(NULL, NULL, res, "Failed to initiate CIA installation.");
-
-            action_install_cias_free_data(installData);
-        }
+        prompt_display("Optional", "Verify content hashes while installing?\nThis catches corrupt CIAs but is slower.", COLOR_TEXT, true, data, action_install_cias_draw_top, action_install_cias_verify_onresponse);
     } else {
         action_install_cias_free_data(installData);
     }
@@ -322,6 +306,7 @@ static void action_install_cias_internal(linked_list* items, list_item* selected
     data->target = (file_info*) data->targetItem->data;
 
     data->delete = delete;
+    data->verify = true;
 
     data->n3dsContinue = false;
 
@@ -330,6 +315,8 @@ static void action_install_cias_internal(linked_list* items, list_item* selected
     data->installInfo.op = DATAOP_COPY;
 
     data->installInfo.copyBufferSize = 256 * 1024;
+    data->installInfo.bufferSizeKey = "install_cia";
+    data->installInfo.bufferCount = 4;
     data->installInfo.copyEmpty = false;
 
     data->installInfo.isSrcDirectory = action_install_cias_is_src_directory;
@@ -337,12 +324,9 @@ static void action_install_cias_internal(linked_list* items, list_item* selected
 
     data->installInfo.openSrc = action_install_cias_open_src;
     data->installInfo.closeSrc = action_install_cias_close_src;
-    data->installInfo.getSrcSize = action_install_cias_get_src_size;
-    data->installInfo.readSrc = action_install_cias_read_src;
 
     data->installInfo.openDst = action_install_cias_open_dst;
     data->installInfo.closeDst = action_install_cias_close_dst;
-    data->installInfo.writeDst = action_install_cias_write_dst;
 
     data->installInfo.suspend = action_install_cias_suspend;
     data->installInfo.restore = action_install_cias_restore;
@@ -11,6 +11,7 @@
 #include "../../list.h"
 #include "../../prompt.h"
 #include "../../ui.h"
+#include "../../../core/io.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
 #include "../../../core/util.h"
@@ -49,33 +50,22 @@ static Result action_install_tickets_make_dst_directory(void* data, u32 index) {
     return 0;
 }
 
-static Result action_install_tickets_open_src(void* data, u32 index, u32* handle) {
+static Result action_install_tickets_open_src(void* data, u32 index, io_stream** stream) {
     install_tickets_data* installData = (install_tickets_data*) data;
 
     file_info* info = (file_info*) ((list_item*) linked_list_get(&installData->contents, index))->data;
 
-    Result res = 0;
-
-    FS_Path* fsPath = util_make_path_utf8(info->path);
-    if(fsPath != NULL) {
-        res = FSUSER_OpenFile(handle, info->archive, *fsPath, FS_OPEN_READ, 0);
-
-        util_free_path_utf8(fsPath);
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
-    }
-
-    return res;
+    return io_open_file(stream, info->archive, info->path, FS_OPEN_READ, 0);
 }
 
-static Result action_install_tickets_close_src(void* data, u32 index, bool succeeded, u32 handle) {
+static Result action_install_tickets_close_src(void* data, u32 index, bool succeeded, io_stream* stream) {
     install_tickets_data* installData = (install_tickets_data*) data;
 
     file_info* info = (file_info*) ((list_item*) linked_list_get(&installData->contents, index))->data;
 
     Result res = 0;
 
-    if(R_SUCCEEDED(res = FSFILE_Close(handle)) && installData->delete && succeeded) {
+    if(R_SUCCEEDED(res = io_close(stream, succeeded)) && installData->delete && succeeded) {
         FS_Path* fsPath = util_make_path_utf8(info->path);
         if(fsPath != NULL) {
             if(R_SUCCEEDED(FSUSER_DeleteFile(info->archive, *fsPath))) {
@@ -102,41 +92,25 @@ static Result action_install_tickets_close_src(void* data, u32 index, bool succe
     return res;
 }
 
-static Result action_install_tickets_get_src_size(void* data, u32 handle, u64* size) {
-    return FSFILE_GetSize(handle, size);
-}
-
-static Result action_install_tickets_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Read(handle, bytesRead, offset, buffer, size);
-}
-
-static Result action_install_tickets_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
+static Result action_install_tickets_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
     AM_DeleteTicket(((file_info*) ((list_item*) linked_list_get(&((install_tickets_data*) data)->contents, index))->data)->ticketInfo.titleId);
-    return AM_InstallTicketBegin(handle);
+    return io_open_ticket_install(stream);
 }
 
-static Result action_install_tickets_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
+static Result action_install_tickets_close_dst(void* data, u32 index, bool succeeded, io_stream* stream) {
     install_tickets_data* installData = (install_tickets_data*) data;
 
-    if(succeeded) {
-        Result res = AM_InstallTicketFinish(handle);
-        if(R_SUCCEEDED(res) && installData->cdn) {
-            volatile bool done = false;
-            action_install_cdn_noprompt(&done, &((file_info*) ((list_item*) linked_list_get(&installData->contents, index))->data)->ticketInfo, false);
+    Result res = io_close(stream, succeeded);
+    if(succeeded && R_SUCCEEDED(res) && installData->cdn) {
+        volatile bool done = false;
+        action_install_cdn_noprompt(&done, &((file_info*) ((list_item*) linked_list_get(&installData->contents, index))->data)->ticketInfo, false);
 
-            while(!done) {
-                svcSleepThread(100000000);
-            }
+        while(!done) {
+            svcSleepThread(100000000);
         }
-
-        return res;
-    } else {
-        return AM_InstallTicketAbort(handle);
     }
-}
 
-static Result action_install_tickets_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Write(handle, bytesWritten, offset, buffer, size, 0);
+    return res;
 }
 
 static Result action_install_tickets_suspend(void* data, u32 index) {
@@ -303,12 +277,9 @@ static void action_install_tickets_internal(linked_list* items, list_item* selec
 
     data->installInfo.openSrc = action_install_tickets_open_src;
     data->installInfo.closeSrc = action_install_tickets_close_src;
-    data->installInfo.getSrcSize = action_install_tickets_get_src_size;
-    data->installInfo.readSrc = action_install_tickets_read_src;
 
     data->installInfo.openDst = action_install_tickets_open_dst;
     data->installInfo.closeDst = action_install_tickets_close_dst;
-    data->installInfo.writeDst = action_install_tickets_write_dst;
 
     data->installInfo.suspend = action_install_tickets_suspend;
     data->installInfo.restore = action_install_tickets_restore;
@@ -12,10 +12,13 @@
 #include "../../prompt.h"
 #include "../../ui.h"
 #include "../../../core/clipboard.h"
+#include "../../../core/io.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
 #include "../../../core/util.h"
 
+#define SYNC_COMPARE_BUFFER_SIZE (64 * 1024)
+
 typedef struct {
     linked_list* items;
 
@@ -24,6 +27,10 @@ typedef struct {
 
     linked_list contents;
 
+    Handle itemsMutex;
+
+    bool sync;
+
     data_op_data pasteInfo;
 } paste_contents_data;
 
@@ -109,36 +116,64 @@ static Result action_paste_contents_make_dst_directory(void* data, u32 index) {
     return res;
 }
 
-static Result action_paste_contents_open_src(void* data, u32 index, u32* handle) {
+static Result action_paste_contents_open_src(void* data, u32 index, io_stream** stream) {
     paste_contents_data* pasteData = (paste_contents_data*) data;
 
-    Result res = 0;
+    return io_open_file(stream, clipboard_get_archive(), ((file_info*) ((list_item*) linked_list_get(&pasteData->contents, index))->data)->path, FS_OPEN_READ, 0);
+}
 
-    FS_Path* fsPath = util_make_path_utf8(((file_info*) ((list_item*) linked_list_get(&pasteData->contents, index))->data)->path);
-    if(fsPath != NULL) {
-        res = FSUSER_OpenFile(handle, clipboard_get_archive(), *fsPath, FS_OPEN_READ, 0);
+// Both files have to be read either way, so comparing them directly is as cheap as hashing and can't collide.
+static bool action_paste_contents_compare(io_stream* src, io_stream* dst, u64 size) {
+    bool matches = false;
 
-        util_free_path_utf8(fsPath);
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
+    u8* srcBuffer = (u8*) malloc(SYNC_COMPARE_BUFFER_SIZE);
+    u8* dstBuffer = (u8*) malloc(SYNC_COMPARE_BUFFER_SIZE);
+    if(srcBuffer != NULL && dstBuffer != NULL) {
+        matches = true;
+
+        u64 offset = 0;
+        while(offset < size && matches) {
+            u32 readSize = size - offset < SYNC_COMPARE_BUFFER_SIZE ? (u32) (size - offset) : SYNC_COMPARE_BUFFER_SIZE;
+
+            u32 srcRead = 0;
+            u32 dstRead = 0;
+            matches = R_SUCCEEDED(io_read(src, &srcRead, srcBuffer, offset, readSize))
+                      && R_SUCCEEDED(io_read(dst, &dstRead, dstBuffer, offset, readSize))
+                      && srcRead == readSize && dstRead == readSize
+                      && memcmp(srcBuffer, dstBuffer, readSize) == 0;
+
+            offset += readSize;
+        }
     }
 
-    return res;
-}
+    free(srcBuffer);
+    free(dstBuffer);
 
-static Result action_paste_contents_close_src(void* data, u32 index, bool succeeded, u32 handle) {
-    return FSFILE_Close(handle);
+    return matches;
 }
 
-static Result action_paste_contents_get_src_size(void* data, u32 handle, u64* size) {
-    return FSFILE_GetSize(handle, size);
-}
+static Result action_paste_contents_check_dst(void* data, u32 index, io_stream* src, u64 size) {
+    paste_contents_data* pasteData = (paste_contents_data*) data;
+
+    char dstPath[FILE_PATH_MAX];
+    action_paste_contents_get_dst_path(pasteData, index, dstPath);
+
+    Result res = 0;
+
+    io_stream* dst = NULL;
+    if(R_SUCCEEDED(io_open_file(&dst, pasteData->target->archive, dstPath, FS_OPEN_READ, 0))) {
+        u64 dstSize = 0;
+        if(R_SUCCEEDED(io_get_size(dst, &dstSize)) && dstSize == size && action_paste_contents_compare(src, dst, size)) {
+            res = R_FBI_SKIPPED;
+        }
 
-static Result action_paste_contents_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Read(handle, bytesRead, offset, buffer, size);
+        io_close(dst, true);
+    }
+
+    return res;
 }
 
-static Result action_paste_contents_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
+static Result action_paste_contents_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
     paste_contents_data* pasteData = (paste_contents_data*) data;
 
     Result res = 0;
@@ -152,6 +187,8 @@ static Result action_paste_contents_open_dst(void* data, u32 index, void* initia
         if(R_SUCCEEDED(FSUSER_OpenFile(&currHandle, pasteData->target->archive, *fsPath, FS_OPEN_READ, 0))) {
             FSFILE_Close(currHandle);
             if(R_SUCCEEDED(res = FSUSER_DeleteFile(pasteData->target->archive, *fsPath))) {
+                svcWaitSynchronization(pasteData->itemsMutex, U64_MAX);
+
                 linked_list_iter iter;
                 linked_list_iterate(pasteData->items, &iter);
 
@@ -164,11 +201,13 @@ static Result action_paste_contents_open_dst(void* data, u32 index, void* initia
                         task_free_file(item);
                     }
                 }
+
+                svcReleaseMutex(pasteData->itemsMutex);
             }
         }
 
         if(R_SUCCEEDED(res) && R_SUCCEEDED(res = FSUSER_CreateFile(pasteData->target->archive, *fsPath, ((file_info*) ((list_item*) linked_list_get(&pasteData->contents, index))->data)->attributes & ~FS_ATTRIBUTE_READ_ONLY, size))) {
-            res = FSUSER_OpenFile(handle, pasteData->target->archive, *fsPath, FS_OPEN_WRITE, 0);
+            res = io_open_file(stream, pasteData->target->archive, dstPath, FS_OPEN_WRITE, 0);
         }
 
         util_free_path_utf8(fsPath);
@@ -179,12 +218,12 @@ static Result action_paste_contents_open_dst(void* data, u32 index, void* initia
     return res;
 }
 
-static Result action_paste_contents_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
+static Result action_paste_contents_close_dst(void* data, u32 index, bool succeeded, io_stream* stream) {
     paste_contents_data* pasteData = (paste_contents_data*) data;
 
     Result res = 0;
 
-    if(R_SUCCEEDED(res = FSFILE_Close(handle))) {
+    if(R_SUCCEEDED(res = io_close(stream, succeeded))) {
         char dstPath[FILE_PATH_MAX];
         action_paste_contents_get_dst_path(pasteData, index, dstPath);
 
@@ -201,7 +240,9 @@ static Result action_paste_contents_close_dst(void* data, u32 index, bool succee
         if(strncmp(parentPath, baseDstPath, FILE_PATH_MAX) == 0) {
             list_item* dstItem = NULL;
             if(R_SUCCEEDED(task_create_file_item(&dstItem, pasteData->target->archive, dstPath, ((file_info*) ((list_item*) linked_list_get(&pasteData->contents, index))->data)->attributes & ~FS_ATTRIBUTE_READ_ONLY))) {
+                svcWaitSynchronization(pasteData->itemsMutex, U64_MAX);
                 linked_list_add(pasteData->items, dstItem);
+                svcReleaseMutex(pasteData->itemsMutex);
             }
         }
     }
@@ -209,10 +250,6 @@ static Result action_paste_contents_close_dst(void* data, u32 index, bool succee
     return res;
 }
 
-static Result action_paste_contents_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Write(handle, bytesWritten, offset, buffer, size, 0);
-}
-
 static Result action_paste_contents_suspend(void* data, u32 index) {
     return 0;
 }
@@ -238,6 +275,11 @@ static bool action_paste_contents_error(void* data, u32 index, Result res) {
 }
 
 static void action_paste_contents_free_data(paste_contents_data* data) {
+    if(data->itemsMutex != 0) {
+        svcCloseHandle(data->itemsMutex);
+        data->itemsMutex = 0;
+    }
+
     task_clear_files(&data->contents);
     linked_list_destroy(&data->contents);
 
@@ -262,7 +304,14 @@ static void action_paste_contents_update(ui_view* view, void* data, float* progr
         info_destroy(view);
 
         if(R_SUCCEEDED(pasteData->pasteInfo.result)) {
-            prompt_display("Success", "Contents pasted.", COLOR_TEXT, false, NULL, NULL, NULL);
+            if(pasteData->sync) {
+                static char syncSummary[128];
+                snprintf(syncSummary, sizeof(syncSummary), "Contents synced.\n%.2f %s copied, %.2f %s unchanged.", util_get_display_size(pasteData->pasteInfo.copiedBytes), util_get_display_size_units(pasteData->pasteInfo.copiedBytes), util_get_display_size(pasteData->pasteInfo.skippedBytes), util_get_display_size_units(pasteData->pasteInfo.skippedBytes));
+
+                prompt_display("Success", syncSummary, COLOR_TEXT, false, NULL, NULL, NULL);
+            } else {
+                prompt_display("Success", "Contents pasted.", COLOR_TEXT, false, NULL, NULL, NULL);
+            }
         }
 
         action_paste_contents_free_data(pasteData);
@@ -315,7 +364,8 @@ static void action_paste_contents_loading_update(ui_view* view, void* data, floa
             loadingData->pasteData->pasteInfo.total = linked_list_size(&loadingData->pasteData->contents);
             loadingData->pasteData->pasteInfo.processed = loadingData->pasteData->pasteInfo.total;
 
-            prompt_display("Confirmation", "Paste clipboard contents to the current directory?", COLOR_TEXT, true, loadingData->pasteData, action_paste_contents_draw_top, action_paste_contents_onresponse);
+            const char* message = loadingData->pasteData->sync ? "Sync clipboard contents to the current directory?\nUnchanged files will be skipped." : "Paste clipboard contents to the current directory?";
+            prompt_display("Confirmation", message, COLOR_TEXT, true, loadingData->pasteData, action_paste_contents_draw_top, action_paste_contents_onresponse);
         } else {
             error_display_res(NULL, NULL, loadingData->popData.result, "Failed to populate clipboard content list.");
 
@@ -333,7 +383,7 @@ static void action_paste_contents_loading_update(ui_view* view, void* data, floa
     snprintf(text, PROGRESS_TEXT_MAX, "Fetching clipboard content list...");
 }
 
-void action_paste_contents(linked_list* items, list_item* selected) {
+static void action_paste_contents_internal(linked_list* items, list_item* selected, bool sync) {
     if(!clipboard_has_contents()) {
         prompt_display("Failure", "Clipboard empty.", COLOR_TEXT, false, NULL, NULL, NULL);
         return;
@@ -347,6 +397,7 @@ void action_paste_contents(linked_list* items, list_item* selected) {
     }
 
     data->items = items;
+    data->sync = sync;
 
     file_info* targetInfo = (file_info*) selected->data;
     Result targetCreateRes = task_create_file_item(&data->targetItem, targetInfo->archive, targetInfo->path, targetInfo->attributes);
@@ -359,24 +410,33 @@ void action_paste_contents(linked_list* items, list_item* selected) {
 
     data->target = (file_info*) data->targetItem->data;
 
+    Result mutexRes = svcCreateMutex(&data->itemsMutex, false);
+    if(R_FAILED(mutexRes)) {
+        error_display_res(NULL, NULL, mutexRes, "Failed to create paste contents mutex.");
+
+        action_paste_contents_free_data(data);
+        return;
+    }
+
     data->pasteInfo.data = data;
 
     data->pasteInfo.op = DATAOP_COPY;
 
     data->pasteInfo.copyBufferSize = 256 * 1024;
     data->pasteInfo.copyEmpty = true;
+    data->pasteInfo.workerCount = 4;
 
     data->pasteInfo.isSrcDirectory = action_paste_contents_is_src_directory;
     data->pasteInfo.makeDstDirectory = action_paste_contents_make_dst_directory;
 
     data->pasteInfo.openSrc = action_paste_contents_open_src;
-    data->pasteInfo.closeSrc = action_paste_contents_close_src;
-    data->pasteInfo.getSrcSize = action_paste_contents_get_src_size;
-    data->pasteInfo.readSrc = action_paste_contents_read_src;
+
+    if(sync) {
+        data->pasteInfo.checkDst = action_paste_contents_check_dst;
+    }
 
     data->pasteInfo.openDst = action_paste_contents_open_dst;
     data->pasteInfo.closeDst = action_paste_contents_close_dst;
-    data->pasteInfo.writeDst = action_paste_contents_write_dst;
 
     data->pasteInfo.suspend = action_paste_contents_suspend;
     data->pasteInfo.restore = action_paste_contents_restore;
@@ -415,4 +475,12 @@ void action_paste_contents(linked_list* items, list_item* selected) {
     }
 
     info_display("Loading", "Press B to cancel.", false, loadingData, action_paste_contents_loading_update, action_paste_contents_loading_draw_top);
+}
+
+void action_paste_contents(linked_list* items, list_item* selected) {
+    action_paste_contents_internal(items, selected, false);
+}
+
+void action_paste_contents_sync(linked_list* items, list_item* selected) {
+    action_paste_contents_internal(items, selected, true);
 }
\ No newline at end of file
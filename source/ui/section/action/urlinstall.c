@@ -59,38 +59,7 @@ static Result action_url_install_get_src_url(void* data, u32 index, char* url, s
     return 0;
 }
 
-static Result action_url_install_open_src(void* data, u32 index, u32* handle) {
-    url_install_data* installData = (url_install_data*) data;
-
-    Result res = 0;
-
-    httpcContext* context = (httpcContext*) calloc(1, sizeof(httpcContext));
-    if(context != NULL) {
-        if(R_SUCCEEDED(res = util_http_open(context, &installData->responseCode, installData->urls[index], true))) {
-            *handle = (u32) context;
-        } else {
-            free(context);
-        }
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
-    }
-
-    return res;
-}
-
-static Result action_url_install_close_src(void* data, u32 index, bool succeeded, u32 handle) {
-    return util_http_close((httpcContext*) handle);
-}
-
-static Result action_url_install_get_src_size(void* data, u32 handle, u64* size) {
-    u32 downloadSize = 0;
-    Result res = util_http_get_size((httpcContext*) handle, &downloadSize);
-
-    *size = downloadSize;
-    return res;
-}
-
-static Result action_url_install_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
+static Result action_url_install_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
     url_install_data* installData = (url_install_data*) data;
 
     Result res = 0;
@@ -114,7 +83,7 @@ static Result action_url_install_open_dst(void* data, u32 index, void* initialRe
         installData->ticketInfo.inUse = false;
 
         AM_DeleteTicket(installData->ticketInfo.titleId);
-        res = AM_InstallTicketBegin(handle);
+        res = io_open_ticket_install(stream);
     } else if(*(u16*) initialReadBlock == 0x2020) {
         u64 titleId = util_get_cia_title_id((u8*) initialReadBlock);
 
@@ -145,7 +114,7 @@ static Result action_url_install_open_dst(void* data, u32 index, void* initialRe
             }
         }
 
-        if(R_SUCCEEDED(res = AM_StartCiaInstall(dest, handle))) {
+        if(R_SUCCEEDED(res = io_open_cia_install(stream, dest, true))) {
             installData->currTitleId = titleId;
         }
     } else {
@@ -155,16 +124,14 @@ static Result action_url_install_open_dst(void* data, u32 index, void* initialRe
     return res;
 }
 
-static Result action_url_install_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
+static Result action_url_install_close_dst(void* data, u32 index, bool succeeded, io_stream* stream) {
     url_install_data* installData = (url_install_data*) data;
 
-    if(succeeded) {
-        Result res = 0;
+    Result res = io_close(stream, succeeded);
 
+    if(succeeded && R_SUCCEEDED(res)) {
         if(installData->ticket) {
-            res = AM_InstallTicketFinish(handle);
-
-            if(R_SUCCEEDED(res) && installData->cdn) {
+            if(installData->cdn) {
                 volatile bool done = false;
                 action_install_cdn_noprompt(&done, &installData->ticketInfo, false);
 
@@ -173,27 +140,15 @@ static Result action_url_install_close_dst(void* data, u32 index, bool succeeded
                 }
             }
         } else {
-            if(R_SUCCEEDED(res = AM_FinishCiaInstall(handle))) {
-                util_import_seed(NULL, installData->currTitleId);
+            util_import_seed(NULL, installData->currTitleId);
 
-                if(installData->currTitleId == 0x0004013800000002 || installData->currTitleId == 0x0004013820000002) {
-                    res = AM_InstallFirm(installData->currTitleId);
-                }
+            if(installData->currTitleId == 0x0004013800000002 || installData->currTitleId == 0x0004013820000002) {
+                res = AM_InstallFirm(installData->currTitleId);
             }
         }
-
-        return res;
-    } else {
-        if(installData->ticket) {
-            return AM_InstallTicketAbort(handle);
-        } else {
-            return AM_CancelCIAInstall(handle);
-        }
     }
-}
 
-static Result action_url_install_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Write(handle, bytesWritten, offset, buffer, size, 0);
+    return res;
 }
 
 static Result action_url_install_suspend(void* data, u32 index) {
@@ -237,6 +192,19 @@ static bool action_url_install_error(void* data, u32 index, Result res) {
     return index < installData->installInfo.total - 1;
 }
 
+// Batch installs show this in their summary instead of stopping on action_url_install_error.
+static void action_url_install_describe_error(void* data, u32 index, Result res, char* message, size_t size) {
+    url_install_data* installData = (url_install_data*) data;
+
+    if(res == R_FBI_HTTP_RESPONSE_CODE) {
+        snprintf(message, size, "HTTP server returned response code %lu", installData->responseCode);
+    } else if(res == R_FBI_WRONG_SYSTEM) {
+        string_copy(message, "Title is intended for New 3DS systems.", size);
+    } else {
+        string_copy(message, error_get_description(res), size);
+    }
+}
+
 static void action_url_install_install_update(ui_view* view, void* data, float* progress, char* text) {
     url_install_data* installData = (url_install_data*) data;
 
@@ -336,17 +304,22 @@ void action_url_install(const char* confirmMessage, const char* urls, void* fini
     data->installInfo.op = DATAOP_DOWNLOAD;
 
     data->installInfo.copyBufferSize = 128 * 1024;
+    data->installInfo.downloadConnections = HTTP_SEGMENTED_CONNECTIONS_DEFAULT;
+    data->installInfo.prefetchMemory = DATAOP_PREFETCH_MEMORY_DEFAULT;
 
     data->installInfo.getSrcUrl = action_url_install_get_src_url;
 
     data->installInfo.openDst = action_url_install_open_dst;
     data->installInfo.closeDst = action_url_install_close_dst;
-    data->installInfo.writeDst = action_url_install_write_dst;
 
     data->installInfo.suspend = action_url_install_suspend;
     data->installInfo.restore = action_url_install_restore;
 
     data->installInfo.error = action_url_install_error;
+    data->installInfo.describeError = action_url_install_describe_error;
+
+    // Multi-URL installs are often left running unattended; don't stop on every failure.
+    data->installInfo.batch = data->installInfo.total > 1;
 
     data->installInfo.finished = true;
 
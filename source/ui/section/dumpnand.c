@@ -11,9 +11,17 @@
 #include "../info.h"
 #include "../prompt.h"
 #include "../ui.h"
+#include "../../core/io.h"
 #include "../../core/screen.h"
+#include "../../core/stringutil.h"
 #include "../../core/util.h"
 
+typedef struct {
+    char path[FILE_PATH_MAX];
+
+    data_op_data dumpInfo;
+} dump_nand_data;
+
 static Result dumpnand_is_src_directory(void* data, u32 index, bool* isDirectory) {
     *isDirectory = false;
     return 0;
@@ -23,23 +31,22 @@ static Result dumpnand_make_dst_directory(void* data, u32 index) {
     return 0;
 }
 
-static Result dumpnand_open_src(void* data, u32 index, u32* handle) {
-    return FSUSER_OpenFileDirectly(handle, ARCHIVE_NAND_W_FS, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_UTF16, u"/"), FS_OPEN_READ, 0);
+static Result dumpnand_open_src(void* data, u32 index, io_stream** stream) {
+    return io_open_file_directly(stream, ARCHIVE_NAND_W_FS, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_UTF16, u"/"), FS_OPEN_READ);
 }
 
-static Result dumpnand_close_src(void* data, u32 index, bool succeeded, u32 handle) {
-    return FSFILE_Close(handle);
-}
+// NAND is written to on every boot, so a dump may only be resumed within the boot that started it. The boot time is
+// rounded to the minute to absorb clock jitter; a mismatch just means starting over.
+static Result dumpnand_get_src_identity(void* data, u32 index, char* identity, size_t maxSize) {
+    u64 bootTime = osGetTime() - svcGetSystemTick() / (u64) (SYSCLOCK_ARM11 / 1000);
 
-static Result dumpnand_get_src_size(void* data, u32 handle, u64* size) {
-    return FSFILE_GetSize(handle, size);
+    snprintf(identity, maxSize, "nand@%llu", bootTime / 60000);
+    return 0;
 }
 
-static Result dumpnand_read_src(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Read(handle, bytesRead, offset, buffer, size);
-}
+static Result dumpnand_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    dump_nand_data* dumpData = (dump_nand_data*) data;
 
-static Result dumpnand_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle) {
     Result res = 0;
 
     FS_Archive sdmcArchive = 0;
@@ -48,17 +55,9 @@ static Result dumpnand_open_dst(void* data, u32 index, void* initialReadBlock, u
             time_t t = time(NULL);
             struct tm* timeInfo = localtime(&t);
 
-            char path[FILE_PATH_MAX];
-            strftime(path, sizeof(path), "/fbi/nand/NAND_%m-%d-%y_%H-%M-%S.bin", timeInfo);
-
-            FS_Path* fsPath = util_make_path_utf8(path);
-            if(fsPath != NULL) {
-                res = FSUSER_OpenFileDirectly(handle, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), *fsPath, FS_OPEN_WRITE | FS_OPEN_CREATE, 0);
+            strftime(dumpData->path, sizeof(dumpData->path), "/fbi/nand/NAND_%m-%d-%y_%H-%M-%S.bin", timeInfo);
 
-                util_free_path_utf8(fsPath);
-            } else {
-                res = R_FBI_OUT_OF_MEMORY;
-            }
+            res = io_open_sd_file(stream, dumpData->path, FS_OPEN_WRITE | FS_OPEN_CREATE);
         }
 
         FSUSER_CloseArchive(sdmcArchive);
@@ -67,12 +66,21 @@ static Result dumpnand_open_dst(void* data, u32 index, void* initialReadBlock, u
     return res;
 }
 
-static Result dumpnand_close_dst(void* data, u32 index, bool succeeded, u32 handle) {
-    return FSFILE_Close(handle);
+static Result dumpnand_get_dst_identity(void* data, u32 index, io_stream* dst, char* identity, size_t maxSize) {
+    string_copy(identity, ((dump_nand_data*) data)->path, maxSize);
+    return 0;
 }
 
-static Result dumpnand_write_dst(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
-    return FSFILE_Write(handle, bytesWritten, offset, buffer, size, 0);
+static Result dumpnand_resume_dst(void* data, u32 index, const char* identity, io_stream** stream) {
+    dump_nand_data* dumpData = (dump_nand_data*) data;
+
+    Result res = 0;
+
+    if(R_SUCCEEDED(res = io_open_sd_file(stream, identity, FS_OPEN_READ | FS_OPEN_WRITE))) {
+        string_copy(dumpData->path, identity, sizeof(dumpData->path));
+    }
+
+    return res;
 }
 
 static Result dumpnand_suspend(void* data, u32 index) {
@@ -94,13 +102,13 @@ static bool dumpnand_error(void* data, u32 index, Result res) {
 }
 
 static void dumpnand_update(ui_view* view, void* data, float* progress, char* text) {
-    data_op_data* dumpData = (data_op_data*) data;
+    dump_nand_data* dumpData = (dump_nand_data*) data;
 
-    if(dumpData->finished) {
+    if(dumpData->dumpInfo.finished) {
         ui_pop();
         info_destroy(view);
 
-        if(R_SUCCEEDED(dumpData->result)) {
+        if(R_SUCCEEDED(dumpData->dumpInfo.result)) {
             prompt_display("Success", "NAND dumped.", COLOR_TEXT, false, NULL, NULL, NULL);
         }
 
@@ -110,18 +118,18 @@ static void dumpnand_update(ui_view* view, void* data, float* progress, char* te
     }
 
     if(hidKeysDown() & KEY_B) {
-        svcSignalEvent(dumpData->cancelEvent);
+        svcSignalEvent(dumpData->dumpInfo.cancelEvent);
     }
 
-    *progress = dumpData->currTotal != 0 ? (float) ((double) dumpData->currProcessed / (double) dumpData->currTotal) : 0;
-    snprintf(text, PROGRESS_TEXT_MAX, "%.2f %s / %.2f %s\n%.2f %s/s", util_get_display_size(dumpData->currProcessed), util_get_display_size_units(dumpData->currProcessed), util_get_display_size(dumpData->currTotal), util_get_display_size_units(dumpData->currTotal), util_get_display_size(dumpData->bytesPerSecond), util_get_display_size_units(dumpData->bytesPerSecond));
+    *progress = dumpData->dumpInfo.currTotal != 0 ? (float) ((double) dumpData->dumpInfo.currProcessed / (double) dumpData->dumpInfo.currTotal) : 0;
+    snprintf(text, PROGRESS_TEXT_MAX, "%.2f %s / %.2f %s\n%.2f %s/s", util_get_display_size(dumpData->dumpInfo.currProcessed), util_get_display_size_units(dumpData->dumpInfo.currProcessed), util_get_display_size(dumpData->dumpInfo.currTotal), util_get_display_size_units(dumpData->dumpInfo.currTotal), util_get_display_size(dumpData->dumpInfo.bytesPerSecond), util_get_display_size_units(dumpData->dumpInfo.bytesPerSecond));
 }
 
 static void dumpnand_onresponse(ui_view* view, void* data, bool response) {
     if(response) {
-        data_op_data* dumpData = (data_op_data*) data;
+        dump_nand_data* dumpData = (dump_nand_data*) data;
 
-        Result res = task_data_op(dumpData);
+        Result res = task_data_op(&dumpData->dumpInfo);
         if(R_SUCCEEDED(res)) {
             info_display("Dumping NAND", "Press B to cancel.", true, data, dumpnand_update, NULL);
         } else {
@@ -134,40 +142,41 @@ static void dumpnand_onresponse(ui_view* view, void* data, bool response) {
 }
 
 void dumpnand_open() {
-    data_op_data* data = (data_op_data*) calloc(1, sizeof(data_op_data));
+    dump_nand_data* data = (dump_nand_data*) calloc(1, sizeof(dump_nand_data));
     if(data == NULL) {
         error_display(NULL, NULL, "Failed to allocate dump NAND data.");
 
         return;
     }
 
-    data->data = data;
+    data->dumpInfo.data = data;
 
-    data->op = DATAOP_COPY;
+    data->dumpInfo.op = DATAOP_COPY;
 
-    data->bufferSize = 256 * 1024;
-    data->copyEmpty = true;
+    data->dumpInfo.bufferSize = 256 * 1024;
+    data->dumpInfo.bufferCount = 4;
+    data->dumpInfo.bufferSizeKey = "dump_nand";
+    data->dumpInfo.copyEmpty = true;
 
-    data->total = 1;
+    data->dumpInfo.total = 1;
 
-    data->isSrcDirectory = dumpnand_is_src_directory;
-    data->makeDstDirectory = dumpnand_make_dst_directory;
+    data->dumpInfo.isSrcDirectory = dumpnand_is_src_directory;
+    data->dumpInfo.makeDstDirectory = dumpnand_make_dst_directory;
 
-    data->openSrc = dumpnand_open_src;
-    data->closeSrc = dumpnand_close_src;
-    data->getSrcSize = dumpnand_get_src_size;
-    data->readSrc = dumpnand_read_src;
+    data->dumpInfo.openSrc = dumpnand_open_src;
+    data->dumpInfo.openDst = dumpnand_open_dst;
 
-    data->openDst = dumpnand_open_dst;
-    data->closeDst = dumpnand_close_dst;
-    data->writeDst = dumpnand_write_dst;
+    data->dumpInfo.journalName = "dumpnand";
+    data->dumpInfo.getSrcIdentity = dumpnand_get_src_identity;
+    data->dumpInfo.getDstIdentity = dumpnand_get_dst_identity;
+    data->dumpInfo.resumeDst = dumpnand_resume_dst;
 
-    data->suspend = dumpnand_suspend;
-    data->restore = dumpnand_restore;
+    data->dumpInfo.suspend = dumpnand_suspend;
+    data->dumpInfo.restore = dumpnand_restore;
 
-    data->error = dumpnand_error;
+    data->dumpInfo.error = dumpnand_error;
 
-    data->finished = true;
+    data->dumpInfo.finished = true;
 
     prompt_display("Confirmation", "Dump raw NAND image to the SD card?", COLOR_TEXT, true, data, NULL, dumpnand_onresponse);
 }
\ No newline at end of file
@@ -19,6 +19,7 @@
 static list_item rename_opt = {"Rename", COLOR_TEXT, action_rename};
 static list_item copy = {"Copy", COLOR_TEXT, NULL};
 static list_item paste = {"Paste", COLOR_TEXT, action_paste_contents};
+static list_item paste_sync = {"Sync paste", COLOR_TEXT, action_paste_contents_sync};
 
 static list_item delete_file = {"Delete", COLOR_TEXT, action_delete_file};
 
@@ -147,6 +148,7 @@ static void files_action_update(ui_view* view, void* data, linked_list* items, l
         linked_list_add(items, &rename_opt);
         linked_list_add(items, &copy);
         linked_list_add(items, &paste);
+        linked_list_add(items, &paste_sync);
     }
 }
 
@@ -376,6 +378,7 @@ void files_open(FS_ArchiveID archiveId, FS_Path archivePath) {
 
     data->populateData.recursive = false;
     data->populateData.includeBase = true;
+    data->populateData.deferIcons = true;
 
     data->populateData.filter = files_filter;
     data->populateData.filterData = data;
@@ -417,7 +420,7 @@ void files_open(FS_ArchiveID archiveId, FS_Path archivePath) {
         return;
     }
 
-    list_display("Files", "A: Select, B: Back, X: Refresh, Select: Options", data, files_update, files_draw_top);
+    list_set_icon_ops(list_display("Files", "A: Select, B: Back, X: Refresh, Select: Options", data, files_update, files_draw_top), &task_file_icon_ops, 1);
 }
 
 static void files_open_nand_warning_onresponse(ui_view* view, void* data, bool response) {
@@ -0,0 +1,364 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <3ds.h>
+
+#include "section.h"
+#include "task/task.h"
+#include "../error.h"
+#include "../info.h"
+#include "../prompt.h"
+#include "../ui.h"
+#include "../../core/http.h"
+#include "../../core/io.h"
+#include "../../core/job.h"
+#include "../../core/screen.h"
+#include "../../core/stringutil.h"
+#include "../../core/util.h"
+
+#define JOBS_DIR "/fbi/jobs/"
+#define JOBS_MAX 32
+
+typedef struct {
+    char paths[JOBS_MAX][FILE_PATH_MAX];
+    u32 total;
+    u32 processed;
+    u32 failed;
+
+    job* currJob;
+    data_op_data op;
+
+    io_stream* log;
+    u64 logOffset;
+
+    volatile bool cancelled;
+    volatile bool finished;
+} jobs_data;
+
+static job_step* jobs_get_step(jobs_data* data) {
+    return &data->currJob->steps[data->currJob->currStep];
+}
+
+static Result jobs_delete_sd(const char* path, bool recursive) {
+    Result res = 0;
+
+    FS_Path* fsPath = util_make_path_utf8(path);
+    if(fsPath != NULL) {
+        FS_Archive sdmcArchive = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+            if(R_FAILED(res = FSUSER_DeleteFile(sdmcArchive, *fsPath)) && recursive) {
+                res = FSUSER_DeleteDirectoryRecursively(sdmcArchive, *fsPath);
+            }
+
+            FSUSER_CloseArchive(sdmcArchive);
+        }
+
+        util_free_path_utf8(fsPath);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+static Result jobs_is_src_directory(void* data, u32 index, bool* isDirectory) {
+    *isDirectory = false;
+    return 0;
+}
+
+static Result jobs_make_dst_directory(void* data, u32 index) {
+    return 0;
+}
+
+static Result jobs_open_src(void* data, u32 index, io_stream** stream) {
+    job_step* step = jobs_get_step((jobs_data*) data);
+
+    switch(step->op) {
+        case JOB_OP_DUMP_NAND:
+            return io_open_file_directly(stream, ARCHIVE_NAND_W_FS, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_UTF16, u"/"), FS_OPEN_READ);
+        case JOB_OP_EXPORT_SAVE:
+            return io_open_spi_save(stream);
+        default:
+            return io_open_sd_file(stream, step->src, FS_OPEN_READ);
+    }
+}
+
+static Result jobs_open_dst(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream) {
+    job_step* step = jobs_get_step((jobs_data*) data);
+
+    if(step->op == JOB_OP_INSTALL_CIA || step->op == JOB_OP_INSTALL_URL) {
+        return io_open_cia_install(stream, step->nand ? MEDIATYPE_NAND : MEDIATYPE_SD, step->verify);
+    }
+
+    jobs_delete_sd(step->dst, false);
+    return io_open_sd_file(stream, step->dst, FS_OPEN_WRITE | FS_OPEN_CREATE);
+}
+
+static Result jobs_get_src_url(void* data, u32 index, char* url, size_t maxSize) {
+    string_copy(url, jobs_get_step((jobs_data*) data)->src, maxSize);
+    return 0;
+}
+
+static Result jobs_delete(void* data, u32 index) {
+    return jobs_delete_sd(jobs_get_step((jobs_data*) data)->src, true);
+}
+
+static void jobs_log(void* data, const char* line) {
+    jobs_data* jobsData = (jobs_data*) data;
+
+    if(jobsData->log == NULL) {
+        return;
+    }
+
+    char buffer[JOB_PATH_MAX * 2 + 64];
+    int len = snprintf(buffer, sizeof(buffer), "%s\n", line);
+    if(len > (int) sizeof(buffer) - 1) {
+        len = sizeof(buffer) - 1;
+    }
+
+    u32 bytesWritten = 0;
+    if(R_SUCCEEDED(io_write(jobsData->log, &bytesWritten, buffer, jobsData->logOffset, (u32) len))) {
+        jobsData->logOffset += bytesWritten;
+    }
+}
+
+static u64 jobs_now(void* data) {
+    return osGetTime();
+}
+
+static Result jobs_run_step(void* data, job* j, job_step* step, u64* bytes) {
+    jobs_data* jobsData = (jobs_data*) data;
+    data_op_data* op = &jobsData->op;
+
+    memset(op, 0, sizeof(*op));
+
+    op->data = jobsData;
+    op->total = 1;
+    op->bufferSize = j->bufferSize;
+    op->copyEmpty = true;
+
+    op->batch = true;
+    op->headless = true;
+
+    if(step->op == JOB_OP_INSTALL_URL) {
+        op->op = DATAOP_DOWNLOAD;
+        op->downloadConnections = HTTP_SEGMENTED_CONNECTIONS_DEFAULT;
+        op->getSrcUrl = jobs_get_src_url;
+        op->openDst = jobs_open_dst;
+    } else if(step->op == JOB_OP_DELETE) {
+        op->op = DATAOP_DELETE;
+        op->delete = jobs_delete;
+    } else {
+        op->op = DATAOP_COPY;
+        op->isSrcDirectory = jobs_is_src_directory;
+        op->makeDstDirectory = jobs_make_dst_directory;
+        op->openSrc = jobs_open_src;
+        op->openDst = jobs_open_dst;
+    }
+
+    Result res = task_data_op_run(op);
+
+    for(u32 phase = 0; phase < DATAOP_PHASE_COUNT; phase++) {
+        data_op_histogram* histogram = &op->histograms[phase];
+        if(histogram->count > 0) {
+            char line[128];
+            snprintf(line, sizeof(line), "  %s: %lu calls, %llu ms, p50 %llu us, p99 %llu us, max %llu us", task_trace_phase_name((data_op_phase) phase), histogram->count,
+                     histogram->totalUs / 1000, task_trace_histogram_percentile(histogram, 50), task_trace_histogram_percentile(histogram, 99), histogram->maxUs);
+            jobs_log(jobsData, line);
+        }
+    }
+
+    *bytes = op->currProcessed;
+    return res;
+}
+
+static bool jobs_cancelled(void* data) {
+    return ((jobs_data*) data)->cancelled || task_is_quit_all();
+}
+
+static const job_backend jobs_backend = {
+    .now = jobs_now,
+    .run = jobs_run_step,
+    .log = jobs_log,
+    .cancelled = jobs_cancelled
+};
+
+static void jobs_open_log(jobs_data* data, const char* jobPath) {
+    char logPath[FILE_PATH_MAX];
+    string_copy(logPath, jobPath, sizeof(logPath));
+
+    char* extension = strrchr(logPath, '.');
+    if(extension != NULL) {
+        *extension = '\0';
+    }
+
+    strncat(logPath, ".log", sizeof(logPath) - strlen(logPath) - 1);
+
+    jobs_delete_sd(logPath, false);
+
+    data->log = NULL;
+    data->logOffset = 0;
+    io_open_sd_file(&data->log, logPath, FS_OPEN_WRITE | FS_OPEN_CREATE);
+}
+
+static void jobs_thread(void* arg) {
+    jobs_data* data = (jobs_data*) arg;
+
+    job* j = (job*) calloc(1, sizeof(job));
+    if(j != NULL) {
+        for(data->processed = 0; data->processed < data->total && !jobs_cancelled(data); data->processed++) {
+            const char* path = data->paths[data->processed];
+
+            jobs_open_log(data, path);
+
+            Result res = 0;
+
+            io_stream* stream = NULL;
+            if(R_SUCCEEDED(res = io_open_sd_file(&stream, path, FS_OPEN_READ))) {
+                res = job_load(j, stream);
+                io_close(stream, true);
+            }
+
+            if(R_SUCCEEDED(res)) {
+                data->currJob = j;
+                res = job_run(j, &jobs_backend, data);
+                data->currJob = NULL;
+            } else {
+                char line[FILE_PATH_MAX + 64];
+                snprintf(line, sizeof(line), "failed to load %s: 0x%08lX", path, res);
+                jobs_log(data, line);
+            }
+
+            if(R_FAILED(res)) {
+                data->failed++;
+            }
+
+            if(data->log != NULL) {
+                io_close(data->log, true);
+                data->log = NULL;
+            }
+        }
+
+        free(j);
+    } else {
+        data->failed = data->total;
+    }
+
+    data->finished = true;
+}
+
+static void jobs_update(ui_view* view, void* data, float* progress, char* text) {
+    jobs_data* jobsData = (jobs_data*) data;
+
+    if(jobsData->finished) {
+        ui_pop();
+        info_destroy(view);
+
+        if(jobsData->cancelled) {
+            prompt_display("Failure", "Jobs cancelled.", COLOR_TEXT, false, NULL, NULL, NULL);
+        } else if(jobsData->failed > 0) {
+            error_display(NULL, NULL, "%lu of %lu job(s) failed.\nSee the logs in " JOBS_DIR " for details.", jobsData->failed, jobsData->total);
+        } else {
+            prompt_display("Success", "Jobs finished.\nLogs written to " JOBS_DIR ".", COLOR_TEXT, false, NULL, NULL, NULL);
+        }
+
+        free(jobsData);
+
+        return;
+    }
+
+    if(hidKeysDown() & KEY_B) {
+        jobsData->cancelled = true;
+
+        if(!jobsData->op.finished && jobsData->op.cancelEvent != 0) {
+            svcSignalEvent(jobsData->op.cancelEvent);
+        }
+    }
+
+    job* currJob = jobsData->currJob;
+    if(currJob != NULL && currJob->currStep < currJob->stepCount) {
+        *progress = jobsData->op.currTotal != 0 ? (float) ((double) jobsData->op.currProcessed / (double) jobsData->op.currTotal) : 0;
+        snprintf(text, PROGRESS_TEXT_MAX, "Job %lu / %lu: %s\nStep %lu / %lu: %s\n%.2f %s / %.2f %s\n%.2f %s/s", jobsData->processed + 1, jobsData->total, currJob->name,
+                 currJob->currStep + 1, currJob->stepCount, job_op_name(currJob->steps[currJob->currStep].op),
+                 util_get_display_size(jobsData->op.currProcessed), util_get_display_size_units(jobsData->op.currProcessed),
+                 util_get_display_size(jobsData->op.currTotal), util_get_display_size_units(jobsData->op.currTotal),
+                 util_get_display_size(jobsData->op.bytesPerSecond), util_get_display_size_units(jobsData->op.bytesPerSecond));
+    } else {
+        *progress = 0;
+        snprintf(text, PROGRESS_TEXT_MAX, "Job %lu / %lu", jobsData->processed + 1, jobsData->total);
+    }
+}
+
+static void jobs_onresponse(ui_view* view, void* data, bool response) {
+    jobs_data* jobsData = (jobs_data*) data;
+
+    if(response) {
+        Result res = task_submit("Job runner", TASK_PRIORITY_BACKGROUND, jobs_thread, jobsData);
+        if(R_SUCCEEDED(res)) {
+            info_display("Running Jobs", "Press B to cancel.", true, jobsData, jobs_update, NULL);
+        } else {
+            error_display_res(NULL, NULL, res, "Failed to start jobs.");
+            free(jobsData);
+        }
+    } else {
+        free(jobsData);
+    }
+}
+
+static Result jobs_find(jobs_data* data) {
+    Result res = 0;
+
+    FS_Archive sdmcArchive = 0;
+    if(R_SUCCEEDED(res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        Handle dirHandle = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenDirectory(&dirHandle, sdmcArchive, fsMakePath(PATH_ASCII, JOBS_DIR)))) {
+            FS_DirectoryEntry entry;
+
+            u32 entriesRead = 0;
+            while(data->total < JOBS_MAX && R_SUCCEEDED(FSDIR_Read(dirHandle, &entriesRead, 1, &entry)) && entriesRead > 0) {
+                if(entry.attributes & FS_ATTRIBUTE_DIRECTORY) {
+                    continue;
+                }
+
+                char name[FILE_NAME_MAX] = {'\0'};
+                utf16_to_utf8((uint8_t*) name, entry.name, sizeof(name) - 1);
+
+                size_t len = strlen(name);
+                if(len > 5 && strcasecmp(&name[len - 5], ".json") == 0) {
+                    snprintf(data->paths[data->total++], FILE_PATH_MAX, JOBS_DIR "%s", name);
+                }
+            }
+
+            FSDIR_Close(dirHandle);
+        }
+
+        FSUSER_CloseArchive(sdmcArchive);
+    }
+
+    return res;
+}
+
+void jobs_open() {
+    jobs_data* data = (jobs_data*) calloc(1, sizeof(jobs_data));
+    if(data == NULL) {
+        error_display(NULL, NULL, "Failed to allocate jobs data.");
+
+        return;
+    }
+
+    data->op.finished = true;
+
+    Result res = jobs_find(data);
+    if(R_FAILED(res) || data->total == 0) {
+        prompt_display("Failure", "No job files found in " JOBS_DIR ".", COLOR_TEXT, false, NULL, NULL, NULL);
+        free(data);
+
+        return;
+    }
+
+    static char message[64];
+    snprintf(message, sizeof(message), "Run %lu job(s) from " JOBS_DIR "?", data->total);
+
+    prompt_display("Confirmation", message, COLOR_TEXT, true, data, NULL, jobs_onresponse);
+}
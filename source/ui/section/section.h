@@ -8,9 +8,11 @@ void files_open_ctr_nand();
 void files_open_twl_nand();
 void files_open_twl_photo();
 void files_open_twl_sound();
+void jobs_open();
 void pendingtitles_open();
 void remoteinstall_open();
 void systemsavedata_open();
+void taskmetrics_open();
 void tickets_open();
 void titles_open();
 void titledb_open();
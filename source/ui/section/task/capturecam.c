@@ -125,9 +125,7 @@ Result task_capture_cam(capture_cam_data* data) {
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY)) && R_SUCCEEDED(res = svcCreateMutex(&data->mutex, false))) {
-        if(threadCreate(task_capture_cam_thread, data, 0x10000, 0x1A, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("Camera capture", TASK_PRIORITY_BACKGROUND, task_capture_cam_thread, data);
     }
 
     if(R_FAILED(res)) {
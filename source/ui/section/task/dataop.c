@@ -1,327 +1,1569 @@
 #include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef FBI_HOST
+#include "../../../core/iohost.h"
+#else
 #include <3ds.h>
-#include <jansson.h>
+#endif
+
+#include <zlib.h>
 
 #include "task.h"
-#include "../../../core/core.h"
+#include "../../error.h"
 #include "../../prompt.h"
+#include "../../ui.h"
+#include "../../../core/bandwidth.h"
+#include "../../../core/bufpool.h"
+#include "../../../core/http.h"
+#include "../../../core/io.h"
+#include "../../../core/screen.h"
+#include "../../../core/stringutil.h"
+#include "../../../core/util.h"
+
+// State of the item being processed. Pool workers each keep their own and only share the operation's settings and
+// callbacks; the serial path's item also tunes the buffer size, journals and shows its progress on the operation.
+typedef struct {
+    data_op_data* data;
+    u32 index;
+
+    u64 currProcessed;
+    u64 currTotal;
+
+    // What the pool reads of a worker's progress while the item runs.
+    u64 shownProcessed;
+    u64 shownTotal;
+
+    u64 copiedBytes;
+    u64 skippedBytes;
+
+    data_op_histogram* histograms;
+
+    bool serial;
+} data_op_item;
+
+static void task_data_op_item_progress(data_op_item* item) {
+    if(item->serial) {
+        item->data->currProcessed = item->currProcessed;
+        item->data->currTotal = item->currTotal;
+    } else {
+        __atomic_store_n(&item->shownProcessed, item->currProcessed, __ATOMIC_RELAXED);
+        __atomic_store_n(&item->shownTotal, item->currTotal, __ATOMIC_RELAXED);
+    }
+}
+
+// Times one phase of an item into the item's latency histograms and, when enabled, the operation's trace.
+static void task_data_op_phase_end(data_op_item* item, data_op_phase phase, u64 start, u32 bytes) {
+    u64 end = svcGetSystemTick();
+
+    task_trace_histogram_add(&item->histograms[phase], (end - start) * 1000000 / SYSCLOCK_ARM11, bytes);
+
+    if(item->data->trace != NULL) {
+        task_trace_record(item->data->trace, phase, item->index, start, end, bytes);
+    }
+}
+
+static Result task_data_op_check_running(data_op_item* item) {
+    data_op_data* data = item->data;
 
-static Result task_data_op_check_running(data_op_data* data) {
     Result res = 0;
 
+    u64 start = svcGetSystemTick();
+
     if(task_is_quit_all() || svcWaitSynchronization(data->cancelEvent, 0) == 0) {
         res = R_FBI_CANCELLED;
     } else {
         bool suspended = svcWaitSynchronization(task_get_suspend_event(), 0) != 0;
+
+        // Pool workers share the suspend callbacks; the first to get here runs them for everyone, and the others
+        // find the suspend over once they get the lock.
+        bool locked = suspended && data->suspendLock != 0;
+        if(locked) {
+            svcWaitSynchronization(data->suspendLock, U64_MAX);
+            suspended = svcWaitSynchronization(task_get_suspend_event(), 0) != 0;
+        }
+
         if(suspended) {
             if(data->suspend != NULL && R_SUCCEEDED(res)) {
-                res = data->suspend(data->data, data->processed);
+                res = data->suspend(data->data, item->index);
+            }
+        }
+
+        svcWaitSynchronization(task_get_pause_event(), U64_MAX);
+
+        if(suspended) {
+            if(data->restore != NULL && R_SUCCEEDED(res)) {
+                res = data->restore(data->data, item->index);
+            }
+        }
+
+        if(locked) {
+            svcReleaseMutex(data->suspendLock);
+        }
+    }
+
+    task_data_op_phase_end(item, DATAOP_PHASE_CHECK_RUNNING, start, 0);
+
+    return res;
+}
+
+static Result task_data_op_open_src(data_op_item* item, io_stream** src) {
+    u64 start = svcGetSystemTick();
+
+    Result res = item->data->openSrc(item->data->data, item->index, src);
+
+    task_data_op_phase_end(item, DATAOP_PHASE_OPEN_SRC, start, 0);
+
+    return res;
+}
+
+static Result task_data_op_close_src(data_op_item* item, bool succeeded, io_stream* src) {
+    Result res = 0;
+
+    u64 start = svcGetSystemTick();
+
+    if(item->data->closeSrc != NULL) {
+        res = item->data->closeSrc(item->data->data, item->index, succeeded, src);
+    } else {
+        res = io_close(src, succeeded);
+    }
+
+    task_data_op_phase_end(item, DATAOP_PHASE_CLOSE_SRC, start, 0);
+
+    return res;
+}
+
+static Result task_data_op_read_src(data_op_item* item, io_stream* src, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    u64 start = svcGetSystemTick();
+
+    Result res = io_read(src, bytesRead, buffer, offset, size);
+
+    task_data_op_phase_end(item, DATAOP_PHASE_READ, start, R_SUCCEEDED(res) ? *bytesRead : 0);
+
+    return res;
+}
+
+static Result task_data_op_open_dst(data_op_item* item, void* initialReadBlock, u64 size, io_stream** dst) {
+    u64 start = svcGetSystemTick();
+
+    Result res = item->data->openDst(item->data->data, item->index, initialReadBlock, size, dst);
+
+    task_data_op_phase_end(item, DATAOP_PHASE_OPEN_DST, start, 0);
+
+    return res;
+}
+
+static Result task_data_op_close_dst(data_op_item* item, bool succeeded, io_stream* dst) {
+    Result res = 0;
+
+    u64 start = svcGetSystemTick();
+
+    if(item->data->closeDst != NULL) {
+        res = item->data->closeDst(item->data->data, item->index, succeeded, dst);
+    } else {
+        res = io_close(dst, succeeded);
+    }
+
+    task_data_op_phase_end(item, DATAOP_PHASE_CLOSE_DST, start, 0);
+
+    return res;
+}
+
+static Result task_data_op_write_dst(data_op_item* item, io_stream* dst, u32* bytesWritten, void* buffer, u64 offset, u32 size) {
+    u64 start = svcGetSystemTick();
+
+    Result res = io_write(dst, bytesWritten, buffer, offset, size);
+
+    task_data_op_phase_end(item, DATAOP_PHASE_WRITE, start, R_SUCCEEDED(res) ? *bytesWritten : 0);
+
+    return res;
+}
+
+#define BUFFER_SIZE_CONFIG_PATH "sdmc:/fbi/buffersize.cfg"
+#define BUFFER_SIZE_CONFIG_MAX 32
+
+#define BUFFER_TUNE_PROBE_MS 250
+
+static const u32 task_data_op_tune_sizes[] = {16 * 1024, 32 * 1024, 64 * 1024, 128 * 1024, 256 * 1024, 512 * 1024};
+
+#define BUFFER_TUNE_SIZE_COUNT (sizeof(task_data_op_tune_sizes) / sizeof(task_data_op_tune_sizes[0]))
+#define BUFFER_TUNE_SIZE_MAX (512 * 1024)
+
+typedef struct {
+    char key[64];
+    u32 size;
+} buffer_size_entry;
+
+static u32 task_data_op_read_buffer_sizes(buffer_size_entry* entries, u32 max) {
+    u32 count = 0;
+
+    FILE* fd = fopen(BUFFER_SIZE_CONFIG_PATH, "rb");
+    if(fd != NULL) {
+        char line[128];
+        while(count < max && fgets(line, sizeof(line), fd) != NULL) {
+            char* newline = strchr(line, '\n');
+            if(newline != NULL) {
+                *newline = '\0';
+            }
+
+            char* equals = strchr(line, '=');
+            if(equals != NULL && (size_t) (equals - line) < sizeof(entries[count].key)) {
+                memset(entries[count].key, '\0', sizeof(entries[count].key));
+                strncpy(entries[count].key, line, equals - line);
+                entries[count].size = strtoul(equals + 1, NULL, 10);
+
+                if(entries[count].size > 0) {
+                    count++;
+                }
+            }
+        }
+
+        fclose(fd);
+    }
+
+    return count;
+}
+
+static bool task_data_op_load_buffer_size(const char* key, u32* size) {
+    buffer_size_entry entries[BUFFER_SIZE_CONFIG_MAX];
+    u32 count = task_data_op_read_buffer_sizes(entries, BUFFER_SIZE_CONFIG_MAX);
+
+    for(u32 i = 0; i < count; i++) {
+        if(strncmp(entries[i].key, key, sizeof(entries[i].key)) == 0) {
+            *size = entries[i].size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void task_data_op_save_buffer_size(const char* key, u32 size) {
+    buffer_size_entry entries[BUFFER_SIZE_CONFIG_MAX];
+    u32 count = task_data_op_read_buffer_sizes(entries, BUFFER_SIZE_CONFIG_MAX);
+
+    u32 i = 0;
+    while(i < count && strncmp(entries[i].key, key, sizeof(entries[i].key)) != 0) {
+        i++;
+    }
+
+    if(i == count) {
+        if(count == BUFFER_SIZE_CONFIG_MAX) {
+            return;
+        }
+
+        count++;
+    }
+
+    string_copy(entries[i].key, key, sizeof(entries[i].key));
+    entries[i].size = size;
+
+#ifndef FBI_HOST
+    FS_Archive sdmcArchive = 0;
+    if(R_SUCCEEDED(FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        util_ensure_dir(sdmcArchive, "/fbi/");
+        FSUSER_CloseArchive(sdmcArchive);
+    }
+#endif
+
+    FILE* fd = fopen(BUFFER_SIZE_CONFIG_PATH, "wb");
+    if(fd != NULL) {
+        for(i = 0; i < count; i++) {
+            fprintf(fd, "%s=%lu\n", entries[i].key, (unsigned long) entries[i].size);
+        }
+
+        fclose(fd);
+    }
+}
+
+static void task_data_op_tune_init(data_op_data* data) {
+    memset(&data->tuning, 0, sizeof(data->tuning));
+
+    if(data->bufferSizeKey != NULL) {
+        u32 size = 0;
+        if(task_data_op_load_buffer_size(data->bufferSizeKey, &size) && size <= BUFFER_TUNE_SIZE_MAX) {
+            data->bufferSize = size;
+        } else {
+            data->tuning.active = true;
+        }
+    }
+}
+
+static bool task_data_op_tuning(data_op_item* item) {
+    return item->serial && item->data->tuning.active;
+}
+
+static u32 task_data_op_alloc_size(data_op_item* item) {
+    return task_data_op_tuning(item) && item->data->bufferSize < BUFFER_TUNE_SIZE_MAX ? BUFFER_TUNE_SIZE_MAX : item->data->bufferSize;
+}
+
+static u32 task_data_op_chunk_size(data_op_item* item) {
+    return task_data_op_tuning(item) ? task_data_op_tune_sizes[item->data->tuning.candidate] : item->data->bufferSize;
+}
+
+static void task_data_op_tune(data_op_item* item, u32 bytes) {
+    if(!task_data_op_tuning(item)) {
+        return;
+    }
+
+    data_op_data* data = item->data;
+    data_op_buffer_tuning* tuning = &data->tuning;
+
+    u64 time = osGetTime();
+
+    // The first chunk of each probe absorbs the cost of switching sizes or items.
+    if(tuning->startTime == 0) {
+        tuning->startTime = time;
+        tuning->bytes = 0;
+        return;
+    }
+
+    tuning->bytes += bytes;
+
+    u64 elapsed = time - tuning->startTime;
+    if(elapsed >= BUFFER_TUNE_PROBE_MS) {
+        u32 bytesPerSecond = (u32) (tuning->bytes * 1000 / elapsed);
+        if(bytesPerSecond > tuning->bestBytesPerSecond) {
+            tuning->bestBytesPerSecond = bytesPerSecond;
+            tuning->bestSize = task_data_op_tune_sizes[tuning->candidate];
+        }
+
+        tuning->candidate++;
+        tuning->startTime = 0;
+
+        if(tuning->candidate >= BUFFER_TUNE_SIZE_COUNT) {
+            tuning->active = false;
+
+            data->bufferSize = tuning->bestSize;
+            task_data_op_save_buffer_size(data->bufferSizeKey, tuning->bestSize);
+        }
+    }
+}
+
+#define JOURNAL_CHECKPOINT_BYTES (4 * 1024 * 1024)
+
+static void task_data_op_resume_onresponse(ui_view* view, void* data, bool response) {
+    ((data_op_data*) data)->resumeResponse = response;
+}
+
+static Result task_data_op_journal_get_src_identity(data_op_data* data, u32 index, char* identity, size_t maxSize) {
+    if(data->op == DATAOP_DOWNLOAD) {
+        return data->getSrcUrl(data->data, index, identity, maxSize);
+    } else if(data->getSrcIdentity != NULL) {
+        return data->getSrcIdentity(data->data, index, identity, maxSize);
+    }
+
+    return R_FBI_NOT_IMPLEMENTED;
+}
+
+static void task_data_op_journal_prepare(data_op_data* data) {
+    data->journalActive = data->journalName != NULL && data->getDstIdentity != NULL && data->resumeDst != NULL;
+    data->journalResume = false;
+    data->journalSequence = 0;
+    data->journalCheckpoint = 0;
+
+    memset(&data->journal, 0, sizeof(data->journal));
+
+    if(!data->journalActive) {
+        return;
+    }
+
+    data_op_journal journal;
+    u32 sequence = 0;
+    if(R_SUCCEEDED(task_journal_load(data->journalName, &journal, &sequence))) {
+        char identity[DOWNLOAD_URL_MAX];
+        if(journal.op == data->op && journal.index < data->total && journal.currProcessed > 0
+           && R_SUCCEEDED(task_data_op_journal_get_src_identity(data, journal.index, identity, sizeof(identity)))
+           && strncmp(identity, journal.srcIdentity, sizeof(identity)) == 0) {
+            // Nobody is there to ask; the source and destination checks decide on their own.
+            data->resumeResponse = data->headless;
+
+            if(!data->headless) {
+                ui_view* view = prompt_display("Confirmation", "Resume interrupted transfer?", COLOR_TEXT, true, data, NULL, task_data_op_resume_onresponse);
+                if(view != NULL) {
+                    svcWaitSynchronization(view->active, U64_MAX);
+                }
+            }
+
+            if(data->resumeResponse) {
+                data->journal = journal;
+                data->journalSequence = sequence + 1;
+                data->journalResume = true;
+                return;
             }
         }
 
-        svcWaitSynchronization(task_get_pause_event(), U64_MAX);
+        task_journal_delete(data->journalName);
+    }
+}
+
+// Reopens an interrupted item's destination once the bytes already written match the journal.
+static bool task_data_op_journal_resume(data_op_item* item, io_stream** dst) {
+    data_op_data* data = item->data;
+
+    if(!item->serial || !data->journalResume || data->journal.index != item->index) {
+        return false;
+    }
+
+    data->journalResume = false;
+
+    if(item->currTotal != 0 && item->currTotal != data->journal.currTotal) {
+        return false;
+    }
+
+    io_stream* stream = NULL;
+    if(R_SUCCEEDED(data->resumeDst(data->data, item->index, data->journal.dstIdentity, &stream))) {
+        if(R_SUCCEEDED(task_journal_verify(stream, data->journal.currProcessed, data->journal.hash, data->bufferSize))) {
+            *dst = stream;
+
+            item->currProcessed = data->journal.currProcessed;
+            task_data_op_item_progress(item);
+
+            data->journalCheckpoint = data->journal.currProcessed;
+
+            return true;
+        }
+
+        task_data_op_close_dst(item, false, stream);
+    }
+
+    return false;
+}
+
+static void task_data_op_journal_begin(data_op_item* item, io_stream* dst) {
+    data_op_data* data = item->data;
+
+    if(!item->serial || !data->journalActive) {
+        return;
+    }
+
+    u32 index = item->index;
+
+    memset(&data->journal, 0, sizeof(data->journal));
+
+    data->journal.op = data->op;
+    data->journal.index = index;
+    data->journal.currTotal = item->currTotal;
+    data->journal.hash = (u32) crc32(0, Z_NULL, 0);
+
+    data->journalCheckpoint = 0;
+
+    if(R_FAILED(task_data_op_journal_get_src_identity(data, index, data->journal.srcIdentity, sizeof(data->journal.srcIdentity)))
+       || R_FAILED(data->getDstIdentity(data->data, index, dst, data->journal.dstIdentity, sizeof(data->journal.dstIdentity)))) {
+        memset(data->journal.dstIdentity, '\0', sizeof(data->journal.dstIdentity));
+    }
+}
+
+static void task_data_op_journal_update(data_op_item* item, void* buffer, u32 size) {
+    data_op_data* data = item->data;
+
+    if(!item->serial || !data->journalActive || data->journal.dstIdentity[0] == '\0') {
+        return;
+    }
+
+    data->journal.hash = (u32) crc32(data->journal.hash, buffer, size);
+    data->journal.currProcessed += size;
+
+    if(data->journal.currProcessed - data->journalCheckpoint >= JOURNAL_CHECKPOINT_BYTES) {
+        if(R_SUCCEEDED(task_journal_save(data->journalName, &data->journal, data->journalSequence))) {
+            data->journalSequence++;
+        }
+
+        data->journalCheckpoint = data->journal.currProcessed;
+    }
+}
+
+static void task_data_op_update_speed(data_op_data* data, u64* ioStartTime, u64* lastBytesPerSecondUpdate, u32* bytesSinceUpdate, u32 bytes) {
+    *bytesSinceUpdate += bytes;
+
+    u64 time = osGetTime();
+    u64 elapsed = time - *lastBytesPerSecondUpdate;
+    if(elapsed >= 1000) {
+        data->bytesPerSecond = (u32) (*bytesSinceUpdate / (elapsed / 1000.0f));
+
+        if(*ioStartTime != 0) {
+            data->estimatedRemainingSeconds = (u32) ((data->currTotal - data->currProcessed) / (data->currProcessed / ((time - *ioStartTime) / 1000.0f)));
+        } else {
+            data->estimatedRemainingSeconds = 0;
+        }
+
+        if(*ioStartTime == 0 && data->currProcessed > 0) {
+            *ioStartTime = time;
+        }
+
+        *bytesSinceUpdate = 0;
+        *lastBytesPerSecondUpdate = time;
+    }
+}
+
+// The transfer loops open the destination on the first block unless it was resumed, and leave it open for the caller.
+// With untilOpened, the serial loop stops once the destination is open.
+static Result task_data_op_copy_serial(data_op_item* item, io_stream* src, io_stream** dst, bool untilOpened) {
+    data_op_data* data = item->data;
+
+    Result res = 0;
+
+    u32 allocSize = task_data_op_alloc_size(item);
+
+    u8* buffer = (u8*) bufpool_alloc(BUFPOOL_HEAP, allocSize);
+    if(buffer != NULL) {
+        u64 ioStartTime = 0;
+        u64 lastBytesPerSecondUpdate = osGetTime();
+        u32 bytesSinceUpdate = 0;
+
+        while(item->currProcessed < item->currTotal) {
+            if(R_FAILED(res = task_data_op_check_running(item))) {
+                break;
+            }
+
+            u32 bytesRead = 0;
+            if(R_FAILED(res = task_data_op_read_src(item, src, &bytesRead, buffer, item->currProcessed, task_data_op_chunk_size(item)))) {
+                break;
+            }
+
+            if(bytesRead == 0) {
+                res = R_FBI_BAD_DATA;
+                break;
+            }
+
+            if(*dst == NULL) {
+                if(R_FAILED(res = task_data_op_open_dst(item, buffer, item->currTotal, dst))) {
+                    break;
+                }
+
+                task_data_op_journal_begin(item, *dst);
+            }
+
+            u32 bytesWritten = 0;
+            if(R_FAILED(res = task_data_op_write_dst(item, *dst, &bytesWritten, buffer, item->currProcessed, bytesRead))) {
+                break;
+            }
+
+            task_data_op_journal_update(item, buffer, bytesWritten);
+
+            item->currProcessed += bytesWritten;
+            task_data_op_item_progress(item);
+
+            if(item->serial) {
+                task_data_op_update_speed(data, &ioStartTime, &lastBytesPerSecondUpdate, &bytesSinceUpdate, bytesWritten);
+            }
+
+            task_data_op_tune(item, bytesWritten);
+
+            if(untilOpened) {
+                break;
+            }
+        }
+
+        bufpool_free(BUFPOOL_HEAP, buffer, allocSize);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+typedef struct {
+    u8* buffer;
+    u64 offset;
+    u32 size;
+} data_op_copy_block;
+
+typedef struct {
+    data_op_item* item;
+    io_stream* src;
+    u64 startOffset;
+
+    data_op_copy_block* blocks;
+    u32 blockCount;
+
+    // Counts blocks the reader may fill and blocks the writer may drain.
+    Handle freeBlocks;
+    Handle filledBlocks;
+
+    volatile bool abort;
+    volatile Result readResult;
+} data_op_copy_pipeline;
+
+static void task_data_op_copy_read_thread(void* arg) {
+    data_op_copy_pipeline* pipeline = (data_op_copy_pipeline*) arg;
+    data_op_item* item = pipeline->item;
+
+    bandwidth_set_class(BANDWIDTH_CLASS_INSTALL);
+
+    u64 offset = pipeline->startOffset;
+    u32 curr = 0;
+    while(offset < item->currTotal) {
+        svcWaitSynchronization(pipeline->freeBlocks, U64_MAX);
+        if(pipeline->abort) {
+            break;
+        }
+
+        // The writer handles suspend callbacks; the reader only needs to stop touching the source.
+        svcWaitSynchronization(task_get_pause_event(), U64_MAX);
+
+        data_op_copy_block* block = &pipeline->blocks[curr];
+        block->offset = offset;
+        block->size = 0;
+
+        Result res = task_data_op_read_src(item, pipeline->src, &block->size, block->buffer, offset, task_data_op_chunk_size(item));
+        if(R_SUCCEEDED(res) && block->size == 0) {
+            res = R_FBI_BAD_DATA;
+        }
+
+        if(R_FAILED(res)) {
+            pipeline->readResult = res;
+        }
+
+        s32 count = 0;
+        svcReleaseSemaphore(&count, pipeline->filledBlocks, 1);
+
+        if(R_FAILED(res)) {
+            break;
+        }
+
+        offset += block->size;
+        curr = (curr + 1) % pipeline->blockCount;
+    }
+}
+
+static Result task_data_op_copy_pipelined(data_op_item* item, io_stream* src, io_stream** dst) {
+    data_op_data* data = item->data;
+
+    Result res = 0;
+
+    data_op_copy_pipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+
+    pipeline.item = item;
+    pipeline.src = src;
+    pipeline.startOffset = item->currProcessed;
+    pipeline.blockCount = data->bufferCount;
+
+    u32 allocSize = task_data_op_alloc_size(item);
+
+    pipeline.blocks = (data_op_copy_block*) calloc(pipeline.blockCount, sizeof(data_op_copy_block));
+    if(pipeline.blocks != NULL) {
+        for(u32 i = 0; i < pipeline.blockCount && R_SUCCEEDED(res); i++) {
+            if((pipeline.blocks[i].buffer = (u8*) bufpool_alloc(BUFPOOL_HEAP, allocSize)) == NULL) {
+                res = R_FBI_OUT_OF_MEMORY;
+            }
+        }
+
+        if(R_SUCCEEDED(res)
+           && R_SUCCEEDED(res = svcCreateSemaphore(&pipeline.freeBlocks, (s32) pipeline.blockCount, (s32) pipeline.blockCount + 1))
+           && R_SUCCEEDED(res = svcCreateSemaphore(&pipeline.filledBlocks, 0, (s32) pipeline.blockCount + 1))) {
+            Thread readThread = threadCreate(task_data_op_copy_read_thread, &pipeline, 0x4000, 0x18, 1, false);
+            if(readThread != NULL) {
+                u64 ioStartTime = 0;
+                u64 lastBytesPerSecondUpdate = osGetTime();
+                u32 bytesSinceUpdate = 0;
+
+                u32 curr = 0;
+                while(item->currProcessed < item->currTotal) {
+                    if(R_FAILED(res = task_data_op_check_running(item))) {
+                        break;
+                    }
+
+                    Handle handles[2] = {pipeline.filledBlocks, data->cancelEvent};
+                    s32 signaled = 0;
+                    if(R_FAILED(res = svcWaitSynchronizationN(&signaled, handles, 2, false, U64_MAX))) {
+                        break;
+                    }
+
+                    if(signaled == 1) {
+                        res = R_FBI_CANCELLED;
+                        break;
+                    }
+
+                    if(R_FAILED(res = pipeline.readResult)) {
+                        break;
+                    }
+
+                    data_op_copy_block* block = &pipeline.blocks[curr];
+
+                    if(*dst == NULL) {
+                        if(R_FAILED(res = task_data_op_open_dst(item, block->buffer, item->currTotal, dst))) {
+                            break;
+                        }
+
+                        task_data_op_journal_begin(item, *dst);
+                    }
+
+                    u32 blockWritten = 0;
+                    while(blockWritten < block->size) {
+                        u32 bytesWritten = 0;
+                        if(R_FAILED(res = task_data_op_write_dst(item, *dst, &bytesWritten, block->buffer + blockWritten, block->offset + blockWritten, block->size - blockWritten))) {
+                            break;
+                        }
+
+                        if(bytesWritten == 0) {
+                            res = R_FBI_BAD_DATA;
+                            break;
+                        }
+
+                        task_data_op_journal_update(item, block->buffer + blockWritten, bytesWritten);
+
+                        blockWritten += bytesWritten;
+
+                        item->currProcessed += bytesWritten;
+                        task_data_op_item_progress(item);
+
+                        if(item->serial) {
+                            task_data_op_update_speed(data, &ioStartTime, &lastBytesPerSecondUpdate, &bytesSinceUpdate, bytesWritten);
+                        }
+                    }
+
+                    task_data_op_tune(item, blockWritten);
+
+                    if(R_FAILED(res)) {
+                        break;
+                    }
+
+                    s32 count = 0;
+                    svcReleaseSemaphore(&count, pipeline.freeBlocks, 1);
+
+                    curr = (curr + 1) % pipeline.blockCount;
+                }
+
+                pipeline.abort = true;
+
+                s32 count = 0;
+                svcReleaseSemaphore(&count, pipeline.freeBlocks, 1);
+
+                threadJoin(readThread, U64_MAX);
+                threadFree(readThread);
+            } else {
+                res = R_FBI_THREAD_CREATE_FAILED;
+            }
+        }
+
+        if(pipeline.filledBlocks != 0) {
+            svcCloseHandle(pipeline.filledBlocks);
+        }
+
+        if(pipeline.freeBlocks != 0) {
+            svcCloseHandle(pipeline.freeBlocks);
+        }
+
+        for(u32 i = 0; i < pipeline.blockCount; i++) {
+            if(pipeline.blocks[i].buffer != NULL) {
+                bufpool_free(BUFPOOL_HEAP, pipeline.blocks[i].buffer, allocSize);
+            }
+        }
+
+        free(pipeline.blocks);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+// Pipelining only pays off when one side waits on something the other can run during; between two local streams its
+// thread handoffs are pure overhead. Destinations are mostly opened by the first block, so that is copied first.
+static Result task_data_op_transfer(data_op_item* item, io_stream* src, io_stream** dst) {
+    data_op_data* data = item->data;
+
+    Result res = 0;
+
+    if(data->bufferCount > 1) {
+        if(*dst == NULL && io_is_local(src) && R_FAILED(res = task_data_op_copy_serial(item, src, dst, true))) {
+            return res;
+        }
+
+        if(!(io_is_local(src) && io_is_local(*dst)) && item->currTotal - item->currProcessed > data->bufferSize) {
+            return task_data_op_copy_pipelined(item, src, dst);
+        }
+    }
+
+    return task_data_op_copy_serial(item, src, dst, false);
+}
+
+static void task_data_op_item_start(data_op_item* item) {
+    item->currProcessed = 0;
+    item->currTotal = 0;
+    task_data_op_item_progress(item);
+
+    if(item->serial) {
+        item->data->bytesPerSecond = 0;
+        item->data->estimatedRemainingSeconds = 0;
+
+        item->data->tuning.startTime = 0;
+    }
+}
+
+static Result task_data_op_copy(data_op_item* item) {
+    data_op_data* data = item->data;
+    u32 index = item->index;
+
+    task_data_op_item_start(item);
+
+    Result res = 0;
+
+    bool isDir = false;
+    if(R_SUCCEEDED(res = data->isSrcDirectory(data->data, index, &isDir)) && isDir) {
+        res = data->makeDstDirectory(data->data, index);
+    } else {
+        bool skipped = false;
+
+        io_stream* src = NULL;
+        if(R_SUCCEEDED(res = task_data_op_open_src(item, &src))) {
+            if(R_SUCCEEDED(res = io_get_size(src, &item->currTotal))
+               && (data->checkDst == NULL || R_SUCCEEDED(res = data->checkDst(data->data, index, src, item->currTotal)))) {
+                task_data_op_item_progress(item);
+
+                io_stream* dst = NULL;
+
+                if(item->currTotal == 0) {
+                    if(data->copyEmpty) {
+                        res = task_data_op_open_dst(item, NULL, item->currTotal, &dst);
+                    } else {
+                        res = R_FBI_BAD_DATA;
+                    }
+                } else {
+                    task_data_op_journal_resume(item, &dst);
+
+                    res = task_data_op_transfer(item, src, &dst);
+                }
+
+                if(dst != NULL) {
+                    Result closeDstRes = task_data_op_close_dst(item, res == 0, dst);
+                    if(R_SUCCEEDED(res)) {
+                        res = closeDstRes;
+                    }
+                }
+            }
+
+            if(res == R_FBI_SKIPPED) {
+                skipped = true;
+                res = 0;
+            }
+
+            Result closeSrcRes = task_data_op_close_src(item, res == 0, src);
+            if(R_SUCCEEDED(res)) {
+                res = closeSrcRes;
+            }
+        }
+
+        if(R_SUCCEEDED(res)) {
+            if(skipped) {
+                item->currProcessed = item->currTotal;
+                task_data_op_item_progress(item);
+
+                item->skippedBytes += item->currTotal;
+            } else {
+                item->copiedBytes += item->currTotal;
+            }
+        }
+    }
+
+    return res;
+}
+
+#ifndef FBI_HOST
+static void task_data_op_prefetch_next(data_op_data* data, u32 index) {
+    if(data->prefetchMemory == 0 || index >= data->total || data->prefetch != NULL) {
+        return;
+    }
+
+    char url[DOWNLOAD_URL_MAX];
+    if(R_SUCCEEDED(data->getSrcUrl(data->data, index, url, DOWNLOAD_URL_MAX))) {
+        task_prefetch_start(&data->prefetch, index, url, data->bufferSize, data->downloadConnections, data->prefetchMemory, data->cancelEvent);
+    }
+}
+
+// Picks up where a resumed destination left off, or takes over the prefetch when it fetched this item.
+static Result task_data_op_open_url(data_op_item* item, const char* url, io_stream** src, io_stream** dst) {
+    data_op_data* data = item->data;
+    u32 index = item->index;
+
+    Result res = 0;
+
+    u64 start = svcGetSystemTick();
+
+    data_op_prefetch* prefetch = data->prefetch;
+    data->prefetch = NULL;
+
+    if(item->currProcessed == 0 && task_prefetch_matches(prefetch, index, url)) {
+        res = task_prefetch_open(src, prefetch);
+    } else {
+        task_prefetch_close(prefetch);
+
+        res = io_open_http(src, url, true, item->currProcessed, data->downloadConnections, data->cancelEvent);
+
+        // The server ignored the range request; start the item over from the beginning.
+        if(res == R_FBI_HTTP_RANGE_NOT_SUPPORTED && *dst != NULL) {
+            task_data_op_close_dst(item, false, *dst);
+            *dst = NULL;
+
+            item->currProcessed = 0;
+            task_data_op_item_progress(item);
+
+            res = io_open_http(src, url, true, 0, data->downloadConnections, data->cancelEvent);
+        }
+    }
+
+    task_data_op_phase_end(item, DATAOP_PHASE_OPEN_SRC, start, 0);
+
+    return res;
+}
+
+static Result task_data_op_download(data_op_item* item) {
+    data_op_data* data = item->data;
+    u32 index = item->index;
+
+    task_data_op_item_start(item);
+
+    Result res = 0;
+
+    char url[DOWNLOAD_URL_MAX];
+    if(R_SUCCEEDED(res = data->getSrcUrl(data->data, index, url, DOWNLOAD_URL_MAX))) {
+        io_stream* dst = NULL;
+        task_data_op_journal_resume(item, &dst);
+
+        io_stream* src = NULL;
+        u64 size = 0;
+        if(R_SUCCEEDED(res = task_data_op_open_url(item, url, &src, &dst)) && R_SUCCEEDED(res = io_get_size(src, &size))) {
+            item->currTotal = item->currProcessed + size;
+            task_data_op_item_progress(item);
+
+            res = task_data_op_transfer(item, src, &dst);
+        }
+
+        if(src != NULL) {
+            io_close(src, res == 0);
+        }
 
-        if(suspended) {
-            if(data->restore != NULL && R_SUCCEEDED(res)) {
-                res = data->restore(data->data, data->processed);
+        // Finalizing the item can take a while; keep the network busy with the next one meanwhile.
+        if(R_SUCCEEDED(res)) {
+            task_data_op_prefetch_next(data, index + 1);
+        }
+
+        if(dst != NULL) {
+            Result closeDstRes = task_data_op_close_dst(item, res == 0, dst);
+            if(R_SUCCEEDED(res)) {
+                res = closeDstRes;
             }
         }
     }
 
     return res;
 }
+#else
+// Downloads need the HTTP client and the prefetcher, neither of which the host engine links.
+static Result task_data_op_download(data_op_item* item) {
+    return R_FBI_NOT_IMPLEMENTED;
+}
+#endif
 
-static Result task_data_op_copy(data_op_data* data, u32 index) {
-    data->currProcessed = 0;
-    data->currTotal = 0;
+static Result task_data_op_delete(data_op_item* item) {
+    return item->data->delete(item->data->data, item->index);
+}
 
-    data->bytesPerSecond = 0;
-    data->estimatedRemainingSeconds = 0;
+static void task_data_op_retry_onresponse(ui_view* view, void* data, bool response) {
+    ((data_op_data*) data)->retryResponse = response;
+}
 
+static Result task_data_op_process(data_op_item* item) {
     Result res = 0;
 
-    bool isDir = false;
-    if(R_SUCCEEDED(res = data->isSrcDirectory(data->data, index, &isDir)) && isDir) {
-        res = data->makeDstDirectory(data->data, index);
-    } else {
-        u32 srcHandle = 0;
-        if(R_SUCCEEDED(res = data->openSrc(data->data, index, &srcHandle))) {
-            if(R_SUCCEEDED(res = data->getSrcSize(data->data, srcHandle, &data->currTotal))) {
-                if(data->currTotal == 0) {
-                    if(data->copyEmpty) {
-                        u32 dstHandle = 0;
-                        if(R_SUCCEEDED(res = data->openDst(data->data, index, NULL, data->currTotal, &dstHandle))) {
-                            res = data->closeDst(data->data, index, true, dstHandle);
-                        }
-                    } else {
-                        res = R_FBI_BAD_DATA;
-                    }
-                } else {
-                    u8* buffer = (u8*) calloc(1, data->bufferSize);
-                    if(buffer != NULL) {
-                        u32 dstHandle = 0;
-
-                        u64 ioStartTime = 0;
-                        u64 lastBytesPerSecondUpdate = osGetTime();
-                        u32 bytesSinceUpdate = 0;
-
-                        bool firstRun = true;
-                        while(data->currProcessed < data->currTotal) {
-                            if(R_FAILED(res = task_data_op_check_running(data))) {
-                                break;
-                            }
-
-                            u32 bytesRead = 0;
-                            if(R_FAILED(res = data->readSrc(data->data, srcHandle, &bytesRead, buffer, data->currProcessed, data->bufferSize))) {
-                                break;
-                            }
-
-                            if(firstRun) {
-                                firstRun = false;
-
-                                if(R_FAILED(res = data->openDst(data->data, index, buffer, data->currTotal, &dstHandle))) {
-                                    break;
-                                }
-                            }
-
-                            u32 bytesWritten = 0;
-                            if(R_FAILED(res = data->writeDst(data->data, dstHandle, &bytesWritten, buffer, data->currProcessed, bytesRead))) {
-                                break;
-                            }
-
-                            data->currProcessed += bytesWritten;
-                            bytesSinceUpdate += bytesWritten;
-
-                            u64 time = osGetTime();
-                            u64 elapsed = time - lastBytesPerSecondUpdate;
-                            if(elapsed >= 1000) {
-                                data->bytesPerSecond = (u32) (bytesSinceUpdate / (elapsed / 1000.0f));
-
-                                if(ioStartTime != 0) {
-                                    data->estimatedRemainingSeconds = (u32) ((data->currTotal - data->currProcessed) / (data->currProcessed / ((time - ioStartTime) / 1000.0f)));
-                                } else {
-                                    data->estimatedRemainingSeconds = 0;
-                                }
-
-                                if(ioStartTime == 0 && data->currProcessed > 0) {
-                                    ioStartTime = time;
-                                }
-
-                                bytesSinceUpdate = 0;
-                                lastBytesPerSecondUpdate = time;
-                            }
-                        }
+    if(R_SUCCEEDED(res = task_data_op_check_running(item))) {
+        switch(item->data->op) {
+            case DATAOP_COPY:
+                res = task_data_op_copy(item);
+                break;
+            case DATAOP_DOWNLOAD:
+                res = task_data_op_download(item);
+                break;
+            case DATAOP_DELETE:
+                res = task_data_op_delete(item);
+                break;
+            default:
+                break;
+        }
+    }
 
-                        if(dstHandle != 0) {
-                            Result closeDstRes = data->closeDst(data->data, index, res == 0, dstHandle);
-                            if(R_SUCCEEDED(res)) {
-                                res = closeDstRes;
-                            }
-                        }
+    return res;
+}
 
-                        free(buffer);
-                    } else {
-                        res = R_FBI_OUT_OF_MEMORY;
-                    }
-                }
-            }
+typedef enum {
+    DATAOP_ERROR_CONTINUE,
+    DATAOP_ERROR_RETRY,
+    DATAOP_ERROR_RESTART,
+    DATAOP_ERROR_STOP
+} data_op_error_action;
+
+#define DATAOP_BATCH_DEFAULT_RETRIES 5
+#define DATAOP_BATCH_DEFAULT_BACKOFF_MS 1000
+#define DATAOP_BATCH_MAX_BACKOFF_MS (60 * 1000)
+#define DATAOP_BATCH_SUMMARY_ITEMS 8
+
+bool task_data_op_is_transient(Result res) {
+#ifdef FBI_HOST
+    return R_LEVEL(res) == RL_TEMPORARY;
+#else
+    return R_LEVEL(res) == RL_TEMPORARY || http_is_transient_error(res);
+#endif
+}
 
-            Result closeSrcRes = data->closeSrc(data->data, index, res == 0, srcHandle);
-            if(R_SUCCEEDED(res)) {
-                res = closeSrcRes;
-            }
+// Returns the retry record of an item that has failed but not been given up on yet.
+static data_op_failure* task_data_op_batch_find(data_op_data* data, u32 index) {
+    for(u32 i = 0; i < data->failureCount; i++) {
+        data_op_failure* failure = &data->failures[i];
+        if(failure->index == index && !failure->final) {
+            return failure;
         }
     }
 
-    return res;
+    return NULL;
 }
 
-typedef struct {
-    data_op_data* data;
+static void task_data_op_batch_succeeded(data_op_data* data, u32 index) {
+    if(!data->batch) {
+        return;
+    }
 
-    u32 index;
+    data_op_failure* failure = task_data_op_batch_find(data, index);
+    if(failure != NULL) {
+        memmove(failure, failure + 1, (size_t) (&data->failures[data->failureCount] - (failure + 1)) * sizeof(data_op_failure));
+        data->failureCount--;
+
+        data->recoveredItems++;
+    }
+}
 
-    u32 dstHandle;
-    bool firstRun;
-    u64 ioStartTime;
-    u64 lastBytesPerSecondUpdate;
-    u32 bytesSinceUpdate;
+static data_op_error_action task_data_op_batch_error(data_op_data* data, u32 index, Result res) {
+    data_op_failure* failure = task_data_op_batch_find(data, index);
+    if(failure == NULL) {
+        if(data->failureCount >= DATAOP_BATCH_FAILURES_MAX) {
+            data->failedItems++;
+            return DATAOP_ERROR_CONTINUE;
+        }
 
-    u64 writeOffset;
-} data_op_download_data;
+        failure = &data->failures[data->failureCount++];
+        failure->index = index;
+        failure->attempts = 0;
+        failure->final = false;
+    }
 
-static Result task_data_op_download_callback(void* userData, void* buffer, size_t size) {
-    data_op_download_data* downloadData = (data_op_download_data*) userData;
-    data_op_data* data = downloadData->data;
+    failure->result = res;
+    failure->attempts++;
 
-    if(downloadData->firstRun) {
-        downloadData->firstRun = false;
+    // Captured now; whatever the operation knows about the failure is gone once the next item starts.
+    if(data->describeError != NULL) {
+        data->describeError(data->data, index, res, failure->message, sizeof(failure->message));
+    } else {
+        failure->message[0] = '\0';
+    }
 
-        Result res = data->openDst(data->data, downloadData->index, buffer, data->currTotal, &downloadData->dstHandle);
-        if(R_FAILED(res)) {
-            return res;
+    u32 maxRetries = data->batchMaxRetries != 0 ? data->batchMaxRetries : DATAOP_BATCH_DEFAULT_RETRIES;
+    if(task_data_op_is_transient(res) && failure->attempts <= maxRetries) {
+        u64 backoffMs = (u64) (data->batchBackoffMs != 0 ? data->batchBackoffMs : DATAOP_BATCH_DEFAULT_BACKOFF_MS) << (failure->attempts - 1);
+        if(backoffMs > DATAOP_BATCH_MAX_BACKOFF_MS) {
+            backoffMs = DATAOP_BATCH_MAX_BACKOFF_MS;
+        }
+
+        if(svcWaitSynchronization(data->cancelEvent, backoffMs * 1000000) == 0 || task_is_quit_all()) {
+            data->result = R_FBI_CANCELLED;
+
+            if(!data->headless) {
+                prompt_display("Failure", "Operation cancelled.", COLOR_TEXT, false, NULL, NULL, NULL);
+            }
+
+            return DATAOP_ERROR_STOP;
+        }
+
+        // Pick up from the last journaled byte if the operation supports it; downloads then resume with a range request.
+        if(data->journalActive && data->journal.index == index && data->journal.currProcessed > 0 && data->journal.dstIdentity[0] != '\0') {
+            data->journalResume = true;
         }
+
+        return DATAOP_ERROR_RETRY;
     }
 
-    u32 bytesWritten = 0;
-    Result res = data->writeDst(data->data, downloadData->dstHandle, &bytesWritten, buffer, downloadData->writeOffset, size);
-    downloadData->writeOffset += bytesWritten;
+    failure->final = true;
+    data->failedItems++;
 
-    return res;
+    return DATAOP_ERROR_CONTINUE;
 }
 
-static Result task_data_op_download_check_running(void* userData) {
-    data_op_download_data* downloadData = (data_op_download_data*) userData;
+static void task_data_op_batch_get_name(data_op_data* data, u32 index, char* name, size_t size) {
+    if(data->op == DATAOP_DOWNLOAD && data->getSrcUrl != NULL && R_SUCCEEDED(data->getSrcUrl(data->data, index, name, size))) {
+        return;
+    }
+
+    if(data->getSrcIdentity != NULL && R_SUCCEEDED(data->getSrcIdentity(data->data, index, name, size))) {
+        return;
+    }
 
-    return task_data_op_check_running(downloadData->data);
+    snprintf(name, size, "Item %lu", (unsigned long) (index + 1));
 }
 
-static Result task_data_op_download_progress(void* userData, u64 total, u64 curr) {
-    data_op_download_data* downloadData = (data_op_download_data*) userData;
-    data_op_data* data = downloadData->data;
+static void task_data_op_batch_report(data_op_data* data) {
+    if(!data->batch || data->failedItems == 0 || data->result == R_FBI_CANCELLED) {
+        return;
+    }
+
+    // Later successes overwrite the result; keep the operation marked as failed.
+    if(R_SUCCEEDED(data->result)) {
+        data_op_failure* first = NULL;
+        for(u32 i = 0; i < data->failureCount && first == NULL; i++) {
+            if(data->failures[i].final) {
+                first = &data->failures[i];
+            }
+        }
+
+        data->result = first != NULL ? first->result : R_FBI_BAD_DATA;
+    }
+
+    if(data->headless) {
+        return;
+    }
 
-    downloadData->bytesSinceUpdate += curr - data->currProcessed;
+    char text[2048];
+    size_t len = (size_t) snprintf(text, sizeof(text), "%lu of %lu item(s) failed.", (unsigned long) data->failedItems, (unsigned long) data->total);
 
-    data->currTotal = total;
-    data->currProcessed = curr;
+    if(data->recoveredItems > 0 && len < sizeof(text)) {
+        len += snprintf(text + len, sizeof(text) - len, "\n%lu item(s) succeeded after retrying.", (unsigned long) data->recoveredItems);
+    }
 
-    u64 time = osGetTime();
-    u64 elapsed = time - downloadData->lastBytesPerSecondUpdate;
-    if(elapsed >= 1000) {
-        data->bytesPerSecond = (u32) (downloadData->bytesSinceUpdate / (elapsed / 1000.0f));
+    u32 shown = 0;
+    for(u32 i = 0; i < data->failureCount && shown < DATAOP_BATCH_SUMMARY_ITEMS && len < sizeof(text); i++) {
+        data_op_failure* failure = &data->failures[i];
+        if(!failure->final) {
+            continue;
+        }
+
+        char name[DOWNLOAD_URL_MAX];
+        task_data_op_batch_get_name(data, failure->index, name, sizeof(name));
 
-        if(downloadData->ioStartTime != 0) {
-            data->estimatedRemainingSeconds = (u32) ((data->currTotal - data->currProcessed) / (data->currProcessed / ((time - downloadData->ioStartTime) / 1000.0f)));
+        const char* message = failure->message[0] != '\0' ? failure->message : error_get_description(failure->result);
+
+        if(strlen(name) > 38) {
+            len += snprintf(text + len, sizeof(text) - len, "\n\n%.35s...\n0x%08lX: %s", name, (unsigned long) (u32) failure->result, message);
         } else {
-            data->estimatedRemainingSeconds = 0;
+            len += snprintf(text + len, sizeof(text) - len, "\n\n%.38s\n0x%08lX: %s", name, (unsigned long) (u32) failure->result, message);
+        }
+
+        shown++;
+    }
+
+    if(shown < data->failedItems && len < sizeof(text)) {
+        snprintf(text + len, sizeof(text) - len, "\n\n...and %lu more.", (unsigned long) (data->failedItems - shown));
+    }
+
+    ui_view* view = error_display(NULL, NULL, "%s", text);
+    if(view != NULL) {
+        svcWaitSynchronization(view->active, U64_MAX);
+    }
+}
+
+static data_op_error_action task_data_op_handle_error(data_op_data* data, u32 index, Result res) {
+    if(res == R_FBI_CANCELLED) {
+        if(!data->headless) {
+            prompt_display("Failure", "Operation cancelled.", COLOR_TEXT, false, NULL, NULL, NULL);
         }
 
-        if(downloadData->ioStartTime == 0 && data->currProcessed > 0) {
-            downloadData->ioStartTime = time;
+        return DATAOP_ERROR_STOP;
+    } else if(data->batch && res != R_FBI_SKIPPED) {
+        return task_data_op_batch_error(data, index, res);
+    } else if(res != R_FBI_SKIPPED) {
+        ui_view* errorView = NULL;
+        bool proceed = data->error(data->data, index, res, &errorView);
+
+        if(errorView != NULL) {
+            svcWaitSynchronization(errorView->active, U64_MAX);
         }
 
-        downloadData->bytesSinceUpdate = 0;
-        downloadData->lastBytesPerSecondUpdate = time;
+        ui_view* retryView = prompt_display("Confirmation", "Retry?", COLOR_TEXT, true, data, NULL, task_data_op_retry_onresponse);
+        if(retryView != NULL) {
+            svcWaitSynchronization(retryView->active, U64_MAX);
+
+            if(data->retryResponse) {
+                return proceed ? DATAOP_ERROR_RETRY : DATAOP_ERROR_RESTART;
+            } else if(!proceed) {
+                return DATAOP_ERROR_STOP;
+            }
+        }
     }
 
-    return 0;
+    return DATAOP_ERROR_CONTINUE;
 }
 
-static Result task_data_op_download(data_op_data* data, u32 index) {
-    data->currProcessed = 0;
-    data->currTotal = 0;
+static void task_data_op_serial(data_op_data* data) {
+    data_op_item item;
+    memset(&item, 0, sizeof(item));
 
-    data->bytesPerSecond = 0;
-    data->estimatedRemainingSeconds = 0;
+    item.data = data;
+    item.histograms = data->histograms;
+    item.serial = true;
 
-    Result res = 0;
+    for(data->processed = data->journalResume ? data->journal.index : 0; data->processed < data->total; data->processed++) {
+        item.index = data->processed;
+        item.copiedBytes = 0;
+        item.skippedBytes = 0;
 
-    char url[DOWNLOAD_URL_MAX];
-    if(R_SUCCEEDED(res = data->getSrcUrl(data->data, index, url, DOWNLOAD_URL_MAX))) {
-        data_op_download_data downloadData = {data, index, 0, true, 0, osGetTime(), 0, 0};
-        res = http_download_callback(url, data->bufferSize, &downloadData, task_data_op_download_callback, task_data_op_download_check_running);
+        Result res = task_data_op_process(&item);
 
-        if(downloadData.dstHandle != 0) {
-            Result closeDstRes = data->closeDst(data->data, index, res == 0, downloadData.dstHandle);
-            if(R_SUCCEEDED(res)) {
-                res = closeDstRes;
+        data->copiedBytes += item.copiedBytes;
+        data->skippedBytes += item.skippedBytes;
+
+        data->result = res;
+
+        if(R_FAILED(res)) {
+            data_op_error_action action = task_data_op_handle_error(data, data->processed, res);
+            if(action == DATAOP_ERROR_STOP) {
+                break;
+            } else if(action == DATAOP_ERROR_RETRY) {
+                data->processed--;
+            } else if(action == DATAOP_ERROR_RESTART) {
+                data->processed = 0;
             }
+        } else {
+            task_data_op_batch_succeeded(data, data->processed);
         }
     }
+}
 
-    return res;
+typedef struct {
+    data_op_item item;
+    data_op_histogram histograms[DATAOP_PHASE_COUNT];
+
+    Handle startEvent;
+    Handle doneSemaphore;
+
+    volatile bool busy;
+    volatile bool done;
+    volatile bool quit;
+    Result result;
+
+    Thread thread;
+} data_op_worker;
+
+typedef struct {
+    data_op_data* data;
+
+    data_op_worker* workers;
+    u32 workerCount;
+    Handle doneSemaphore;
+
+    u32 next;
+    u32 inFlight;
+    bool restart;
+    bool stop;
+
+    u64 completedBytes;
+} data_op_pool;
+
+static void task_data_op_worker_thread(void* arg) {
+    data_op_worker* worker = (data_op_worker*) arg;
+
+    bandwidth_set_class(BANDWIDTH_CLASS_INSTALL);
+
+    while(true) {
+        svcWaitSynchronization(worker->startEvent, U64_MAX);
+        if(worker->quit) {
+            break;
+        }
+
+        worker->result = task_data_op_process(&worker->item);
+
+        // The pool also checks for finished workers when its wait times out, not only after the semaphore is released.
+        __atomic_store_n(&worker->done, true, __ATOMIC_RELEASE);
+
+        s32 count = 0;
+        svcReleaseSemaphore(&count, worker->doneSemaphore, 1);
+    }
 }
 
-static Result task_data_op_delete(data_op_data* data, u32 index) {
-    return data->delete(data->data, index);
+static void task_data_op_pool_start(data_op_pool* pool, data_op_worker* worker, u32 index) {
+    memset(&worker->item, 0, sizeof(worker->item));
+    memset(worker->histograms, 0, sizeof(worker->histograms));
+
+    worker->item.data = pool->data;
+    worker->item.index = index;
+    worker->item.histograms = worker->histograms;
+
+    worker->result = 0;
+    worker->done = false;
+    worker->busy = true;
+
+    svcSignalEvent(worker->startEvent);
 }
 
-static void task_data_op_retry_onresponse(ui_view* view, void* data, u32 response) {
-    ((data_op_data*) data)->retryResponse = response == PROMPT_YES;
+static void task_data_op_pool_dispatch(data_op_pool* pool, u32 index) {
+    for(u32 i = 0; i < pool->workerCount; i++) {
+        data_op_worker* worker = &pool->workers[i];
+        if(!worker->busy) {
+            task_data_op_pool_start(pool, worker, index);
+            pool->inFlight++;
+            break;
+        }
+    }
 }
 
-static void task_data_op_thread(void* arg) {
-    data_op_data* data = (data_op_data*) arg;
+// Returns true if the item should be run again.
+static bool task_data_op_pool_complete(data_op_pool* pool, u32 index, Result res) {
+    data_op_data* data = pool->data;
 
-    for(data->processed = 0; data->processed < data->total; data->processed++) {
-        Result res = 0;
+    data->result = res;
 
-        if(R_SUCCEEDED(res = task_data_op_check_running(data))) {
-            switch(data->op) {
-                case DATAOP_COPY:
-                    res = task_data_op_copy(data, data->processed);
-                    break;
-                case DATAOP_DOWNLOAD:
-                    res = task_data_op_download(data, data->processed);
-                    break;
-                case DATAOP_DELETE:
-                    res = task_data_op_delete(data, data->processed);
-                    break;
-                default:
-                    break;
+    if(R_FAILED(res)) {
+        data_op_error_action action = task_data_op_handle_error(data, index, res);
+        if(action == DATAOP_ERROR_RETRY) {
+            return true;
+        } else if(action == DATAOP_ERROR_RESTART) {
+            pool->restart = true;
+        } else if(action == DATAOP_ERROR_STOP) {
+            pool->stop = true;
+        }
+    } else {
+        task_data_op_batch_succeeded(data, index);
+    }
+
+    if(data->processed < data->total) {
+        data->processed++;
+    }
+
+    return false;
+}
+
+static void task_data_op_pool_collect(data_op_pool* pool) {
+    for(u32 i = 0; i < pool->workerCount; i++) {
+        data_op_worker* worker = &pool->workers[i];
+        if(worker->busy && __atomic_load_n(&worker->done, __ATOMIC_ACQUIRE)) {
+            worker->busy = false;
+            pool->inFlight--;
+
+            pool->completedBytes += worker->item.currProcessed;
+
+            pool->data->copiedBytes += worker->item.copiedBytes;
+            pool->data->skippedBytes += worker->item.skippedBytes;
+
+            for(u32 phase = 0; phase < DATAOP_PHASE_COUNT; phase++) {
+                task_trace_histogram_merge(&pool->data->histograms[phase], &worker->histograms[phase]);
+            }
+
+            if(task_data_op_pool_complete(pool, worker->item.index, worker->result) && !pool->stop && !pool->restart) {
+                task_data_op_pool_start(pool, worker, worker->item.index);
+                pool->inFlight++;
             }
         }
+    }
+}
 
-        data->result = res;
+static void task_data_op_pool_run(data_op_pool* pool) {
+    data_op_data* data = pool->data;
 
-        if(R_FAILED(res)) {
-            if(res == R_FBI_CANCELLED) {
-                prompt_display("Failure", "Operation cancelled.", COLOR_TEXT, false, NULL, NULL, NULL);
+    // Checks made between dispatches are timed on the operation itself.
+    data_op_item self;
+    memset(&self, 0, sizeof(self));
+
+    self.data = data;
+    self.histograms = data->histograms;
+
+    u64 ioStartTime = 0;
+    u64 lastBytesPerSecondUpdate = osGetTime();
+    u32 bytesSinceUpdate = 0;
+    u64 reportedBytes = 0;
+
+    data->processed = 0;
+
+    while(!pool->stop && (pool->next < data->total || pool->inFlight > 0)) {
+        while(!pool->stop && !pool->restart && pool->inFlight < pool->workerCount && pool->next < data->total) {
+            u32 index = pool->next;
+
+            self.index = index;
+            Result res = task_data_op_check_running(&self);
+
+            bool isDir = false;
+            if(R_SUCCEEDED(res) && R_SUCCEEDED(res = data->isSrcDirectory(data->data, index, &isDir)) && !isDir) {
+                task_data_op_pool_dispatch(pool, index);
+                pool->next++;
+                continue;
+            }
+
+            // Directories act as barriers: everything before them finishes first, nothing after them starts early.
+            if(R_SUCCEEDED(res) && pool->inFlight > 0) {
                 break;
-            } else if(res != R_FBI_SKIPPED) {
-                ui_view* errorView = NULL;
-                bool proceed = data->error(data->data, data->processed, res, &errorView);
+            }
 
-                if(errorView != NULL) {
-                    svcWaitSynchronization(errorView->active, U64_MAX);
+            do {
+                if(R_SUCCEEDED(res)) {
+                    res = data->makeDstDirectory(data->data, index);
                 }
+            } while(task_data_op_pool_complete(pool, index, res) && R_SUCCEEDED(res = task_data_op_check_running(&self)));
 
-                ui_view* retryView = prompt_display("Confirmation", "Retry?", COLOR_TEXT, true, data, NULL, task_data_op_retry_onresponse);
-                if(retryView != NULL) {
-                    svcWaitSynchronization(retryView->active, U64_MAX);
+            pool->next++;
+        }
 
-                    if(data->retryResponse) {
-                        if(proceed) {
-                            data->processed--;
-                        } else {
-                            data->processed = 0;
-                        }
-                    } else if(!proceed) {
-                        break;
-                    }
+        if(pool->inFlight > 0) {
+            svcWaitSynchronization(pool->doneSemaphore, 100 * 1000000);
+
+            task_data_op_pool_collect(pool);
+        }
+
+        u64 inFlightProcessed = 0;
+        u64 inFlightTotal = 0;
+        for(u32 i = 0; i < pool->workerCount; i++) {
+            data_op_worker* worker = &pool->workers[i];
+            if(worker->busy) {
+                inFlightProcessed += __atomic_load_n(&worker->item.shownProcessed, __ATOMIC_RELAXED);
+                inFlightTotal += __atomic_load_n(&worker->item.shownTotal, __ATOMIC_RELAXED);
+            }
+        }
+
+        data->currProcessed = inFlightProcessed;
+        data->currTotal = inFlightTotal;
+
+        u64 bytes = pool->completedBytes + inFlightProcessed;
+        task_data_op_update_speed(data, &ioStartTime, &lastBytesPerSecondUpdate, &bytesSinceUpdate, (u32) (bytes - reportedBytes));
+        reportedBytes = bytes;
+
+        if(pool->restart && pool->inFlight == 0) {
+            pool->restart = false;
+            pool->next = 0;
+            data->processed = 0;
+        }
+    }
+}
+
+static bool task_data_op_pool(data_op_data* data) {
+    data_op_pool pool;
+    memset(&pool, 0, sizeof(pool));
+
+    pool.data = data;
+    pool.workerCount = data->workerCount;
+
+    pool.workers = (data_op_worker*) calloc(pool.workerCount, sizeof(data_op_worker));
+    if(pool.workers == NULL) {
+        return false;
+    }
+
+    u32 started = 0;
+    if(R_SUCCEEDED(svcCreateSemaphore(&pool.doneSemaphore, 0, 0x7FFFFFFF))) {
+        if(R_SUCCEEDED(svcCreateMutex(&data->suspendLock, false))) {
+            for(; started < pool.workerCount; started++) {
+                data_op_worker* worker = &pool.workers[started];
+                worker->doneSemaphore = pool.doneSemaphore;
+
+                if(R_FAILED(svcCreateEvent(&worker->startEvent, RESET_ONESHOT))) {
+                    break;
                 }
+
+                if((worker->thread = threadCreate(task_data_op_worker_thread, worker, 0x10000, 0x18, 1, false)) == NULL) {
+                    svcCloseHandle(worker->startEvent);
+                    break;
+                }
+            }
+
+            if(started == pool.workerCount) {
+                task_data_op_pool_run(&pool);
+            }
+
+            for(u32 i = 0; i < started; i++) {
+                data_op_worker* worker = &pool.workers[i];
+
+                worker->quit = true;
+                svcSignalEvent(worker->startEvent);
+
+                threadJoin(worker->thread, U64_MAX);
+                threadFree(worker->thread);
+
+                svcCloseHandle(worker->startEvent);
             }
+
+            svcCloseHandle(data->suspendLock);
+            data->suspendLock = 0;
         }
+
+        svcCloseHandle(pool.doneSemaphore);
+    }
+
+    free(pool.workers);
+
+    return started == pool.workerCount;
+}
+
+static void task_data_op_thread(void* arg) {
+    data_op_data* data = (data_op_data*) arg;
+
+    // Transfers get the largest share of the link while listings or icon fetches run alongside them.
+    bandwidth_set_class(BANDWIDTH_CLASS_INSTALL);
+
+    task_data_op_journal_prepare(data);
+
+    task_trace_open(&data->trace);
+
+    if(data->op != DATAOP_COPY || data->workerCount <= 1 || data->journalResume || !task_data_op_pool(data)) {
+        task_data_op_serial(data);
+    }
+
+    if(data->journalActive && R_SUCCEEDED(data->result) && data->processed >= data->total) {
+        task_journal_delete(data->journalName);
+    }
+
+    if(data->trace != NULL) {
+        task_trace_close(data->trace);
+        data->trace = NULL;
     }
 
-    svcCloseHandle(data->cancelEvent);
+#ifndef FBI_HOST
+    // Left over if the operation stopped early or never reached the item.
+    task_prefetch_close(data->prefetch);
+    data->prefetch = NULL;
+#endif
+
+    task_data_op_batch_report(data);
+
+    // Cleared first so a late cancel from the UI signals nothing rather than a closed handle.
+    Handle cancelEvent = data->cancelEvent;
+    data->cancelEvent = 0;
+    svcCloseHandle(cancelEvent);
 
     data->finished = true;
 
     aptSetSleepAllowed(true);
 }
 
-Result task_data_op(data_op_data* data) {
-    if(data == NULL) {
-        return R_FBI_INVALID_ARGUMENT;
-    }
-
+static void task_data_op_reset(data_op_data* data) {
     data->processed = 0;
 
     data->currProcessed = 0;
     data->currTotal = 0;
 
+    data->copiedBytes = 0;
+    data->skippedBytes = 0;
+
+    data->failureCount = 0;
+    data->failedItems = 0;
+    data->recoveredItems = 0;
+
+    memset(data->histograms, 0, sizeof(data->histograms));
+    data->trace = NULL;
+    data->prefetch = NULL;
+    data->suspendLock = 0;
+
+    task_data_op_tune_init(data);
+
     data->finished = false;
     data->result = 0;
     data->cancelEvent = 0;
+}
+
+Result task_data_op(data_op_data* data) {
+    if(data == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    task_data_op_reset(data);
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
-        if(threadCreate(task_data_op_thread, data, 0x10000, 0x18, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("Data operation", TASK_PRIORITY_BACKGROUND, task_data_op_thread, data);
     }
 
     if(R_FAILED(res)) {
@@ -336,4 +1578,25 @@ Result task_data_op(data_op_data* data) {
     aptSetSleepAllowed(false);
 
     return res;
-}
\ No newline at end of file
+}
+
+Result task_data_op_run(data_op_data* data) {
+    if(data == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    task_data_op_reset(data);
+
+    Result res = 0;
+    if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
+        aptSetSleepAllowed(false);
+
+        task_data_op_thread(data);
+
+        res = data->result;
+    } else {
+        data->finished = true;
+    }
+
+    return res;
+}
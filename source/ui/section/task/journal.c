@@ -0,0 +1,271 @@
+#include <malloc.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef FBI_HOST
+#include <sys/stat.h>
+
+#include "../../../core/iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include <zlib.h>
+
+#include "task.h"
+#include "../../error.h"
+#include "../../../core/bufpool.h"
+#include "../../../core/io.h"
+#include "../../../core/util.h"
+
+#define JOURNAL_MAGIC 0x4A494246 // "FBIJ"
+#define JOURNAL_VERSION 1
+
+// Two records are kept and written alternately, so a torn write never destroys the last good checkpoint.
+#define JOURNAL_RECORD_COUNT 2
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 sequence;
+    data_op_journal journal;
+    u32 checksum;
+} journal_record;
+
+static void task_journal_make_path(char* out, const char* name, size_t size) {
+    snprintf(out, size, "/fbi/journal/%s.bin", name);
+}
+
+static u32 task_journal_checksum(journal_record* record) {
+    return (u32) crc32(0, (const Bytef*) record, offsetof(journal_record, checksum));
+}
+
+#ifdef FBI_HOST
+// The working directory stands in for the SD card root.
+static Result task_journal_read_file(const char* path, void* buffer, u32 size, u32* bytesRead) {
+    Result res = 0;
+
+    io_stream* stream = NULL;
+    if(R_SUCCEEDED(res = io_open_posix(&stream, path + 1, "rb"))) {
+        res = io_read(stream, bytesRead, buffer, 0, size);
+        io_close(stream, R_SUCCEEDED(res));
+    }
+
+    return res;
+}
+
+static Result task_journal_write_file(const char* path, void* buffer, u64 offset, u32 size) {
+    mkdir("fbi", 0777);
+    mkdir("fbi/journal", 0777);
+
+    Result res = 0;
+
+    io_stream* stream = NULL;
+    if(R_SUCCEEDED(res = io_open_posix(&stream, path + 1, "r+b")) || R_SUCCEEDED(res = io_open_posix(&stream, path + 1, "w+b"))) {
+        u32 bytesWritten = 0;
+        if(R_SUCCEEDED(res = io_write(stream, &bytesWritten, buffer, offset, size)) && bytesWritten != size) {
+            res = R_FBI_BAD_DATA;
+        }
+
+        Result closeRes = io_close(stream, R_SUCCEEDED(res));
+        if(R_SUCCEEDED(res)) {
+            res = closeRes;
+        }
+    }
+
+    return res;
+}
+
+static Result task_journal_delete_file(const char* path) {
+    return remove(path + 1) == 0 ? 0 : R_FBI_BAD_DATA;
+}
+#else
+static Result task_journal_read_file(const char* path, void* buffer, u32 size, u32* bytesRead) {
+    Result res = 0;
+
+    FS_Path* fsPath = util_make_path_utf8(path);
+    if(fsPath != NULL) {
+        Handle fileHandle = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenFileDirectly(&fileHandle, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), *fsPath, FS_OPEN_READ, 0))) {
+            res = FSFILE_Read(fileHandle, bytesRead, 0, buffer, size);
+
+            FSFILE_Close(fileHandle);
+        }
+
+        util_free_path_utf8(fsPath);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+static Result task_journal_write_file(const char* path, void* buffer, u64 offset, u32 size) {
+    Result res = 0;
+
+    FS_Archive sdmcArchive = 0;
+    if(R_SUCCEEDED(res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        if(R_SUCCEEDED(res = util_ensure_dir(sdmcArchive, "/fbi/")) && R_SUCCEEDED(res = util_ensure_dir(sdmcArchive, "/fbi/journal/"))) {
+            FS_Path* fsPath = util_make_path_utf8(path);
+            if(fsPath != NULL) {
+                Handle fileHandle = 0;
+                if(R_SUCCEEDED(res = FSUSER_OpenFile(&fileHandle, sdmcArchive, *fsPath, FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+                    u32 bytesWritten = 0;
+                    if(R_SUCCEEDED(res = FSFILE_Write(fileHandle, &bytesWritten, offset, buffer, size, FS_WRITE_FLUSH)) && bytesWritten != size) {
+                        res = R_FBI_BAD_DATA;
+                    }
+
+                    FSFILE_Close(fileHandle);
+                }
+
+                util_free_path_utf8(fsPath);
+            } else {
+                res = R_FBI_OUT_OF_MEMORY;
+            }
+        }
+
+        FSUSER_CloseArchive(sdmcArchive);
+    }
+
+    return res;
+}
+
+static Result task_journal_delete_file(const char* path) {
+    Result res = 0;
+
+    FS_Path* fsPath = util_make_path_utf8(path);
+    if(fsPath != NULL) {
+        FS_Archive sdmcArchive = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+            res = FSUSER_DeleteFile(sdmcArchive, *fsPath);
+
+            FSUSER_CloseArchive(sdmcArchive);
+        }
+
+        util_free_path_utf8(fsPath);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+#endif
+
+Result task_journal_load(const char* name, data_op_journal* journal, u32* sequence) {
+    if(name == NULL || journal == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    char path[FILE_PATH_MAX];
+    task_journal_make_path(path, name, sizeof(path));
+
+    journal_record* records = (journal_record*) calloc(JOURNAL_RECORD_COUNT, sizeof(journal_record));
+    if(records != NULL) {
+        u32 bytesRead = 0;
+        if(R_SUCCEEDED(res = task_journal_read_file(path, records, JOURNAL_RECORD_COUNT * sizeof(journal_record), &bytesRead))) {
+            journal_record* newest = NULL;
+
+            for(u32 i = 0; i < bytesRead / sizeof(journal_record); i++) {
+                journal_record* record = &records[i];
+                if(record->magic == JOURNAL_MAGIC && record->version == JOURNAL_VERSION && record->checksum == task_journal_checksum(record)
+                   && (newest == NULL || record->sequence > newest->sequence)) {
+                    newest = record;
+                }
+            }
+
+            if(newest != NULL) {
+                *journal = newest->journal;
+
+                if(sequence != NULL) {
+                    *sequence = newest->sequence;
+                }
+            } else {
+                res = R_FBI_BAD_DATA;
+            }
+        }
+
+        free(records);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+Result task_journal_save(const char* name, data_op_journal* journal, u32 sequence) {
+    if(name == NULL || journal == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    char path[FILE_PATH_MAX];
+    task_journal_make_path(path, name, sizeof(path));
+
+    journal_record record;
+    memset(&record, 0, sizeof(record));
+
+    record.magic = JOURNAL_MAGIC;
+    record.version = JOURNAL_VERSION;
+    record.sequence = sequence;
+    record.journal = *journal;
+    record.checksum = task_journal_checksum(&record);
+
+    return task_journal_write_file(path, &record, (sequence % JOURNAL_RECORD_COUNT) * sizeof(journal_record), sizeof(record));
+}
+
+Result task_journal_delete(const char* name) {
+    if(name == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    char path[FILE_PATH_MAX];
+    task_journal_make_path(path, name, sizeof(path));
+
+    return task_journal_delete_file(path);
+}
+
+Result task_journal_verify(io_stream* dst, u64 size, u32 hash, u32 bufferSize) {
+    if(dst == NULL || bufferSize == 0) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    u8* buffer = (u8*) bufpool_alloc(BUFPOOL_HEAP, bufferSize);
+    if(buffer != NULL) {
+        uLong currHash = crc32(0, Z_NULL, 0);
+
+        u64 offset = 0;
+        while(offset < size) {
+            u32 readSize = bufferSize;
+            if(readSize > size - offset) {
+                readSize = (u32) (size - offset);
+            }
+
+            u32 bytesRead = 0;
+            if(R_FAILED(res = io_read(dst, &bytesRead, buffer, offset, readSize))) {
+                break;
+            }
+
+            if(bytesRead == 0) {
+                res = R_FBI_BAD_DATA;
+                break;
+            }
+
+            currHash = crc32(currHash, buffer, bytesRead);
+            offset += bytesRead;
+        }
+
+        if(R_SUCCEEDED(res) && (u32) currHash != hash) {
+            res = R_FBI_BAD_DATA;
+        }
+
+        bufpool_free(BUFPOOL_HEAP, buffer, bufferSize);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
@@ -61,8 +61,7 @@ static Result task_populate_ext_save_data_from(populate_ext_save_data_data* data
                                     utf16_to_utf8((uint8_t*) extSaveDataInfo->meta.longDescription, smdhTitle->longDescription, sizeof(extSaveDataInfo->meta.longDescription) - 1);
                                     utf16_to_utf8((uint8_t*) extSaveDataInfo->meta.publisher, smdhTitle->publisher, sizeof(extSaveDataInfo->meta.publisher) - 1);
                                     extSaveDataInfo->meta.region = smdh->region;
-                                    extSaveDataInfo->meta.texture = screen_allocate_free_texture();
-                                    screen_load_texture_tiled(extSaveDataInfo->meta.texture, smdh->largeIcon, sizeof(smdh->largeIcon), 48, 48, GPU_RGB565, false);
+                                    extSaveDataInfo->meta.texture = screen_load_texture_atlas(smdh->largeIcon, sizeof(smdh->largeIcon), 48, 48, GPU_RGB565, true);
                                 }
                             }
 
@@ -158,9 +157,7 @@ Result task_populate_ext_save_data(populate_ext_save_data_data* data) {
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
-        if(threadCreate(task_populate_ext_save_data_thread, data, 0x10000, 0x19, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("Ext save data listing", TASK_PRIORITY_INTERACTIVE, task_populate_ext_save_data_thread, data);
     }
 
     if(R_FAILED(res)) {
@@ -10,11 +10,12 @@
 #include "../../error.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
+#include "../../../core/stringutil.h"
 #include "../../../core/util.h"
 
 #define MAX_FILES 1024
 
-Result task_create_file_item(list_item** out, FS_Archive archive, const char* path, u32 attributes) {
+static Result task_create_file_item_icon(list_item** out, FS_Archive archive, const char* path, u32 attributes, bool loadIcon) {
     Result res = 0;
 
     list_item* item = (list_item*) calloc(1, sizeof(list_item));
@@ -81,8 +82,10 @@ Result task_create_file_item(list_item** out, FS_Archive archive, const char* pa
                                             utf16_to_utf8((uint8_t*) fileInfo->ciaInfo.meta.longDescription, smdhTitle->longDescription, sizeof(fileInfo->ciaInfo.meta.longDescription) - 1);
                                             utf16_to_utf8((uint8_t*) fileInfo->ciaInfo.meta.publisher, smdhTitle->publisher, sizeof(fileInfo->ciaInfo.meta.publisher) - 1);
                                             fileInfo->ciaInfo.meta.region = smdh->region;
-                                            fileInfo->ciaInfo.meta.texture = screen_allocate_free_texture();
-                                            screen_load_texture_tiled(fileInfo->ciaInfo.meta.texture, smdh->largeIcon, sizeof(smdh->largeIcon), 48, 48, GPU_RGB565, false);
+
+                                            if(loadIcon) {
+                                                fileInfo->ciaInfo.meta.texture = screen_load_texture_atlas(smdh->largeIcon, sizeof(smdh->largeIcon), 48, 48, GPU_RGB565, true);
+                                            }
                                         }
                                     }
 
@@ -129,6 +132,10 @@ Result task_create_file_item(list_item** out, FS_Archive archive, const char* pa
     return res;
 }
 
+Result task_create_file_item(list_item** out, FS_Archive archive, const char* path, u32 attributes) {
+    return task_create_file_item_icon(out, archive, path, attributes, true);
+}
+
 static int task_populate_files_compare_directory_entries(const void* e1, const void* e2) {
     FS_DirectoryEntry* ent1 = (FS_DirectoryEntry*) e1;
     FS_DirectoryEntry* ent2 = (FS_DirectoryEntry*) e2;
@@ -154,7 +161,7 @@ static void task_populate_files_thread(void* arg) {
     Result res = 0;
 
     list_item* baseItem = NULL;
-    if(R_SUCCEEDED(res = task_create_file_item(&baseItem, data->archive, data->path, UINT32_MAX))) {
+    if(R_SUCCEEDED(res = task_create_file_item_icon(&baseItem, data->archive, data->path, UINT32_MAX, !data->deferIcons))) {
         file_info* baseInfo = (file_info*) baseItem->data;
         if(baseInfo->attributes & FS_ATTRIBUTE_DIRECTORY) {
             strncpy(baseItem->name, "<current directory>", LIST_ITEM_NAME_MAX);
@@ -204,7 +211,7 @@ static void task_populate_files_thread(void* arg) {
                                         snprintf(path, FILE_PATH_MAX, "%s%s", curr->path, name);
 
                                         list_item* item = NULL;
-                                        if(R_SUCCEEDED(res = task_create_file_item(&item, curr->archive, path, entries[i].attributes))) {
+                                        if(R_SUCCEEDED(res = task_create_file_item_icon(&item, curr->archive, path, entries[i].attributes, !data->deferIcons))) {
                                             if(data->recursive && (((file_info*) item->data)->attributes & FS_ATTRIBUTE_DIRECTORY)) {
                                                 linked_list_add(&queue, item);
                                             } else {
@@ -243,6 +250,73 @@ static void task_populate_files_thread(void* arg) {
     data->finished = true;
 }
 
+typedef struct {
+    FS_Archive archive;
+    char path[FILE_PATH_MAX];
+} task_file_icon_key;
+
+static u32* task_file_icon_get_texture(list_item* item) {
+    file_info* fileInfo = (file_info*) item->data;
+    return fileInfo->isCia && fileInfo->ciaInfo.hasMeta ? &fileInfo->ciaInfo.meta.texture : NULL;
+}
+
+static void task_file_icon_get_key(list_item* item, void* key) {
+    file_info* fileInfo = (file_info*) item->data;
+    task_file_icon_key* fileKey = (task_file_icon_key*) key;
+
+    fileKey->archive = fileInfo->archive;
+    string_copy(fileKey->path, fileInfo->path, sizeof(fileKey->path));
+}
+
+static Result task_file_icon_fetch(const void* key, list_icon* icon) {
+    const task_file_icon_key* fileKey = (const task_file_icon_key*) key;
+
+    Result res = 0;
+
+    FS_Path* fileFsPath = util_make_path_utf8(fileKey->path);
+    if(fileFsPath != NULL) {
+        Handle fileHandle;
+        if(R_SUCCEEDED(res = FSUSER_OpenFile(&fileHandle, fileKey->archive, *fileFsPath, FS_OPEN_READ, 0))) {
+            SMDH* smdh = (SMDH*) calloc(1, sizeof(SMDH));
+            if(smdh != NULL) {
+                if(R_SUCCEEDED(res = util_get_cia_file_smdh(smdh, fileHandle))) {
+                    if(smdh->magic[0] != 'S' || smdh->magic[1] != 'M' || smdh->magic[2] != 'D' || smdh->magic[3] != 'H') {
+                        res = R_FBI_BAD_DATA;
+                    } else if((icon->data = malloc(sizeof(smdh->largeIcon))) != NULL) {
+                        memcpy(icon->data, smdh->largeIcon, sizeof(smdh->largeIcon));
+                        icon->size = sizeof(smdh->largeIcon);
+                        icon->width = 48;
+                        icon->height = 48;
+                        icon->format = GPU_RGB565;
+                        icon->tiled = true;
+                    } else {
+                        res = R_FBI_OUT_OF_MEMORY;
+                    }
+                }
+
+                free(smdh);
+            } else {
+                res = R_FBI_OUT_OF_MEMORY;
+            }
+
+            FSFILE_Close(fileHandle);
+        }
+
+        util_free_path_utf8(fileFsPath);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+const list_icon_ops task_file_icon_ops = {
+    .getTexture = task_file_icon_get_texture,
+    .getKey = task_file_icon_get_key,
+    .fetch = task_file_icon_fetch,
+    .decode = NULL
+};
+
 void task_free_file(list_item* item) {
     if(item == NULL) {
         return;
@@ -250,7 +324,7 @@ void task_free_file(list_item* item) {
 
     if(item->data != NULL) {
         file_info* fileInfo = (file_info*) item->data;
-        if(fileInfo->isCia && fileInfo->ciaInfo.hasMeta) {
+        if(fileInfo->isCia && fileInfo->ciaInfo.meta.texture != 0) {
             screen_unload_texture(fileInfo->ciaInfo.meta.texture);
         }
 
@@ -289,9 +363,7 @@ Result task_populate_files(populate_files_data* data) {
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
-        if(threadCreate(task_populate_files_thread, data, 0x10000, 0x19, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("File listing", TASK_PRIORITY_INTERACTIVE, task_populate_files_thread, data);
     }
 
     if(R_FAILED(res)) {
@@ -137,9 +137,7 @@ Result task_populate_pending_titles(populate_pending_titles_data* data) {
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
-        if(threadCreate(task_populate_pending_titles_thread, data, 0x10000, 0x19, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("Pending title listing", TASK_PRIORITY_INTERACTIVE, task_populate_pending_titles_thread, data);
     }
 
     if(R_FAILED(res)) {
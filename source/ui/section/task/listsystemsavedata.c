@@ -105,9 +105,7 @@ Result task_populate_system_save_data(populate_system_save_data_data* data) {
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
-        if(threadCreate(task_populate_system_save_data_thread, data, 0x10000, 0x19, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("System save data listing", TASK_PRIORITY_INTERACTIVE, task_populate_system_save_data_thread, data);
     }
 
     if(R_FAILED(res)) {
@@ -4,191 +4,410 @@
 #include <string.h>
 
 #include <3ds.h>
+#include <jansson.h>
 
 #include "task.h"
 #include "../../list.h"
 #include "../../error.h"
+#include "../../../core/bufpool.h"
+#include "../../../core/fs.h"
+#include "../../../core/http.h"
+#include "../../../core/jsonstream.h"
 #include "../../../core/linkedlist.h"
 #include "../../../core/screen.h"
+#include "../../../core/stringutil.h"
+#include "../../../core/titledbcache.h"
 #include "../../../core/util.h"
-#include "../../../json/json.h"
 #include "../../../stb_image/stb_image.h"
 
+// Goes through the shared downloader so that icon requests can reuse pooled connections.
 static Result task_populate_titledb_download(u32* downloadSize, void* buffer, u32 maxSize, const char* url) {
-    Result res = 0;
+    return http_download_buffer(url, downloadSize, buffer, maxSize);
+}
+
+static int task_populate_titledb_compare(void* userData, const void* p1, const void* p2) {
+    list_item* info1 = (list_item*) p1;
+    list_item* info2 = (list_item*) p2;
 
-    httpcContext context;
-    if(R_SUCCEEDED(res = util_http_open(&context, NULL, url, true))) {
-        res = util_http_read(&context, downloadSize, buffer, maxSize);
+    return strncasecmp(info1->name, info2->name, LIST_ITEM_NAME_MAX);
+}
+
+#define TITLEDB_ICON_PNG_MAX (128 * 1024)
+
+static u32* task_titledb_icon_get_texture(list_item* item) {
+    return &((titledb_info*) item->data)->meta.texture;
+}
 
-        Result closeRes = util_http_close(&context);
-        if(R_SUCCEEDED(res)) {
-            res = closeRes;
+static void task_titledb_icon_get_key(list_item* item, void* key) {
+    memcpy(key, &((titledb_info*) item->data)->titleId, sizeof(u64));
+}
+
+static Result task_titledb_icon_fetch(const void* key, list_icon* icon) {
+    u64 titleId = 0;
+    memcpy(&titleId, key, sizeof(titleId));
+
+    Result res = 0;
+
+    // Downloads go through a pooled buffer; only the bytes actually received are handed on.
+    u8* png = (u8*) bufpool_alloc(BUFPOOL_HEAP, TITLEDB_ICON_PNG_MAX);
+    if(png != NULL) {
+        char pngUrl[128];
+        snprintf(pngUrl, sizeof(pngUrl), "https://api.titledb.ga:7443/images/%016llX.png", titleId);
+
+        u32 pngSize = 0;
+        if(R_SUCCEEDED(res = task_populate_titledb_download(&pngSize, png, TITLEDB_ICON_PNG_MAX, pngUrl))) {
+            if((icon->data = malloc(pngSize)) != NULL) {
+                memcpy(icon->data, png, pngSize);
+                icon->size = pngSize;
+            } else {
+                res = R_FBI_OUT_OF_MEMORY;
+            }
         }
+
+        bufpool_free(BUFPOOL_HEAP, png, TITLEDB_ICON_PNG_MAX);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
     }
 
     return res;
 }
 
-static int task_populate_titledb_compare(void* userData, const void* p1, const void* p2) {
-    list_item* info1 = (list_item*) p1;
-    list_item* info2 = (list_item*) p2;
+static Result task_titledb_icon_decode(list_icon* icon) {
+    int width;
+    int height;
+    int depth;
+    u8* image = stbi_load_from_memory((u8*) icon->data, (int) icon->size, &width, &height, &depth, STBI_rgb_alpha);
+    if(image == NULL) {
+        return R_FBI_BAD_DATA;
+    }
 
-    return strncasecmp(info1->name, info2->name, LIST_ITEM_NAME_MAX);
+    if(depth != STBI_rgb_alpha) {
+        free(image);
+        return R_FBI_BAD_DATA;
+    }
+
+    for(u32 x = 0; x < width; x++) {
+        for(u32 y = 0; y < height; y++) {
+            u32 pos = (y * width + x) * 4;
+
+            u8 c1 = image[pos + 0];
+            u8 c2 = image[pos + 1];
+            u8 c3 = image[pos + 2];
+            u8 c4 = image[pos + 3];
+
+            image[pos + 0] = c4;
+            image[pos + 1] = c3;
+            image[pos + 2] = c2;
+            image[pos + 3] = c1;
+        }
+    }
+
+    free(icon->data);
+
+    icon->data = image;
+    icon->size = (u32) (width * height * 4);
+    icon->width = (u32) width;
+    icon->height = (u32) height;
+    icon->format = GPU_RGBA8;
+    icon->tiled = false;
+
+    return 0;
 }
 
-static void task_populate_titledb_thread(void* arg) {
-    populate_titledb_data* data = (populate_titledb_data*) arg;
+const list_icon_ops task_titledb_icon_ops = {
+    .getTexture = task_titledb_icon_get_texture,
+    .getKey = task_titledb_icon_get_key,
+    .fetch = task_titledb_icon_fetch,
+    .decode = task_titledb_icon_decode
+};
+
+#define TITLEDB_CACHE_PATH "/fbi/cache/titledb.bin"
+
+typedef struct {
+    populate_titledb_data* data;
+
+    json_stream stream;
+    titledb_info* info;
+    char key[16];
+
+    // With a snapshot already on screen, entries only go into the new snapshot until the download is complete.
+    bool cached;
+    titledb_cache_builder builder;
+} populate_titledb_parse_data;
+
+static Result task_populate_titledb_add(linked_list* items, titledb_info* titledbInfo) {
+    list_item* item = (list_item*) calloc(1, sizeof(list_item));
+    if(item == NULL) {
+        return R_FBI_OUT_OF_MEMORY;
+    }
+
+    if(strlen(titledbInfo->meta.shortDescription) > 0) {
+        string_copy(item->name, titledbInfo->meta.shortDescription, LIST_ITEM_NAME_MAX);
+    } else {
+        snprintf(item->name, LIST_ITEM_NAME_MAX, "%016llX", titledbInfo->titleId);
+    }
+
+    AM_TitleEntry entry;
+    if(R_SUCCEEDED(AM_GetTitleInfo(util_get_title_destination(titledbInfo->titleId), 1, &titledbInfo->titleId, &entry))) {
+        item->color = COLOR_INSTALLED;
+    } else {
+        item->color = COLOR_NOT_INSTALLED;
+    }
+
+    item->data = titledbInfo;
+
+    linked_list_add_sorted(items, item, NULL, task_populate_titledb_compare);
+
+    return 0;
+}
+
+static Result task_populate_titledb_add_cache(populate_titledb_data* data, linked_list* items, const titledb_cache* cache) {
+    Result res = 0;
+
+    for(u32 i = 0; i < cache->recordCount && R_SUCCEEDED(res); i++) {
+        if(task_is_quit_all() || svcWaitSynchronization(data->cancelEvent, 0) == 0) {
+            res = R_FBI_CANCELLED;
+            break;
+        }
+
+        const titledb_cache_record* record = &cache->records[i];
+
+        titledb_info* titledbInfo = (titledb_info*) calloc(1, sizeof(titledb_info));
+        if(titledbInfo == NULL) {
+            res = R_FBI_OUT_OF_MEMORY;
+            break;
+        }
+
+        titledbInfo->titleId = record->titleId;
+        titledbInfo->size = record->size;
+        string_copy(titledbInfo->meta.shortDescription, titledb_cache_get_string(cache, record->name), sizeof(titledbInfo->meta.shortDescription));
+        string_copy(titledbInfo->meta.longDescription, titledb_cache_get_string(cache, record->description), sizeof(titledbInfo->meta.longDescription));
+        string_copy(titledbInfo->meta.publisher, titledb_cache_get_string(cache, record->author), sizeof(titledbInfo->meta.publisher));
+
+        if(R_FAILED(res = task_populate_titledb_add(items, titledbInfo))) {
+            free(titledbInfo);
+        }
+    }
+
+    return res;
+}
 
+// The snapshot is read with a single read into one buffer; records and strings are used in place.
+static Result task_populate_titledb_read_cache(void** buffer, u32* size) {
     Result res = 0;
 
-    linked_list tempItems;
-    linked_list_init(&tempItems);
-
-    u32 maxTextSize = 128 * 1024;
-    char* text = (char*) calloc(sizeof(char), maxTextSize);
-    if(text != NULL) {
-        u32 textSize = 0;
-        if(R_SUCCEEDED(res = task_populate_titledb_download(&textSize, text, maxTextSize, "https://api.titledb.ga:7443/v0/"))) {
-            json_value* json = json_parse(text, textSize);
-            if(json != NULL) {
-                if(json->type == json_array) {
-                    for(u32 i = 0; i < json->u.array.length && R_SUCCEEDED(res); i++) {
-                        svcWaitSynchronization(task_get_pause_event(), U64_MAX);
-                        if(task_is_quit_all() || svcWaitSynchronization(data->cancelEvent, 0) == 0) {
-                            break;
+    FS_Archive archive = 0;
+    if(R_SUCCEEDED(res = FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        Handle fileHandle = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenFile(&fileHandle, archive, fsMakePath(PATH_ASCII, TITLEDB_CACHE_PATH), FS_OPEN_READ, 0))) {
+            u64 fileSize = 0;
+            if(R_SUCCEEDED(res = FSFILE_GetSize(fileHandle, &fileSize))) {
+                if(fileSize <= TITLEDB_CACHE_SIZE_MAX) {
+                    void* data = malloc((size_t) fileSize);
+                    if(data != NULL) {
+                        u32 bytesRead = 0;
+                        if(R_SUCCEEDED(res = FSFILE_Read(fileHandle, &bytesRead, 0, data, (u32) fileSize)) && bytesRead != fileSize) {
+                            res = R_FBI_BAD_DATA;
                         }
 
-                        json_value* val = json->u.array.values[i];
-                        if(val->type == json_object) {
-                            list_item* item = (list_item*) calloc(1, sizeof(list_item));
-                            if(item != NULL) {
-                                titledb_info* titledbInfo = (titledb_info*) calloc(1, sizeof(titledb_info));
-                                if(titledbInfo != NULL) {
-                                    for(u32 j = 0; j < val->u.object.length; j++) {
-                                        char* name = val->u.object.values[j].name;
-                                        u32 nameLen = val->u.object.values[j].name_length;
-                                        json_value* subVal = val->u.object.values[j].value;
-                                        if(subVal->type == json_string) {
-                                            if(strncmp(name, "titleid", nameLen) == 0) {
-                                                titledbInfo->titleId = strtoull(subVal->u.string.ptr, NULL, 16);
-                                            } else if(strncmp(name, "name", nameLen) == 0) {
-                                                strncpy(titledbInfo->meta.shortDescription, subVal->u.string.ptr, sizeof(titledbInfo->meta.shortDescription));
-                                            } else if(strncmp(name, "description", nameLen) == 0) {
-                                                strncpy(titledbInfo->meta.longDescription, subVal->u.string.ptr, sizeof(titledbInfo->meta.longDescription));
-                                            } else if(strncmp(name, "author", nameLen) == 0) {
-                                                strncpy(titledbInfo->meta.publisher, subVal->u.string.ptr, sizeof(titledbInfo->meta.publisher));
-                                            }
-                                        } else if(subVal->type == json_integer) {
-                                            if(strncmp(name, "size", nameLen) == 0) {
-                                                titledbInfo->size = (u64) subVal->u.integer;
-                                            }
-                                        }
-                                    }
-
-                                    if(strlen(titledbInfo->meta.shortDescription) > 0) {
-                                        strncpy(item->name, titledbInfo->meta.shortDescription, LIST_ITEM_NAME_MAX);
-                                    } else {
-                                        snprintf(item->name, LIST_ITEM_NAME_MAX, "%016llX", titledbInfo->titleId);
-                                    }
-
-                                    AM_TitleEntry entry;
-                                    if(R_SUCCEEDED(AM_GetTitleInfo(util_get_title_destination(titledbInfo->titleId), 1, &titledbInfo->titleId, &entry))) {
-                                        item->color = COLOR_INSTALLED;
-                                    } else {
-                                        item->color = COLOR_NOT_INSTALLED;
-                                    }
-
-                                    item->data = titledbInfo;
-
-                                    linked_list_add(&tempItems, item);
-                                } else {
-                                    free(item);
-
-                                    res = R_FBI_OUT_OF_MEMORY;
-                                }
-                            } else {
-                                res = R_FBI_OUT_OF_MEMORY;
-                            }
+                        if(R_SUCCEEDED(res)) {
+                            *buffer = data;
+                            *size = (u32) fileSize;
+                        } else {
+                            free(data);
                         }
+                    } else {
+                        res = R_FBI_OUT_OF_MEMORY;
                     }
                 } else {
                     res = R_FBI_BAD_DATA;
                 }
-            } else {
-                res = R_FBI_PARSE_FAILED;
             }
+
+            FSFILE_Close(fileHandle);
         }
 
-        free(text);
-    } else {
-        res = R_FBI_OUT_OF_MEMORY;
+        FSUSER_CloseArchive(archive);
     }
 
-    if(R_SUCCEEDED(res)) {
-        linked_list_sort(&tempItems, NULL, task_populate_titledb_compare);
+    return res;
+}
+
+static Result task_populate_titledb_write_cache(const void* buffer, u32 size) {
+    Result res = 0;
+
+    FS_Archive archive = 0;
+    if(R_SUCCEEDED(res = FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        FS_Path path = fsMakePath(PATH_ASCII, TITLEDB_CACHE_PATH);
 
-        linked_list_iter tempIter;
-        linked_list_iterate(&tempItems, &tempIter);
+        if(R_SUCCEEDED(res = fs_ensure_dir(archive, "/fbi/")) && R_SUCCEEDED(res = fs_ensure_dir(archive, "/fbi/cache/"))) {
+            FSUSER_DeleteFile(archive, path);
 
-        while(linked_list_iter_has_next(&tempIter)) {
-            linked_list_add(data->items, linked_list_iter_next(&tempIter));
+            Handle fileHandle = 0;
+            if(R_SUCCEEDED(res = FSUSER_OpenFile(&fileHandle, archive, path, FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+                u32 bytesWritten = 0;
+                res = FSFILE_Write(fileHandle, &bytesWritten, 0, buffer, size, FS_WRITE_FLUSH);
+
+                FSFILE_Close(fileHandle);
+
+                // A partial snapshot would be rejected on load anyway, but don't leave it lying around.
+                if(R_FAILED(res)) {
+                    FSUSER_DeleteFile(archive, path);
+                }
+            }
         }
 
-        linked_list_iter iter;
-        linked_list_iterate(data->items, &iter);
+        FSUSER_CloseArchive(archive);
+    }
 
-        while(linked_list_iter_has_next(&iter)) {
-            svcWaitSynchronization(task_get_pause_event(), U64_MAX);
-            if(task_is_quit_all() || svcWaitSynchronization(data->cancelEvent, 0) == 0) {
-                break;
+    return res;
+}
+
+// Each top-level array element becomes a list item as soon as its closing brace arrives.
+static Result task_populate_titledb_parse_callback(void* userData, json_stream_event event, u32 depth, const char* value, u32 length) {
+    populate_titledb_parse_data* parseData = (populate_titledb_parse_data*) userData;
+
+    Result res = 0;
+
+    if(depth == 0) {
+        if(event != JSON_STREAM_ARRAY_START && event != JSON_STREAM_ARRAY_END) {
+            res = R_FBI_BAD_DATA;
+        }
+    } else if(depth == 1) {
+        if(event == JSON_STREAM_OBJECT_START) {
+            if(parseData->info != NULL) {
+                memset(parseData->info, 0, sizeof(titledb_info));
+            } else if((parseData->info = (titledb_info*) calloc(1, sizeof(titledb_info))) == NULL) {
+                res = R_FBI_OUT_OF_MEMORY;
             }
+        } else if(event == JSON_STREAM_OBJECT_END && parseData->info != NULL) {
+            titledb_info* titledbInfo = parseData->info;
 
-            list_item* item = (list_item*) linked_list_iter_next(&iter);
-            titledb_info* titledbInfo = (titledb_info*) item->data;
-
-            u32 maxPngSize = 128 * 1024;
-            u8* png = (u8*) calloc(1, maxPngSize);
-            if(png != NULL) {
-                char pngUrl[128];
-                snprintf(pngUrl, sizeof(pngUrl), "https://api.titledb.ga:7443/images/%016llX.png", titledbInfo->titleId);
-
-                u32 pngSize = 0;
-                if(R_SUCCEEDED(task_populate_titledb_download(&pngSize, png, maxPngSize, pngUrl))) {
-                    int width;
-                    int height;
-                    int depth;
-                    u8* image = stbi_load_from_memory(png, (int) pngSize, &width, &height, &depth, STBI_rgb_alpha);
-                    if(image != NULL && depth == STBI_rgb_alpha) {
-                        for(u32 x = 0; x < width; x++) {
-                            for(u32 y = 0; y < height; y++) {
-                                u32 pos = (y * width + x) * 4;
-
-                                u8 c1 = image[pos + 0];
-                                u8 c2 = image[pos + 1];
-                                u8 c3 = image[pos + 2];
-                                u8 c4 = image[pos + 3];
-
-                                image[pos + 0] = c4;
-                                image[pos + 1] = c3;
-                                image[pos + 2] = c2;
-                                image[pos + 3] = c1;
-                            }
-                        }
+            if(R_SUCCEEDED(res = titledb_cache_builder_add(&parseData->builder, titledbInfo->titleId, titledbInfo->size, titledbInfo->meta.shortDescription, titledbInfo->meta.longDescription, titledbInfo->meta.publisher))
+               && !parseData->cached) {
+                if(R_SUCCEEDED(res = task_populate_titledb_add(parseData->data->items, titledbInfo))) {
+                    parseData->info = NULL;
+                }
+            }
+        }
+    } else if(depth == 2 && parseData->info != NULL) {
+        titledb_info* titledbInfo = parseData->info;
+
+        if(event == JSON_STREAM_KEY) {
+            string_copy(parseData->key, value, sizeof(parseData->key));
+        } else if(event == JSON_STREAM_STRING) {
+            if(strcmp(parseData->key, "titleid") == 0) {
+                titledbInfo->titleId = strtoull(value, NULL, 16);
+            } else if(strcmp(parseData->key, "name") == 0) {
+                string_copy(titledbInfo->meta.shortDescription, value, sizeof(titledbInfo->meta.shortDescription));
+            } else if(strcmp(parseData->key, "description") == 0) {
+                string_copy(titledbInfo->meta.longDescription, value, sizeof(titledbInfo->meta.longDescription));
+            } else if(strcmp(parseData->key, "author") == 0) {
+                string_copy(titledbInfo->meta.publisher, value, sizeof(titledbInfo->meta.publisher));
+            }
+        } else if(event == JSON_STREAM_NUMBER) {
+            if(strcmp(parseData->key, "size") == 0) {
+                titledbInfo->size = strtoull(value, NULL, 10);
+            }
+        }
+    }
+
+    return res;
+}
+
+static Result task_populate_titledb_download_callback(void* userData, void* buffer, size_t size) {
+    populate_titledb_parse_data* parseData = (populate_titledb_parse_data*) userData;
 
-                        titledbInfo->meta.texture = screen_allocate_free_texture();
-                        screen_load_texture(titledbInfo->meta.texture, image, (u32) (width * height * 4), (u32) width, (u32) height, GPU_RGBA8, false);
+    svcWaitSynchronization(task_get_pause_event(), U64_MAX);
+    if(task_is_quit_all() || svcWaitSynchronization(parseData->data->cancelEvent, 0) == 0) {
+        return R_FBI_CANCELLED;
+    }
+
+    return json_stream_feed(&parseData->stream, buffer, (u32) size);
+}
+
+static void task_populate_titledb_thread(void* arg) {
+    populate_titledb_data* data = (populate_titledb_data*) arg;
+
+    Result res = 0;
 
-                        free(image);
+    // The last snapshot is shown straight away; the download then replaces it only if the catalogue has changed.
+    void* cacheBuffer = NULL;
+    u32 cacheSize = 0;
+    titledb_cache cache;
+
+    bool cached = false;
+    if(R_SUCCEEDED(task_populate_titledb_read_cache(&cacheBuffer, &cacheSize))) {
+        if(R_SUCCEEDED(titledb_cache_open(&cache, cacheBuffer, cacheSize))) {
+            cached = true;
+            res = task_populate_titledb_add_cache(data, data->items, &cache);
+        } else {
+            free(cacheBuffer);
+            cacheBuffer = NULL;
+        }
+    }
+
+    // The catalogue is parsed as it arrives, so memory use doesn't grow with its size.
+    populate_titledb_parse_data* parseData = NULL;
+    if(R_SUCCEEDED(res) && (parseData = (populate_titledb_parse_data*) calloc(1, sizeof(populate_titledb_parse_data))) == NULL) {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    if(parseData != NULL) {
+        parseData->data = data;
+        parseData->cached = cached;
+        titledb_cache_builder_init(&parseData->builder);
+        json_stream_init(&parseData->stream, parseData, task_populate_titledb_parse_callback);
+
+        u64 contentLength = 0;
+        if(R_SUCCEEDED(res = http_download_callback("https://api.titledb.ga:7443/v0/", 16 * 1024, &contentLength, parseData, task_populate_titledb_download_callback))
+           && R_SUCCEEDED(res = json_stream_finish(&parseData->stream))) {
+            void* snapshot = NULL;
+            u32 snapshotSize = 0;
+            if(R_SUCCEEDED(titledb_cache_builder_finish(&parseData->builder, &snapshot, &snapshotSize))) {
+                if(!cached || snapshotSize != cacheSize || memcmp(snapshot, cacheBuffer, cacheSize) != 0) {
+                    task_populate_titledb_write_cache(snapshot, snapshotSize);
+
+                    titledb_cache fresh;
+                    if(cached && R_SUCCEEDED(titledb_cache_open(&fresh, snapshot, snapshotSize))) {
+                        linked_list* refreshItems = (linked_list*) calloc(1, sizeof(linked_list));
+                        if(refreshItems != NULL) {
+                            linked_list_init(refreshItems);
+
+                            if(R_SUCCEEDED(res = task_populate_titledb_add_cache(data, refreshItems, &fresh))) {
+                                data->refreshItems = refreshItems;
+                            } else {
+                                task_clear_titledb(refreshItems);
+                                free(refreshItems);
+                            }
+                        } else {
+                            res = R_FBI_OUT_OF_MEMORY;
+                        }
                     }
                 }
 
-                free(png);
+                free(snapshot);
             }
         }
+
+        if(res == R_FBI_CANCELLED) {
+            res = 0;
+        }
+
+        titledb_cache_builder_free(&parseData->builder);
+
+        if(parseData->info != NULL) {
+            free(parseData->info);
+        }
+
+        free(parseData);
+    } else if(res == R_FBI_CANCELLED) {
+        res = 0;
     }
 
-    linked_list_destroy(&tempItems);
+    if(cacheBuffer != NULL) {
+        free(cacheBuffer);
+    }
 
     svcCloseHandle(data->cancelEvent);
 
@@ -230,11 +449,78 @@ void task_clear_titledb(linked_list* items) {
     }
 }
 
+static int task_populate_titledb_compare_title_id(const void* p1, const void* p2) {
+    u64 titleId1 = ((titledb_info*) (*(list_item**) p1)->data)->titleId;
+    u64 titleId2 = ((titledb_info*) (*(list_item**) p2)->data)->titleId;
+
+    return titleId1 < titleId2 ? -1 : titleId1 > titleId2 ? 1 : 0;
+}
+
+void task_apply_titledb_refresh(populate_titledb_data* data) {
+    if(data == NULL || data->items == NULL || data->refreshItems == NULL) {
+        return;
+    }
+
+    linked_list* refreshItems = data->refreshItems;
+    data->refreshItems = NULL;
+
+    // Icons that are already loaded carry over to the matching refreshed entries.
+    u32 count = linked_list_size(data->items);
+    list_item** oldItems = count > 0 ? (list_item**) calloc(count, sizeof(list_item*)) : NULL;
+    if(oldItems != NULL) {
+        linked_list_iter iter;
+        linked_list_iterate(data->items, &iter);
+
+        for(u32 i = 0; i < count && linked_list_iter_has_next(&iter); i++) {
+            oldItems[i] = (list_item*) linked_list_iter_next(&iter);
+        }
+
+        qsort(oldItems, count, sizeof(list_item*), task_populate_titledb_compare_title_id);
+
+        linked_list_iterate(refreshItems, &iter);
+        while(linked_list_iter_has_next(&iter)) {
+            list_item* item = (list_item*) linked_list_iter_next(&iter);
+
+            list_item** oldItem = (list_item**) bsearch(&item, oldItems, count, sizeof(list_item*), task_populate_titledb_compare_title_id);
+            if(oldItem != NULL) {
+                titledb_info* oldInfo = (titledb_info*) (*oldItem)->data;
+
+                ((titledb_info*) item->data)->meta.texture = oldInfo->meta.texture;
+                oldInfo->meta.texture = 0;
+            }
+        }
+
+        free(oldItems);
+    }
+
+    task_clear_titledb(data->items);
+
+    linked_list_iter iter;
+    linked_list_iterate(refreshItems, &iter);
+    while(linked_list_iter_has_next(&iter)) {
+        linked_list_add(data->items, linked_list_iter_next(&iter));
+    }
+
+    linked_list_destroy(refreshItems);
+    free(refreshItems);
+}
+
+void task_discard_titledb_refresh(populate_titledb_data* data) {
+    if(data == NULL || data->refreshItems == NULL) {
+        return;
+    }
+
+    task_clear_titledb(data->refreshItems);
+    free(data->refreshItems);
+    data->refreshItems = NULL;
+}
+
 Result task_populate_titledb(populate_titledb_data* data) {
     if(data == NULL || data->items == NULL) {
         return R_FBI_INVALID_ARGUMENT;
     }
 
+    task_discard_titledb_refresh(data);
     task_clear_titledb(data->items);
 
     data->finished = false;
@@ -243,9 +529,7 @@ Result task_populate_titledb(populate_titledb_data* data) {
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
-        if(threadCreate(task_populate_titledb_thread, data, 0x10000, 0x19, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("TitleDB listing", TASK_PRIORITY_INTERACTIVE, task_populate_titledb_thread, data);
     }
 
     if(R_FAILED(res)) {
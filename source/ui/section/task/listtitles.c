@@ -13,6 +13,27 @@
 #include "../../../core/screen.h"
 #include "../../../core/util.h"
 
+static Result task_populate_titles_read_smdh(FS_MediaType mediaType, u64 titleId, SMDH* smdh) {
+    static const u32 filePath[5] = {0x00000000, 0x00000000, 0x00000002, 0x6E6F6369, 0x00000000};
+    u32 archivePath[4] = {(u32) (titleId & 0xFFFFFFFF), (u32) ((titleId >> 32) & 0xFFFFFFFF), mediaType, 0x00000000};
+
+    Result res = 0;
+
+    Handle fileHandle;
+    if(R_SUCCEEDED(res = FSUSER_OpenFileDirectly(&fileHandle, ARCHIVE_SAVEDATA_AND_CONTENT, util_make_binary_path(archivePath, sizeof(archivePath)), util_make_binary_path(filePath, sizeof(filePath)), FS_OPEN_READ, 0))) {
+        u32 bytesRead = 0;
+        if(R_SUCCEEDED(res = FSFILE_Read(fileHandle, &bytesRead, 0, smdh, sizeof(SMDH)))) {
+            if(bytesRead != sizeof(SMDH) || smdh->magic[0] != 'S' || smdh->magic[1] != 'M' || smdh->magic[2] != 'D' || smdh->magic[3] != 'H') {
+                res = R_FBI_BAD_DATA;
+            }
+        }
+
+        FSFILE_Close(fileHandle);
+    }
+
+    return res;
+}
+
 static Result task_populate_titles_add_ctr(populate_titles_data* data, FS_MediaType mediaType, u64 titleId) {
     Result res = 0;
 
@@ -30,35 +51,23 @@ static Result task_populate_titles_add_ctr(populate_titles_data* data, FS_MediaT
                 titleInfo->twl = false;
                 titleInfo->hasMeta = false;
 
-                static const u32 filePath[5] = {0x00000000, 0x00000000, 0x00000002, 0x6E6F6369, 0x00000000};
-                u32 archivePath[4] = {(u32) (titleId & 0xFFFFFFFF), (u32) ((titleId >> 32) & 0xFFFFFFFF), mediaType, 0x00000000};
-
-                Handle fileHandle;
-                if(R_SUCCEEDED(FSUSER_OpenFileDirectly(&fileHandle, ARCHIVE_SAVEDATA_AND_CONTENT, util_make_binary_path(archivePath, sizeof(archivePath)), util_make_binary_path(filePath, sizeof(filePath)), FS_OPEN_READ, 0))) {
-                    SMDH* smdh = (SMDH*) calloc(1, sizeof(SMDH));
-                    if(smdh != NULL) {
-                        u32 bytesRead = 0;
-                        if(R_SUCCEEDED(FSFILE_Read(fileHandle, &bytesRead, 0, smdh, sizeof(SMDH))) && bytesRead == sizeof(SMDH)) {
-                            if(smdh->magic[0] == 'S' && smdh->magic[1] == 'M' && smdh->magic[2] == 'D' && smdh->magic[3] == 'H') {
-                                titleInfo->hasMeta = true;
+                // The icon is left for the list to load once the title scrolls into view.
+                SMDH* smdh = (SMDH*) calloc(1, sizeof(SMDH));
+                if(smdh != NULL) {
+                    if(R_SUCCEEDED(task_populate_titles_read_smdh(mediaType, titleId, smdh))) {
+                        titleInfo->hasMeta = true;
 
-                                SMDH_title* smdhTitle = util_select_smdh_title(smdh);
+                        SMDH_title* smdhTitle = util_select_smdh_title(smdh);
 
-                                utf16_to_utf8((uint8_t*) item->name, smdhTitle->shortDescription, NAME_MAX - 1);
+                        utf16_to_utf8((uint8_t*) item->name, smdhTitle->shortDescription, NAME_MAX - 1);
 
-                                utf16_to_utf8((uint8_t*) titleInfo->meta.shortDescription, smdhTitle->shortDescription, sizeof(titleInfo->meta.shortDescription) - 1);
-                                utf16_to_utf8((uint8_t*) titleInfo->meta.longDescription, smdhTitle->longDescription, sizeof(titleInfo->meta.longDescription) - 1);
-                                utf16_to_utf8((uint8_t*) titleInfo->meta.publisher, smdhTitle->publisher, sizeof(titleInfo->meta.publisher) - 1);
-                                titleInfo->meta.region = smdh->region;
-                                titleInfo->meta.texture = screen_allocate_free_texture();
-                                screen_load_texture_tiled(titleInfo->meta.texture, smdh->largeIcon, sizeof(smdh->largeIcon), 48, 48, GPU_RGB565, false);
-                            }
-                        }
-
-                        free(smdh);
+                        utf16_to_utf8((uint8_t*) titleInfo->meta.shortDescription, smdhTitle->shortDescription, sizeof(titleInfo->meta.shortDescription) - 1);
+                        utf16_to_utf8((uint8_t*) titleInfo->meta.longDescription, smdhTitle->longDescription, sizeof(titleInfo->meta.longDescription) - 1);
+                        utf16_to_utf8((uint8_t*) titleInfo->meta.publisher, smdhTitle->publisher, sizeof(titleInfo->meta.publisher) - 1);
+                        titleInfo->meta.region = smdh->region;
                     }
 
-                    FSFILE_Close(fileHandle);
+                    free(smdh);
                 }
 
                 if(util_is_string_empty(item->name)) {
@@ -190,8 +199,7 @@ static Result task_populate_titles_add_twl(populate_titles_data* data, FS_MediaT
                             titleInfo->meta.region = 0;
                         }
 
-                        titleInfo->meta.texture = screen_allocate_free_texture();
-                        screen_load_texture(titleInfo->meta.texture, icon, sizeof(icon), 32, 32, GPU_RGBA5551, false);
+                        titleInfo->meta.texture = screen_load_texture_atlas(icon, sizeof(icon), 32, 32, GPU_RGBA5551, false);
                     }
 
                     free(bnr);
@@ -290,6 +298,60 @@ static void task_populate_titles_thread(void* arg) {
     data->finished = true;
 }
 
+typedef struct {
+    FS_MediaType mediaType;
+    u64 titleId;
+} task_title_icon_key;
+
+// DS titles keep the icon built from their banner while listing.
+static u32* task_title_icon_get_texture(list_item* item) {
+    title_info* titleInfo = (title_info*) item->data;
+    return titleInfo->hasMeta && !titleInfo->twl ? &titleInfo->meta.texture : NULL;
+}
+
+static void task_title_icon_get_key(list_item* item, void* key) {
+    title_info* titleInfo = (title_info*) item->data;
+    task_title_icon_key* titleKey = (task_title_icon_key*) key;
+
+    titleKey->mediaType = titleInfo->mediaType;
+    titleKey->titleId = titleInfo->titleId;
+}
+
+static Result task_title_icon_fetch(const void* key, list_icon* icon) {
+    const task_title_icon_key* titleKey = (const task_title_icon_key*) key;
+
+    Result res = 0;
+
+    SMDH* smdh = (SMDH*) calloc(1, sizeof(SMDH));
+    if(smdh != NULL) {
+        if(R_SUCCEEDED(res = task_populate_titles_read_smdh(titleKey->mediaType, titleKey->titleId, smdh))) {
+            if((icon->data = malloc(sizeof(smdh->largeIcon))) != NULL) {
+                memcpy(icon->data, smdh->largeIcon, sizeof(smdh->largeIcon));
+                icon->size = sizeof(smdh->largeIcon);
+                icon->width = 48;
+                icon->height = 48;
+                icon->format = GPU_RGB565;
+                icon->tiled = true;
+            } else {
+                res = R_FBI_OUT_OF_MEMORY;
+            }
+        }
+
+        free(smdh);
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+const list_icon_ops task_title_icon_ops = {
+    .getTexture = task_title_icon_get_texture,
+    .getKey = task_title_icon_get_key,
+    .fetch = task_title_icon_fetch,
+    .decode = NULL
+};
+
 void task_free_title(list_item* item) {
     if(item == NULL) {
         return;
@@ -297,7 +359,7 @@ void task_free_title(list_item* item) {
 
     if(item->data != NULL) {
         title_info* titleInfo = (title_info*) item->data;
-        if(titleInfo->hasMeta) {
+        if(titleInfo->meta.texture != 0) {
             screen_unload_texture(titleInfo->meta.texture);
         }
 
@@ -336,9 +398,7 @@ Result task_populate_titles(populate_titles_data* data) {
 
     Result res = 0;
     if(R_SUCCEEDED(res = svcCreateEvent(&data->cancelEvent, RESET_STICKY))) {
-        if(threadCreate(task_populate_titles_thread, data, 0x10000, 0x19, 1, true) == NULL) {
-            res = R_FBI_THREAD_CREATE_FAILED;
-        }
+        res = task_submit("Title listing", TASK_PRIORITY_INTERACTIVE, task_populate_titles_thread, data);
     }
 
     if(R_FAILED(res)) {
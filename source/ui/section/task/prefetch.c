@@ -0,0 +1,376 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <3ds.h>
+#include <jansson.h>
+
+#include "task.h"
+#include "../../../core/core.h"
+
+#define PREFETCH_SPILL_PATH "/fbi/cache/prefetch.tmp"
+
+typedef struct prefetch_chunk_s {
+    struct prefetch_chunk_s* next;
+    u32 size;
+    u32 offset;
+    u8 data[];
+} prefetch_chunk;
+
+struct data_op_prefetch_s {
+    u32 index;
+    char url[DOWNLOAD_URL_MAX];
+    u32 bufferSize;
+    u32 connections;
+    u32 memoryBudget;
+    Handle cancelEvent;
+
+    Handle mutex;
+    Handle dataEvent;
+    Handle spaceEvent;
+    Handle closeEvent;
+    Thread thread;
+
+    // Bytes are queued in memory first; once the budget is used up they go to the spill file, and memory is only used
+    // again once the spill file has been drained, so everything in memory always precedes everything spilled.
+    prefetch_chunk* head;
+    prefetch_chunk* tail;
+    u32 memoryUsed;
+
+    FS_Archive spillArchive;
+    Handle spillHandle;
+    u64 spillRead;
+    u64 spillWrite;
+
+    u64 contentLength;
+    bool claimed;
+    volatile bool cancel;
+    bool done;
+    Result result;
+};
+
+static Result task_prefetch_spill(data_op_prefetch* prefetch, void* buffer, u32 size) {
+    Result res = 0;
+
+    if(prefetch->spillHandle == 0) {
+        if(R_SUCCEEDED(res = FSUSER_OpenArchive(&prefetch->spillArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+            FS_Path path = fsMakePath(PATH_ASCII, PREFETCH_SPILL_PATH);
+
+            if(R_SUCCEEDED(res = fs_ensure_dir(prefetch->spillArchive, "/fbi/"))
+               && R_SUCCEEDED(res = fs_ensure_dir(prefetch->spillArchive, "/fbi/cache/"))) {
+                FSUSER_DeleteFile(prefetch->spillArchive, path);
+                res = FSUSER_OpenFile(&prefetch->spillHandle, prefetch->spillArchive, path, FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE, 0);
+            }
+
+            if(R_FAILED(res)) {
+                FSUSER_CloseArchive(prefetch->spillArchive);
+                prefetch->spillArchive = 0;
+                prefetch->spillHandle = 0;
+            }
+        }
+    }
+
+    if(R_SUCCEEDED(res)) {
+        u32 bytesWritten = 0;
+        if(R_SUCCEEDED(res = FSFILE_Write(prefetch->spillHandle, &bytesWritten, prefetch->spillWrite, buffer, size, 0))) {
+            prefetch->spillWrite += bytesWritten;
+        }
+    }
+
+    return res;
+}
+
+static Result task_prefetch_callback(void* userData, void* buffer, size_t size) {
+    data_op_prefetch* prefetch = (data_op_prefetch*) userData;
+
+    Result res = 0;
+
+    svcWaitSynchronization(prefetch->mutex, U64_MAX);
+
+    // Once claimed, the data is being consumed as it arrives; wait for room instead of spilling.
+    while(!prefetch->cancel && prefetch->claimed && prefetch->spillRead == prefetch->spillWrite
+          && prefetch->memoryUsed > 0 && prefetch->memoryUsed + size > prefetch->memoryBudget) {
+        svcReleaseMutex(prefetch->mutex);
+        svcWaitSynchronization(prefetch->spaceEvent, U64_MAX);
+        svcWaitSynchronization(prefetch->mutex, U64_MAX);
+    }
+
+    if(prefetch->cancel || task_is_quit_all() || svcWaitSynchronization(prefetch->cancelEvent, 0) == 0) {
+        res = R_FBI_CANCELLED;
+    } else {
+        prefetch_chunk* chunk = NULL;
+        if(prefetch->spillRead == prefetch->spillWrite && prefetch->memoryUsed + size <= prefetch->memoryBudget) {
+            chunk = (prefetch_chunk*) malloc(sizeof(prefetch_chunk) + size);
+        }
+
+        if(chunk != NULL) {
+            chunk->next = NULL;
+            chunk->size = size;
+            chunk->offset = 0;
+            memcpy(chunk->data, buffer, size);
+
+            if(prefetch->tail != NULL) {
+                prefetch->tail->next = chunk;
+            } else {
+                prefetch->head = chunk;
+            }
+
+            prefetch->tail = chunk;
+            prefetch->memoryUsed += size;
+        } else {
+            res = task_prefetch_spill(prefetch, buffer, size);
+        }
+
+        svcSignalEvent(prefetch->dataEvent);
+    }
+
+    svcReleaseMutex(prefetch->mutex);
+
+    return res;
+}
+
+static void task_prefetch_thread(void* arg) {
+    data_op_prefetch* prefetch = (data_op_prefetch*) arg;
+
+    bandwidth_set_class(BANDWIDTH_CLASS_INSTALL);
+
+    // The length is set before the first callback, so it is in place by the time anything can be read.
+    Result res = http_download_callback_segmented(prefetch->url, 0, prefetch->bufferSize, prefetch->connections, prefetch->closeEvent, &prefetch->contentLength, prefetch, task_prefetch_callback);
+
+    svcWaitSynchronization(prefetch->mutex, U64_MAX);
+
+    prefetch->result = res;
+    prefetch->done = true;
+
+    svcSignalEvent(prefetch->dataEvent);
+    svcReleaseMutex(prefetch->mutex);
+}
+
+Result task_prefetch_start(data_op_prefetch** prefetch, u32 index, const char* url, u32 bufferSize, u32 connections, u32 memoryBudget, Handle cancelEvent) {
+    if(prefetch == NULL || url == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    data_op_prefetch* newPrefetch = (data_op_prefetch*) calloc(1, sizeof(data_op_prefetch));
+    if(newPrefetch != NULL) {
+        newPrefetch->index = index;
+        string_copy(newPrefetch->url, url, sizeof(newPrefetch->url));
+        newPrefetch->bufferSize = bufferSize;
+        newPrefetch->connections = connections;
+        newPrefetch->memoryBudget = memoryBudget;
+        newPrefetch->cancelEvent = cancelEvent;
+
+        if(R_SUCCEEDED(res = svcCreateMutex(&newPrefetch->mutex, false))) {
+            if(R_SUCCEEDED(res = svcCreateEvent(&newPrefetch->dataEvent, RESET_ONESHOT))) {
+                if(R_SUCCEEDED(res = svcCreateEvent(&newPrefetch->spaceEvent, RESET_ONESHOT))) {
+                    if(R_SUCCEEDED(res = svcCreateEvent(&newPrefetch->closeEvent, RESET_STICKY))) {
+                        if((newPrefetch->thread = threadCreate(task_prefetch_thread, newPrefetch, 0x10000, 0x18, 1, false)) == NULL) {
+                            res = R_FBI_THREAD_CREATE_FAILED;
+
+                            svcCloseHandle(newPrefetch->closeEvent);
+                        }
+                    }
+
+                    if(R_FAILED(res)) {
+                        svcCloseHandle(newPrefetch->spaceEvent);
+                    }
+                }
+
+                if(R_FAILED(res)) {
+                    svcCloseHandle(newPrefetch->dataEvent);
+                }
+            }
+
+            if(R_FAILED(res)) {
+                svcCloseHandle(newPrefetch->mutex);
+            }
+        }
+
+        if(R_SUCCEEDED(res)) {
+            *prefetch = newPrefetch;
+        } else {
+            free(newPrefetch);
+        }
+    } else {
+        res = R_FBI_OUT_OF_MEMORY;
+    }
+
+    return res;
+}
+
+bool task_prefetch_matches(data_op_prefetch* prefetch, u32 index, const char* url) {
+    return prefetch != NULL && prefetch->index == index && strncmp(prefetch->url, url, sizeof(prefetch->url)) == 0;
+}
+
+// Hands out prefetched bytes in order, waiting for more while the download is still running.
+// Returns no bytes at the end of the download, along with the download's own result.
+static Result task_prefetch_read(data_op_prefetch* prefetch, u32* bytesRead, void* buffer, u32 size) {
+    Result res = 0;
+
+    *bytesRead = 0;
+
+    svcWaitSynchronization(prefetch->mutex, U64_MAX);
+
+    while(prefetch->head == NULL && prefetch->spillRead == prefetch->spillWrite && !prefetch->done) {
+        svcReleaseMutex(prefetch->mutex);
+        svcWaitSynchronization(prefetch->dataEvent, U64_MAX);
+        svcWaitSynchronization(prefetch->mutex, U64_MAX);
+    }
+
+    if(prefetch->head != NULL) {
+        prefetch_chunk* chunk = prefetch->head;
+
+        u32 copySize = chunk->size - chunk->offset;
+        if(copySize > size) {
+            copySize = size;
+        }
+
+        memcpy(buffer, chunk->data + chunk->offset, copySize);
+        chunk->offset += copySize;
+
+        if(chunk->offset >= chunk->size) {
+            prefetch->head = chunk->next;
+            if(prefetch->head == NULL) {
+                prefetch->tail = NULL;
+            }
+
+            prefetch->memoryUsed -= chunk->size;
+            free(chunk);
+        }
+
+        *bytesRead = copySize;
+    } else if(prefetch->spillRead < prefetch->spillWrite) {
+        u64 remaining = prefetch->spillWrite - prefetch->spillRead;
+        u32 readSize = remaining < size ? (u32) remaining : size;
+
+        if(R_SUCCEEDED(res = FSFILE_Read(prefetch->spillHandle, bytesRead, prefetch->spillRead, buffer, readSize))) {
+            if(*bytesRead == 0) {
+                res = R_FBI_BAD_DATA;
+            }
+
+            prefetch->spillRead += *bytesRead;
+
+            // Drained; start over at the front of the file.
+            if(prefetch->spillRead == prefetch->spillWrite) {
+                prefetch->spillRead = 0;
+                prefetch->spillWrite = 0;
+            }
+        }
+    } else {
+        res = prefetch->result;
+    }
+
+    svcSignalEvent(prefetch->spaceEvent);
+    svcReleaseMutex(prefetch->mutex);
+
+    return res;
+}
+
+static Result task_prefetch_stream_get_size(io_stream* stream, u64* size) {
+    *size = stream->size;
+    return 0;
+}
+
+// Fills the buffer unless the download ends first, the same as HTTP streams.
+static Result task_prefetch_stream_read(io_stream* stream, u32* bytesRead, void* buffer, u64 offset, u32 size) {
+    data_op_prefetch* prefetch = (data_op_prefetch*) stream->data;
+
+    Result res = 0;
+
+    u32 total = 0;
+    while(total < size) {
+        u32 currRead = 0;
+        if(R_FAILED(res = task_prefetch_read(prefetch, &currRead, (u8*) buffer + total, size - total)) || currRead == 0) {
+            break;
+        }
+
+        total += currRead;
+    }
+
+    *bytesRead = total;
+    return res;
+}
+
+static Result task_prefetch_stream_close(io_stream* stream, bool succeeded) {
+    task_prefetch_close((data_op_prefetch*) stream->data);
+    return 0;
+}
+
+static const io_ops task_prefetch_stream_ops = {
+    .getSize = task_prefetch_stream_get_size,
+    .read = task_prefetch_stream_read,
+    .write = NULL,
+    .close = task_prefetch_stream_close
+};
+
+Result task_prefetch_open(io_stream** stream, data_op_prefetch* prefetch) {
+    if(stream == NULL || prefetch == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    svcWaitSynchronization(prefetch->mutex, U64_MAX);
+
+    // From here on the data is consumed as it arrives, and the download waits for room rather than spilling.
+    prefetch->claimed = true;
+
+    // The length is in place once the first bytes are, or the download has ended.
+    while(prefetch->head == NULL && prefetch->spillRead == prefetch->spillWrite && !prefetch->done) {
+        svcReleaseMutex(prefetch->mutex);
+        svcWaitSynchronization(prefetch->dataEvent, U64_MAX);
+        svcWaitSynchronization(prefetch->mutex, U64_MAX);
+    }
+
+    if(prefetch->head == NULL && prefetch->spillRead == prefetch->spillWrite) {
+        res = prefetch->result;
+    }
+
+    u64 size = prefetch->contentLength;
+
+    svcReleaseMutex(prefetch->mutex);
+
+    if(R_FAILED(res) || R_FAILED(res = io_open(stream, &task_prefetch_stream_ops, prefetch, 0, size))) {
+        task_prefetch_close(prefetch);
+    }
+
+    return res;
+}
+
+void task_prefetch_close(data_op_prefetch* prefetch) {
+    if(prefetch == NULL) {
+        return;
+    }
+
+    svcWaitSynchronization(prefetch->mutex, U64_MAX);
+    prefetch->cancel = true;
+    svcSignalEvent(prefetch->spaceEvent);
+    svcReleaseMutex(prefetch->mutex);
+
+    // Also wakes the download if it is waiting on a segment.
+    svcSignalEvent(prefetch->closeEvent);
+
+    threadJoin(prefetch->thread, U64_MAX);
+    threadFree(prefetch->thread);
+
+    while(prefetch->head != NULL) {
+        prefetch_chunk* next = prefetch->head->next;
+        free(prefetch->head);
+        prefetch->head = next;
+    }
+
+    if(prefetch->spillHandle != 0) {
+        FSFILE_Close(prefetch->spillHandle);
+        FSUSER_DeleteFile(prefetch->spillArchive, fsMakePath(PATH_ASCII, PREFETCH_SPILL_PATH));
+        FSUSER_CloseArchive(prefetch->spillArchive);
+    }
+
+    svcCloseHandle(prefetch->closeEvent);
+    svcCloseHandle(prefetch->spaceEvent);
+    svcCloseHandle(prefetch->dataEvent);
+    svcCloseHandle(prefetch->mutex);
+
+    free(prefetch);
+}
@@ -1,13 +1,45 @@
+#include <string.h>
+
 #include <3ds.h>
 
 #include "task.h"
+#include "../../error.h"
+#include "../../../core/bandwidth.h"
 #include "../../../core/util.h"
 
+#define TASK_QUEUE_MAX 32
+
+typedef struct {
+    const char* name;
+    void (*func)(void* arg);
+    void* arg;
+    u64 submitTime;
+} task_job;
+
+typedef struct {
+    task_job jobs[TASK_QUEUE_MAX];
+    u32 head;
+    u32 count;
+} task_queue;
+
 static bool task_quit;
 
 static Handle task_pause_event;
 static Handle task_suspend_event;
 
+static Handle task_mutex;
+static Handle task_wake_event;
+
+static Thread task_workers[TASK_WORKER_COUNT];
+static task_queue task_queues[TASK_PRIORITY_COUNT];
+static task_metrics task_stats;
+
+// Background jobs may block on prompts for their whole run, so they are capped to leave workers free for listing.
+// Icon loads follow the connection count of the list showing them.
+static u32 task_priority_limits[TASK_PRIORITY_COUNT] = {TASK_WORKER_COUNT, 2, 2};
+static const s32 task_priority_thread_priorities[TASK_PRIORITY_COUNT] = {0x18, 0x19, 0x1A};
+static const bandwidth_class task_priority_bandwidth_classes[TASK_PRIORITY_COUNT] = {BANDWIDTH_CLASS_LISTING, BANDWIDTH_CLASS_ICON, BANDWIDTH_CLASS_INSTALL};
+
 static aptHookCookie cookie;
 
 static void task_apt_hook(APT_HookType hook, void* param) {
@@ -27,6 +59,160 @@ static void task_apt_hook(APT_HookType hook, void* param) {
     }
 }
 
+static bool task_take_job(u32 workerIndex, task_job* job, task_priority* priority) {
+    for(u32 i = 0; i < TASK_PRIORITY_COUNT; i++) {
+        task_queue* queue = &task_queues[i];
+        if(queue->count > 0 && task_stats.priorities[i].running < task_priority_limits[i]) {
+            *job = queue->jobs[queue->head];
+            *priority = (task_priority) i;
+
+            queue->head = (queue->head + 1) % TASK_QUEUE_MAX;
+            queue->count--;
+
+            u64 now = osGetTime();
+            u64 wait = now - job->submitTime;
+
+            task_priority_metrics* metrics = &task_stats.priorities[i];
+            metrics->queued--;
+            metrics->running++;
+            metrics->totalWait += wait;
+            if(wait > metrics->maxWait) {
+                metrics->maxWait = wait;
+            }
+
+            task_stats.workers[workerIndex].name = job->name;
+            task_stats.workers[workerIndex].startTime = now;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void task_finish_job(u32 workerIndex, task_priority priority) {
+    u64 run = osGetTime() - task_stats.workers[workerIndex].startTime;
+
+    task_priority_metrics* metrics = &task_stats.priorities[priority];
+    metrics->running--;
+    metrics->completed++;
+    metrics->totalRun += run;
+    if(run > metrics->maxRun) {
+        metrics->maxRun = run;
+    }
+
+    task_stats.workers[workerIndex].name = NULL;
+    task_stats.workers[workerIndex].startTime = 0;
+}
+
+static void task_worker_thread(void* arg) {
+    u32 workerIndex = (u32) arg;
+
+    while(!task_quit) {
+        svcWaitSynchronization(task_pause_event, U64_MAX);
+
+        task_job job;
+        task_priority priority = TASK_PRIORITY_INTERACTIVE;
+
+        svcWaitSynchronization(task_mutex, U64_MAX);
+
+        bool found = !task_quit && task_take_job(workerIndex, &job, &priority);
+        if(!found) {
+            // Cleared under the mutex; submit and finish signal under it too, so no wakeup is lost.
+            svcClearEvent(task_wake_event);
+        }
+
+        svcReleaseMutex(task_mutex);
+
+        if(!found) {
+            svcWaitSynchronization(task_wake_event, U64_MAX);
+            continue;
+        }
+
+        svcSetThreadPriority(CUR_THREAD_HANDLE, task_priority_thread_priorities[priority]);
+        bandwidth_set_class(task_priority_bandwidth_classes[priority]);
+
+        job.func(job.arg);
+
+        svcWaitSynchronization(task_mutex, U64_MAX);
+        task_finish_job(workerIndex, priority);
+        svcSignalEvent(task_wake_event);
+        svcReleaseMutex(task_mutex);
+    }
+}
+
+Result task_submit(const char* name, task_priority priority, void (*func)(void* arg), void* arg) {
+    if(func == NULL || priority >= TASK_PRIORITY_COUNT) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    if(task_quit || task_mutex == 0) {
+        return R_FBI_THREAD_CREATE_FAILED;
+    }
+
+    Result res = 0;
+
+    svcWaitSynchronization(task_mutex, U64_MAX);
+
+    task_queue* queue = &task_queues[priority];
+    if(queue->count < TASK_QUEUE_MAX) {
+        task_job* job = &queue->jobs[(queue->head + queue->count) % TASK_QUEUE_MAX];
+        job->name = name != NULL ? name : "Unnamed";
+        job->func = func;
+        job->arg = arg;
+        job->submitTime = osGetTime();
+
+        queue->count++;
+
+        task_stats.priorities[priority].queued++;
+        task_stats.priorities[priority].submitted++;
+
+        svcSignalEvent(task_wake_event);
+    } else {
+        res = R_FBI_OUT_OF_RANGE;
+    }
+
+    svcReleaseMutex(task_mutex);
+
+    return res;
+}
+
+void task_set_icon_limit(u32 limit) {
+    if(limit < 1) {
+        limit = 1;
+    } else if(limit > TASK_ICON_LIMIT_MAX) {
+        limit = TASK_ICON_LIMIT_MAX;
+    }
+
+    // Lists call this every frame; only take the lock when something changes.
+    if(task_mutex == 0 || task_priority_limits[TASK_PRIORITY_ICON] == limit) {
+        return;
+    }
+
+    svcWaitSynchronization(task_mutex, U64_MAX);
+
+    task_priority_limits[TASK_PRIORITY_ICON] = limit;
+
+    // A raised limit may let queued jobs run.
+    svcSignalEvent(task_wake_event);
+
+    svcReleaseMutex(task_mutex);
+}
+
+void task_get_metrics(task_metrics* metrics) {
+    if(metrics == NULL) {
+        return;
+    }
+
+    if(task_mutex == 0) {
+        memset(metrics, 0, sizeof(*metrics));
+        return;
+    }
+
+    svcWaitSynchronization(task_mutex, U64_MAX);
+    *metrics = task_stats;
+    svcReleaseMutex(task_mutex);
+}
+
 void task_init() {
     task_quit = false;
 
@@ -48,6 +234,26 @@ void task_init() {
     svcSignalEvent(task_suspend_event);
 
     aptHook(&cookie, task_apt_hook, NULL);
+
+    if(R_FAILED(res = svcCreateMutex(&task_mutex, false))) {
+        util_panic("Failed to create task mutex: 0x%08lX", res);
+        return;
+    }
+
+    if(R_FAILED(res = svcCreateEvent(&task_wake_event, RESET_STICKY))) {
+        util_panic("Failed to create task wake event: 0x%08lX", res);
+        return;
+    }
+
+    memset(task_queues, 0, sizeof(task_queues));
+    memset(&task_stats, 0, sizeof(task_stats));
+
+    for(u32 i = 0; i < TASK_WORKER_COUNT; i++) {
+        if((task_workers[i] = threadCreate(task_worker_thread, (void*) i, 0x10000, 0x19, 1, false)) == NULL) {
+            util_panic("Failed to create task worker thread.");
+            return;
+        }
+    }
 }
 
 void task_exit() {
@@ -55,6 +261,35 @@ void task_exit() {
 
     aptUnhook(&cookie);
 
+    if(task_wake_event != 0) {
+        svcSignalEvent(task_wake_event);
+    }
+
+    if(task_pause_event != 0) {
+        svcSignalEvent(task_pause_event);
+    }
+
+    // Jobs are expected to notice task_is_quit_all(); one stuck on a prompt is left behind rather than hanging exit.
+    for(u32 i = 0; i < TASK_WORKER_COUNT; i++) {
+        if(task_workers[i] != NULL) {
+            if(R_SUCCEEDED(threadJoin(task_workers[i], 1000000000))) {
+                threadFree(task_workers[i]);
+            }
+
+            task_workers[i] = NULL;
+        }
+    }
+
+    if(task_wake_event != 0) {
+        svcCloseHandle(task_wake_event);
+        task_wake_event = 0;
+    }
+
+    if(task_mutex != 0) {
+        svcCloseHandle(task_mutex);
+        task_mutex = 0;
+    }
+
     if(task_pause_event != 0) {
         svcCloseHandle(task_pause_event);
         task_pause_event = 0;
@@ -8,12 +8,13 @@ typedef struct ui_view_s ui_view;
 
 #define FILE_NAME_MAX 512
 #define FILE_PATH_MAX 512
-#define PROMPT_YES 0
 #define copyBytesPerSecond bytesPerSecond
 #define copyBufferSize bufferSize
 
 typedef struct linked_list_s linked_list;
+typedef struct io_stream_s io_stream;
 typedef struct list_item_s list_item;
+typedef struct list_icon_ops_s list_icon_ops;
 
 typedef struct titledb_cache_entry_s {
     u32 id;
@@ -122,6 +123,64 @@ typedef struct capture_cam_data_s {
     Handle cancelEvent;
 } capture_cam_data;
 
+typedef struct data_op_buffer_tuning_s {
+    bool active;
+    u32 candidate;
+    u64 startTime;
+    u64 bytes;
+    u32 bestSize;
+    u32 bestBytesPerSecond;
+} data_op_buffer_tuning;
+
+typedef struct data_op_journal_s {
+    u32 op;
+    u32 index;
+    u64 currProcessed;
+    u64 currTotal;
+    u32 hash;
+    char srcIdentity[DOWNLOAD_URL_MAX];
+    char dstIdentity[FILE_PATH_MAX];
+} data_op_journal;
+
+#define DATAOP_BATCH_FAILURES_MAX 64
+#define DATAOP_FAILURE_MESSAGE_MAX 128
+
+typedef struct data_op_failure_s {
+    u32 index;
+    Result result;
+    u32 attempts;
+    bool final;
+    char message[DATAOP_FAILURE_MESSAGE_MAX];
+} data_op_failure;
+
+typedef enum data_op_phase_e {
+    DATAOP_PHASE_OPEN_SRC,
+    DATAOP_PHASE_READ,
+    DATAOP_PHASE_CLOSE_SRC,
+    DATAOP_PHASE_OPEN_DST,
+    DATAOP_PHASE_WRITE,
+    DATAOP_PHASE_CLOSE_DST,
+    DATAOP_PHASE_CHECK_RUNNING,
+
+    DATAOP_PHASE_COUNT
+} data_op_phase;
+
+// Bucket i holds samples of [2^i, 2^(i+1)) microseconds; bucket 0 also holds anything under 1us.
+#define DATAOP_HISTOGRAM_BUCKETS 32
+
+typedef struct data_op_histogram_s {
+    u32 count;
+    u64 totalUs;
+    u64 maxUs;
+    u64 bytes;
+    u32 buckets[DATAOP_HISTOGRAM_BUCKETS];
+} data_op_histogram;
+
+typedef struct data_op_trace_s data_op_trace;
+typedef struct data_op_prefetch_s data_op_prefetch;
+
+#define DATAOP_PREFETCH_MEMORY_DEFAULT (4 * 1024 * 1024)
+
 typedef enum data_op_e {
     DATAOP_COPY,
     DATAOP_DOWNLOAD,
@@ -144,36 +203,67 @@ typedef struct data_op_data_s {
     u32 estimatedRemainingSeconds;
 
     u32 bufferSize;
+    u32 bufferCount;
+    const char* bufferSizeKey;
 
-    Result (*openDst)(void* data, u32 index, void* initialReadBlock, u64 size, u32* handle);
-    Result (*closeDst)(void* data, u32 index, bool succeeded, u32 handle);
-
-    Result (*writeDst)(void* data, u32 handle, u32* bytesWritten, void* buffer, u64 offset, u32 size);
+    // Streams are closed through closeSrc and closeDst when set, and with io_close otherwise.
+    Result (*openDst)(void* data, u32 index, void* initialReadBlock, u64 size, io_stream** stream);
+    Result (*closeDst)(void* data, u32 index, bool succeeded, io_stream* stream);
 
     // Copy
     bool copyEmpty;
+    u32 workerCount;
+
+    u64 copiedBytes;
+    u64 skippedBytes;
 
     Result (*isSrcDirectory)(void* data, u32 index, bool* isDirectory);
     Result (*makeDstDirectory)(void* data, u32 index);
 
-    Result (*openSrc)(void* data, u32 index, u32* handle);
-    Result (*closeSrc)(void* data, u32 index, bool succeeded, u32 handle);
+    Result (*openSrc)(void* data, u32 index, io_stream** stream);
+    Result (*closeSrc)(void* data, u32 index, bool succeeded, io_stream* stream);
+
+    // Returns R_FBI_SKIPPED if the destination is already up to date.
+    Result (*checkDst)(void* data, u32 index, io_stream* src, u64 size);
 
-    Result (*getSrcSize)(void* data, u32 handle, u64* size);
-    Result (*readSrc)(void* data, u32 handle, u32* bytesRead, void* buffer, u64 offset, u32 size);
+    // Download; sources are opened with io_open_http. More than one connection fetches large files as concurrent
+    // ranged requests.
+    u32 downloadConnections;
+    // When non-zero, the next item starts downloading while the current one finalizes; up to this many bytes are held
+    // in memory, the rest is spilled to the SD card until the item is reached.
+    u32 prefetchMemory;
 
-    // Download
     Result (*getSrcUrl)(void* data, u32 index, char* url, size_t maxSize);
 
     // Delete
     Result (*delete)(void* data, u32 index);
 
-    // Suspend
+    // Journal
+    const char* journalName;
+
+    Result (*getSrcIdentity)(void* data, u32 index, char* identity, size_t maxSize);
+    Result (*getDstIdentity)(void* data, u32 index, io_stream* dst, char* identity, size_t maxSize);
+
+    // Reopens a destination for reading back what it holds and writing the rest.
+    Result (*resumeDst)(void* data, u32 index, const char* identity, io_stream** stream);
+
+    // Suspend; never called from more than one thread at a time, even when workers copy items concurrently.
     Result (*suspend)(void* data, u32 index);
     Result (*restore)(void* data, u32 index);
 
     // Errors
     bool (*error)(void* data, u32 index, Result res, ui_view** errorView);
+    // Optional; the text listed for a failed item in the batch summary. Defaults to the result's description.
+    void (*describeError)(void* data, u32 index, Result res, char* message, size_t size);
+
+    // Batch; when set, failures never prompt. Transient ones are retried with exponential backoff,
+    // permanent ones are skipped, and a summary is shown once the operation ends.
+    bool batch;
+    u32 batchMaxRetries;
+    u32 batchBackoffMs;
+
+    // Never displays prompts; only valid together with batch. Interrupted transfers are resumed without asking.
+    bool headless;
 
     // General
     volatile bool finished;
@@ -182,6 +272,21 @@ typedef struct data_op_data_s {
 
     // Internal
     volatile bool retryResponse;
+    data_op_buffer_tuning tuning;
+    volatile bool resumeResponse;
+    bool journalActive;
+    bool journalResume;
+    data_op_journal journal;
+    u32 journalSequence;
+    u64 journalCheckpoint;
+    data_op_failure failures[DATAOP_BATCH_FAILURES_MAX];
+    u32 failureCount;
+    u32 failedItems;
+    u32 recoveredItems;
+    data_op_histogram histograms[DATAOP_PHASE_COUNT];
+    data_op_trace* trace;
+    data_op_prefetch* prefetch;
+    Handle suspendLock;
 } data_op_data;
 
 typedef struct populate_ext_save_data_data_s {
@@ -204,6 +309,8 @@ typedef struct populate_files_data_s {
 
     bool recursive;
     bool includeBase;
+    // Leaves CIA icons for the list to load as their rows come into view.
+    bool deferIcons;
 
     bool (*filter)(void* data, const char* name, u32 attributes);
     void* filterData;
@@ -249,6 +356,8 @@ typedef struct populate_titles_data_s {
     Handle cancelEvent;
 } populate_titles_data;
 
+#define TITLEDB_ICON_CONNECTIONS_DEFAULT 4
+
 typedef struct populate_titledb_data_s {
     void* userData;
     bool (*filter)(void* data, titledb_info* info);
@@ -256,21 +365,84 @@ typedef struct populate_titledb_data_s {
     volatile bool itemsListed;
     linked_list* items;
 
+    // Set before finishing when the downloaded catalogue differs from the cached one already listed.
+    linked_list* refreshItems;
+
     volatile bool finished;
     Result result;
     Handle cancelEvent;
     Handle resumeEvent;
 } populate_titledb_data;
 
+#define TASK_WORKER_COUNT 8
+// Icon loads may take every worker but three: two for background jobs and one always left for listing.
+#define TASK_ICON_LIMIT_MAX (TASK_WORKER_COUNT - 3)
+
+typedef enum task_priority_e {
+    TASK_PRIORITY_INTERACTIVE,
+    TASK_PRIORITY_ICON,
+    TASK_PRIORITY_BACKGROUND,
+    TASK_PRIORITY_COUNT
+} task_priority;
+
+// Times are in milliseconds.
+typedef struct task_priority_metrics_s {
+    u32 submitted;
+    u32 queued;
+    u32 running;
+    u32 completed;
+
+    u64 totalWait;
+    u64 maxWait;
+    u64 totalRun;
+    u64 maxRun;
+} task_priority_metrics;
+
+typedef struct task_worker_metrics_s {
+    const char* name;
+    u64 startTime;
+} task_worker_metrics;
+
+typedef struct task_metrics_s {
+    task_priority_metrics priorities[TASK_PRIORITY_COUNT];
+    task_worker_metrics workers[TASK_WORKER_COUNT];
+} task_metrics;
+
 void task_init();
 void task_exit();
 bool task_is_quit_all();
 Handle task_get_pause_event();
 Handle task_get_suspend_event();
+Result task_submit(const char* name, task_priority priority, void (*func)(void* arg), void* arg);
+// Caps how many TASK_PRIORITY_ICON jobs run at once; set by the list currently loading icons.
+void task_set_icon_limit(u32 limit);
+void task_get_metrics(task_metrics* metrics);
 
 Result task_capture_cam(capture_cam_data* data);
 
 Result task_data_op(data_op_data* data);
+// Runs the operation on the calling thread and returns its result once finished.
+Result task_data_op_run(data_op_data* data);
+bool task_data_op_is_transient(Result res);
+
+Result task_journal_load(const char* name, data_op_journal* journal, u32* sequence);
+Result task_journal_save(const char* name, data_op_journal* journal, u32 sequence);
+Result task_journal_delete(const char* name);
+Result task_journal_verify(io_stream* dst, u64 size, u32 hash, u32 bufferSize);
+
+const char* task_trace_phase_name(data_op_phase phase);
+void task_trace_histogram_add(data_op_histogram* histogram, u64 us, u32 bytes);
+void task_trace_histogram_merge(data_op_histogram* dst, const data_op_histogram* src);
+u64 task_trace_histogram_percentile(const data_op_histogram* histogram, u32 percent);
+Result task_trace_open(data_op_trace** trace);
+void task_trace_record(data_op_trace* trace, data_op_phase phase, u32 index, u64 start, u64 end, u32 bytes);
+Result task_trace_close(data_op_trace* trace);
+
+Result task_prefetch_start(data_op_prefetch** prefetch, u32 index, const char* url, u32 bufferSize, u32 connections, u32 memoryBudget, Handle cancelEvent);
+bool task_prefetch_matches(data_op_prefetch* prefetch, u32 index, const char* url);
+// Hands the prefetched item on as a source stream; closing the stream closes the prefetch.
+Result task_prefetch_open(io_stream** stream, data_op_prefetch* prefetch);
+void task_prefetch_close(data_op_prefetch* prefetch);
 
 void task_free_ext_save_data(list_item* item);
 void task_clear_ext_save_data(linked_list* items);
@@ -280,6 +452,7 @@ void task_free_file(list_item* item);
 void task_clear_files(linked_list* items);
 Result task_create_file_item(list_item** out, FS_Archive archive, const char* path, u32 attributes);
 Result task_populate_files(populate_files_data* data);
+extern const list_icon_ops task_file_icon_ops;
 
 void task_free_pending_title(list_item* item);
 void task_clear_pending_titles(linked_list* items);
@@ -296,7 +469,12 @@ Result task_populate_tickets(populate_tickets_data* data);
 void task_free_title(list_item* item);
 void task_clear_titles(linked_list* items);
 Result task_populate_titles(populate_titles_data* data);
+extern const list_icon_ops task_title_icon_ops;
 
 void task_free_titledb(list_item* item);
 void task_clear_titledb(linked_list* items);
 Result task_populate_titledb(populate_titledb_data* data);
+// Replaces the listed items with a finished refresh; must be called from the main thread.
+void task_apply_titledb_refresh(populate_titledb_data* data);
+void task_discard_titledb_refresh(populate_titledb_data* data);
+extern const list_icon_ops task_titledb_icon_ops;
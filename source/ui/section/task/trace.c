@@ -0,0 +1,245 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef FBI_HOST
+#include <sys/stat.h>
+
+#include "../../../core/iohost.h"
+#else
+#include <3ds.h>
+#endif
+
+#include "task.h"
+#include "../../error.h"
+#include "../../../core/io.h"
+
+#define TRACE_MAGIC 0x54494246 // "FBIT"
+#define TRACE_VERSION 1
+
+#define TRACE_DIR "/fbi/trace/"
+#define TRACE_BUFFER_RECORDS 512
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 tickRate;
+    u32 recordSize;
+    u32 reserved;
+} trace_header;
+
+typedef struct {
+    u64 start;
+    u64 duration;
+    u32 bytes;
+    u32 index;
+    u16 phase;
+    u16 reserved;
+    u32 thread;
+} trace_record;
+
+struct data_op_trace_s {
+    Handle mutex;
+    io_stream* file;
+    u64 offset;
+
+    u32 count;
+    trace_record records[TRACE_BUFFER_RECORDS];
+};
+
+static const char* task_trace_phase_names[DATAOP_PHASE_COUNT] = {"Open source", "Read", "Close source", "Open destination", "Write", "Close destination", "Check running"};
+
+const char* task_trace_phase_name(data_op_phase phase) {
+    return phase < DATAOP_PHASE_COUNT ? task_trace_phase_names[phase] : "Unknown";
+}
+
+void task_trace_histogram_add(data_op_histogram* histogram, u64 us, u32 bytes) {
+    u32 bucket = 0;
+    while(bucket < DATAOP_HISTOGRAM_BUCKETS - 1 && (us >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+
+    histogram->count++;
+    histogram->totalUs += us;
+    histogram->bytes += bytes;
+    histogram->buckets[bucket]++;
+
+    if(us > histogram->maxUs) {
+        histogram->maxUs = us;
+    }
+}
+
+void task_trace_histogram_merge(data_op_histogram* dst, const data_op_histogram* src) {
+    dst->count += src->count;
+    dst->totalUs += src->totalUs;
+    dst->bytes += src->bytes;
+
+    if(src->maxUs > dst->maxUs) {
+        dst->maxUs = src->maxUs;
+    }
+
+    for(u32 i = 0; i < DATAOP_HISTOGRAM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+// Returns the upper bound of the bucket holding the given percentile, clamped to the largest sample.
+u64 task_trace_histogram_percentile(const data_op_histogram* histogram, u32 percent) {
+    if(histogram->count == 0) {
+        return 0;
+    }
+
+    u64 target = ((u64) histogram->count * percent + 99) / 100;
+    u64 seen = 0;
+
+    for(u32 i = 0; i < DATAOP_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if(seen >= target) {
+            u64 bound = ((u64) 1 << (i + 1)) - 1;
+            return bound < histogram->maxUs ? bound : histogram->maxUs;
+        }
+    }
+
+    return histogram->maxUs;
+}
+
+static Result task_trace_flush(data_op_trace* trace) {
+    Result res = 0;
+
+    if(trace->count > 0) {
+        u32 size = trace->count * sizeof(trace_record);
+
+        u32 bytesWritten = 0;
+        if(R_SUCCEEDED(res = io_write(trace->file, &bytesWritten, trace->records, trace->offset, size))) {
+            trace->offset += bytesWritten;
+        }
+
+        trace->count = 0;
+    }
+
+    return res;
+}
+
+// Tracing is opt-in; a trace is only written when the trace directory already exists.
+#ifdef FBI_HOST
+// The working directory stands in for the SD card root.
+static Result task_trace_open_file(io_stream** stream, const char* path) {
+    struct stat st;
+    if(stat(TRACE_DIR + 1, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return R_FBI_BAD_DATA;
+    }
+
+    return io_open_posix(stream, path + 1, "wb");
+}
+#else
+static Result task_trace_open_file(io_stream** stream, const char* path) {
+    Result res = 0;
+
+    FS_Archive sdmcArchive = 0;
+    if(R_SUCCEEDED(res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        Handle dirHandle = 0;
+        if(R_SUCCEEDED(res = FSUSER_OpenDirectory(&dirHandle, sdmcArchive, fsMakePath(PATH_ASCII, TRACE_DIR)))) {
+            FSDIR_Close(dirHandle);
+
+            res = io_open_file(stream, sdmcArchive, path, FS_OPEN_WRITE | FS_OPEN_CREATE, 0);
+        }
+
+        FSUSER_CloseArchive(sdmcArchive);
+    }
+
+    return res;
+}
+#endif
+
+Result task_trace_open(data_op_trace** trace) {
+    if(trace == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = 0;
+
+    char path[FILE_PATH_MAX];
+
+    time_t t = time(NULL);
+    strftime(path, sizeof(path), TRACE_DIR "%m-%d-%y_%H-%M-%S.bin", localtime(&t));
+
+    io_stream* file = NULL;
+    if(R_SUCCEEDED(res = task_trace_open_file(&file, path))) {
+        data_op_trace* newTrace = (data_op_trace*) calloc(1, sizeof(data_op_trace));
+        if(newTrace != NULL) {
+            newTrace->file = file;
+
+            if(R_SUCCEEDED(res = svcCreateMutex(&newTrace->mutex, false))) {
+                trace_header header;
+                memset(&header, 0, sizeof(header));
+
+                header.magic = TRACE_MAGIC;
+                header.version = TRACE_VERSION;
+                header.tickRate = SYSCLOCK_ARM11;
+                header.recordSize = sizeof(trace_record);
+
+                u32 bytesWritten = 0;
+                if(R_SUCCEEDED(res = io_write(file, &bytesWritten, &header, 0, sizeof(header)))) {
+                    newTrace->offset = bytesWritten;
+                } else {
+                    svcCloseHandle(newTrace->mutex);
+                }
+            }
+
+            if(R_SUCCEEDED(res)) {
+                *trace = newTrace;
+            } else {
+                free(newTrace);
+            }
+        } else {
+            res = R_FBI_OUT_OF_MEMORY;
+        }
+
+        if(R_FAILED(res)) {
+            io_close(file, false);
+        }
+    }
+
+    return res;
+}
+
+void task_trace_record(data_op_trace* trace, data_op_phase phase, u32 index, u64 start, u64 end, u32 bytes) {
+    u32 thread = 0;
+    svcGetThreadId(&thread, CUR_THREAD_HANDLE);
+
+    svcWaitSynchronization(trace->mutex, U64_MAX);
+
+    trace_record* record = &trace->records[trace->count++];
+    record->start = start;
+    record->duration = end - start;
+    record->bytes = bytes;
+    record->index = index;
+    record->phase = (u16) phase;
+    record->reserved = 0;
+    record->thread = thread;
+
+    if(trace->count >= TRACE_BUFFER_RECORDS) {
+        task_trace_flush(trace);
+    }
+
+    svcReleaseMutex(trace->mutex);
+}
+
+Result task_trace_close(data_op_trace* trace) {
+    if(trace == NULL) {
+        return R_FBI_INVALID_ARGUMENT;
+    }
+
+    Result res = task_trace_flush(trace);
+
+    Result closeRes = io_close(trace->file, R_SUCCEEDED(res));
+    if(R_SUCCEEDED(res)) {
+        res = closeRes;
+    }
+
+    svcCloseHandle(trace->mutex);
+    free(trace);
+
+    return res;
+}
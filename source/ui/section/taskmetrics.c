@@ -0,0 +1,83 @@
+#include <stdio.h>
+
+#include <3ds.h>
+#include <jansson.h>
+
+#include "section.h"
+#include "task/task.h"
+#include "../info.h"
+#include "../ui.h"
+#include "../../core/bandwidth.h"
+#include "../../core/bufpool.h"
+#include "../../core/http.h"
+
+static const char* taskmetrics_priority_names[TASK_PRIORITY_COUNT] = {"Listing", "Icons", "Background"};
+static const char* taskmetrics_heap_names[BUFPOOL_HEAP_COUNT] = {"Heap", "Linear"};
+
+static void taskmetrics_update(ui_view* view, void* data, float* progress, char* text) {
+    if(hidKeysDown() & KEY_B) {
+        ui_pop();
+        info_destroy(view);
+
+        return;
+    }
+
+    task_metrics metrics;
+    task_get_metrics(&metrics);
+
+    size_t len = 0;
+
+    for(u32 i = 0; i < TASK_PRIORITY_COUNT && len < PROGRESS_TEXT_MAX; i++) {
+        task_priority_metrics* priority = &metrics.priorities[i];
+
+        u64 avgWait = priority->completed + priority->running > 0 ? priority->totalWait / (priority->completed + priority->running) : 0;
+        u64 avgRun = priority->completed > 0 ? priority->totalRun / priority->completed : 0;
+
+        len += snprintf(text + len, PROGRESS_TEXT_MAX - len, "%s: %lu run, %lu queued, %lu done\nWait %llu/%llu ms, Run %llu/%llu ms (avg/max)\n",
+                        taskmetrics_priority_names[i], priority->running, priority->queued, priority->completed, avgWait, priority->maxWait, avgRun, priority->maxRun);
+    }
+
+    if(len < PROGRESS_TEXT_MAX) {
+        len += snprintf(text + len, PROGRESS_TEXT_MAX - len, "Link: Install %lu KiB/s, Listing %lu KiB/s, Icons %lu KiB/s\n",
+                        bandwidth_get_rate(BANDWIDTH_CLASS_INSTALL) / 1024, bandwidth_get_rate(BANDWIDTH_CLASS_LISTING) / 1024, bandwidth_get_rate(BANDWIDTH_CLASS_ICON) / 1024);
+    }
+
+    for(u32 i = 0; i < BUFPOOL_HEAP_COUNT && len < PROGRESS_TEXT_MAX; i++) {
+        bufpool_stats pool;
+        bufpool_get_stats((bufpool_heap) i, &pool);
+
+        len += snprintf(text + len, PROGRESS_TEXT_MAX - len, "%s buffers: %lu KiB used, %lu KiB cached, %lu KiB peak, %lu/%lu reused\n",
+                        taskmetrics_heap_names[i], pool.outstandingBytes / 1024, pool.cachedBytes / 1024, pool.peakBytes / 1024, pool.reused, pool.allocs);
+    }
+
+    if(len < PROGRESS_TEXT_MAX) {
+        http_pool_stats httpPool;
+        http_get_pool_stats(&httpPool);
+
+        u64 avgFirstByte = httpPool.requests > 0 ? httpPool.firstByteMs / httpPool.requests : 0;
+
+        len += snprintf(text + len, PROGRESS_TEXT_MAX - len, "HTTP: %lu requests, %lu connections, %lu reused, %lu idle, %llu ms to first byte (avg), %lu served from cache\n",
+                        httpPool.requests, httpPool.connections, httpPool.reused, httpPool.idle, avgFirstByte, httpPool.cached);
+    }
+
+    u64 now = osGetTime();
+    u32 idle = 0;
+
+    for(u32 i = 0; i < TASK_WORKER_COUNT && len < PROGRESS_TEXT_MAX; i++) {
+        task_worker_metrics* worker = &metrics.workers[i];
+
+        if(worker->name != NULL) {
+            len += snprintf(text + len, PROGRESS_TEXT_MAX - len, "\n%s (%llu ms)", worker->name, now - worker->startTime);
+        } else {
+            idle++;
+        }
+    }
+
+    if(len < PROGRESS_TEXT_MAX) {
+        snprintf(text + len, PROGRESS_TEXT_MAX - len, "\n%lu of %d workers idle", idle, TASK_WORKER_COUNT);
+    }
+}
+
+void taskmetrics_open() {
+    info_display("Task Metrics", "B: Return", false, NULL, taskmetrics_update, NULL);
+}
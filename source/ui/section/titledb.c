@@ -92,6 +92,7 @@ static void titledb_update(ui_view* view, void* data, linked_list* items, list_i
 
         ui_pop();
 
+        task_discard_titledb_refresh(&listData->populateData);
         task_clear_titledb(items);
         list_destroy(view);
 
@@ -116,6 +117,12 @@ static void titledb_update(ui_view* view, void* data, linked_list* items, list_i
         listData->populated = true;
     }
 
+    // The selected item is among those replaced, so wait for the next frame before acting on it.
+    if(listData->populateData.finished && listData->populateData.refreshItems != NULL) {
+        task_apply_titledb_refresh(&listData->populateData);
+        return;
+    }
+
     if(listData->populateData.finished && R_FAILED(listData->populateData.result)) {
         error_display_res(NULL, NULL, listData->populateData.result, "Failed to populate TitleDB list.");
 
@@ -138,5 +145,5 @@ void titledb_open() {
 
     data->populateData.finished = true;
 
-    list_display("https://discord.gg/ptQg9kM", "A: Select, B: Return, X: Refresh", data, titledb_update, titledb_draw_top);
+    list_set_icon_ops(list_display("https://discord.gg/ptQg9kM", "A: Select, B: Return, X: Refresh", data, titledb_update, titledb_draw_top), &task_titledb_icon_ops, TITLEDB_ICON_CONNECTIONS_DEFAULT);
 }
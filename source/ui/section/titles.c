@@ -300,5 +300,5 @@ void titles_open() {
     data->showNAND = true;
     data->sortByName = true;
 
-    list_display("Titles", "A: Select, B: Return, X: Refresh, Select: Options", data, titles_update, titles_draw_top);
+    list_set_icon_ops(list_display("Titles", "A: Select, B: Return, X: Refresh, Select: Options", data, titles_update, titles_draw_top), &task_title_icon_ops, 1);
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+# coding: utf-8 -*-
+
+import json
+import struct
+import sys
+
+if len(sys.argv) < 2 or len(sys.argv) > 3:
+    print('Usage:', sys.argv[0], '<trace file> [output file]')
+    sys.exit(1)
+
+trace_magic = 0x54494246 # "FBIT"
+trace_version = 1
+
+header_format = '<IIQII'
+record_format = '<QQIIHHI'
+
+phase_names = ['Open source', 'Read', 'Close source', 'Open destination', 'Write', 'Close destination', 'Check running']
+
+input_path = sys.argv[1]
+output_path = sys.argv[2] if len(sys.argv) == 3 else input_path.rsplit('.', 1)[0] + '.json'
+
+with open(input_path, 'rb') as f:
+    data = f.read()
+
+header_size = struct.calcsize(header_format)
+if len(data) < header_size:
+    print('Trace file is truncated.')
+    sys.exit(1)
+
+magic, version, tick_rate, record_size, _ = struct.unpack_from(header_format, data, 0)
+if magic != trace_magic or version != trace_version or record_size != struct.calcsize(record_format):
+    print('Not an FBI trace file, or an unsupported version.')
+    sys.exit(1)
+
+records = []
+for offset in range(header_size, len(data) - record_size + 1, record_size):
+    records.append(struct.unpack_from(record_format, data, offset))
+
+base = min([record[0] for record in records]) if records else 0
+
+def to_us(ticks):
+    return ticks * 1000000.0 / tick_rate
+
+events = []
+threads = set()
+
+for start, duration, size, index, phase, _, thread in records:
+    threads.add(thread)
+    events.append({
+        'name': phase_names[phase] if phase < len(phase_names) else 'Phase %d' % phase,
+        'cat': 'dataop',
+        'ph': 'X',
+        'ts': to_us(start - base),
+        'dur': to_us(duration),
+        'pid': 1,
+        'tid': thread,
+        'args': {'item': index, 'bytes': size}
+    })
+
+for thread in sorted(threads):
+    events.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': thread, 'args': {'name': 'Thread %d' % thread}})
+
+with open(output_path, 'w') as f:
+    json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, f)
+
+print('Wrote', len(records), 'events to', output_path)